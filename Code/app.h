@@ -10,18 +10,37 @@
 #include "mesh.h"
 #include "program.h"
 #include "texture.h"
+#include "texture_streaming.h"
 #include "ImGuizmo.h"
 #include "ssao.h"
-
-static const char* RenderingModeStr[] = {"FORWARD", "DEFERRED"};
+#include "impostor.h"
+#include "material_batching.h"
+#include "virtual_texturing.h"
+#include "gpu_memory.h"
+#include "cpu_memory.h"
+#include "asset_loader.h"
+#include "world_partition.h"
+#include "clustered_lighting.h"
+#include "light_volumes.h"
+#include "forward_plus.h"
+#include "depth_prepass.h"
+#include "temporal.h"
+#include "tile_classification.h"
+#include "cone_step_map.h"
+#include "shader_permutation.h"
+#include "gpu_timer.h"
+#include "gltf_model_loading.h"
+
+static const char* RenderingModeStr[] = {"FORWARD", "DEFERRED", "FORWARD+"};
 
 enum RenderingMode
 {
     FORWARD,
-    DEFERRED
+    DEFERRED,
+    FORWARD_PLUS // See ForwardPlus
 };
 
-static const char* GBufferModeStr[] = { "COLOR", "NORMAL", "TANGENT", "BUMP", "POSITION", "SPECULAR", "SSAO", "DEPTH", "FINAL" };
+static const char* GBufferModeStr[] = { "COLOR", "NORMAL", "TANGENT", "BUMP", "POSITION", "SPECULAR", "SSAO", "DEPTH", "FINAL", "OVERDRAW" };
 
 enum GBufferMode
 {
@@ -33,7 +52,18 @@ enum GBufferMode
     SPECULAR,
     SSAO,
     DEPTH,
-    FINAL
+    FINAL,
+    OVERDRAW // Fragments shaded per pixel by the geometry pass, see DepthPrepass
+};
+
+static const char* GBufferLayoutStr[] = { "FULL", "COMPACT" };
+
+// COMPACT rebuilds the position from depth and stores normal and tangent octahedral encoded,
+// specular and bump share a two channel target. Roughly 18 bytes per pixel instead of 44
+enum class GBufferLayout
+{
+    FULL,
+    COMPACT
 };
 
 struct ImGuizmoData 
@@ -78,8 +108,34 @@ struct App
     u32 gPositionTextureIdx;
     u32 gSpecularTextureIdx;
     u32 gFinalResultTextureIdx;
+
+    // Compact G Buffer, see GBufferLayout
+    Buffer compactFrameBufferObject;
+    u32 gNormalTangentTextureIdx;
+    u32 gMasksTextureIdx;
+    GBufferLayout gBufferLayout = GBufferLayout::FULL;
+    DepthPrepass depthPrepass;
+
+    // Deferred lighting, see LightingMode. The timer spans the light culling, shading and light volume passes
+    LightingMode lightingMode = LightingMode::CLUSTERED;
+    GpuTimer lightingTimer;
+
+    // Motion vectors, history buffers and the TAA resolve
+    TemporalReprojection temporal;
+
+    // Per tile shading variants of the deferred shading pass
+    TileClassification tileClassification;
+
+    // Parallax of the geometry pass, see ConeStepMapSupport
+    ConeStepMapping coneStepMapping;
+
+    // Material variants of the lit and geometry programs
+    ShaderPermutations shaderPermutations;
     
     bool drawWireFrame = false;
+    bool useMeshletCulling = true;
+    bool useBackFaceCulling = false; // GL_CULL_FACE in the deferred geometry pass, the meshlet normal cone test only runs with it
+    MeshletCullStats meshletCullStats;
     RenderingMode renderingMode = RenderingMode::DEFERRED;
     GBufferMode gBufferMode = GBufferMode::FINAL;
 
@@ -90,6 +146,46 @@ struct App
     u32 ssaoNoiseTextureIdx;
     u32 deferredSSAOProgramIdx;
     
+    // Impostors (far field representation of models)
+    std::vector<Impostor> impostors;
+    u32 impostorBakeProgramIdx;
+    u32 impostorProgramIdx;
+    bool useImpostors = true;
+    f32 impostorDistance = 40.0f;
+    u32 impostorsDrawn = 0;
+
+    // Materials in a storage buffer and textures in arrays (or bindless), one multi draw per mesh in the geometry pass
+    MaterialBatching materialBatching;
+    bool useMaterialBatching = true;
+
+    // Material textures paged in from the texture cache on demand (enabled in virtualTexturing)
+    VirtualTexturing virtualTexturing;
+
+    // Imported glTF files, their meshes are regular models and the node hierarchy is kept here
+    std::vector<GltfScene> gltfScenes;
+
+    // Models read by workers and created on the main thread, see AssetLoaderSupport
+    AssetLoader assetLoader;
+    WorldPartition worldPartition;
+    ClusteredLighting clusteredLighting;
+    LightVolumes lightVolumes;
+    ForwardPlus forwardPlus;
+
+    // Model loading stats (startup benchmark of the import and mesh cache paths)
+    f64 modelLoadingTimeMs = 0.0;
+    u32 modelsLoaded = 0;
+    u32 modelCacheHits = 0;
+    GeometryResidency geometryResidency = GeometryResidency::RELEASE; // Applied to the next loads, nothing reads the CPU copies once uploaded
+
+    // Background texture decode and budgeted upload
+    TextureStreamer textureStreamer;
+
+    // Estimated video memory per category and the texture budget
+    GpuMemory gpuMemory;
+
+    // System memory held by each subsystem
+    CpuMemory cpuMemory;
+
     // Camera
     Camera camera;
     glm::mat4 projectionMat;
@@ -0,0 +1,180 @@
+﻿#include "asset_loader.h"
+
+#include <filesystem>
+
+#include "app.h"
+#include "engine.h"
+
+void AssetLoaderSupport::Init(App* app)
+{
+    // The main thread runs the creations meanwhile
+    const u32 workerCount = std::max(std::thread::hardware_concurrency(), 2u) - 1;
+    TaskGraphSupport::Start(app->assetLoader.graph, workerCount);
+}
+
+void AssetLoaderSupport::Shutdown(App* app)
+{
+    TaskGraphSupport::Stop(app->assetLoader.graph);
+}
+
+static u32 QueueModelRequest(App* app, const char* filename, const u32 loadingFlags, const bool timeSliced, const ModelSpawn& spawn,
+    const u32 targetModelIdx = UINT32_MAX)
+{
+    AssetLoader& loader = app->assetLoader;
+    const u32 requestIdx = static_cast<u32>(loader.modelRequests.size());
+    loader.modelRequests.emplace_back();
+    ModelRequest& request = loader.modelRequests.back();
+    request.filename = filename;
+    request.loadingFlags = loadingFlags;
+    request.timeSliced = timeSliced;
+    request.targetModelIdx = targetModelIdx;
+    request.spawn = spawn;
+    request.requestMs = TaskGraphSupport::TimeMs();
+
+    // The source size weighs the progress, a parse takes longer than a cache mapping of the same file but both scale with it
+    std::error_code error;
+    const u64 fileBytes = std::max<u64>(std::filesystem::file_size(filename, error), 1);
+    const u64 readCost = error ? 1 : fileBytes;
+
+    request.readTaskIdx = TaskGraphSupport::AddTask(loader.graph, "Read " + request.filename, [&request]()
+    {
+        AssimpSupport::ReadModel(request.filename.c_str(), request.loadingFlags, request.import);
+    }, false, {}, readCost);
+
+    std::vector<u32> createDependencies = { request.readTaskIdx };
+    if (loader.lastCreateTaskIdx != UINT32_MAX)
+        createDependencies.push_back(loader.lastCreateTaskIdx);
+    request.createTaskIdx = TaskGraphSupport::AddTask(loader.graph, "Create " + request.filename, [app, &request, requestIdx]()
+    {
+        if (!request.timeSliced)
+        {
+            request.modelIdx = AssimpSupport::CreateModel(app, request.import);
+            request.state = request.modelIdx != UINT32_MAX ? ModelRequestState::RESIDENT : ModelRequestState::FAILED;
+            request.import = ModelImport(); // The vectors were moved into the app or released
+            return;
+        }
+
+        // Only the materials, the model and empty buffers here, Update fills them within its budget
+        request.modelIdx = AssimpSupport::BeginCreateModel(app, request.import, request.targetModelIdx);
+        if (request.modelIdx == UINT32_MAX)
+        {
+            ELOG("Runtime import of %s failed", request.filename.c_str())
+            request.state = ModelRequestState::FAILED;
+            request.import = ModelImport();
+            return;
+        }
+        const Mesh& mesh = app->meshes[app->models[request.modelIdx].meshIdx];
+        request.totalBytes = static_cast<u64>(mesh.vertexBuffer.size) + mesh.indexBuffer.size;
+        request.state = ModelRequestState::UPLOADING;
+        app->assetLoader.uploadingRequests.push_back(requestIdx);
+    }, true, createDependencies, std::max<u64>(readCost / ASSET_LOADER_CREATE_COST_DIVISOR, 1));
+    loader.lastCreateTaskIdx = request.createTaskIdx;
+
+    return requestIdx;
+}
+
+u32 AssetLoaderSupport::RequestModel(App* app, const char* filename, const u32 loadingFlags)
+{
+    return QueueModelRequest(app, filename, loadingFlags, false, ModelSpawn());
+}
+
+u32 AssetLoaderSupport::ImportModelAsync(App* app, const char* filename, const u32 loadingFlags, const ModelSpawn& spawn)
+{
+    return QueueModelRequest(app, filename, loadingFlags, true, spawn);
+}
+
+u32 AssetLoaderSupport::ReloadModelAsync(App* app, const u32 modelIdx, const char* filename, const u32 loadingFlags, const ModelSpawn& spawn)
+{
+    return QueueModelRequest(app, filename, loadingFlags, true, spawn, modelIdx);
+}
+
+void AssetLoaderSupport::WaitAll(App* app)
+{
+    AssetLoader& loader = app->assetLoader;
+    TaskGraph& graph = loader.graph;
+    while (TaskGraphSupport::RunMainThreadTasks(graph, ASSET_LOADER_PROGRESS_LOG_MS, ASSET_LOADER_PROGRESS_LOG_MS))
+    {
+        const f64 nowMs = TaskGraphSupport::TimeMs();
+        if (nowMs - loader.lastProgressLogMs < ASSET_LOADER_PROGRESS_LOG_MS)
+            continue;
+        loader.lastProgressLogMs = nowMs;
+        ILOG("Loading assets: %.0f%%, ETA %.2f s (%u textures waiting for decode)", TaskGraphSupport::GetProgress(graph) * 100.0f,
+            TaskGraphSupport::GetEtaMs(graph) / 1000.0, app->textureStreamer.pendingTextures)
+    }
+
+    loader.lastLoadWallMs = graph.endMs - graph.startMs;
+    f64 workMs = 0.0;
+    for (const Task& task : graph.tasks)
+        workMs += task.endMs - task.startMs;
+    ILOG("Assets loaded in %.2f ms, %.2f ms of work on %u workers and the main thread", loader.lastLoadWallMs, workMs, static_cast<u32>(graph.workers.size()))
+}
+
+void AssetLoaderSupport::Update(App* app)
+{
+    AssetLoader& loader = app->assetLoader;
+    const f64 startMs = TaskGraphSupport::TimeMs();
+
+    // Creations first, they allocate the buffers of the uploads below. At least one task runs per frame
+    TaskGraphSupport::RunMainThreadTasks(loader.graph, loader.frameBudgetMs);
+
+    // Idle between imports and world streaming loads, the done tasks are forgotten so the graph does not grow for the whole session
+    if (TaskGraphSupport::IsDone(loader.graph))
+    {
+        TaskGraphSupport::Reset(loader.graph);
+        loader.lastCreateTaskIdx = UINT32_MAX;
+    }
+
+    u64 uploadBudgetBytes = static_cast<u64>(loader.uploadBudgetKB) * 1024ull;
+    loader.lastFrameUploadedBytes = 0;
+    while (!loader.uploadingRequests.empty() && uploadBudgetBytes > 0 && TaskGraphSupport::TimeMs() - startMs < loader.frameBudgetMs)
+    {
+        const u32 requestIdx = loader.uploadingRequests.front();
+        ModelRequest& request = loader.modelRequests[requestIdx];
+
+        const f64 chunkStartMs = TaskGraphSupport::TimeMs();
+        const u64 previousBytes = request.uploadedBytes;
+        const bool uploaded = AssimpSupport::UploadMeshBuffers(app->meshes[app->models[request.modelIdx].meshIdx], request.import.subMeshVertices,
+            request.import.subMeshIndices, request.uploadedBytes, std::min(uploadBudgetBytes, ASSET_LOADER_UPLOAD_CHUNK_BYTES));
+        request.import.createMs += TaskGraphSupport::TimeMs() - chunkStartMs;
+        uploadBudgetBytes -= request.uploadedBytes - previousBytes;
+        loader.lastFrameUploadedBytes += request.uploadedBytes - previousBytes;
+
+        // The finish (cache write, residency policy) waits for the next frame when the last chunk used up the budget
+        if (!uploaded || TaskGraphSupport::TimeMs() - startMs >= loader.frameBudgetMs)
+            continue;
+
+        AssimpSupport::FinishCreateModel(app, request.import, request.modelIdx);
+        request.import = ModelImport();
+        if (request.spawn.spawnEntity)
+        {
+            const ModelSpawn& spawn = request.spawn;
+            CreateEntity(app, spawn.position, spawn.orientation, spawn.scale, request.modelIdx, spawn.programIdx, spawn.color, spawn.name.c_str());
+            request.entityIdx = static_cast<u32>(app->entities.size()) - 1u;
+        }
+        request.state = ModelRequestState::RESIDENT;
+        loader.uploadingRequests.pop_front();
+        ILOG("Model %s resident %.2f ms after its request (%.2f MB uploaded)", request.filename.c_str(),
+            TaskGraphSupport::TimeMs() - request.requestMs, static_cast<f64>(request.totalBytes) / (1024.0 * 1024.0))
+    }
+
+    loader.lastFrameMs = TaskGraphSupport::TimeMs() - startMs;
+    loader.maxFrameMs = std::max(loader.maxFrameMs, loader.lastFrameMs);
+}
+
+u32 AssetLoaderSupport::GetModelIdx(const App* app, const u32 requestIdx)
+{
+    return app->assetLoader.modelRequests[requestIdx].modelIdx;
+}
+
+ModelRequestState AssetLoaderSupport::GetState(const App* app, const u32 requestIdx)
+{
+    return app->assetLoader.modelRequests[requestIdx].state;
+}
+
+f32 AssetLoaderSupport::GetUploadProgress(const App* app, const u32 requestIdx)
+{
+    const ModelRequest& request = app->assetLoader.modelRequests[requestIdx];
+    if (request.state == ModelRequestState::RESIDENT)
+        return 1.0f;
+    return request.totalBytes > 0 ? static_cast<f32>(static_cast<f64>(request.uploadedBytes) / static_cast<f64>(request.totalBytes)) : 0.0f;
+}
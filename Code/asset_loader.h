@@ -0,0 +1,122 @@
+﻿#ifndef ASSET_LOADER_H
+#define ASSET_LOADER_H
+#include <deque>
+
+#include "platform.h"
+#include "assimp_model_loading.h"
+#include "task_graph.h"
+
+#define ASSET_LOADER_PROGRESS_LOG_MS 250.0
+
+// Main thread part of a load weighs this fraction of its read in the progress
+#define ASSET_LOADER_CREATE_COST_DIVISOR 8
+
+// Runtime imports upload their buffers in chunks of this size, the frame budget is checked between two chunks
+#define ASSET_LOADER_UPLOAD_CHUNK_BYTES (256ull * 1024ull)
+
+struct App;
+
+enum class ModelRequestState
+{
+    PENDING,   // Waiting for its read or its creation
+    UPLOADING, // Model created, buffers filled over the next frames
+    RESIDENT,  // Buffers uploaded, the entity (if any) spawned
+    FAILED
+};
+
+static const char* ModelRequestStateStr[] = { "Pending", "Uploading", "Resident", "Failed" };
+
+/// <summary>
+/// Entity created once the model of a runtime import is resident, nothing is spawned when spawnEntity is false.
+/// </summary>
+struct ModelSpawn
+{
+    bool spawnEntity = true;
+    glm::vec3 position = glm::vec3(0.0f);
+    glm::vec3 orientation = glm::vec3(0.0f);
+    glm::vec3 scale = glm::vec3(1.0f);
+    u32 programIdx = 0;
+    glm::vec4 color = glm::vec4(1.0f);
+    std::string name = "Imported";
+};
+
+struct ModelRequest
+{
+    std::string filename;
+    u32 loadingFlags;
+    ModelImport import;
+    u32 modelIdx = UINT32_MAX;
+    u32 readTaskIdx; // Task ids are only valid until the graph goes idle and Update resets it
+    u32 createTaskIdx;
+
+    // Runtime imports
+    bool timeSliced = false;
+    u32 targetModelIdx = UINT32_MAX; // Released model loaded again in place
+    ModelRequestState state = ModelRequestState::PENDING;
+    ModelSpawn spawn;
+    u64 uploadedBytes = 0;
+    u64 totalBytes = 0;
+    u32 entityIdx = UINT32_MAX;
+    f64 requestMs = 0.0;
+};
+
+/// <summary>
+/// Loads the assets through a task graph. Every model is read (mesh cache mapping or import, meshlets) by a worker and
+/// then created on the main thread, where its textures are requested from the streaming workers and its buffers uploaded.
+/// The creations are chained in request order, so the model, material and texture indices are the same on every run.
+/// </summary>
+struct AssetLoader
+{
+    TaskGraph graph;
+    std::deque<ModelRequest> modelRequests; // A deque keeps the imports in place while the workers fill them
+    u32 lastCreateTaskIdx = UINT32_MAX;
+    f64 lastProgressLogMs = 0.0;
+
+    // Runtime imports, the main thread work of a frame (creations and uploads) stops at the first of the two budgets
+    std::deque<u32> uploadingRequests; // Uploaded one after the other, in request order
+    f32 frameBudgetMs = 2.0f;
+    u32 uploadBudgetKB = 4096;
+
+    // Editor import, spawned in front of the camera
+    char guiImportPath[256] = "Patrick\\Patrick.obj";
+    ModelSpawn guiSpawn;
+    u32 guiLastRequestIdx = UINT32_MAX;
+
+    // Stats
+    f64 lastLoadWallMs = 0.0;
+    f64 lastFrameMs = 0.0;
+    f64 maxFrameMs = 0.0;
+    u64 lastFrameUploadedBytes = 0;
+};
+
+struct AssetLoaderSupport
+{
+    static void Init(App* app);
+    static void Shutdown(App* app);
+
+    // Queues the read of the model on a worker and its creation on the main thread, returns the request index
+    static u32 RequestModel(App* app, const char* filename, u32 loadingFlags = MLF_NONE);
+
+    // Non blocking import into a running session: returns the request index right away, the model is read on a worker,
+    // created and uploaded on the main thread within the frame budgets by Update, and the entity spawned once it is resident
+    static u32 ImportModelAsync(App* app, const char* filename, u32 loadingFlags = MLF_NONE, const ModelSpawn& spawn = ModelSpawn());
+
+    // ImportModelAsync into the slots of a model freed by AssimpSupport::ReleaseModel, its index stays the same
+    static u32 ReloadModelAsync(App* app, u32 modelIdx, const char* filename, u32 loadingFlags = MLF_NONE, const ModelSpawn& spawn = ModelSpawn());
+
+    // Runs the main thread tasks until every request is done, logging the progress and the ETA
+    static void WaitAll(App* app);
+
+    // Per frame main thread part of the runtime imports, bounded by frameBudgetMs and uploadBudgetKB
+    static void Update(App* app);
+
+    static ModelRequestState GetState(const App* app, u32 requestIdx);
+
+    // Uploaded fraction of the buffers of a request, 0 until it is created
+    static f32 GetUploadProgress(const App* app, u32 requestIdx);
+
+    // Model of a finished request, UINT32_MAX when it failed
+    static u32 GetModelIdx(const App* app, u32 requestIdx);
+};
+
+#endif // ASSET_LOADER_H
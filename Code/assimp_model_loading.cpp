@@ -5,58 +5,279 @@
 #include "engine.h"
 #include <iostream>
 #include <filesystem> 
+#include <cfloat>
+#include <chrono>
+#include <unordered_set>
 
-u32 AssimpSupport::LoadModel(App* app, const char* filename)
+#include "mesh_cache.h"
+#include "obj_model_loading.h"
+
+u32 AssimpSupport::LoadModel(App* app, const char* filename, const u32 loadingFlags)
+{
+    ModelImport import;
+    ReadModel(filename, loadingFlags, import);
+    return CreateModel(app, import);
+}
+
+bool AssimpSupport::ReadModel(const char* filename, const u32 loadingFlags, ModelImport& import)
+{
+    const auto readStart = std::chrono::high_resolution_clock::now();
+    import.filename = filename;
+    import.loadingFlags = loadingFlags;
+
+    // The cache depends on everything that changes the imported data
+    const u32 cachedLoadingFlags = loadingFlags & ~MLF_USE_MESH_CACHE;
+    import.sourceHash = (loadingFlags & MLF_USE_MESH_CACHE) ? MeshCacheSupport::HashSource(filename) : 0;
+    if (loadingFlags & MLF_USE_MESH_CACHE)
+        import.fromCache = MeshCacheSupport::ReadModelCache(filename, import.sourceHash, ASSIMP_IMPORT_FLAGS, cachedLoadingFlags, import);
+
+    import.valid = import.fromCache;
+    if (!import.fromCache)
+    {
+        const std::string extension = MakeString(filename).substr(MakeString(filename).find_last_of('.') + 1);
+        import.nativeObjParser = (loadingFlags & MLF_NATIVE_OBJ_PARSER) && (extension == "obj" || extension == "OBJ");
+        import.valid = import.nativeObjParser ? ObjSupport::ImportModel(filename, import) : ImportModel(filename, import);
+        if (import.valid)
+        {
+            FinalizeMesh(import.mesh, loadingFlags);
+            for (const SubMesh& subMesh : import.mesh.subMeshes)
+            {
+                import.subMeshVertices.push_back(subMesh.vertices.data());
+                import.subMeshIndices.push_back(subMesh.indices.data());
+            }
+        }
+    }
+
+    import.readMs = std::chrono::duration<f64, std::milli>(std::chrono::high_resolution_clock::now() - readStart).count();
+    return import.valid;
+}
+
+u32 AssimpSupport::CreateModel(App* app, ModelImport& import)
+{
+    const u32 modelIdx = BeginCreateModel(app, import);
+    if (modelIdx == UINT32_MAX)
+        return UINT32_MAX;
+
+    const auto uploadStart = std::chrono::high_resolution_clock::now();
+    u64 uploadedBytes = 0;
+    UploadMeshBuffers(app->meshes[app->models[modelIdx].meshIdx], import.subMeshVertices, import.subMeshIndices, uploadedBytes, UINT64_MAX);
+    import.createMs += std::chrono::duration<f64, std::milli>(std::chrono::high_resolution_clock::now() - uploadStart).count();
+
+    FinishCreateModel(app, import, modelIdx);
+    return modelIdx;
+}
+
+#define MATERIAL_SAMPLED_TEXTURE_COUNT 5 // Albedo, emissive, normals, masks and cone step map
+
+// Textures a material samples, the specular and bump sources only live in the packed masks
+static void GetSampledTextures(const Material& material, u32 textureIdxs[MATERIAL_SAMPLED_TEXTURE_COUNT])
+{
+    textureIdxs[0] = material.albedoTextureIdx;
+    textureIdxs[1] = material.emissiveTextureIdx;
+    textureIdxs[2] = material.normalsTextureIdx;
+    textureIdxs[3] = material.masksTextureIdx;
+    textureIdxs[4] = material.coneStepTextureIdx;
+}
+
+u32 AssimpSupport::BeginCreateModel(App* app, ModelImport& import, const u32 targetModelIdx)
+{
+    if (!import.valid)
+        return UINT32_MAX;
+    const auto createStart = std::chrono::high_resolution_clock::now();
+
+    if (targetModelIdx != UINT32_MAX)
+    {
+        const Model& model = app->models[targetModelIdx];
+        for (const u32 materialIdx : model.materialIdx)
+        {
+            u32 textureIdxs[MATERIAL_SAMPLED_TEXTURE_COUNT];
+            GetSampledTextures(app->materials[materialIdx], textureIdxs);
+            for (const u32 textureIdx : textureIdxs)
+                if (app->textures[textureIdx].released)
+                    TextureSupport::ReloadTexture(app, textureIdx);
+        }
+
+        app->meshes[model.meshIdx] = std::move(import.mesh);
+        AllocateMeshBuffers(app->meshes[model.meshIdx]);
+        import.createMs += std::chrono::duration<f64, std::milli>(std::chrono::high_resolution_clock::now() - createStart).count();
+        return targetModelIdx;
+    }
+
+    // Textures are requested by path and decoded by the streaming workers, masks are only sources of the packed texture
+    const TextureRole textureRoles[MMT_COUNT] = { TextureRole::COLOR, TextureRole::COLOR, TextureRole::MASK, TextureRole::NORMAL, TextureRole::MASK };
+    const u32 baseMaterialIdx = static_cast<u32>(app->materials.size());
+    for (u32 m = 0; m < import.materials.size(); ++m)
+    {
+        Material material = import.materials[m];
+        u32* textureIdxs[MMT_COUNT] = { &material.albedoTextureIdx, &material.emissiveTextureIdx, &material.specularTextureIdx,
+            &material.normalsTextureIdx, &material.bumpTextureIdx };
+        for (u32 t = 0; t < MMT_COUNT; ++t)
+        {
+            const std::string& texturePath = import.texturePaths[m * MMT_COUNT + t];
+            if (texturePath.empty())
+                *textureIdxs[t] = 0;
+            else if (textureRoles[t] == TextureRole::MASK)
+                *textureIdxs[t] = TextureSupport::AddTextureSource(app, texturePath.c_str());
+            else
+                *textureIdxs[t] = TextureSupport::LoadTexture2D(app, texturePath.c_str(), textureRoles[t]);
+        }
+        app->materials.push_back(material);
+    }
+
+    app->meshes.push_back(std::move(import.mesh));
+    const u32 meshIdx = static_cast<u32>(app->meshes.size()) - 1u;
+    AllocateMeshBuffers(app->meshes[meshIdx]);
+
+    app->models.emplace_back(import.modelName.c_str());
+    Model& model = app->models.back();
+    model.meshIdx = meshIdx;
+    for (const u32 subMeshMaterial : import.subMeshMaterials)
+        model.materialIdx.push_back(baseMaterialIdx + subMeshMaterial);
+
+    import.createMs += std::chrono::duration<f64, std::milli>(std::chrono::high_resolution_clock::now() - createStart).count();
+    return static_cast<u32>(app->models.size()) - 1u;
+}
+
+void AssimpSupport::FinishCreateModel(App* app, ModelImport& import, const u32 modelIdx)
+{
+    const auto finishStart = std::chrono::high_resolution_clock::now();
+    const Model& model = app->models[modelIdx];
+    Mesh& mesh = app->meshes[model.meshIdx];
+
+    // The cache writer is the last reader of the imported vertices, the residency policy may release them afterwards
+    if (!import.fromCache && (import.loadingFlags & MLF_USE_MESH_CACHE))
+        MeshCacheSupport::WriteModelCache(app, modelIdx, import.filename.c_str(), import.sourceHash, ASSIMP_IMPORT_FLAGS, import.loadingFlags & ~MLF_USE_MESH_CACHE);
+    ApplyGeometryResidency(mesh, import.subMeshVertices, import.subMeshIndices, app->geometryResidency);
+    if (import.fromCache)
+        UnmapFile(import.cacheFile);
+
+    // Specular and bump are sampled from a single packed texture, the parallax marches the cone step map of the bump
+    for (const u32 materialIdx : model.materialIdx)
+    {
+        Material& material = app->materials[materialIdx];
+        if (material.masksTextureIdx == 0 && (material.specularTextureIdx != 0 || material.bumpTextureIdx != 0))
+            material.masksTextureIdx = TextureSupport::LoadPackedMaskTexture2D(app, material.bumpTextureIdx, material.specularTextureIdx);
+        if (material.coneStepTextureIdx == 0 && material.bumpTextureIdx != 0)
+            material.coneStepTextureIdx = ConeStepMapSupport::LoadConeStepMap(app, material.bumpTextureIdx);
+    }
+
+    // Startup benchmark, compare the logs of a first run (import) with the next ones (cache)
+    import.createMs += std::chrono::duration<f64, std::milli>(std::chrono::high_resolution_clock::now() - finishStart).count();
+    const f64 createMs = import.createMs;
+    app->modelLoadingTimeMs += import.readMs + createMs;
+    app->modelCacheHits += import.fromCache ? 1 : 0;
+    ++app->modelsLoaded;
+    ILOG("Model %s %s in %.2f ms (%.2f ms read, %.2f ms create)", import.filename.c_str(),
+        import.fromCache ? "mapped from the mesh cache" : import.nativeObjParser ? "parsed with the native OBJ parser" : "imported with assimp",
+        import.readMs + createMs, import.readMs, createMs)
+}
+
+void AssimpSupport::ReleaseModel(App* app, const u32 modelIdx)
+{
+    const Model& model = app->models[modelIdx];
+    Mesh& mesh = app->meshes[model.meshIdx];
+
+    MaterialBatchingSupport::ReleaseMeshVAO(app, model.meshIdx);
+    for (const SubMesh& subMesh : mesh.subMeshes)
+        for (const VAO& vao : subMesh.vaoList)
+            glDeleteVertexArrays(1, &vao.handle);
+    glDeleteBuffers(1, &mesh.vertexBuffer.handle);
+    glDeleteBuffers(1, &mesh.indexBuffer.handle);
+    mesh.vertexBuffer = Buffer();
+    mesh.indexBuffer = Buffer();
+    std::vector<SubMesh>().swap(mesh.subMeshes);
+
+    // Textures are shared by path, the ones another resident model samples stay loaded
+    std::unordered_set<u32> usedTextures;
+    for (u32 m = 0; m < app->models.size(); ++m)
+    {
+        if (m == modelIdx || app->meshes[app->models[m].meshIdx].vertexBuffer.handle == 0)
+            continue;
+        for (const u32 materialIdx : app->models[m].materialIdx)
+        {
+            u32 textureIdxs[MATERIAL_SAMPLED_TEXTURE_COUNT];
+            GetSampledTextures(app->materials[materialIdx], textureIdxs);
+            usedTextures.insert(textureIdxs, textureIdxs + MATERIAL_SAMPLED_TEXTURE_COUNT);
+        }
+    }
+    for (const u32 materialIdx : model.materialIdx)
+    {
+        u32 textureIdxs[MATERIAL_SAMPLED_TEXTURE_COUNT];
+        GetSampledTextures(app->materials[materialIdx], textureIdxs);
+        for (const u32 textureIdx : textureIdxs)
+            if (textureIdx != app->defaultTextureIdx && usedTextures.count(textureIdx) == 0)
+                TextureSupport::ReleaseTexture(app, textureIdx);
+    }
+}
+
+bool AssimpSupport::ImportModel(const char* filename, ModelImport& import)
 {
     // Define import flags
-    const aiScene* scene = aiImportFile(filename,
-                                        aiProcess_Triangulate           |
-                                        aiProcess_GenSmoothNormals      |
-                                        aiProcess_CalcTangentSpace      |
-                                        aiProcess_JoinIdenticalVertices |
-                                        aiProcess_PreTransformVertices  |
-                                        aiProcess_ImproveCacheLocality  |
-                                        aiProcess_OptimizeMeshes        |
-                                        aiProcess_SortByPType);
+    const aiScene* scene = aiImportFile(filename, ASSIMP_IMPORT_FLAGS);
 
     if (!scene)
     {
         ELOG("Error loading mesh %s: %s", filename, aiGetErrorString())
-        return UINT32_MAX;
+        return false;
     }
 
-    // Create & save mesh
+    // Mesh & model names
     const char* name = scene->mRootNode->mName.C_Str();
     std::string modelName = "Model_";
     std::string meshName = "Mesh_";
     modelName += name;
     meshName += name;
-    app->meshes.emplace_back(meshName.c_str());
-    Mesh& mesh = app->meshes.back();
-    const u32 meshIdx = (u32)app->meshes.size() - 1u;
-
-    // Create & save model, cache mesh idx
-    app->models.emplace_back(modelName.c_str());
-    Model& model = app->models.back();
-    model.meshIdx = meshIdx;
-    const u32 modelIdx = (u32)app->models.size() - 1u;
+    import.modelName = modelName;
+    import.mesh = Mesh(meshName.c_str());
 
     const std::string directory = GetDirectoryPart(MakeString(filename));
 
     // Create a list of materials and process each material
-    const u32 baseMeshMaterialIndex = (u32)app->materials.size();
+    import.materials.resize(scene->mNumMaterials);
+    import.texturePaths.resize(scene->mNumMaterials * MMT_COUNT);
     for (unsigned int i = 0; i < scene->mNumMaterials; ++i)
     {
-        app->materials.emplace_back();
-        Material& material = app->materials.back();
-        ProcessAssimpMaterial(app, scene->mMaterials[i], material, directory);
+        ProcessAssimpMaterial(scene->mMaterials[i], import.materials[i], &import.texturePaths[i * MMT_COUNT], directory);
     }
 
     // Process asset into mesh
-    ProcessAssimpNode(scene, scene->mRootNode, &mesh, baseMeshMaterialIndex, model.materialIdx);
+    ProcessAssimpNode(scene, scene->mRootNode, &import.mesh, 0, import.subMeshMaterials);
     aiReleaseImport(scene);
 
-    // Create VBO & EBO
+    return true;
+}
+
+void AssimpSupport::FinalizeMesh(Mesh& mesh, const u32 loadingFlags)
+{
+    // Local bounds, positions are always the first attribute of the vertex
+    mesh.boundsMin = glm::vec3(FLT_MAX);
+    mesh.boundsMax = glm::vec3(-FLT_MAX);
+    for (const SubMesh& subMesh : mesh.subMeshes)
+    {
+        const u32 floatStride = subMesh.vertexBufferLayout.stride / sizeof(float);
+        for (u32 v = 0; v + 2 < subMesh.vertices.size(); v += floatStride)
+        {
+            mesh.boundsMin = glm::min(mesh.boundsMin, glm::make_vec3(&subMesh.vertices[v]));
+            mesh.boundsMax = glm::max(mesh.boundsMax, glm::make_vec3(&subMesh.vertices[v]));
+        }
+    }
+
+    if (loadingFlags & MLF_BUILD_MESHLETS)
+    {
+        for (SubMesh& subMesh : mesh.subMeshes)
+            MeshletSupport::BuildMeshlets(subMesh);
+    }
+}
+
+void AssimpSupport::CreateMeshBuffers(Mesh& mesh, const std::vector<const void*>& subMeshVertices, const std::vector<const void*>& subMeshIndices)
+{
+    u64 uploadedBytes = 0;
+    AllocateMeshBuffers(mesh);
+    UploadMeshBuffers(mesh, subMeshVertices, subMeshIndices, uploadedBytes, UINT64_MAX);
+}
+
+u64 AssimpSupport::AllocateMeshBuffers(Mesh& mesh)
+{
     u32 vertexBufferSize = 0;
     u32 indexBufferSize = 0;
 
@@ -64,17 +285,12 @@ u32 AssimpSupport::LoadModel(App* app, const char* filename)
     // Each subMesh then will use their own vertices and indices through vertex offset and indices offset
     for (u32 i = 0; i < mesh.subMeshes.size(); ++i)
     {
-        vertexBufferSize += mesh.subMeshes[i].vertices.size() * sizeof(float);
-        indexBufferSize  += mesh.subMeshes[i].indices.size()  * sizeof(u32);
+        vertexBufferSize += mesh.subMeshes[i].vertexCount * mesh.subMeshes[i].vertexBufferLayout.stride;
+        indexBufferSize  += mesh.subMeshes[i].indexCount * sizeof(u32);
     }
-    
-    mesh.vertexBuffer = CREATE_STATIC_VERTEX_BUFFER(sizeof(vertexBufferSize), nullptr);
-    BufferManagement::BindBuffer(mesh.vertexBuffer);
-    glBufferData(GL_ARRAY_BUFFER, vertexBufferSize, NULL, GL_STATIC_DRAW);
 
-    mesh.indexBuffer = CREATE_STATIC_INDEX_BUFFER(sizeof(indexBufferSize), nullptr);
-    BufferManagement::BindBuffer(mesh.indexBuffer);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexBufferSize, NULL, GL_STATIC_DRAW);
+    mesh.vertexBuffer = CREATE_STATIC_VERTEX_BUFFER(vertexBufferSize, nullptr);
+    mesh.indexBuffer = CREATE_STATIC_INDEX_BUFFER(indexBufferSize, nullptr);
 
     u32 indicesOffset = 0;
     u32 verticesOffset = 0;
@@ -82,23 +298,84 @@ u32 AssimpSupport::LoadModel(App* app, const char* filename)
     // Batching vertex attributes?? https://learnopengl.com/Advanced-OpenGL/Advanced-Data#:~:text=Batching%20vertex%20attributes
     for (u32 i = 0; i < mesh.subMeshes.size(); ++i)
     {
-        const void* verticesData = mesh.subMeshes[i].vertices.data();
-        const u32   verticesSize = mesh.subMeshes[i].vertices.size() * sizeof(float);
-        glBufferSubData(GL_ARRAY_BUFFER, verticesOffset, verticesSize, verticesData);
         mesh.subMeshes[i].vertexOffset = verticesOffset;
-        verticesOffset += verticesSize;
+        verticesOffset += mesh.subMeshes[i].vertexCount * mesh.subMeshes[i].vertexBufferLayout.stride;
 
-        const void* indicesData = mesh.subMeshes[i].indices.data();
-        const u32   indicesSize = mesh.subMeshes[i].indices.size() * sizeof(u32);
-        glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, indicesOffset, indicesSize, indicesData);
         mesh.subMeshes[i].indexOffset = indicesOffset;
-        indicesOffset += indicesSize;
+        indicesOffset += mesh.subMeshes[i].indexCount * sizeof(u32);
     }
 
-    BufferManagement::UnBindBuffer(mesh.indexBuffer);
-    BufferManagement::UnBindBuffer(mesh.vertexBuffer);
+    return static_cast<u64>(vertexBufferSize) + indexBufferSize;
+}
 
-    return modelIdx;
+bool AssimpSupport::UploadMeshBuffers(const Mesh& mesh, const std::vector<const void*>& subMeshVertices, const std::vector<const void*>& subMeshIndices,
+    u64& uploadedBytes, const u64 maxBytes)
+{
+    // The copy write target leaves the element array binding of whatever VAO is bound untouched
+    u64 blockStart = 0;
+    u64 remainingBytes = maxBytes;
+    for (u32 pass = 0; pass < 2; ++pass)
+    {
+        const bool vertices = pass == 0;
+        glBindBuffer(GL_COPY_WRITE_BUFFER, vertices ? mesh.vertexBuffer.handle : mesh.indexBuffer.handle);
+        for (u32 i = 0; i < mesh.subMeshes.size(); ++i)
+        {
+            const SubMesh& subMesh = mesh.subMeshes[i];
+            const u64 blockSize = vertices ? static_cast<u64>(subMesh.vertexCount) * subMesh.vertexBufferLayout.stride
+                                           : static_cast<u64>(subMesh.indexCount) * sizeof(u32);
+            const u64 blockEnd = blockStart + blockSize;
+            if (uploadedBytes < blockEnd && remainingBytes > 0)
+            {
+                // Blocks are uploaded in order, so the ones before this one are complete
+                const u64 blockUploaded = uploadedBytes - blockStart;
+                const u64 chunkSize = std::min(blockSize - blockUploaded, remainingBytes);
+                const u8* source = static_cast<const u8*>(vertices ? subMeshVertices[i] : subMeshIndices[i]);
+                const u64 bufferOffset = vertices ? subMesh.vertexOffset : subMesh.indexOffset;
+                glBufferSubData(GL_COPY_WRITE_BUFFER, static_cast<GLintptr>(bufferOffset + blockUploaded), static_cast<GLsizeiptr>(chunkSize), source + blockUploaded);
+                uploadedBytes += chunkSize;
+                remainingBytes -= chunkSize;
+            }
+            blockStart = blockEnd;
+        }
+    }
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    return uploadedBytes >= blockStart;
+}
+
+void AssimpSupport::ApplyGeometryResidency(Mesh& mesh, const std::vector<const void*>& subMeshVertices, const std::vector<const void*>& subMeshIndices, const GeometryResidency residency)
+{
+    for (u32 i = 0; i < mesh.subMeshes.size(); ++i)
+    {
+        SubMesh& subMesh = mesh.subMeshes[i];
+        const f32* vertices = static_cast<const f32*>(subMeshVertices[i]);
+        const u32* indices = static_cast<const u32*>(subMeshIndices[i]);
+        const u32 floatStride = subMesh.vertexBufferLayout.stride / sizeof(f32);
+
+        // Positions are always the first attribute of the vertex
+        std::vector<vec3>().swap(subMesh.positions);
+        if (residency == GeometryResidency::POSITIONS_AND_INDICES && vertices != nullptr)
+        {
+            subMesh.positions.resize(subMesh.vertexCount);
+            for (u32 v = 0; v < subMesh.vertexCount; ++v)
+                subMesh.positions[v] = glm::make_vec3(vertices + static_cast<u64>(v) * floatStride);
+        }
+
+        if (residency == GeometryResidency::KEEP_ALL)
+        {
+            if (vertices != nullptr && vertices != subMesh.vertices.data())
+                subMesh.vertices.assign(vertices, vertices + static_cast<u64>(subMesh.vertexCount) * floatStride);
+        }
+        else
+        {
+            std::vector<f32>().swap(subMesh.vertices);
+        }
+
+        if (residency == GeometryResidency::RELEASE)
+            std::vector<u32>().swap(subMesh.indices);
+        else if (indices != nullptr && indices != subMesh.indices.data())
+            subMesh.indices.assign(indices, indices + subMesh.indexCount);
+    }
 }
 
 void AssimpSupport::ProcessAssimpNode(const aiScene* scene, const aiNode* node, Mesh* myMesh, u32 baseMeshMaterialIndex,
@@ -118,7 +395,7 @@ void AssimpSupport::ProcessAssimpNode(const aiScene* scene, const aiNode* node,
     }
 }
 
-void AssimpSupport::ProcessAssimpMaterial(App* app, const aiMaterial* material, Material& myMaterial, const std::string& directory)
+void AssimpSupport::ProcessAssimpMaterial(const aiMaterial* material, Material& myMaterial, std::string* texturePaths, const std::string& directory)
 {
     aiString name;
     aiColor3D diffuseColor;
@@ -141,22 +418,19 @@ void AssimpSupport::ProcessAssimpMaterial(App* app, const aiMaterial* material,
     {
         material->GetTexture(aiTextureType_DIFFUSE, 0, &aiFilename);
         const std::string filename = MakeString(aiFilename.C_Str());
-        const std::string filepath = MakePath(directory, filename);
-        myMaterial.albedoTextureIdx = TextureSupport::LoadTexture2D(app, filepath.c_str());
+        texturePaths[MMT_ALBEDO] = MakePath(directory, filename);
     }
     if (material->GetTextureCount(aiTextureType_EMISSIVE) > 0)
     {
         material->GetTexture(aiTextureType_EMISSIVE, 0, &aiFilename);
         const std::string filename = MakeString(aiFilename.C_Str());
-        const std::string filepath = MakePath(directory, filename);
-        myMaterial.emissiveTextureIdx = TextureSupport::LoadTexture2D(app, filepath.c_str());
+        texturePaths[MMT_EMISSIVE] = MakePath(directory, filename);
     }
     if (material->GetTextureCount(aiTextureType_SPECULAR) > 0)
     {
         material->GetTexture(aiTextureType_SPECULAR, 0, &aiFilename);
         const std::string filename = MakeString(aiFilename.C_Str());
-        const std::string filepath = MakePath(directory, filename);
-        myMaterial.specularTextureIdx = TextureSupport::LoadTexture2D(app, filepath.c_str());
+        texturePaths[MMT_SPECULAR] = MakePath(directory, filename);
     }
     if (material->GetTextureCount(aiTextureType_NORMALS) > 0)
     {
@@ -167,23 +441,26 @@ void AssimpSupport::ProcessAssimpMaterial(App* app, const aiMaterial* material,
     if (material->GetTextureCount(aiTextureType_HEIGHT) > 0)
     {
         material->GetTexture(aiTextureType_HEIGHT, 0, &aiFilename);
-        const std::string filename = MakeString(aiFilename.C_Str());
-        const std::string filepath = MakePath(directory, filename);
-        myMaterial.normalsTextureIdx = TextureSupport::LoadTexture2D(app, filepath.c_str());
+        GetHeightMapTexturePaths(directory, MakeString(aiFilename.C_Str()), texturePaths);
+    }
+    //myMaterial.createNormalFromBump();
+}
 
-        size_t lastUnderScoreIdx = filename.rfind('_');
+void AssimpSupport::GetHeightMapTexturePaths(const std::string& directory, const std::string& filename, std::string* texturePaths)
+{
+    texturePaths[MMT_NORMALS] = MakePath(directory, filename);
 
-        if (lastUnderScoreIdx != std::string::npos) {
-            // Replace the part after the last underscore with 'bump'
-            std::string bumpFileName = filename.substr(0, lastUnderScoreIdx) + "_bump" + filename.substr(filename.rfind('.')); // Output: xxxx_bump.png
-            const std::string bumpFilePath = MakePath(directory, bumpFileName);
-            if (std::filesystem::exists(bumpFilePath)) {
-                std::cout << "Bump File exists: " << bumpFilePath << std::endl;
-                myMaterial.bumpTextureIdx = TextureSupport::LoadTexture2D(app, bumpFilePath.c_str());
-            }
+    size_t lastUnderScoreIdx = filename.rfind('_');
+
+    if (lastUnderScoreIdx != std::string::npos) {
+        // Replace the part after the last underscore with 'bump'
+        std::string bumpFileName = filename.substr(0, lastUnderScoreIdx) + "_bump" + filename.substr(filename.rfind('.')); // Output: xxxx_bump.png
+        const std::string bumpFilePath = MakePath(directory, bumpFileName);
+        if (std::filesystem::exists(bumpFilePath)) {
+            std::cout << "Bump File exists: " << bumpFilePath << std::endl;
+            texturePaths[MMT_BUMP] = bumpFilePath;
         }
     }
-    //myMaterial.createNormalFromBump();
 }
 
 void AssimpSupport::ProcessAssimpMesh(const aiScene* scene, aiMesh* mesh, Mesh* myMesh, u32 baseMeshMaterialIndex,
@@ -267,6 +544,8 @@ void AssimpSupport::ProcessAssimpMesh(const aiScene* scene, aiMesh* mesh, Mesh*
     // Add the subMesh into the mesh
     SubMesh subMesh = {mesh->mName.C_Str()};
     subMesh.vertexBufferLayout = vertexBufferLayout;
+    subMesh.vertexCount = mesh->mNumVertices;
+    subMesh.indexCount = static_cast<u32>(indices.size());
     subMesh.vertices.swap(vertices);
     subMesh.indices.swap(indices);
     myMesh->subMeshes.push_back( subMesh );
@@ -6,16 +6,113 @@
 #include <assimp/postprocess.h>
 
 #include "platform.h"
+#include "mesh.h"
 
-struct Material;
-struct Mesh;
 struct App;
 
+#define ASSIMP_IMPORT_FLAGS (aiProcess_Triangulate           | \
+                             aiProcess_GenSmoothNormals      | \
+                             aiProcess_CalcTangentSpace      | \
+                             aiProcess_JoinIdenticalVertices | \
+                             aiProcess_PreTransformVertices  | \
+                             aiProcess_ImproveCacheLocality  | \
+                             aiProcess_OptimizeMeshes        | \
+                             aiProcess_SortByPType)
+
+// Optional import steps, combined as a bit mask
+enum MODEL_LOADING_FLAGS
+{
+    MLF_NONE = 0,
+    MLF_BUILD_MESHLETS = 1 << 0,
+    MLF_USE_MESH_CACHE = 1 << 1, // Load from (or write) the binary mesh cache next to the source file, see MeshCacheSupport
+    MLF_NATIVE_OBJ_PARSER = 1 << 2 // Parse .obj files with ObjSupport instead of assimp
+};
+
+// Texture slots of an imported material, also the order of the paths in the mesh cache
+enum MODEL_MATERIAL_TEXTURE
+{
+    MMT_ALBEDO = 0,
+    MMT_EMISSIVE,
+    MMT_SPECULAR,
+    MMT_NORMALS,
+    MMT_BUMP,
+    MMT_COUNT
+};
+
+/// <summary>
+/// CPU side result of reading a model file, imported or mapped from the mesh cache. It is built without touching the app
+/// or OpenGL, so it can be read on any thread, and AssimpSupport::CreateModel turns it into a model on the main thread.
+/// </summary>
+/// <param name="texturePaths">MMT_COUNT paths per material, empty when the material has no such texture.</param>
+/// <param name="subMeshMaterials">Material of every subMesh, relative to materials.</param>
+/// <param name="subMeshVertices/subMeshIndices">Data of every subMesh for the GPU buffers, the subMesh vectors or the mapped cache.</param>
+struct ModelImport
+{
+    std::string filename;
+    u32 loadingFlags = MLF_NONE;
+    u64 sourceHash = 0;
+    bool valid = false;
+    bool fromCache = false;
+    bool nativeObjParser = false;
+
+    std::string modelName;
+    Mesh mesh = Mesh("");
+    std::vector<Material> materials;
+    std::vector<std::string> texturePaths;
+    std::vector<u32> subMeshMaterials;
+    std::vector<const void*> subMeshVertices;
+    std::vector<const void*> subMeshIndices;
+    MappedFile cacheFile; // Kept mapped until the buffers are uploaded
+
+    f64 readMs = 0.0;
+    f64 createMs = 0.0; // Main thread time, summed over the frames of a time sliced upload
+};
+
 struct AssimpSupport
 {
-    static u32 LoadModel(App* app, const char* filename);
+    // ReadModel and CreateModel back to back
+    static u32 LoadModel(App* app, const char* filename, u32 loadingFlags = MLF_NONE);
+
+    // Maps the mesh cache or imports the source file into the import, safe on worker threads
+    static bool ReadModel(const char* filename, u32 loadingFlags, ModelImport& import);
+
+    // Main thread part of the load: materials and their texture requests, GPU buffers and the mesh cache write.
+    // Returns the model index, UINT32_MAX when the read failed
+    static u32 CreateModel(App* app, ModelImport& import);
+
+    // CreateModel split for time sliced uploads: BeginCreateModel creates the materials, the model and empty buffers,
+    // UploadMeshBuffers fills them over as many calls as needed and FinishCreateModel runs once the mesh is resident
+    // A targetModelIdx released by ReleaseModel is loaded again in place, its materials only get their textures back
+    static u32 BeginCreateModel(App* app, ModelImport& import, u32 targetModelIdx = UINT32_MAX);
+    static void FinishCreateModel(App* app, ModelImport& import, u32 modelIdx);
+
+    // Frees the buffers, VAOs and CPU geometry of a model created by CreateModel, and the textures no other resident model samples.
+    // The model, mesh and material slots stay valid so indices held elsewhere don't move, BeginCreateModel can fill them again
+    static void ReleaseModel(App* app, u32 modelIdx);
+
+    static bool ImportModel(const char* filename, ModelImport& import);
+
+    // Bounds and optional meshlets of a mesh whose subMeshes are already filled (shared by all the importers)
+    static void FinalizeMesh(Mesh& mesh, u32 loadingFlags);
+
+    // Creates the VBO & EBO of the mesh, vertex and index data of each subMesh can come from any CPU memory (vectors, mapped files...)
+    static void CreateMeshBuffers(Mesh& mesh, const std::vector<const void*>& subMeshVertices, const std::vector<const void*>& subMeshIndices);
+
+    // Creates the VBO & EBO of the mesh without data and places the subMeshes in them, returns their total size in bytes
+    static u64 AllocateMeshBuffers(Mesh& mesh);
+
+    // Uploads up to maxBytes of the mesh data from uploadedBytes on, vertices of every subMesh first and then the indices.
+    // Advances uploadedBytes and returns true once the whole mesh is uploaded
+    static bool UploadMeshBuffers(const Mesh& mesh, const std::vector<const void*>& subMeshVertices, const std::vector<const void*>& subMeshIndices,
+        u64& uploadedBytes, u64 maxBytes);
+
+    // Trims the CPU side geometry of an uploaded mesh, the data is the one given to CreateMeshBuffers (the subMesh vectors or a mapping)
+    static void ApplyGeometryResidency(Mesh& mesh, const std::vector<const void*>& subMeshVertices, const std::vector<const void*>& subMeshIndices, GeometryResidency residency);
     static void ProcessAssimpNode(const aiScene* scene, const aiNode *node, Mesh *myMesh, u32 baseMeshMaterialIndex, std::vector<u32>& submeshMaterialIndices);
-    static void ProcessAssimpMaterial(App* app, const aiMaterial *material, Material& myMaterial, const std::string& directory);
+    static void ProcessAssimpMaterial(const aiMaterial *material, Material& myMaterial, std::string* texturePaths, const std::string& directory);
+
+    // Normal map from the height map name and its _bump sibling (when it exists) as the bump source
+    static void GetHeightMapTexturePaths(const std::string& directory, const std::string& filename, std::string* texturePaths);
     static void ProcessAssimpMesh(const aiScene* scene, aiMesh *mesh, Mesh *myMesh, u32 baseMeshMaterialIndex, std::vector<u32>& submeshMaterialIndices);
 };
 
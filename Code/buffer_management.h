@@ -67,6 +67,7 @@ public:
 
     static void SetColorAttachment(const Buffer& buffer, const GLint colorTextureIdx, const GLuint layoutLocation);
     static void SetDepthAttachment(const Buffer& buffer, const GLint depthTextureIdx);
+    static void SetDepthStencilAttachment(const Buffer& buffer, const GLint depthStencilTextureIdx);
 
     static void SetDrawBuffersTextures(const std::vector<u32>& activeAttachments);
 
@@ -94,17 +95,31 @@ enum DRAW_BUFFERS_LOCATION
     RT_LOCATION_NORMAL = 2,
     RT_LOCATION_SPECULAR_ROUGHNESS = 3,
     RT_LOCATION_SSAO = 4,
+    RT_LOCATION_MOTION_VECTORS = 4, // The SSAO target has its own frame buffer, both G-buffer layouts attach the motion vectors here
     RT_LOCATION_BUMP = 5,
     RT_LOCATION_TANGENT = 6,
-    RT_LOCATION_FINAL_RESULT = 7
+    RT_LOCATION_FINAL_RESULT = 7,
+
+    // Compact G-buffer, see GBufferLayout::COMPACT. Shares the color, final result and depth targets
+    RT_LOCATION_NORMAL_TANGENT_OCTAHEDRAL = 1, // Normal (rg) and tangent (ba), octahedral encoded
+    RT_LOCATION_MASKS = 2, // Specular (r) and bump (g)
+    RT_LOCATION_NONE = 0xFF // Draw buffer slot without attachment, its fragment output is dropped
+};
+
+// Texture units of the compact G-buffer targets in the passes that read it
+enum COMPACT_G_BUFFER_BINDING
+{
+    CG_BINDING_NORMAL_TANGENT = 8,
+    CG_BINDING_MASKS = 9,
+    CG_BINDING_DEPTH = 10
 };
 
 enum MAT_TEXTURE_LOCATION
 {
     MAT_T_DIFFUSE = 0,
     MAT_T_NORMALS = 1,
-    MAT_T_SPECULAR = 2,
-    MAT_T_BUMP = 3
+    MAT_T_MASKS = 2, // Bump height (r) and specular mask (g), see TextureSupport::LoadPackedMaskTexture2D
+    MAT_T_CONE_STEP = 3 // Depth (r) and relaxed cone ratio (g) of the bump, see ConeStepMapSupport
 };
 
 enum VERTEX_ATTRIBUTE_LOCATION
@@ -114,6 +129,7 @@ enum VERTEX_ATTRIBUTE_LOCATION
     ATTR_LOCATION_TEXTCOORD = 2,
     ATTR_LOCATION_TANGENT = 3,
     ATTR_LOCATION_BITANGENT = 4,
+    ATTR_LOCATION_MATERIAL_INDEX = 5 // Instanced, see MaterialBatchingSupport
 };
 
 enum STD_140_BINDING_POINT
@@ -124,4 +140,14 @@ enum STD_140_BINDING_POINT
     BP_SSAO_PARAMS = 3
 };
 
+enum STD_430_BINDING_POINT
+{
+    BP_BATCHED_MATERIALS = 0,
+    BP_CLUSTER_LIGHTS = 1,
+    BP_CLUSTER_BOUNDS = 2,
+    BP_CLUSTER_GRID = 3,
+    BP_TILE_LIGHTS = 4,
+    BP_TILE_CLASSES = 5
+};
+
 #endif // BUFFER_MANAGEMENT_H
@@ -127,12 +127,16 @@ void FrameBufferManagement::SetDepthAttachment(const Buffer& buffer, const GLint
 {
     glFramebufferTexture2D(GL_FRAMEBUFFER, static_cast<GLenum>(GL_DEPTH_ATTACHMENT), GL_TEXTURE_2D, depthTextureIdx, 0);
 }
+void FrameBufferManagement::SetDepthStencilAttachment(const Buffer& buffer, const GLint depthStencilTextureIdx)
+{
+    glFramebufferTexture2D(GL_FRAMEBUFFER, static_cast<GLenum>(GL_DEPTH_STENCIL_ATTACHMENT), GL_TEXTURE_2D, depthStencilTextureIdx, 0);
+}
 void FrameBufferManagement::SetDrawBuffersTextures(const std::vector<u32>& activeAttachments)
 {
     std::vector<GLenum> buffers(activeAttachments.size());
     
     for (u32 i = 0; i < buffers.size(); ++i)
-        buffers[i] = (GLenum)(GL_COLOR_ATTACHMENT0 + activeAttachments[i]);
+        buffers[i] = activeAttachments[i] == RT_LOCATION_NONE ? GL_NONE : (GLenum)(GL_COLOR_ATTACHMENT0 + activeAttachments[i]);
 
     glDrawBuffers(static_cast<GLsizei>(buffers.size()), buffers.data());
 }
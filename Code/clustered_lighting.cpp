@@ -0,0 +1,289 @@
+﻿#include "clustered_lighting.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <random>
+
+#include "app.h"
+
+static u32 GetClusterIdx(const u32 x, const u32 y, const u32 z)
+{
+    return x + CLUSTER_GRID_X * (y + CLUSTER_GRID_Y * z);
+}
+
+static u32 GetDepthSlice(const ClusterLightsHeader& header, const f32 viewDepth)
+{
+    const f32 slice = std::floor(std::log(viewDepth) * header.depth.z + header.depth.w);
+    return static_cast<u32>(glm::clamp(slice, 0.0f, static_cast<f32>(CLUSTER_GRID_Z - 1)));
+}
+
+static bool SphereIntersectsBounds(const glm::vec3& center, const f32 radius, const ClusterBounds& bounds)
+{
+    const glm::vec3 closest = glm::clamp(center, glm::vec3(bounds.minPoint), glm::vec3(bounds.maxPoint));
+    const glm::vec3 offset = closest - center;
+    return glm::dot(offset, offset) <= radius * radius;
+}
+
+// View space AABBs of the froxels, the near and far planes are read back from the projection. Without the TAA jitter,
+// the sub-pixel offset would rebuild them every frame
+static void BuildClusterBounds(App* app, ClusteredLighting& clustered)
+{
+    const glm::mat4& projection = app->temporal.unjitteredProjectionMat;
+    const f32 zNear = projection[3][2] / (projection[2][2] - 1.0f);
+    const f32 zFar = projection[3][2] / (projection[2][2] + 1.0f);
+    const f32 logDepthRatio = std::log(zFar / zNear);
+    const glm::mat4 inverseProjection = glm::inverse(projection);
+
+    clustered.bounds.resize(CLUSTER_COUNT);
+    for (u32 z = 0; z < CLUSTER_GRID_Z; ++z)
+    {
+        const f32 sliceNear = zNear * std::pow(zFar / zNear, static_cast<f32>(z) / CLUSTER_GRID_Z);
+        const f32 sliceFar = zNear * std::pow(zFar / zNear, static_cast<f32>(z + 1) / CLUSTER_GRID_Z);
+        for (u32 y = 0; y < CLUSTER_GRID_Y; ++y)
+        {
+            for (u32 x = 0; x < CLUSTER_GRID_X; ++x)
+            {
+                // Tile corners on the near plane, the rays from the eye through them bound the cluster
+                glm::vec4 minCorner = inverseProjection * glm::vec4(2.0f * x / CLUSTER_GRID_X - 1.0f, 2.0f * y / CLUSTER_GRID_Y - 1.0f, -1.0f, 1.0f);
+                glm::vec4 maxCorner = inverseProjection * glm::vec4(2.0f * (x + 1) / CLUSTER_GRID_X - 1.0f, 2.0f * (y + 1) / CLUSTER_GRID_Y - 1.0f, -1.0f, 1.0f);
+                const glm::vec3 minRay = glm::vec3(minCorner) / minCorner.w;
+                const glm::vec3 maxRay = glm::vec3(maxCorner) / maxCorner.w;
+
+                const glm::vec3 points[4] = { minRay * (sliceNear / -minRay.z), minRay * (sliceFar / -minRay.z),
+                    maxRay * (sliceNear / -maxRay.z), maxRay * (sliceFar / -maxRay.z) };
+                glm::vec3 minPoint = points[0];
+                glm::vec3 maxPoint = points[0];
+                for (u32 p = 1; p < 4; ++p)
+                {
+                    minPoint = glm::min(minPoint, points[p]);
+                    maxPoint = glm::max(maxPoint, points[p]);
+                }
+                clustered.bounds[GetClusterIdx(x, y, z)] = { glm::vec4(minPoint, 0.0f), glm::vec4(maxPoint, 0.0f) };
+            }
+        }
+    }
+
+    clustered.header.grid = glm::uvec4(CLUSTER_GRID_X, CLUSTER_GRID_Y, CLUSTER_GRID_Z, 0);
+    clustered.header.depth = glm::vec4(zNear, zFar, CLUSTER_GRID_Z / logDepthRatio, -CLUSTER_GRID_Z * std::log(zNear) / logDepthRatio);
+    clustered.header.tileSize = glm::vec4(static_cast<f32>(app->displaySizeCurrent.x) / CLUSTER_GRID_X, static_cast<f32>(app->displaySizeCurrent.y) / CLUSTER_GRID_Y, 0.0f, 0.0f);
+    clustered.header.limits = glm::uvec4(CLUSTER_MAX_LIGHTS, CLUSTER_COUNT, 0, 0);
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, clustered.boundsBuffer);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, static_cast<GLsizeiptr>(CLUSTER_COUNT * sizeof(ClusterBounds)), clustered.bounds.data());
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    clustered.boundsProjection = projection;
+    clustered.boundsDisplaySize = app->displaySizeCurrent;
+}
+
+// Each point light only visits the clusters under its screen rectangle and between its depth slices
+static void BinLightsCPU(App* app, ClusteredLighting& clustered)
+{
+    const auto binningStart = std::chrono::high_resolution_clock::now();
+    const ClusterLightsHeader& header = clustered.header;
+    const glm::mat4 viewMatrix = app->camera.GetViewMatrix();
+    const glm::mat4& projection = app->temporal.unjitteredProjectionMat;
+    const f32 zNear = header.depth.x;
+    const f32 zFar = header.depth.y;
+
+    std::vector<u32>& grid = clustered.cpuGrid;
+    grid.resize(CLUSTER_COUNT + CLUSTER_COUNT * CLUSTER_MAX_LIGHTS);
+    std::fill(grid.begin(), grid.begin() + CLUSTER_COUNT, 0u);
+    clustered.droppedClusterLights = 0;
+
+    const u32 lightCount = static_cast<u32>(clustered.lights.size());
+    for (u32 l = 0; l < lightCount; ++l)
+    {
+        const ClusterLight& light = clustered.lights[l];
+        const bool pointLight = static_cast<LightType>(static_cast<u32>(light.colorType.w)) == LightType::POINT;
+        const glm::vec3 center = glm::vec3(viewMatrix * glm::vec4(glm::vec3(light.positionRadius), 1.0f));
+        const f32 radius = light.positionRadius.w;
+
+        glm::uvec3 first = glm::uvec3(0);
+        glm::uvec3 last = glm::uvec3(CLUSTER_GRID_X - 1, CLUSTER_GRID_Y - 1, CLUSTER_GRID_Z - 1);
+        if (pointLight)
+        {
+            const f32 nearDepth = -center.z - radius;
+            const f32 farDepth = -center.z + radius;
+            if (farDepth <= zNear || nearDepth >= zFar)
+                continue;
+            first.z = GetDepthSlice(header, glm::max(nearDepth, zNear));
+            last.z = GetDepthSlice(header, glm::min(farDepth, zFar));
+
+            // The sphere box is in front of the eye, so its projection is bounded
+            if (nearDepth > zNear)
+            {
+                glm::vec2 ndcMin = glm::vec2(1.0f);
+                glm::vec2 ndcMax = glm::vec2(-1.0f);
+                for (u32 c = 0; c < 8; ++c)
+                {
+                    const glm::vec3 corner = center + glm::vec3((c & 1) ? radius : -radius, (c & 2) ? radius : -radius, (c & 4) ? radius : -radius);
+                    const glm::vec4 clip = projection * glm::vec4(corner, 1.0f);
+                    ndcMin = glm::min(ndcMin, glm::vec2(clip) / clip.w);
+                    ndcMax = glm::max(ndcMax, glm::vec2(clip) / clip.w);
+                }
+                if (ndcMax.x < -1.0f || ndcMax.y < -1.0f || ndcMin.x > 1.0f || ndcMin.y > 1.0f)
+                    continue;
+                const glm::vec2 gridSize = glm::vec2(CLUSTER_GRID_X, CLUSTER_GRID_Y);
+                const glm::vec2 firstTile = glm::clamp(glm::floor((ndcMin * 0.5f + 0.5f) * gridSize), glm::vec2(0.0f), gridSize - 1.0f);
+                const glm::vec2 lastTile = glm::clamp(glm::floor((ndcMax * 0.5f + 0.5f) * gridSize), glm::vec2(0.0f), gridSize - 1.0f);
+                first.x = static_cast<u32>(firstTile.x);
+                first.y = static_cast<u32>(firstTile.y);
+                last.x = static_cast<u32>(lastTile.x);
+                last.y = static_cast<u32>(lastTile.y);
+            }
+        }
+
+        for (u32 z = first.z; z <= last.z; ++z)
+        {
+            for (u32 y = first.y; y <= last.y; ++y)
+            {
+                for (u32 x = first.x; x <= last.x; ++x)
+                {
+                    const u32 clusterIdx = GetClusterIdx(x, y, z);
+                    if (pointLight && !SphereIntersectsBounds(center, radius, clustered.bounds[clusterIdx]))
+                        continue;
+                    u32& count = grid[clusterIdx];
+                    if (count == CLUSTER_MAX_LIGHTS)
+                    {
+                        ++clustered.droppedClusterLights;
+                        continue;
+                    }
+                    grid[CLUSTER_COUNT + clusterIdx * CLUSTER_MAX_LIGHTS + count] = l;
+                    ++count;
+                }
+            }
+        }
+    }
+
+    clustered.occupiedClusters = 0;
+    clustered.maxClusterLights = 0;
+    for (u32 c = 0; c < CLUSTER_COUNT; ++c)
+    {
+        clustered.occupiedClusters += grid[c] > 0 ? 1 : 0;
+        clustered.maxClusterLights = std::max(clustered.maxClusterLights, grid[c]);
+    }
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, clustered.gridBuffer);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, static_cast<GLsizeiptr>(grid.size() * sizeof(u32)), grid.data());
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    clustered.cpuBinningMs = std::chrono::duration<f64, std::milli>(std::chrono::high_resolution_clock::now() - binningStart).count();
+}
+
+void ClusteredLightingSupport::Init(App* app)
+{
+    ClusteredLighting& clustered = app->clusteredLighting;
+    clustered.cullingProgramIdx = ShaderSupport::LoadComputeProgram(app, "Shaders\\shader_cluster_light_culling.comp", "CLUSTER_LIGHT_CULLING");
+
+    glGenBuffers(1, &clustered.lightBuffer);
+    glGenBuffers(1, &clustered.boundsBuffer);
+    glGenBuffers(1, &clustered.gridBuffer);
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, clustered.boundsBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, static_cast<GLsizeiptr>(CLUSTER_COUNT * sizeof(ClusterBounds)), nullptr, GL_STATIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, clustered.gridBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, static_cast<GLsizeiptr>((CLUSTER_COUNT + CLUSTER_COUNT * CLUSTER_MAX_LIGHTS) * sizeof(u32)), nullptr, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+void ClusteredLightingSupport::Shutdown(App* app)
+{
+    ClusteredLighting& clustered = app->clusteredLighting;
+    glDeleteBuffers(1, &clustered.lightBuffer);
+    glDeleteBuffers(1, &clustered.boundsBuffer);
+    glDeleteBuffers(1, &clustered.gridBuffer);
+}
+
+void ClusteredLightingSupport::Update(App* app)
+{
+    // The lights are uploaded in every mode, the light volumes read them too
+    ClusteredLighting& clustered = app->clusteredLighting;
+    clustered.lights.clear();
+    for (const std::shared_ptr<Light>& light : app->lights)
+    {
+        ClusterLight clusterLight;
+        clusterLight.positionRadius = glm::vec4(light->position, light->attenuation.radius);
+        clusterLight.colorType = glm::vec4(glm::vec3(light->color), static_cast<f32>(light->type));
+        clusterLight.direction = glm::vec4(light->orientationEuler, 0.0f);
+        clusterLight.attenuation = glm::vec4(light->attenuation.constant, light->attenuation.linear, light->attenuation.quadratic, 0.0f);
+        clustered.lights.push_back(clusterLight);
+    }
+    clustered.lights.insert(clustered.lights.end(), clustered.fieldLights.begin(), clustered.fieldLights.end());
+
+    if (clustered.boundsProjection != app->temporal.unjitteredProjectionMat || clustered.boundsDisplaySize != app->displaySizeCurrent)
+        BuildClusterBounds(app, clustered);
+
+    // Grows by doubling, the header and the lights are rewritten every frame
+    const u64 lightCount = clustered.lights.size();
+    clustered.header.grid.w = static_cast<u32>(lightCount);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, clustered.lightBuffer);
+    if (lightCount > clustered.lightBufferCapacity || clustered.lightBufferCapacity == 0)
+    {
+        clustered.lightBufferCapacity = std::max({ lightCount, clustered.lightBufferCapacity * 2, static_cast<u64>(FORWARD_MAX_LIGHTS) });
+        glBufferData(GL_SHADER_STORAGE_BUFFER, static_cast<GLsizeiptr>(sizeof(ClusterLightsHeader) + clustered.lightBufferCapacity * sizeof(ClusterLight)), nullptr, GL_DYNAMIC_DRAW);
+    }
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(ClusterLightsHeader), &clustered.header);
+    if (lightCount > 0)
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, sizeof(ClusterLightsHeader), static_cast<GLsizeiptr>(lightCount * sizeof(ClusterLight)), clustered.lights.data());
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    if (app->lightingMode == LightingMode::CLUSTERED && !clustered.gpuCulling)
+        BinLightsCPU(app, clustered);
+
+    clustered.bufferBytes = sizeof(ClusterLightsHeader) + clustered.lightBufferCapacity * sizeof(ClusterLight) + CLUSTER_COUNT * sizeof(ClusterBounds) +
+        (CLUSTER_COUNT + CLUSTER_COUNT * CLUSTER_MAX_LIGHTS) * sizeof(u32);
+}
+
+void ClusteredLightingSupport::CullLights(App* app)
+{
+    const ClusteredLighting& clustered = app->clusteredLighting;
+    if (app->lightingMode != LightingMode::CLUSTERED)
+        return;
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, STD_430_BINDING_POINT::BP_CLUSTER_LIGHTS, clustered.lightBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, STD_430_BINDING_POINT::BP_CLUSTER_GRID, clustered.gridBuffer);
+    if (!clustered.gpuCulling)
+        return;
+
+    glPushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, 1, -1, "Cluster Light Culling");
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, STD_430_BINDING_POINT::BP_CLUSTER_BOUNDS, clustered.boundsBuffer);
+    BufferManagement::BindBufferRange(app->uniformBuffer, STD_140_BINDING_POINT::BP_GLOBAL_PARAMS, app->globalParamsSize, app->globalParamsOffset);
+
+    glUseProgram(app->programs[clustered.cullingProgramIdx].handle);
+    glDispatchCompute((CLUSTER_COUNT + CLUSTER_CULLING_GROUP_SIZE - 1) / CLUSTER_CULLING_GROUP_SIZE, 1, 1);
+
+    // The shading pass reads the grid
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    glPopDebugGroup();
+}
+
+void ClusteredLightingSupport::GenerateLightField(App* app, const u32 count)
+{
+    ClusteredLighting& clustered = app->clusteredLighting;
+    clustered.fieldLights.clear();
+    clustered.fieldLightCount = static_cast<i32>(count);
+
+    // Fixed seed, the same count always gives the same field
+    std::default_random_engine generator(1234u);
+    std::uniform_real_distribution<f32> randomX(-28.0f, 28.0f);
+    std::uniform_real_distribution<f32> randomY(4.5f, 14.0f);
+    std::uniform_real_distribution<f32> randomZ(-12.0f, 12.0f);
+    std::uniform_real_distribution<f32> randomHue(0.0f, 1.0f);
+
+    // Stronger falloff than the scene lights, a few meters of radius each
+    Attenuation attenuation = { 1.0f, 1.4f, 3.6f, 0.0f }; // Radius from the color of each light
+    for (u32 i = 0; i < count; ++i)
+    {
+        const glm::vec3 color = glm::clamp(glm::abs(glm::fract(randomHue(generator) + glm::vec3(0.0f, 2.0f / 3.0f, 1.0f / 3.0f)) * 6.0f - 3.0f) - 1.0f, 0.0f, 1.0f);
+        attenuation.CalculateRadius(color);
+
+        ClusterLight light;
+        light.positionRadius = glm::vec4(randomX(generator), randomY(generator), randomZ(generator), attenuation.radius);
+        light.colorType = glm::vec4(color, static_cast<f32>(LightType::POINT));
+        light.direction = glm::vec4(0.0f);
+        light.attenuation = glm::vec4(attenuation.constant, attenuation.linear, attenuation.quadratic, 0.0f);
+        clustered.fieldLights.push_back(light);
+    }
+}
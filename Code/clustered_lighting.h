@@ -0,0 +1,96 @@
+﻿#ifndef CLUSTERED_LIGHTING_H
+#define CLUSTERED_LIGHTING_H
+#include <vector>
+
+#include "platform.h"
+
+struct App;
+
+#define CLUSTER_GRID_X 16
+#define CLUSTER_GRID_Y 9
+#define CLUSTER_GRID_Z 24 // Exponential depth slices between the near and far planes
+#define CLUSTER_COUNT (CLUSTER_GRID_X * CLUSTER_GRID_Y * CLUSTER_GRID_Z)
+#define CLUSTER_MAX_LIGHTS 128 // Per cluster, the lights past it are dropped from the cluster
+#define CLUSTER_CULLING_GROUP_SIZE 128 // local_size_x of shader_cluster_light_culling.comp
+#define FORWARD_MAX_LIGHTS 16 // Size of GlobalParams::uLight, the forward shaders and the non clustered shading only see these
+#define CLUSTER_LIGHT_FIELD_MAX 4096
+
+// Light as read by the clustered shaders (std430, 64 bytes)
+struct ClusterLight
+{
+    glm::vec4 positionRadius; // w: Attenuation::radius
+    glm::vec4 colorType; // w: LightType
+    glm::vec4 direction;
+    glm::vec4 attenuation; // x: constant, y: linear, z: quadratic
+};
+
+// Header of the light buffer, followed by the ClusterLight array (std430)
+struct ClusterLightsHeader
+{
+    glm::uvec4 grid; // Clusters on x, y and z, w: light count
+    glm::vec4 depth; // Near, far, slice scale and slice bias, slice = log(viewDepth) * scale + bias
+    glm::vec4 tileSize; // Pixels per cluster on x and y
+    glm::uvec4 limits; // x: CLUSTER_MAX_LIGHTS, y: CLUSTER_COUNT
+};
+
+// View space AABB of a cluster (std430)
+struct ClusterBounds
+{
+    glm::vec4 minPoint;
+    glm::vec4 maxPoint;
+};
+
+/// <summary>
+/// Clustered deferred lighting. The view frustum is split in a froxel grid, every light volume (a sphere of its attenuation
+/// radius, directional lights cover the whole grid) is binned into the clusters it touches and the shading pass only walks
+/// the light list of the cluster of each pixel. Lights live in a shader storage buffer without a fixed cap. The binning runs
+/// in a compute pass or, in the CPU mode, on the main thread with the grid uploaded afterwards. The grid buffer keeps a count
+/// per cluster followed by CLUSTER_MAX_LIGHTS light indices per cluster.
+/// </summary>
+struct ClusteredLighting
+{
+    bool gpuCulling = true;
+    u32 cullingProgramIdx = 0;
+
+    GLuint lightBuffer = 0;
+    GLuint boundsBuffer = 0;
+    GLuint gridBuffer = 0;
+    u64 lightBufferCapacity = 0; // Lights the buffer holds before it is reallocated
+
+    std::vector<ClusterLight> lights; // Scene lights followed by the light field, rebuilt every frame
+    std::vector<ClusterBounds> bounds;
+    std::vector<u32> cpuGrid; // CPU mode, same layout as the grid buffer
+    ClusterLightsHeader header = {};
+
+    // The cluster bounds only change with the projection
+    glm::mat4 boundsProjection = glm::mat4(0.0f);
+    ivec2 boundsDisplaySize = ivec2(0);
+
+    // Stress test, point lights scattered through Sponza that are not entities
+    std::vector<ClusterLight> fieldLights;
+    i32 fieldLightCount = 0;
+
+    // Stats
+    f64 cpuBinningMs = 0.0;
+    u32 occupiedClusters = 0; // CPU mode only, the GPU grid is not read back
+    u32 maxClusterLights = 0;
+    u32 droppedClusterLights = 0; // Light references past CLUSTER_MAX_LIGHTS
+    u64 bufferBytes = 0;
+};
+
+struct ClusteredLightingSupport
+{
+    static void Init(App* app);
+    static void Shutdown(App* app);
+
+    // Uploads the lights and, in the CPU mode, bins them. Called once per frame after the camera and projection are updated
+    static void Update(App* app);
+
+    // GPU mode binning, before the shading pass. Binds the light and grid buffers for the shading program
+    static void CullLights(App* app);
+
+    // Replaces the light field with count random point lights
+    static void GenerateLightField(App* app, u32 count);
+};
+
+#endif // CLUSTERED_LIGHTING_H
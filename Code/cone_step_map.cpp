@@ -0,0 +1,204 @@
+﻿#include "cone_step_map.h"
+
+#include <chrono>
+#include <cstring>
+#include <vector>
+
+#include "app.h"
+#include "mesh_cache.h"
+#include "parallel.h"
+
+Image ConeStepMapSupport::BuildRelaxedConeMap(const Image& bump)
+{
+    // Depth of every texel at the cone map size, the bump is read with nearest filtering like the packed masks
+    const ivec2 size = glm::clamp(bump.size, ivec2(1), ivec2(CONE_STEP_MAP_MAX_SIZE));
+    std::vector<f32> depths(static_cast<size_t>(size.x) * size.y);
+    for (i32 y = 0; y < size.y; ++y)
+    {
+        for (i32 x = 0; x < size.x; ++x)
+        {
+            const i32 sourceX = x * bump.size.x / size.x;
+            const i32 sourceY = y * bump.size.y / size.y;
+            const u8 height = static_cast<const u8*>(bump.pixels)[static_cast<size_t>(sourceY) * bump.stride + static_cast<size_t>(sourceX) * bump.nchannels];
+            depths[static_cast<size_t>(y) * size.x + x] = 1.0f - height / 255.0f;
+        }
+    }
+
+    // The materials repeat their textures, so do the rays
+    auto depthAt = [&](const i32 x, const i32 y) -> f32
+    {
+        const i32 wrappedX = (x % size.x + size.x) % size.x;
+        const i32 wrappedY = (y % size.y + size.y) % size.y;
+        return depths[static_cast<size_t>(wrappedY) * size.x + wrappedX];
+    };
+
+    Image coneMap = {};
+    coneMap.size = size;
+    coneMap.nchannels = 4;
+    coneMap.stride = size.x * 4;
+    coneMap.pixels = malloc(static_cast<size_t>(coneMap.stride) * size.y); // Released with FreeImage like the stb images
+    u8* pixels = static_cast<u8*>(coneMap.pixels);
+
+    // Ratios are in texels per unit of depth here and in texture coordinates in the map, the larger side keeps them conservative
+    const f32 texelsToUV = 1.0f / static_cast<f32>(glm::max(size.x, size.y));
+    const i32 radius = CONE_STEP_SEARCH_RADIUS;
+    ParallelFor(static_cast<u32>(size.y), [&](const u32 row)
+    {
+        const i32 y = static_cast<i32>(row);
+        for (i32 x = 0; x < size.x; ++x)
+        {
+            const f32 srcDepth = depthAt(x, y);
+            f32 coneRatio = static_cast<f32>(radius);
+            for (i32 dy = -radius; dy <= radius; ++dy)
+            {
+                for (i32 dx = -radius; dx <= radius; ++dx)
+                {
+                    // Any exit point of this ray is at least this far, so it can't narrow the cone further
+                    const f32 distance = glm::sqrt(static_cast<f32>(dx * dx + dy * dy));
+                    if ((dx == 0 && dy == 0) || distance > static_cast<f32>(radius) || distance >= coneRatio * srcDepth)
+                        continue;
+
+                    // Ray from the top of the height field above the source texel through the surface at the destination texel
+                    const f32 dstDepth = depthAt(x + dx, y + dy);
+                    if (dstDepth <= 0.0f)
+                        continue;
+
+                    // Past the destination the ray goes on under the surface until it leaves it, the cone must not reach that exit
+                    const i32 steps = glm::clamp(static_cast<i32>(glm::ceil(distance / dstDepth * (1.0f - dstDepth))), 1, 2 * radius);
+                    const glm::vec3 step = glm::vec3(dx / dstDepth, dy / dstDepth, 1.0f) * ((1.0f - dstDepth) / static_cast<f32>(steps));
+                    glm::vec3 position = glm::vec3(static_cast<f32>(x + dx), static_cast<f32>(y + dy), dstDepth);
+                    for (i32 s = 0; s < steps; ++s)
+                    {
+                        if (depthAt(static_cast<i32>(glm::round(position.x)), static_cast<i32>(glm::round(position.y))) > position.z)
+                            break;
+                        position += step;
+                    }
+
+                    if (position.z < srcDepth)
+                        coneRatio = glm::min(coneRatio, glm::length(glm::vec2(position.x - x, position.y - y)) / (srcDepth - position.z));
+                }
+            }
+
+            // The square root spends more of the 8 bits on the narrow cones
+            u8* pixel = pixels + static_cast<size_t>(y) * coneMap.stride + static_cast<size_t>(x) * 4;
+            pixel[0] = static_cast<u8>(glm::round(srcDepth * 255.0f));
+            pixel[1] = static_cast<u8>(glm::round(glm::sqrt(glm::clamp(coneRatio * texelsToUV, 0.0f, 1.0f)) * 255.0f));
+            pixel[2] = 0;
+            pixel[3] = 255;
+        }
+    });
+    return coneMap;
+}
+
+std::string ConeStepMapSupport::GetCachePath(const char* filename)
+{
+    return MakeString(filename) + CONE_STEP_MAP_EXTENSION;
+}
+
+bool ConeStepMapSupport::ReadCachedConeMap(const char* filename, const u64 sourceHash, Image& coneMap)
+{
+    const std::string cachePath = GetCachePath(filename);
+    MappedFile file;
+    if (!MapFile(cachePath.c_str(), file))
+        return false;
+
+    ConeStepMapHeader header = {};
+    bool valid = file.size >= sizeof(ConeStepMapHeader);
+    if (valid)
+    {
+        memcpy(&header, file.data, sizeof(ConeStepMapHeader));
+        valid = header.magic == CONE_STEP_MAP_MAGIC && header.version == CONE_STEP_MAP_VERSION && header.sourceHash == sourceHash &&
+            header.width > 0 && header.height > 0 && file.size == sizeof(ConeStepMapHeader) + static_cast<u64>(header.width) * header.height * 4;
+    }
+    if (valid)
+    {
+        coneMap.size = ivec2(header.width, header.height);
+        coneMap.nchannels = 4;
+        coneMap.stride = header.width * 4;
+        coneMap.pixels = malloc(static_cast<size_t>(coneMap.stride) * header.height);
+        memcpy(coneMap.pixels, file.data + sizeof(ConeStepMapHeader), static_cast<size_t>(coneMap.stride) * header.height);
+    }
+    UnmapFile(file);
+
+    if (!valid)
+        ELOG("Cone step map %s is outdated or corrupted, building it again", cachePath.c_str())
+    return valid;
+}
+
+bool ConeStepMapSupport::WriteCachedConeMap(const char* filename, const u64 sourceHash, const Image& coneMap)
+{
+    const std::string cachePath = GetCachePath(filename);
+    FILE* file = fopen(cachePath.c_str(), "wb");
+    if (!file)
+    {
+        ELOG("Could not write the cone step map %s", cachePath.c_str())
+        return false;
+    }
+
+    ConeStepMapHeader header = {};
+    header.magic = CONE_STEP_MAP_MAGIC;
+    header.version = CONE_STEP_MAP_VERSION;
+    header.sourceHash = sourceHash;
+    header.width = coneMap.size.x;
+    header.height = coneMap.size.y;
+
+    const size_t dataSize = static_cast<size_t>(coneMap.stride) * coneMap.size.y;
+    bool written = fwrite(&header, sizeof(header), 1, file) == 1;
+    written = written && fwrite(coneMap.pixels, 1, dataSize, file) == dataSize;
+    fclose(file);
+
+    if (!written)
+    {
+        ELOG("Could not write the cone step map %s", cachePath.c_str())
+        remove(cachePath.c_str());
+    }
+    return written;
+}
+
+Image ConeStepMapSupport::ReadOrBuildConeMap(const char* bumpPath, bool& cached)
+{
+    const u64 sourceHash = MeshCacheSupport::HashFile(bumpPath);
+    Image coneMap = {};
+    cached = ReadCachedConeMap(bumpPath, sourceHash, coneMap);
+    if (cached)
+        return coneMap;
+
+    const Image bump = TextureSupport::LoadImage(bumpPath);
+    if (!bump.pixels)
+        return coneMap;
+    coneMap = BuildRelaxedConeMap(bump);
+    TextureSupport::FreeImage(bump);
+    WriteCachedConeMap(bumpPath, sourceHash, coneMap);
+    return coneMap;
+}
+
+u32 ConeStepMapSupport::LoadConeStepMap(App* app, const u32 bumpTextureIdx)
+{
+    // Shared by the materials with the same bump
+    const std::string bumpPath = app->textures[bumpTextureIdx].path;
+    const std::string cachePath = GetCachePath(bumpPath.c_str());
+    for (u32 texIdx = 0; texIdx < app->textures.size(); ++texIdx)
+        if (app->textures[texIdx].path == cachePath)
+            return texIdx;
+
+    const auto start = std::chrono::high_resolution_clock::now();
+    ConeStepMapping& coneStep = app->coneStepMapping;
+    bool cached = false;
+    const Image coneMap = ReadOrBuildConeMap(bumpPath.c_str(), cached);
+    if (!coneMap.pixels)
+        return 0;
+
+    // The role lets ReloadTexture read it again from the cache after an eviction or a release
+    const u32 texIdx = TextureSupport::CreateTexture2D(app, coneMap, cachePath.c_str());
+    app->textures[texIdx].role = TextureRole::CONE_STEP_MAP;
+    TextureSupport::FreeImage(coneMap);
+
+    const f64 elapsedMs = std::chrono::duration<f64, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    coneStep.buildMs += elapsedMs;
+    if (cached)
+        ++coneStep.mapsFromCache;
+    else
+        ++coneStep.mapsBuilt;
+    ILOG("Cone step map %s %s in %.2f ms", cachePath.c_str(), cached ? "read" : "built", elapsedMs)
+    return texIdx;
+}
@@ -0,0 +1,63 @@
+﻿#ifndef CONE_STEP_MAP_H
+#define CONE_STEP_MAP_H
+#include <string>
+
+#include "platform.h"
+#include "texture.h"
+
+struct App;
+
+#define CONE_STEP_MAP_MAGIC 0x50545343 // "CSTP"
+#define CONE_STEP_MAP_VERSION 1
+#define CONE_STEP_MAP_EXTENSION ".conemap"
+#define CONE_STEP_MAP_MAX_SIZE 256 // Larger bump maps are sampled down, the build is quadratic in the search radius per texel
+#define CONE_STEP_SEARCH_RADIUS 16 // Texels around each texel whose rays limit its cone, it also caps the cone ratio
+
+/// <summary>
+/// Header of a cached cone step map, followed by width * height RGBA8 texels. Only valid for the same bump file contents.
+/// </summary>
+struct ConeStepMapHeader
+{
+    u32 magic;
+    u32 version;
+    u64 sourceHash;
+    i32 width;
+    i32 height;
+};
+
+/// <summary>
+/// Relaxed cone step mapping (GPU Gems 3, chapter 18). Every bump texture gets a cone map at load time: the depth below the
+/// top of the height field (1 - height) in r and the square root of the relaxed cone ratio in g. The cone of a texel is the
+/// widest one whose rays cross the surface once at most, so the geometry pass shaders march the view ray a fixed few cone
+/// steps and refine the hit with a short binary search instead of walking hundreds of layers. The parallax fades out with the
+/// distance to the camera, where the march is skipped.
+/// </summary>
+struct ConeStepMapping
+{
+    f32 fadeStart = 15.0f;
+    f32 fadeEnd = 30.0f;
+
+    // Stats
+    u32 mapsBuilt = 0;
+    u32 mapsFromCache = 0;
+    f64 buildMs = 0.0;
+};
+
+struct ConeStepMapSupport
+{
+    // Cone map of the bump image, at most CONE_STEP_MAP_MAX_SIZE per side. No app or OpenGL access
+    static Image BuildRelaxedConeMap(const Image& bump);
+
+    static std::string GetCachePath(const char* filename);
+    static bool ReadCachedConeMap(const char* filename, u64 sourceHash, Image& coneMap);
+    static bool WriteCachedConeMap(const char* filename, u64 sourceHash, const Image& coneMap);
+
+    // Cone map image of the bump file, read from the cache or built and written there. No pixels when the bump can't be read
+    static Image ReadOrBuildConeMap(const char* bumpPath, bool& cached);
+
+    // Texture slot of the cone map of a bump source (see TextureSupport::AddTextureSource), read from the cache next to the
+    // source or built and written there. 0 when the bump can't be read
+    static u32 LoadConeStepMap(App* app, u32 bumpTextureIdx);
+};
+
+#endif // CONE_STEP_MAP_H
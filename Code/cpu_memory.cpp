@@ -0,0 +1,113 @@
+﻿#include "cpu_memory.h"
+
+#include "app.h"
+
+template <typename T>
+static u64 VectorBytes(const std::vector<T>& vector)
+{
+    return static_cast<u64>(vector.capacity()) * sizeof(T);
+}
+
+static u64 GeometryBytes(const App* app)
+{
+    u64 bytes = 0;
+    for (const Mesh& mesh : app->meshes)
+        for (const SubMesh& subMesh : mesh.subMeshes)
+            bytes += VectorBytes(subMesh.vertices) + VectorBytes(subMesh.indices) + VectorBytes(subMesh.positions);
+    return bytes;
+}
+
+static u64 MeshletBytes(const App* app)
+{
+    u64 bytes = 0;
+    for (const Mesh& mesh : app->meshes)
+    {
+        for (const SubMesh& subMesh : mesh.subMeshes)
+        {
+            const MeshletBounds& bounds = subMesh.meshletBounds;
+            bytes += VectorBytes(subMesh.meshlets);
+            bytes += VectorBytes(bounds.centerX) + VectorBytes(bounds.centerY) + VectorBytes(bounds.centerZ) + VectorBytes(bounds.radius);
+            bytes += VectorBytes(bounds.coneAxisX) + VectorBytes(bounds.coneAxisY) + VectorBytes(bounds.coneAxisZ) + VectorBytes(bounds.coneCutoff);
+        }
+    }
+    return bytes;
+}
+
+static u64 SceneBytes(const App* app)
+{
+    u64 bytes = VectorBytes(app->textures) + VectorBytes(app->programs) + VectorBytes(app->meshes) + VectorBytes(app->materials) + VectorBytes(app->models);
+    bytes += static_cast<u64>(app->entities.size()) * sizeof(Light); // Lights are entities too, the largest of the two
+    bytes += VectorBytes(app->entities) + VectorBytes(app->lights);
+    for (const Mesh& mesh : app->meshes)
+        bytes += VectorBytes(mesh.subMeshes);
+    for (const Model& model : app->models)
+        bytes += VectorBytes(model.materialIdx);
+    return bytes;
+}
+
+// Decoded images and cooked mip chains waiting in the queues
+static u64 TextureStreamingBytes(App* app)
+{
+    TextureStreamer& streamer = app->textureStreamer;
+    u64 bytes = 0;
+    std::lock_guard<std::mutex> lock(streamer.mutex);
+    for (const TextureLoadJob& job : streamer.uploadQueue)
+    {
+        if (job.image.pixels != nullptr)
+            bytes += static_cast<u64>(job.image.stride) * job.image.size.y;
+        bytes += VectorBytes(job.compressed.data);
+    }
+    return bytes;
+}
+
+static u64 MaterialBatchingBytes(const App* app)
+{
+    const MaterialBatching& batching = app->materialBatching;
+    return VectorBytes(batching.textureRefs) + VectorBytes(batching.residentHandles) + VectorBytes(batching.meshVAOs) +
+        VectorBytes(batching.commands) + VectorBytes(batching.entityDraws) + VectorBytes(batching.meshletDrawCounts) + VectorBytes(batching.meshletDrawOffsets);
+}
+
+static u64 VirtualTexturingBytes(App* app)
+{
+    VirtualTexturing& virtualTexturing = app->virtualTexturing;
+    u64 bytes = VectorBytes(virtualTexturing.textureToVirtual);
+    for (const VirtualTexture& virtualTexture : virtualTexturing.virtualTextures)
+        for (const std::vector<i32>& levelSlots : virtualTexture.pageSlots)
+            bytes += VectorBytes(levelSlots);
+    for (const PhysicalPageAtlas& atlas : virtualTexturing.atlases)
+        bytes += VectorBytes(atlas.pages);
+
+    std::lock_guard<std::mutex> lock(virtualTexturing.mutex);
+    for (const PageLoadJob& job : virtualTexturing.uploadQueue)
+        bytes += VectorBytes(job.data);
+    return bytes;
+}
+
+void CpuMemorySupport::Update(App* app)
+{
+    CpuMemory& cpuMemory = app->cpuMemory;
+    u64 bytes[CPU_MEMORY_CATEGORY_COUNT] = {};
+    bytes[CPU_MEMORY_GEOMETRY] = GeometryBytes(app);
+    bytes[CPU_MEMORY_MESHLETS] = MeshletBytes(app);
+    bytes[CPU_MEMORY_SCENE] = SceneBytes(app);
+    bytes[CPU_MEMORY_TEXTURE_STREAMING] = TextureStreamingBytes(app);
+    bytes[CPU_MEMORY_MATERIAL_BATCHING] = MaterialBatchingBytes(app);
+    bytes[CPU_MEMORY_VIRTUAL_TEXTURING] = VirtualTexturingBytes(app);
+
+    cpuMemory.totalBytes = 0;
+    for (u32 c = 0; c < CPU_MEMORY_CATEGORY_COUNT; ++c)
+    {
+        cpuMemory.currentBytes[c] = bytes[c];
+        cpuMemory.peakBytes[c] = glm::max(cpuMemory.peakBytes[c], bytes[c]);
+        cpuMemory.totalBytes += bytes[c];
+    }
+    cpuMemory.peakTotalBytes = glm::max(cpuMemory.peakTotalBytes, cpuMemory.totalBytes);
+}
+
+void CpuMemorySupport::ResetPeaks(App* app)
+{
+    CpuMemory& cpuMemory = app->cpuMemory;
+    for (u32 c = 0; c < CPU_MEMORY_CATEGORY_COUNT; ++c)
+        cpuMemory.peakBytes[c] = cpuMemory.currentBytes[c];
+    cpuMemory.peakTotalBytes = cpuMemory.totalBytes;
+}
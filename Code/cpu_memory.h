@@ -0,0 +1,39 @@
+﻿#ifndef CPU_MEMORY_H
+#define CPU_MEMORY_H
+#include "platform.h"
+
+struct App;
+
+static const char* CpuMemoryCategoryStr[] = { "Geometry", "Meshlets", "Scene", "Texture streaming", "Material batching", "Virtual texturing" };
+enum CpuMemoryCategory
+{
+    CPU_MEMORY_GEOMETRY,
+    CPU_MEMORY_MESHLETS,
+    CPU_MEMORY_SCENE,
+    CPU_MEMORY_TEXTURE_STREAMING,
+    CPU_MEMORY_MATERIAL_BATCHING,
+    CPU_MEMORY_VIRTUAL_TEXTURING,
+    CPU_MEMORY_CATEGORY_COUNT
+};
+
+/// <summary>
+/// System memory accountant, the counterpart of GpuMemory. Each subsystem is measured from the capacity of the
+/// containers it owns every frame. Mapped files (mesh and texture caches) are left out, the OS pages them in and out.
+/// </summary>
+struct CpuMemory
+{
+    u64 currentBytes[CPU_MEMORY_CATEGORY_COUNT] = {};
+    u64 peakBytes[CPU_MEMORY_CATEGORY_COUNT] = {};
+    u64 totalBytes = 0;
+    u64 peakTotalBytes = 0;
+};
+
+struct CpuMemorySupport
+{
+    // Recounts the categories, called once per frame
+    static void Update(App* app);
+
+    static void ResetPeaks(App* app);
+};
+
+#endif // CPU_MEMORY_H
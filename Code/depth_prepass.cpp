@@ -0,0 +1,75 @@
+﻿#include "depth_prepass.h"
+
+#include "app.h"
+
+static glm::u8vec4 OverdrawHeatColor(const u32 fragments)
+{
+    if (fragments == 0)
+        return glm::u8vec4(26, 26, 26, 255);
+
+    // Blue for a single fragment, through green to red at OVERDRAW_HEAT_MAX
+    const f32 t = glm::clamp(static_cast<f32>(fragments - 1) / static_cast<f32>(OVERDRAW_HEAT_MAX - 1), 0.0f, 1.0f);
+    const glm::vec3 color = t < 0.5f ? glm::mix(glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 1.0f, 0.0f), t * 2.0f) :
+        glm::mix(glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(1.0f, 0.0f, 0.0f), t * 2.0f - 1.0f);
+    return glm::u8vec4(glm::u8vec3(color * 255.0f), 255);
+}
+
+void DepthPrepassSupport::Init(App* app)
+{
+    DepthPrepass& prepass = app->depthPrepass;
+    prepass.programIdx = ShaderSupport::LoadProgram(app, "Shaders\\shader_depth_prepass.vert", "Shaders\\shader_depth_prepass.frag", "DEPTH_PREPASS");
+    prepass.overdrawTextureIdx = TextureSupport::CreateEmptyColorTexture_8Bit_RGBA(app, "Overdraw Heat Map", app->displaySizeCurrent.x, app->displaySizeCurrent.y);
+    GpuTimerSupport::Init(prepass.geometryTimer);
+}
+
+void DepthPrepassSupport::Shutdown(App* app)
+{
+    GpuTimerSupport::Shutdown(app->depthPrepass.geometryTimer);
+}
+
+void DepthPrepassSupport::BeginOverdrawCount()
+{
+    // Every fragment that passes the depth test is shaded, there is no discard nor depth write in the geometry shaders
+    glEnable(GL_STENCIL_TEST);
+    glStencilFunc(GL_ALWAYS, 0, 0xFF);
+    glStencilOp(GL_KEEP, GL_KEEP, GL_INCR);
+}
+
+void DepthPrepassSupport::EndOverdrawCount(App* app)
+{
+    DepthPrepass& prepass = app->depthPrepass;
+    glDisable(GL_STENCIL_TEST);
+
+    const u32 width = static_cast<u32>(app->displaySizeCurrent.x);
+    const u32 height = static_cast<u32>(app->displaySizeCurrent.y);
+    const u64 pixelCount = static_cast<u64>(width) * height;
+    prepass.stencilReadback.resize(pixelCount);
+    prepass.heatPixels.resize(pixelCount * 4);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, static_cast<GLsizei>(width), static_cast<GLsizei>(height), GL_STENCIL_INDEX, GL_UNSIGNED_BYTE, prepass.stencilReadback.data());
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+
+    // The light volumes expect a zero stencil
+    glClear(GL_STENCIL_BUFFER_BIT);
+
+    OverdrawStats& stats = prepass.overdraw[prepass.enabled ? 1 : 0];
+    stats = {};
+    for (u64 p = 0; p < pixelCount; ++p)
+    {
+        const u32 fragments = prepass.stencilReadback[p];
+        if (fragments > 0)
+        {
+            ++stats.coveredPixels;
+            stats.shadedFragments += fragments;
+            stats.maxFragments = glm::max(stats.maxFragments, fragments);
+        }
+        const glm::u8vec4 color = OverdrawHeatColor(fragments);
+        memcpy(&prepass.heatPixels[p * 4], &color, 4);
+    }
+    stats.averageFragments = stats.coveredPixels > 0 ? static_cast<f32>(static_cast<f64>(stats.shadedFragments) / stats.coveredPixels) : 0.0f;
+    stats.valid = true;
+
+    glBindTexture(GL_TEXTURE_2D, app->textures[prepass.overdrawTextureIdx].handle);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, static_cast<GLsizei>(width), static_cast<GLsizei>(height), GL_RGBA, GL_UNSIGNED_BYTE, prepass.heatPixels.data());
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
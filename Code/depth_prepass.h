@@ -0,0 +1,52 @@
+﻿#ifndef DEPTH_PREPASS_H
+#define DEPTH_PREPASS_H
+#include <vector>
+
+#include "platform.h"
+#include "gpu_timer.h"
+
+struct App;
+
+#define OVERDRAW_HEAT_MAX 8 // Fragments per pixel shown at full red in the overdraw view
+
+// Fragments that passed the depth test of the geometry pass, measured from the stencil count
+struct OverdrawStats
+{
+    bool valid = false;
+    u64 shadedFragments = 0;
+    u64 coveredPixels = 0;
+    u32 maxFragments = 0; // Of a single pixel, the stencil saturates at 255
+    f32 averageFragments = 0.0f; // Per covered pixel
+};
+
+/// <summary>
+/// Optional depth only prepass of the deferred geometry. A position only program lays down the depth of the same draws
+/// the geometry pass does (same culling, material batches included), then the geometry pass runs with GL_EQUAL and no
+/// depth writes, so the material shader runs once per covered pixel. The vertex shaders declare gl_Position invariant so
+/// both passes produce the same depth. Impostors are not in the prepass and are drawn with the regular depth test.
+/// With GBufferMode::OVERDRAW the geometry pass counts its fragments in the stencil, which is read back (stalling) for
+/// the heat map and the stats, then cleared for the light volumes.
+/// </summary>
+struct DepthPrepass
+{
+    bool enabled = false;
+    u32 programIdx = 0; // Also the Forward+ prepass
+    u32 overdrawTextureIdx = 0;
+    GpuTimer geometryTimer; // Prepass and geometry pass
+
+    std::vector<u8> stencilReadback;
+    std::vector<u8> heatPixels;
+    OverdrawStats overdraw[2]; // Last measurement without and with the prepass
+};
+
+struct DepthPrepassSupport
+{
+    static void Init(App* app);
+    static void Shutdown(App* app);
+
+    // Around the geometry pass draws, with the G-buffer frame buffer bound
+    static void BeginOverdrawCount();
+    static void EndOverdrawCount(App* app);
+};
+
+#endif // DEPTH_PREPASS_H
@@ -11,24 +11,22 @@
 #include <imgui.h>
 #include <iostream>
 #include <random>
+#include <algorithm>
 
 #include <glm/gtx/matrix_decompose.hpp>
 #include <glm/gtx/quaternion.hpp>
 #include <glm/gtx/string_cast.hpp>
 
 #include "assimp_model_loading.h"
+#include "gltf_model_loading.h"
 #include "mesh_example.h"
+#include "obj_model_loading.h"
 #include "program.h"
 #include "texture.h"
 #include "vertex.h"
 
 #include "ImGuizmo.h"
 
-float lerp(float a, float b, float f)
-{
-    return a + f * (b - a);
-} 
-
 void Init(App* app)
 {
     // OpenGL inits
@@ -39,9 +37,16 @@ void Init(App* app)
     // Default Texture loading
     app->defaultTextureIdx = TextureSupport::LoadTexture2D(app, "color_white.png");
 
+    // From here on textures are decoded by the workers and uploaded a few per frame
+    TextureStreamingSupport::Init(app);
+    AssetLoaderSupport::Init(app);
+
     // Create uniform buffer
     app->uniformBuffer = CREATE_CONSTANT_BUFFER(BufferManagement::maxUniformBufferSize, nullptr);
 
+    // Motion vectors are attached to both G-buffer layouts
+    TemporalSupport::Init(app);
+
     // Create frame buffer and a color texture attachment
     app->frameBufferObject = FrameBufferManagement::CreateFrameBuffer();
     app->gColorTextureIdx = TextureSupport::CreateEmptyColorTexture_8Bit_RGBA(app, "FBO Color", app->displaySizeCurrent.x, app->displaySizeCurrent.y);
@@ -51,7 +56,7 @@ void Init(App* app)
     app->gBumpTextureIdx = TextureSupport::CreateEmptyColorTexture_16Bit_F_RGBA(app, "FBO Bump", app->displaySizeCurrent.x, app->displaySizeCurrent.y);
     app->gSpecularTextureIdx = TextureSupport::CreateEmptyColorTexture_8Bit_R(app, "FBO Specular", app->displaySizeCurrent.x, app->displaySizeCurrent.y);
     app->gFinalResultTextureIdx = TextureSupport::CreateEmptyColorTexture_8Bit_RGBA(app, "FBO Final Result", app->displaySizeCurrent.x, app->displaySizeCurrent.y);
-    app->gDepthTextureIdx = TextureSupport::CreateEmptyDepthTexture(app, "FBO Depth", app->displaySizeCurrent.x, app->displaySizeCurrent.y);
+    app->gDepthTextureIdx = TextureSupport::CreateEmptyDepthStencilTexture(app, "FBO Depth Stencil", app->displaySizeCurrent.x, app->displaySizeCurrent.y); // Stencil marks the pixels inside the light volumes
 
     // Bind textures to framebuffer, with the corresponding location.
     FrameBufferManagement::BindFrameBuffer(app->frameBufferObject);
@@ -62,32 +67,36 @@ void Init(App* app)
     FrameBufferManagement::SetColorAttachment(app->frameBufferObject, app->textures[app->gBumpTextureIdx].handle, RT_LOCATION_BUMP);
     FrameBufferManagement::SetColorAttachment(app->frameBufferObject, app->textures[app->gSpecularTextureIdx].handle, RT_LOCATION_SPECULAR_ROUGHNESS);
     FrameBufferManagement::SetColorAttachment(app->frameBufferObject, app->textures[app->gFinalResultTextureIdx].handle, RT_LOCATION_FINAL_RESULT);
-    FrameBufferManagement::SetDepthAttachment(app->frameBufferObject, app->textures[app->gDepthTextureIdx].handle);
+    FrameBufferManagement::SetColorAttachment(app->frameBufferObject, app->textures[app->temporal.motionVectorsTextureIdx].handle, RT_LOCATION_MOTION_VECTORS);
+    FrameBufferManagement::SetDepthStencilAttachment(app->frameBufferObject, app->textures[app->gDepthTextureIdx].handle);
     FrameBufferManagement::CheckStatus();
     const std::vector<u32> attachments = { RT_LOCATION_COLOR, RT_LOCATION_POSITION_WORLD_SPACE, RT_LOCATION_NORMAL, RT_LOCATION_SPECULAR_ROUGHNESS, RT_LOCATION_BUMP, RT_LOCATION_TANGENT, RT_LOCATION_FINAL_RESULT };
     FrameBufferManagement::SetDrawBuffersTextures(attachments);
     FrameBufferManagement::UnBindFrameBuffer(app->frameBufferObject);
 
-    // SSAO Samples
-    std::uniform_real_distribution<float> randomFloats(0.0, 1.0); // random floats between [0.0, 1.0]
-    std::default_random_engine generator;
-    for (unsigned int i = 0; i < app->ssaoData.maxSamples; ++i)
-    {
-        glm::vec3 sample(
-            randomFloats(generator) * 2.0 - 1.0, 
-            randomFloats(generator) * 2.0 - 1.0, 
-            randomFloats(generator)
-        );
-        sample  = glm::normalize(sample);
-        sample *= randomFloats(generator);
-        
-        float scale = (float)i / 64.0; 
-        scale = lerp(0.1f, 1.0f, scale * scale);
-        sample *= scale;
-        app->ssaoData.kernel.push_back(sample);
-    }
+    // Compact G buffer, color, final result and depth are the ones of the full layout
+    app->compactFrameBufferObject = FrameBufferManagement::CreateFrameBuffer();
+    app->gNormalTangentTextureIdx = TextureSupport::CreateEmptyColorTexture_16Bit_RGBA(app, "FBO Normal Tangent (Octahedral)", app->displaySizeCurrent.x, app->displaySizeCurrent.y);
+    app->gMasksTextureIdx = TextureSupport::CreateEmptyColorTexture_8Bit_RG(app, "FBO Specular Bump", app->displaySizeCurrent.x, app->displaySizeCurrent.y);
+
+    FrameBufferManagement::BindFrameBuffer(app->compactFrameBufferObject);
+    FrameBufferManagement::SetColorAttachment(app->compactFrameBufferObject, app->textures[app->gColorTextureIdx].handle, RT_LOCATION_COLOR);
+    FrameBufferManagement::SetColorAttachment(app->compactFrameBufferObject, app->textures[app->gNormalTangentTextureIdx].handle, RT_LOCATION_NORMAL_TANGENT_OCTAHEDRAL);
+    FrameBufferManagement::SetColorAttachment(app->compactFrameBufferObject, app->textures[app->gMasksTextureIdx].handle, RT_LOCATION_MASKS);
+    FrameBufferManagement::SetColorAttachment(app->compactFrameBufferObject, app->textures[app->gFinalResultTextureIdx].handle, RT_LOCATION_FINAL_RESULT);
+    FrameBufferManagement::SetColorAttachment(app->compactFrameBufferObject, app->textures[app->temporal.motionVectorsTextureIdx].handle, RT_LOCATION_MOTION_VECTORS);
+    FrameBufferManagement::SetDepthStencilAttachment(app->compactFrameBufferObject, app->textures[app->gDepthTextureIdx].handle);
+    FrameBufferManagement::CheckStatus();
+    const std::vector<u32> compactAttachments = { RT_LOCATION_COLOR, RT_LOCATION_NORMAL_TANGENT_OCTAHEDRAL, RT_LOCATION_MASKS, RT_LOCATION_FINAL_RESULT };
+    FrameBufferManagement::SetDrawBuffersTextures(compactAttachments);
+    FrameBufferManagement::UnBindFrameBuffer(app->compactFrameBufferObject);
+
+    // SSAO Samples, regenerated for the sample count of each tier by SSAOSupport::SetTier
+    SSAOSupport::GenerateKernel(app->ssaoData, static_cast<u32>(app->ssaoData.kernelSize));
 
     // SSAO Noise for random rotation vectors to avoid artifactes (bad visual results) like banding
+    std::uniform_real_distribution<float> randomFloats(0.0, 1.0); // random floats between [0.0, 1.0]
+    std::default_random_engine generator;
     for (unsigned int i = 0; i < 16; i++)
     {
         glm::vec3 noise(
@@ -126,38 +135,65 @@ void Init(App* app)
     app->screenDisplayProgramIdx = ShaderSupport::LoadProgram(app, "Shaders\\shader_unlit_screen.vert", "Shaders\\shader_unlit_screen.frag", "UNLIT_SCREEN");
 
     app->deferredSSAOProgramIdx = ShaderSupport::LoadProgram(app, "Shaders\\shader_deferred_ssao.vert", "Shaders\\shader_deferred_ssao.frag", "SSAO");
+
+    app->impostorBakeProgramIdx = ShaderSupport::LoadProgram(app, "Shaders\\shader_impostor_bake.vert", "Shaders\\shader_impostor_bake.frag", "IMPOSTOR_BAKE");
+    app->impostorProgramIdx = ShaderSupport::LoadProgram(app, "Shaders\\shader_impostor.vert", "Shaders\\shader_impostor.frag", "IMPOSTOR");
+
+    // Drawn with the variant of their material features
+    ShaderPermutationSupport::RegisterProgram(app, litTexturedProgramIdx);
+    ShaderPermutationSupport::RegisterProgram(app, app->deferredGeometryProgramIdx);
+
+    // Batched geometry programs and their buffers
+    MaterialBatchingSupport::Init(app);
+    VirtualTexturingSupport::Init(app);
+    ClusteredLightingSupport::Init(app);
+    LightVolumesSupport::Init(app);
+    SSAOSupport::Init(app);
+    DepthPrepassSupport::Init(app);
+    ForwardPlusSupport::Init(app);
+    TileClassificationSupport::Init(app);
+    GpuTimerSupport::Init(app->lightingTimer);
+
     // Fill vertex shader layout auto
     for (u32 p = 0; p < app->programs.size(); ++p)
     {
-        Program& program = app->programs[p];
-        int programAttributesCount = 0;
-        glGetProgramiv(program.handle, GL_ACTIVE_ATTRIBUTES, &programAttributesCount);
-        for (int i = 0; i < programAttributesCount; ++i)
-        {
-            // Vertex Shader Attribute debug info
-            char attributeName[64];
-            i32 attributeNameLength;
-            i32 attributeSize;
-            u32 attributeType;
-            glGetActiveAttrib(program.handle, i, std::size(attributeName), &attributeNameLength, &attributeSize, &attributeType, attributeName);
-            const u32 attributeLocation = glGetAttribLocation(program.handle, attributeName);
-            std::cout << "Program name: " << program.programName << ", Attribute index: " << i << ", Name: " << attributeName << ", Size: " << attributeSize <<
-                ", Type: " << convertOpenGLDataTypeToString(attributeType) << ", Layout Location: " << attributeLocation << '\n';
-
-            // Vertex Shader Attribute fill
-            program.vertexInputLayout.attributes.push_back({static_cast<u8>(attributeLocation), static_cast<u8>(attributeSize)});
-        }
+        ShaderSupport::FillVertexInputLayout(app->programs[p]);
     }
     
-    // Load models
-    const u32 patrickModelIdx = AssimpSupport::LoadModel(app, "Patrick\\Patrick.obj");
+    // Load models, the files are read in parallel and created here in request order
     app->quadModel = CreateSampleMesh(app);
-    const u32 cubeModelIdx = AssimpSupport::LoadModel(app, "Primitives\\Cube.obj");
-    const u32 sphereModelIdx = AssimpSupport::LoadModel(app, "Primitives\\Sphere.obj");
+    const u32 patrickRequest = AssetLoaderSupport::RequestModel(app, "Patrick\\Patrick.obj", MLF_BUILD_MESHLETS | MLF_USE_MESH_CACHE | MLF_NATIVE_OBJ_PARSER);
+    const u32 cubeRequest = AssetLoaderSupport::RequestModel(app, "Primitives\\Cube.obj", MLF_USE_MESH_CACHE);
+    const u32 sphereRequest = AssetLoaderSupport::RequestModel(app, "Primitives\\Sphere.obj", MLF_USE_MESH_CACHE);
+    AssetLoaderSupport::RequestModel(app, "Primitives\\Arrows.obj", MLF_USE_MESH_CACHE);
+    const u32 sponzaRequest = AssetLoaderSupport::RequestModel(app, "Sponza\\sponza.obj", MLF_BUILD_MESHLETS | MLF_USE_MESH_CACHE | MLF_NATIVE_OBJ_PARSER);
+    AssetLoaderSupport::WaitAll(app);
+
+    const u32 patrickModelIdx = AssetLoaderSupport::GetModelIdx(app, patrickRequest);
+    const u32 cubeModelIdx = AssetLoaderSupport::GetModelIdx(app, cubeRequest);
+    const u32 sphereModelIdx = AssetLoaderSupport::GetModelIdx(app, sphereRequest);
+    const u32 sponzaModelIdx = AssetLoaderSupport::GetModelIdx(app, sponzaRequest);
+    app->lightVolumes.sphereModelIdx = sphereModelIdx;
+    app->assetLoader.guiSpawn.programIdx = litTexturedProgramIdx;
+
+    // Props field east of Sponza, streamed by cells around the camera once the world partition is enabled
+    for (i32 x = 0; x < 12; ++x)
+    {
+        for (i32 z = -6; z < 6; ++z)
+        {
+            const glm::vec3 cellCenter = glm::vec3(64.0f + (x + 0.5f) * WORLD_PARTITION_CELL_SIZE, 0.0f, (z + 0.5f) * WORLD_PARTITION_CELL_SIZE);
+            const f32 yaw = static_cast<f32>((x * 37 + z * 53) % 360);
+            WorldPartitionSupport::AddPlacement(app, "Patrick\\Patrick.obj", MLF_BUILD_MESHLETS | MLF_USE_MESH_CACHE | MLF_NATIVE_OBJ_PARSER,
+                cellCenter + glm::vec3(-3.0f, 1.0f, -3.0f), glm::vec3(0.0f, yaw, 0.0f), glm::vec3(0.3f), litTexturedProgramIdx, glm::vec4(0.788f, 0.522f, 0.02f, 1.0f), "World Patrick");
+            WorldPartitionSupport::AddPlacement(app, "Primitives\\Cube.obj", MLF_USE_MESH_CACHE,
+                cellCenter + glm::vec3(4.0f, 1.0f, 3.0f), glm::vec3(0.0f, yaw, 0.0f), glm::vec3(1.0f), litTexturedProgramIdx, glm::vec4(1.0f), "World Cube");
+            WorldPartitionSupport::AddPlacement(app, "Primitives\\Sphere.obj", MLF_USE_MESH_CACHE,
+                cellCenter + glm::vec3(3.0f, 1.0f, -4.0f), glm::vec3(0.0f), glm::vec3(1.0f), litTexturedProgramIdx, glm::vec4(0.5f, 0.6f, 1.0f, 1.0f), "World Sphere");
+        }
+    }
 
-    const u32 arrowsModelIdx = AssimpSupport::LoadModel(app, "Primitives\\Arrows.obj");
-    
-    const u32 sponzaModelIdx = AssimpSupport::LoadModel(app, "Sponza\\sponza.obj");
+    // Far field representation of the small props
+    ImpostorSupport::BakeImpostor(app, patrickModelIdx);
     
     Attenuation attenuation = {0.1f, 0.2f, 0.2f};
 
@@ -195,7 +231,6 @@ void Init(App* app)
     //  CreateEntity(app, glm::vec3(6.0f, 4.0f, 0.0f), glm::vec3(0.0f),glm::vec3(1.0f)
     //     ,patrickModelIdx, litTexturedProgramIdx, glm::vec4(0.788f, 0.522f, 0.02f, 1.0f), "PatrickModel");
 
-
     // Set camera intial pos
     app->camera.position = glm::vec3(28.0f, 8.453f, 0.052f);
     app->camera.angles = glm::vec3(-183.0f, -8.1, 0.0f);
@@ -217,6 +252,56 @@ void OpenGLContextGUI(App* app) {
     ImGui::Checkbox("Show Demo Window", &app->showDemoWindow);
     ImGui::Checkbox("Draw Wireframe", &app->drawWireFrame);
     ImGui::Checkbox("Debug UBO", &app->debugUBO);
+    ImGui::Checkbox("Meshlet Culling", &app->useMeshletCulling);
+    ImGui::SameLine();
+    ImGui::Checkbox("Back-face culling", &app->useBackFaceCulling);
+    if (app->useMeshletCulling)
+    {
+        const MeshletCullStats& stats = app->meshletCullStats;
+        ImGui::Text("Meshlets visible: %u / %u (frustum culled: %u, back-face culled: %u)", stats.visibleMeshlets, stats.totalMeshlets, stats.frustumCulled, stats.backFaceCulled);
+    }
+    ImGui::Text("Textures streaming: %u pending, %.2f MB uploaded last frame", app->textureStreamer.pendingTextures, app->textureStreamer.uploadedBytesLastFrame / (1024.0f * 1024.0f));
+    i32 uploadBudgetMB = static_cast<i32>(app->textureStreamer.uploadBudgetBytes / (1024 * 1024));
+    if (ImGui::SliderInt("Texture upload budget (MB/frame)", &uploadBudgetMB, 1, 256))
+        app->textureStreamer.uploadBudgetBytes = static_cast<u64>(uploadBudgetMB) * 1024 * 1024;
+    ImGui::Text("Block compressed textures: %u (%u from the texture cache)", app->textureStreamer.compressedTextures, app->textureStreamer.textureCacheHits);
+    ImGui::Checkbox("BC7 for color textures (next loads)", &app->textureStreamer.compressionSettings.useBC7ForColor);
+    ImGui::Checkbox("Impostors", &app->useImpostors);
+    if (app->useImpostors)
+    {
+        ImGui::SliderFloat("Impostor distance", &app->impostorDistance, 1.0f, 100.0f);
+        ImGui::Text("Impostors drawn: %u", app->impostorsDrawn);
+    }
+    ImGui::Checkbox("Virtual Texturing", &app->virtualTexturing.enabled);
+    if (app->virtualTexturing.enabled)
+    {
+        const VirtualTexturing& virtualTexturing = app->virtualTexturing;
+        ImGui::Text("Virtual textures: %u, resident pages: %u (%.2f MB of atlases)", static_cast<u32>(virtualTexturing.virtualTextures.size()), virtualTexturing.residentPages,
+            virtualTexturing.atlasBytes / (1024.0f * 1024.0f));
+        ImGui::Text("Pages requested: %u, uploaded: %u, evicted: %u", virtualTexturing.pagesRequestedLastFrame, virtualTexturing.pagesUploadedLastFrame, virtualTexturing.pagesEvicted);
+    }
+    ImGui::Checkbox("Material Batching", &app->useMaterialBatching);
+    if (app->useMaterialBatching)
+    {
+        MaterialBatching& batching = app->materialBatching;
+        if (batching.bindlessSupported)
+            ImGui::Checkbox("Bindless textures", &batching.useBindless);
+        if (batching.texturesUnplaced)
+            ImGui::Text("Material batching: out of texture arrays, drawing per subMesh");
+        else if (!MaterialBatchingSupport::IsReady(app))
+            ImGui::Text("Material batching: waiting for the textures");
+        else if (batching.builtWithBindless)
+            ImGui::Text("Multi draws: %u (%u commands), %u resident handles", batching.multiDrawCalls, batching.drawCommands, static_cast<u32>(batching.residentHandles.size()));
+        else
+            ImGui::Text("Multi draws: %u (%u commands), %u texture arrays (%.2f MB)", batching.multiDrawCalls, batching.drawCommands,
+                static_cast<u32>(batching.textureArrays.size()), batching.textureArrayBytes / (1024.0f * 1024.0f));
+    }
+
+    // Off, the base programs branch on the material UBO flags
+    ShaderPermutations& permutations = app->shaderPermutations;
+    ImGui::Checkbox("Shader permutations", &permutations.enabled);
+    ImGui::SameLine();
+    ImGui::Text("%u variants compiled (%.2f ms)", permutations.variantsCompiled, permutations.compileMs);
 
     // Rendering mode selection
     int renderingModeSelection = static_cast<int>(app->renderingMode);
@@ -229,6 +314,129 @@ void OpenGLContextGUI(App* app) {
         int gBufferModeSelection = static_cast<int>(app->gBufferMode);
         ImGui::Combo("G-Buffer Mode", &gBufferModeSelection, GBufferModeStr, IM_ARRAYSIZE(GBufferModeStr));
         app->gBufferMode = static_cast<GBufferMode>(gBufferModeSelection);
+
+        int gBufferLayoutSelection = static_cast<int>(app->gBufferLayout);
+        ImGui::Combo("G-Buffer Layout", &gBufferLayoutSelection, GBufferLayoutStr, IM_ARRAYSIZE(GBufferLayoutStr));
+        app->gBufferLayout = static_cast<GBufferLayout>(gBufferLayoutSelection);
+
+        DepthPrepass& prepass = app->depthPrepass;
+        ImGui::Checkbox("Depth prepass", &prepass.enabled);
+        ImGui::SameLine();
+        ImGui::Text("Geometry GPU: %.3f ms (avg %.3f ms)", prepass.geometryTimer.lastMs, prepass.geometryTimer.averageMs);
+        if (app->gBufferMode != GBufferMode::OVERDRAW)
+        {
+            ImGui::Text("Select the OVERDRAW view to measure the shaded fragments");
+        }
+        for (u32 p = 0; p < 2; ++p)
+        {
+            const OverdrawStats& stats = prepass.overdraw[p];
+            if (stats.valid)
+                ImGui::Text("%s prepass: %.2f fragments per covered pixel (max %u), %.2f M shaded", p == 0 ? "Without" : "With", stats.averageFragments,
+                    stats.maxFragments, stats.shadedFragments / 1000000.0f);
+        }
+        if (prepass.overdraw[0].valid && prepass.overdraw[1].valid && prepass.overdraw[0].shadedFragments > 0)
+        {
+            ImGui::Text("The prepass saves %.0f%% of the geometry pass fragments", 100.0f * (1.0f - static_cast<f32>(prepass.overdraw[1].shadedFragments) /
+                static_cast<f32>(prepass.overdraw[0].shadedFragments)));
+        }
+
+        // Targets written by the geometry pass and read back by the SSAO and shading passes
+        const Texture* textures = app->textures.data();
+        const u64 fullBytes = TextureSupport::GetEstimatedBytes(textures[app->gColorTextureIdx]) + TextureSupport::GetEstimatedBytes(textures[app->gPositionTextureIdx]) +
+            TextureSupport::GetEstimatedBytes(textures[app->gNormalTextureIdx]) + TextureSupport::GetEstimatedBytes(textures[app->gSpecularTextureIdx]) +
+            TextureSupport::GetEstimatedBytes(textures[app->gBumpTextureIdx]) + TextureSupport::GetEstimatedBytes(textures[app->gTangentTextureIdx]) +
+            TextureSupport::GetEstimatedBytes(textures[app->gDepthTextureIdx]);
+        const u64 compactBytes = TextureSupport::GetEstimatedBytes(textures[app->gColorTextureIdx]) + TextureSupport::GetEstimatedBytes(textures[app->gNormalTangentTextureIdx]) +
+            TextureSupport::GetEstimatedBytes(textures[app->gMasksTextureIdx]) + TextureSupport::GetEstimatedBytes(textures[app->gDepthTextureIdx]);
+        const f32 pixelCount = static_cast<f32>(glm::max(app->displaySizeCurrent.x * app->displaySizeCurrent.y, 1));
+        ImGui::Text("G-buffer targets: full %.2f MB (%.0f B/px), compact %.2f MB (%.0f B/px)", fullBytes / (1024.0f * 1024.0f), fullBytes / pixelCount,
+            compactBytes / (1024.0f * 1024.0f), compactBytes / pixelCount);
+
+        ConeStepMapping& coneStep = app->coneStepMapping;
+        ImGui::SliderFloat("Parallax Fade Start", &coneStep.fadeStart, 0.0f, 100.0f);
+        ImGui::SliderFloat("Parallax Fade End", &coneStep.fadeEnd, 0.0f, 100.0f);
+        coneStep.fadeEnd = glm::max(coneStep.fadeEnd, coneStep.fadeStart + 0.01f);
+        ImGui::Text("Cone step maps: %u built (%.2f ms), %u from cache", coneStep.mapsBuilt, coneStep.buildMs, coneStep.mapsFromCache);
+
+        ScreenSpaceAmbientOcclusion& ssao = app->ssaoData;
+        int ssaoTierSelection = static_cast<int>(ssao.tier);
+        if (ImGui::Combo("SSAO Tier", &ssaoTierSelection, SSAOTierStr, IM_ARRAYSIZE(SSAOTierStr)))
+            SSAOSupport::SetTier(app, static_cast<SSAOTier>(ssaoTierSelection));
+        ImGui::SliderFloat("SSAO Radius", &ssao.radius, 0.05f, 2.0f);
+        ImGui::SliderFloat("SSAO Falloff", &ssao.falloff, 0.5f, 4.0f);
+        if (ssao.tier != SSAOTier::FULL)
+            ImGui::SliderFloat("SSAO Edge Sharpness", &ssao.blurDepthSharpness, 1.0f, 200.0f);
+        const ivec2 ssaoSize = ssao.tier == SSAOTier::FULL ? app->displaySizeCurrent : app->textures[ssao.lowResDepthTextureIdx].size;
+        ImGui::Text("SSAO GPU: %.3f ms (avg %.3f ms), %d samples at %dx%d", ssao.timer.lastMs, ssao.timer.averageMs, ssao.kernelSize, ssaoSize.x, ssaoSize.y);
+
+        TemporalReprojection& temporal = app->temporal;
+        ImGui::Checkbox("TAA", &temporal.taaEnabled);
+        if (temporal.taaEnabled)
+        {
+            ImGui::SameLine();
+            ImGui::Text("Resolve GPU: %.3f ms (avg %.3f ms), jitter (%.2f, %.2f) px", temporal.resolveTimer.lastMs, temporal.resolveTimer.averageMs,
+                temporal.jitter.x, temporal.jitter.y);
+            ImGui::SliderFloat("TAA History Weight", &temporal.historyWeight, 0.0f, 0.98f);
+        }
+
+        ClusteredLighting& clustered = app->clusteredLighting;
+        LightVolumes& volumes = app->lightVolumes;
+        int lightingModeSelection = static_cast<int>(app->lightingMode);
+        if (ImGui::Combo("Lighting", &lightingModeSelection, LightingModeStr, IM_ARRAYSIZE(LightingModeStr)) && !volumes.benchmark.running)
+            app->lightingMode = static_cast<LightingMode>(lightingModeSelection);
+        if (ImGui::SliderInt("Light field", &clustered.fieldLightCount, 0, CLUSTER_LIGHT_FIELD_MAX))
+            ClusteredLightingSupport::GenerateLightField(app, static_cast<u32>(clustered.fieldLightCount));
+        ImGui::Text("Lighting GPU: %.3f ms (avg %.3f ms)", app->lightingTimer.lastMs, app->lightingTimer.averageMs);
+        TileClassification& classification = app->tileClassification;
+        ImGui::Checkbox("Tile classification", &classification.enabled);
+        if (classification.enabled)
+        {
+            const u32* tiles = classification.classTiles;
+            ImGui::SameLine();
+            ImGui::Text("%ux%u px tiles: %u %s, %u %s, %u %s", TILE_CLASS_SIZE, TILE_CLASS_SIZE, tiles[0], ShadingTileClassStr[0], tiles[1], ShadingTileClassStr[1],
+                tiles[2], ShadingTileClassStr[2]);
+        }
+        if (app->lightingMode == LightingMode::CLUSTERED)
+        {
+            ImGui::Checkbox("GPU light culling", &clustered.gpuCulling);
+            ImGui::Text("Lights: %u in a %ux%ux%u grid, up to %u per cluster", static_cast<u32>(clustered.lights.size()), CLUSTER_GRID_X, CLUSTER_GRID_Y, CLUSTER_GRID_Z, CLUSTER_MAX_LIGHTS);
+            if (!clustered.gpuCulling)
+                ImGui::Text("CPU binning: %.2f ms, %u occupied clusters, %u lights in the fullest, %u dropped", clustered.cpuBinningMs,
+                    clustered.occupiedClusters, clustered.maxClusterLights, clustered.droppedClusterLights);
+        }
+        else if (app->lightingMode == LightingMode::LIGHT_VOLUMES)
+        {
+            ImGui::Text("Light volumes: %u drawn, %u outside the frustum", volumes.drawnVolumes, volumes.culledVolumes);
+        }
+        else if (app->lights.size() > FORWARD_MAX_LIGHTS)
+        {
+            ImGui::Text("Only the first %u of %u lights are shaded", FORWARD_MAX_LIGHTS, static_cast<u32>(app->lights.size()));
+        }
+
+        const LightingBenchmark& benchmark = volumes.benchmark;
+        if (benchmark.running)
+        {
+            ImGui::Text("Benchmarking %s...", LightingModeStr[benchmark.modeIdx]);
+        }
+        else if (ImGui::Button("Benchmark lighting modes"))
+        {
+            LightVolumesSupport::StartBenchmark(app);
+        }
+        if (benchmark.hasResults)
+        {
+            ImGui::Text("%u lights: fullscreen %.3f ms (first %u only), clustered %.3f ms, volumes %.3f ms", benchmark.lightCount, benchmark.resultsMs[0],
+                FORWARD_MAX_LIGHTS, benchmark.resultsMs[1], benchmark.resultsMs[2]);
+        }
+    }
+    else if (renderingModeSelection == RenderingMode::FORWARD_PLUS)
+    {
+        ClusteredLighting& clustered = app->clusteredLighting;
+        const ForwardPlus& forwardPlus = app->forwardPlus;
+        if (ImGui::SliderInt("Light field", &clustered.fieldLightCount, 0, CLUSTER_LIGHT_FIELD_MAX))
+            ClusteredLightingSupport::GenerateLightField(app, static_cast<u32>(clustered.fieldLightCount));
+        ImGui::Text("Forward GPU: %.3f ms (avg %.3f ms)", app->lightingTimer.lastMs, app->lightingTimer.averageMs);
+        ImGui::Text("Lights: %u in %ux%u tiles of %u px, up to %u per tile", static_cast<u32>(clustered.lights.size()), forwardPlus.tileCount.x, forwardPlus.tileCount.y,
+            FORWARD_PLUS_TILE_SIZE, FORWARD_PLUS_TILE_MAX_LIGHTS);
     }
     
     // Full OpenGL & GLSL info dump
@@ -237,6 +445,54 @@ void OpenGLContextGUI(App* app) {
     ImGui::TextColored(ImVec4(1.0f, 1.0f, 0.0f, 1.0f), "FPS:");
     ImGui::SameLine();
     ImGui::Text("%f", 1.0f/app->deltaTime);
+    ImGui::TextColored(ImVec4(1.0f, 1.0f, 0.0f, 1.0f), "Model loading:");
+    ImGui::SameLine();
+    ImGui::Text("%.2f ms (%u / %u from mesh cache)", app->modelLoadingTimeMs, app->modelCacheHits, app->modelsLoaded);
+    ImGui::TextColored(ImVec4(1.0f, 1.0f, 0.0f, 1.0f), "Asset loading:");
+    ImGui::SameLine();
+    ImGui::Text("%.2f ms wall clock, %u workers", app->assetLoader.lastLoadWallMs, static_cast<u32>(app->assetLoader.graph.workers.size()));
+    if (ImGui::Button("Benchmark OBJ parsers (Sponza)"))
+        ObjSupport::BenchmarkAgainstAssimp("Sponza\\sponza.obj");
+
+    // Runtime import, the frame stays within the budgets while the model is read, created and uploaded (glTF scenes excepted)
+    AssetLoader& assetLoader = app->assetLoader;
+    ImGui::InputText("Model path", assetLoader.guiImportPath, IM_ARRAYSIZE(assetLoader.guiImportPath));
+    ImGui::DragFloat("Import scale", &assetLoader.guiSpawn.scale.x, 0.01f, 0.001f, 100.0f);
+    if (ImGui::Button("Import model"))
+    {
+        assetLoader.guiSpawn.position = app->camera.position + app->camera.front * 5.0f;
+        assetLoader.guiSpawn.scale = glm::vec3(assetLoader.guiSpawn.scale.x);
+        assetLoader.guiSpawn.name = assetLoader.guiImportPath;
+
+        std::string extension = assetLoader.guiSpawn.name.substr(glm::min(assetLoader.guiSpawn.name.find_last_of('.'), assetLoader.guiSpawn.name.size()));
+        std::transform(extension.begin(), extension.end(), extension.begin(), [](const char c) { return static_cast<char>(tolower(c)); });
+        if (extension == ".gltf" || extension == ".glb")
+        {
+            // glTF / GLB scenes keep their node hierarchy, every node with a mesh becomes an entity. Loaded in this frame
+            assetLoader.guiLastRequestIdx = UINT32_MAX;
+            const u32 gltfSceneIdx = GltfSupport::LoadGltf(app, assetLoader.guiImportPath);
+            if (gltfSceneIdx != UINT32_MAX)
+                GltfSupport::InstantiateScene(app, gltfSceneIdx, glm::translate(glm::mat4(1.0f), assetLoader.guiSpawn.position) * glm::scale(glm::mat4(1.0f),
+                    assetLoader.guiSpawn.scale), assetLoader.guiSpawn.programIdx);
+        }
+        else
+        {
+            assetLoader.guiLastRequestIdx = AssetLoaderSupport::ImportModelAsync(app, assetLoader.guiImportPath,
+                MLF_BUILD_MESHLETS | MLF_USE_MESH_CACHE | MLF_NATIVE_OBJ_PARSER, assetLoader.guiSpawn);
+        }
+    }
+    if (assetLoader.guiLastRequestIdx != UINT32_MAX)
+    {
+        ImGui::SameLine();
+        ImGui::Text("%s %.0f%%", ModelRequestStateStr[static_cast<u32>(AssetLoaderSupport::GetState(app, assetLoader.guiLastRequestIdx))],
+            AssetLoaderSupport::GetUploadProgress(app, assetLoader.guiLastRequestIdx) * 100.0f);
+    }
+    i32 uploadBudgetKB = static_cast<i32>(assetLoader.uploadBudgetKB);
+    ImGui::SliderInt("Upload budget (KB/frame)", &uploadBudgetKB, 64, 65536);
+    assetLoader.uploadBudgetKB = static_cast<u32>(uploadBudgetKB);
+    ImGui::SliderFloat("Import budget (ms/frame)", &assetLoader.frameBudgetMs, 0.1f, 16.0f);
+    ImGui::Text("Import cost: %.2f ms last frame, %.2f ms max, %.1f KB uploaded", assetLoader.lastFrameMs, assetLoader.maxFrameMs,
+        static_cast<f64>(assetLoader.lastFrameUploadedBytes) / 1024.0);
     ImGui::TextColored(ImVec4(1.0f, 1.0f, 0.0f, 1.0f), "OpenGL version:");
     ImGui::SameLine();
     ImGui::Text("%s", app->ctx.version.c_str());
@@ -286,7 +542,7 @@ void EntityTransformGUI(App* app)
     if (app->entities[selectedEntity])
     {
         Entity& entity = *app->entities[selectedEntity];
-        EditTransform(app, glm::value_ptr(app->camera.GetViewMatrix()), glm::value_ptr(app->projectionMat), glm::value_ptr(entity.worldMatrix), true);
+        EditTransform(app, glm::value_ptr(app->camera.GetViewMatrix()), glm::value_ptr(app->temporal.unjitteredProjectionMat), glm::value_ptr(entity.worldMatrix), true);
 
         // Light input
         if (std::shared_ptr<Light> light = std::dynamic_pointer_cast<Light>(app->entities[selectedEntity]))
@@ -305,6 +561,8 @@ void ProgramsGUI(const App* app) {
     {
         for (u32 n = 0; n < app->programs.size(); n++)
         {
+            if (app->programs[n].isPermutation)
+                continue;
             const bool isSelected = (itemCurrentIdx == n);
             if (ImGui::Selectable(app->programs[n].programName.c_str(), isSelected))
                 itemCurrentIdx = n;
@@ -343,6 +601,98 @@ void ResourcesGUI(App* app)
         ImGui::SameLine();
         ImGui::Text("%d, %d", app->displaySizeCurrent.x, app->displaySizeCurrent.y);
     }
+    if (ImGui::CollapsingHeader("GPU Memory", ImGuiTreeNodeFlags_DefaultOpen))
+    {
+        GpuMemory& gpuMemory = app->gpuMemory;
+        PushStyleCompact();
+        static ImGuiTableFlags flags = ImGuiTableFlags_SizingFixedFit | ImGuiTableFlags_RowBg | ImGuiTableFlags_Borders | ImGuiTableFlags_Resizable | ImGuiTableFlags_Reorderable | ImGuiTableFlags_Hideable;
+        if (ImGui::BeginTable("GPU memory table", 3, flags))
+        {
+            ImGui::TableSetupColumn("Category", ImGuiTableColumnFlags_WidthFixed);
+            ImGui::TableSetupColumn("Current (MB)", ImGuiTableColumnFlags_WidthFixed);
+            ImGui::TableSetupColumn("Peak (MB)", ImGuiTableColumnFlags_WidthFixed);
+
+            ImGui::TableHeadersRow();
+            for (u32 c = 0; c < GPU_MEMORY_CATEGORY_COUNT; ++c)
+            {
+                ImGui::TableNextRow();
+                ImGui::TableNextColumn(); ImGui::Text(GpuMemoryCategoryStr[c]);
+                ImGui::TableNextColumn(); ImGui::Text("%.2f", gpuMemory.currentBytes[c] / (1024.0f * 1024.0f));
+                ImGui::TableNextColumn(); ImGui::Text("%.2f", gpuMemory.peakBytes[c] / (1024.0f * 1024.0f));
+            }
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn(); ImGui::TextColored(ImVec4(1.0f, 1.0f, 0.0f, 1.0f), "Total");
+            ImGui::TableNextColumn(); ImGui::Text("%.2f", gpuMemory.totalBytes / (1024.0f * 1024.0f));
+            ImGui::TableNextColumn(); ImGui::Text("%.2f", gpuMemory.peakTotalBytes / (1024.0f * 1024.0f));
+            ImGui::EndTable();
+        }
+        PopStyleCompact();
+        if (ImGui::Button("Reset peaks"))
+            GpuMemorySupport::ResetPeaks(app);
+
+        ImGui::Checkbox("Texture budget", &gpuMemory.enforceTextureBudget);
+        if (gpuMemory.enforceTextureBudget)
+        {
+            i32 textureBudgetMB = static_cast<i32>(gpuMemory.textureBudgetMB);
+            if (ImGui::SliderInt("Texture budget (MB)", &textureBudgetMB, 16, 4096))
+                gpuMemory.textureBudgetMB = static_cast<u32>(textureBudgetMB);
+        }
+        ImGui::Text("Textures with evicted mips: %u (%u levels evicted last frame, %u in total, %u reloads)", gpuMemory.evictedTextures,
+            gpuMemory.levelsEvictedLastFrame, gpuMemory.totalLevelsEvicted, gpuMemory.totalReloads);
+    }
+    if (ImGui::CollapsingHeader("CPU Memory", ImGuiTreeNodeFlags_DefaultOpen))
+    {
+        CpuMemory& cpuMemory = app->cpuMemory;
+        PushStyleCompact();
+        static ImGuiTableFlags flags = ImGuiTableFlags_SizingFixedFit | ImGuiTableFlags_RowBg | ImGuiTableFlags_Borders | ImGuiTableFlags_Resizable | ImGuiTableFlags_Reorderable | ImGuiTableFlags_Hideable;
+        if (ImGui::BeginTable("CPU memory table", 3, flags))
+        {
+            ImGui::TableSetupColumn("Subsystem", ImGuiTableColumnFlags_WidthFixed);
+            ImGui::TableSetupColumn("Current (MB)", ImGuiTableColumnFlags_WidthFixed);
+            ImGui::TableSetupColumn("Peak (MB)", ImGuiTableColumnFlags_WidthFixed);
+
+            ImGui::TableHeadersRow();
+            for (u32 c = 0; c < CPU_MEMORY_CATEGORY_COUNT; ++c)
+            {
+                ImGui::TableNextRow();
+                ImGui::TableNextColumn(); ImGui::Text(CpuMemoryCategoryStr[c]);
+                ImGui::TableNextColumn(); ImGui::Text("%.2f", cpuMemory.currentBytes[c] / (1024.0f * 1024.0f));
+                ImGui::TableNextColumn(); ImGui::Text("%.2f", cpuMemory.peakBytes[c] / (1024.0f * 1024.0f));
+            }
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn(); ImGui::TextColored(ImVec4(1.0f, 1.0f, 0.0f, 1.0f), "Total");
+            ImGui::TableNextColumn(); ImGui::Text("%.2f", cpuMemory.totalBytes / (1024.0f * 1024.0f));
+            ImGui::TableNextColumn(); ImGui::Text("%.2f", cpuMemory.peakTotalBytes / (1024.0f * 1024.0f));
+            ImGui::EndTable();
+        }
+        PopStyleCompact();
+        if (ImGui::Button("Reset peaks##CPU"))
+            CpuMemorySupport::ResetPeaks(app);
+
+        int geometryResidencySelection = static_cast<int>(app->geometryResidency);
+        ImGui::Combo("Geometry residency (next loads)", &geometryResidencySelection, GeometryResidencyStr, IM_ARRAYSIZE(GeometryResidencyStr));
+        app->geometryResidency = static_cast<GeometryResidency>(geometryResidencySelection);
+    }
+    if (ImGui::CollapsingHeader("World Partition", ImGuiTreeNodeFlags_DefaultOpen))
+    {
+        WorldPartition& world = app->worldPartition;
+        ImGui::Checkbox("Stream world cells", &world.enabled);
+        ImGui::SliderFloat("Load radius", &world.loadRadius, WORLD_PARTITION_CELL_SIZE, 200.0f);
+        ImGui::SliderFloat("Unload radius", &world.unloadRadius, world.loadRadius, 256.0f);
+        world.unloadRadius = glm::max(world.unloadRadius, world.loadRadius);
+        ImGui::SliderFloat("Prefetch (s)", &world.prefetchSeconds, 0.0f, 5.0f);
+        i32 memoryBudgetMB = static_cast<i32>(world.memoryBudgetMB);
+        if (ImGui::SliderInt("World budget (MB)", &memoryBudgetMB, 1, 4096))
+            world.memoryBudgetMB = static_cast<u32>(memoryBudgetMB);
+        i32 maxLoadingCells = static_cast<i32>(world.maxLoadingCells);
+        if (ImGui::SliderInt("Max loading cells", &maxLoadingCells, 1, 16))
+            world.maxLoadingCells = static_cast<u32>(maxLoadingCells);
+        ImGui::Text("Cells: %u resident, %u loading, %u in total", world.residentCells, world.loadingCells, static_cast<u32>(world.cells.size()));
+        ImGui::Text("Models: %u resident of %u, %.2f MB resident, %.2f MB loading", world.residentModels, static_cast<u32>(world.models.size()),
+            world.residentBytes / (1024.0f * 1024.0f), world.loadingBytes / (1024.0f * 1024.0f));
+        ImGui::Text("Cell loads: %u, unloads: %u (%u over budget), camera speed %.1f", world.totalCellLoads, world.totalCellUnloads,
+            world.budgetUnloads, glm::length(world.cameraVelocity));
+    }
     if (ImGui::CollapsingHeader("Models", ImGuiTreeNodeFlags_DefaultOpen))
     {
         PushStyleCompact();
@@ -412,8 +762,8 @@ void ResourcesGUI(App* app)
                     {
                         const SubMesh& subMesh = mesh.subMeshes[rowSubMesh];
                         ImGui::TableNextColumn(); ImGui::Text((const char*)subMesh.name.c_str());
-                        ImGui::TableNextColumn(); ImGui::Text((const char*)std::to_string(subMesh.vertices.size()).c_str());
-                        ImGui::TableNextColumn(); ImGui::Text((const char*)std::to_string(subMesh.indices.size()).c_str());
+                        ImGui::TableNextColumn(); ImGui::Text((const char*)std::to_string(subMesh.vertexCount).c_str());
+                        ImGui::TableNextColumn(); ImGui::Text((const char*)std::to_string(subMesh.indexCount).c_str());
                         ImGui::TableNextColumn(); ImGui::Text((const char*)std::to_string(subMesh.vertexOffset).c_str());
                         ImGui::TableNextColumn(); ImGui::Text((const char*)std::to_string(subMesh.indexOffset).c_str());
                     }
@@ -495,7 +845,7 @@ void ResourcesGUI(App* app)
     {
         PushStyleCompact();
         static ImGuiTableFlags flags = ImGuiTableFlags_SizingFixedFit | ImGuiTableFlags_RowBg | ImGuiTableFlags_Borders | ImGuiTableFlags_Resizable | ImGuiTableFlags_Reorderable | ImGuiTableFlags_Hideable;
-        if (ImGui::BeginTable("Materials table", 11, flags))
+        if (ImGui::BeginTable("Materials table", 12, flags))
         {
             ImGui::TableSetupColumn("Idx vector", ImGuiTableColumnFlags_WidthFixed);
             ImGui::TableSetupColumn("Name", ImGuiTableColumnFlags_WidthFixed);
@@ -507,6 +857,7 @@ void ResourcesGUI(App* app)
             ImGui::TableSetupColumn("SpecularTextureIdx", ImGuiTableColumnFlags_WidthFixed);
             ImGui::TableSetupColumn("NormalsTextureIdx", ImGuiTableColumnFlags_WidthFixed);
             ImGui::TableSetupColumn("BumpTextureIdx", ImGuiTableColumnFlags_WidthFixed);
+            ImGui::TableSetupColumn("MasksTextureIdx", ImGuiTableColumnFlags_WidthFixed);
             ImGui::TableSetupColumn("HeightScale", ImGuiTableColumnFlags_WidthFixed);
 
             ImGui::TableHeadersRow();
@@ -525,6 +876,7 @@ void ResourcesGUI(App* app)
                 ImGui::TableNextColumn(); ImGui::Text((const char*)std::to_string(mat.specularTextureIdx).c_str());
                 ImGui::TableNextColumn(); ImGui::Text((const char*)std::to_string(mat.normalsTextureIdx).c_str());
                 ImGui::TableNextColumn(); ImGui::Text((const char*)std::to_string(mat.bumpTextureIdx).c_str());
+                ImGui::TableNextColumn(); ImGui::Text((const char*)std::to_string(mat.masksTextureIdx).c_str());
                 ImGui::TableNextColumn(); ImGui::SliderFloat((const char*)std::to_string(mat.heightScale).c_str(), &mat.heightScale, 0.0f, 0.2f);
             }
             ImGui::EndTable();
@@ -574,10 +926,22 @@ void Update(App* app)
 
     // Update projection matrix after new camera inputs
     app->projectionMat = glm::perspective(glm::radians(app->camera.zoom), (float)app->displaySizeCurrent.x / (float)app->displaySizeCurrent.y, 0.1f, 100.0f);
+    TemporalSupport::BeginFrame(app);
 
     // Programs hot reload
     CheckShadersHotReload(app);
 
+    // Textures decoded since last frame
+    AssetLoaderSupport::Update(app);
+    WorldPartitionSupport::Update(app);
+    LightVolumesSupport::UpdateBenchmark(app);
+    TextureStreamingSupport::Update(app);
+    // Before the batching update, which picks up the handles the evictions replaced in the same frame
+    GpuMemorySupport::Update(app);
+    MaterialBatchingSupport::Update(app);
+    VirtualTexturingSupport::Update(app);
+    CpuMemorySupport::Update(app);
+
     app->ssaoData.noiseScale = glm::vec2(app->displaySizeCurrent.x/4.0f, app->displaySizeCurrent.y/4.0f);
     
     // Uniform buffers push
@@ -588,12 +952,31 @@ void Update(App* app)
     PushMaterialDataUBO(app);
     PushSSAODataUBO(app);
     BufferManagement::UnmapBuffer(uniformBuffer);
+
+    // After the push, the light radii are updated there
+    ClusteredLightingSupport::Update(app);
+}
+
+void Shutdown(App* app)
+{
+    AssetLoaderSupport::Shutdown(app);
+    MaterialBatchingSupport::Shutdown(app);
+    VirtualTexturingSupport::Shutdown(app);
+    ClusteredLightingSupport::Shutdown(app);
+    ForwardPlusSupport::Shutdown(app);
+    TileClassificationSupport::Shutdown(app);
+    DepthPrepassSupport::Shutdown(app);
+    GpuTimerSupport::Shutdown(app->lightingTimer);
+    SSAOSupport::Shutdown(app);
+    TemporalSupport::Shutdown(app);
+    TextureStreamingSupport::Shutdown(app);
 }
 
 void Render(App* app)
 {
     switch (app->renderingMode) {
     case FORWARD:
+    case FORWARD_PLUS:
         ForwardRender(app);
         break;
     case DEFERRED:
@@ -622,6 +1005,18 @@ void ForwardRender(App* app)
     
     glViewport(0, 0, app->displaySizeCurrent.x, app->displaySizeCurrent.y);
 
+    GpuTimerSupport::Begin(app->lightingTimer);
+
+    // Forward+ shades against the prepass depth, every fragment that passes is the visible one
+    const bool forwardPlus = app->renderingMode == RenderingMode::FORWARD_PLUS;
+    if (forwardPlus)
+    {
+        ForwardPlusSupport::DepthPrepass(app);
+        ForwardPlusSupport::CullLights(app);
+        glDepthFunc(GL_LEQUAL);
+        glDepthMask(GL_FALSE);
+    }
+
     glEnable(GL_BLEND);
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
     
@@ -641,16 +1036,15 @@ void ForwardRender(App* app)
     {
         const Entity& entity = *app->entities[e];
                 
-        const Program& program = app->programs[entity.programIndex];
-        app->defaultShaderProgram_uTexture = glGetUniformLocation(program.handle, "uTexture");
-        glUseProgram(program.handle);
         BufferManagement::BindBufferRange(app->uniformBuffer, STD_140_BINDING_POINT::BP_LOCAL_PARAMS, entity.localParamsSize, entity.localParamsOffset);
 
         Model& model = app->models[entity.modelIndex];
         Mesh& mesh = app->meshes[model.meshIdx];
+        GpuMemorySupport::MarkEntityVisible(app, entity);
                 
         glPushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, 1, -1, model.name.c_str());
 
+        GLuint boundProgramHandle = 0;
         const u32 subMeshCount = static_cast<u32>(mesh.subMeshes.size());
         for (u32 i = 0; i < subMeshCount; i++)
         {
@@ -658,14 +1052,27 @@ void ForwardRender(App* app)
             const Material subMeshMaterial = app->materials[subMeshMaterialIdx];
             BufferManagement::BindBufferRange(app->uniformBuffer, STD_140_BINDING_POINT::BP_MATERIAL_PARAMS, subMeshMaterial.paramsSize, subMeshMaterial.paramsOffset);
 
-            const std::vector<u32> texturesUniformLocations = { MAT_T_DIFFUSE, MAT_T_NORMALS, MAT_T_SPECULAR };
+            // The subMeshes of an entity only switch programs when their materials need different permutations
+            const Program& program = app->programs[ShaderPermutationSupport::GetVariantIdx(app, entity.programIndex, subMeshMaterial)];
+            if (program.handle != boundProgramHandle)
+            {
+                app->defaultShaderProgram_uTexture = glGetUniformLocation(program.handle, "uTexture");
+                glUseProgram(program.handle);
+                glUniform1i(glGetUniformLocation(program.handle, "uForwardPlus"), forwardPlus ? 1 : 0);
+                boundProgramHandle = program.handle;
+            }
+
+            const std::vector<u32> texturesUniformLocations = { MAT_T_DIFFUSE, MAT_T_NORMALS, MAT_T_MASKS };
             const std::vector<u32> texturesUniformHandles = { app->textures[subMeshMaterial.albedoTextureIdx].handle, app->textures[subMeshMaterial.normalsTextureIdx].handle,
-                app->textures[subMeshMaterial.specularTextureIdx].handle};
+                app->textures[subMeshMaterial.masksTextureIdx].handle};
             
             mesh.DrawSubMesh(i, texturesUniformHandles, texturesUniformLocations, program, false);
         }
         glPopDebugGroup();
     }
+    glDepthFunc(GL_LESS);
+    glDepthMask(GL_TRUE);
+    GpuTimerSupport::End(app->lightingTimer);
     glPopDebugGroup();
     
     FrameBufferManagement::UnBindFrameBuffer(app->frameBufferObject);
@@ -781,32 +1188,120 @@ void ForwardRenderLightBoxes(App* app)
 }
 
 void DeferredRender(App* app) {
+    GpuTimerSupport::Begin(app->depthPrepass.geometryTimer);
     DeferredRenderGeometryPass(app);
+    GpuTimerSupport::End(app->depthPrepass.geometryTimer);
     DeferredRenderSSAOPass(app);
+    GpuTimerSupport::Begin(app->lightingTimer);
+    ClusteredLightingSupport::CullLights(app);
+    if (app->tileClassification.enabled)
+        TileClassificationSupport::Classify(app);
     DeferredRenderShadingPass(app);
+    if (app->lightingMode == LightingMode::LIGHT_VOLUMES)
+        LightVolumesSupport::RenderLightVolumes(app);
+    GpuTimerSupport::End(app->lightingTimer);
+    TemporalSupport::ResolveTAA(app);
     DeferredRenderDisplayPass(app);
 }
 
+// Position only draws of the geometry pass entities, with the same culling. Entities added to the material batches are flagged,
+// the geometry pass flushes those batches instead of collecting them again
+static void DeferredRenderDepthPrepass(App* app, const bool useMaterialBatching, std::vector<u8>& batchedEntities)
+{
+    glPushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, 1, -1, "Engine Deferred Render Depth Prepass");
+
+    const Program& program = app->programs[app->depthPrepass.programIdx];
+    glUseProgram(program.handle);
+    glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+
+    const std::vector<u32> noTextures;
+    MeshletCullStats prepassCullStats; // The geometry pass counts the same meshlets again
+    std::vector<i32> meshletDrawCounts;
+    std::vector<const void*> meshletDrawOffsets;
+
+    const u32 entityCount = static_cast<u32>(app->entities.size());
+    batchedEntities.assign(entityCount, 0);
+    for (u32 e = 0; e < entityCount; ++e)
+    {
+        const Entity& entity = *app->entities[e];
+        if (std::dynamic_pointer_cast<Light>(app->entities[e]) || ImpostorSupport::UseImpostor(app, entity))
+            continue;
+
+        BufferManagement::BindBufferRange(app->uniformBuffer, STD_140_BINDING_POINT::BP_LOCAL_PARAMS, entity.localParamsSize, entity.localParamsOffset);
+        Model& model = app->models[entity.modelIndex];
+        Mesh& mesh = app->meshes[model.meshIdx];
+
+        glm::vec4 frustumPlanes[6];
+        MeshletSupport::ExtractFrustumPlanes(entity.worldViewProjectionMat, frustumPlanes);
+        const glm::vec3 cameraPositionLocal = glm::vec3(glm::inverse(entity.worldMatrix) * glm::vec4(app->camera.position, 1.0f));
+
+        if (useMaterialBatching && MaterialBatchingSupport::AddEntityDraws(app, entity, frustumPlanes, cameraPositionLocal))
+        {
+            batchedEntities[e] = 1;
+            continue;
+        }
+
+        const u32 subMeshCount = static_cast<u32>(mesh.subMeshes.size());
+        for (u32 i = 0; i < subMeshCount; i++)
+        {
+            if (app->useMeshletCulling && !mesh.subMeshes[i].meshlets.empty())
+            {
+                meshletDrawCounts.clear();
+                meshletDrawOffsets.clear();
+                MeshletSupport::CullMeshlets(mesh.subMeshes[i], frustumPlanes, cameraPositionLocal, app->useBackFaceCulling, meshletDrawCounts, meshletDrawOffsets, prepassCullStats);
+                mesh.DrawSubMeshRanges(i, meshletDrawCounts, meshletDrawOffsets, noTextures, noTextures, program, false);
+            }
+            else
+            {
+                mesh.DrawSubMesh(i, noTextures, noTextures, program, false);
+            }
+        }
+    }
+    MaterialBatchingSupport::DrawDepthOnly(app, program);
+
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+    glPopDebugGroup();
+}
+
 void DeferredRenderGeometryPass(App* app)
 {
     glPushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, 1, -1, "Engine Deferred Render Geometry Pass");
 
-    // Render on this framebuffer render targets
-    FrameBufferManagement::BindFrameBuffer(app->frameBufferObject);
+    // The feedback image is cleared before the G-buffer is bound
+    const bool useVirtualTexturing = VirtualTexturingSupport::IsActive(app);
+    if (useVirtualTexturing)
+        VirtualTexturingSupport::BeginGeometryPass(app);
 
-    // Select on which render targets to draw
-    const std::vector<u32> attachments = { RT_LOCATION_COLOR, RT_LOCATION_POSITION_WORLD_SPACE, RT_LOCATION_NORMAL, RT_LOCATION_SPECULAR_ROUGHNESS, RT_LOCATION_BUMP, RT_LOCATION_TANGENT };
+    // Render on this framebuffer render targets
+    const bool compactGBuffer = app->gBufferLayout == GBufferLayout::COMPACT;
+    const Buffer& gBufferObject = compactGBuffer ? app->compactFrameBufferObject : app->frameBufferObject;
+    FrameBufferManagement::BindFrameBuffer(gBufferObject);
+
+    // Select on which render targets to draw. The shaders write both layouts, the compact targets are outputs 6 and 7.
+    // Output 3 is the motion vectors, the full layout takes its specular from the masks output (7, specular in r)
+    const std::vector<u32> attachments = compactGBuffer ?
+        std::vector<u32>{ RT_LOCATION_COLOR, RT_LOCATION_NONE, RT_LOCATION_NONE, RT_LOCATION_MOTION_VECTORS, RT_LOCATION_NONE, RT_LOCATION_NONE, RT_LOCATION_NORMAL_TANGENT_OCTAHEDRAL, RT_LOCATION_MASKS } :
+        std::vector<u32>{ RT_LOCATION_COLOR, RT_LOCATION_POSITION_WORLD_SPACE, RT_LOCATION_NORMAL, RT_LOCATION_MOTION_VECTORS, RT_LOCATION_BUMP, RT_LOCATION_TANGENT, RT_LOCATION_NONE, RT_LOCATION_SPECULAR_ROUGHNESS };
     FrameBufferManagement::SetDrawBuffersTextures(attachments);
 
     glEnable(GL_DEPTH_TEST);
 
     glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT); // The light volumes expect a zero stencil
+    const GLfloat noMotion[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+    glClearBufferfv(GL_COLOR, 3, noMotion); // Draw buffer of the motion vectors, the background does not move
 
     glViewport(0, 0, app->displaySizeCurrent.x, app->displaySizeCurrent.y);
 
     glEnable(GL_BLEND);
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glDisablei(GL_BLEND, 3); // Motion vectors
+    if (compactGBuffer)
+    {
+        // The alpha channels carry encoded data, blending them would mix the tangent with the background
+        glDisablei(GL_BLEND, 6);
+        glDisablei(GL_BLEND, 7);
+    }
 
     // - clear the framebuffer
     // - set the viewport
@@ -819,10 +1314,32 @@ void DeferredRenderGeometryPass(App* app)
 
     BufferManagement::BindBufferRange(app->uniformBuffer, STD_140_BINDING_POINT::BP_GLOBAL_PARAMS, app->globalParamsSize, app->globalParamsOffset);
 
-    // Bind the deferred program
-    const Program& program = app->programs[app->deferredGeometryProgramIdx];
-    app->defaultShaderProgram_uTexture = glGetUniformLocation(program.handle, "uTexture");
-    glUseProgram(program.handle);
+    app->meshletCullStats = {};
+    std::vector<i32> meshletDrawCounts;
+    std::vector<const void*> meshletDrawOffsets;
+    // The batched programs sample regular textures only
+    const bool useMaterialBatching = !useVirtualTexturing && app->useMaterialBatching && MaterialBatchingSupport::IsReady(app);
+
+    // Most assets are modeled double-sided (Sponza), back faces are only dropped on request
+    if (app->useBackFaceCulling)
+        glEnable(GL_CULL_FACE);
+
+    // Only the fragments at the prepass depth are shaded
+    const bool useDepthPrepass = app->depthPrepass.enabled;
+    std::vector<u8> prepassBatchedEntities;
+    if (useDepthPrepass)
+    {
+        DeferredRenderDepthPrepass(app, useMaterialBatching, prepassBatchedEntities);
+        glDepthFunc(GL_EQUAL);
+        glDepthMask(GL_FALSE);
+    }
+    const bool countOverdraw = app->gBufferMode == GBufferMode::OVERDRAW;
+    if (countOverdraw)
+        DepthPrepassSupport::BeginOverdrawCount();
+
+    // The deferred program, bound per subMesh in the variant of its material (the virtual texturing program has no permutations)
+    const u32 baseProgramIdx = useVirtualTexturing ? app->virtualTexturing.programIdx : app->deferredGeometryProgramIdx;
+    GLuint boundProgramHandle = 0;
 
     const u32 entityCount = static_cast<u32>(app->entities.size());
     for (u32 e = 0; e < entityCount; ++e)
@@ -833,7 +1350,13 @@ void DeferredRenderGeometryPass(App* app)
         if (std::shared_ptr<Light> light = std::dynamic_pointer_cast<Light>(app->entities[e]))
         {
             continue;
-        }        
+        }
+        // Far entities are drawn afterwards as impostors
+        if (ImpostorSupport::UseImpostor(app, entity))
+        {
+            continue;
+        }
+        GpuMemorySupport::MarkEntityVisible(app, entity);
         BufferManagement::BindBufferRange(app->uniformBuffer, STD_140_BINDING_POINT::BP_LOCAL_PARAMS, entity.localParamsSize, entity.localParamsOffset);
 
         Model& model = app->models[entity.modelIndex];
@@ -841,25 +1364,80 @@ void DeferredRenderGeometryPass(App* app)
 
         glPushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, 1, -1, model.name.c_str());
 
+        // Meshlet bounds are in local space, so the frustum and the camera are brought to the entity space
+        glm::vec4 frustumPlanes[6];
+        MeshletSupport::ExtractFrustumPlanes(entity.worldViewProjectionMat, frustumPlanes);
+        const glm::vec3 cameraPositionLocal = glm::vec3(glm::inverse(entity.worldMatrix) * glm::vec4(app->camera.position, 1.0f));
+
+        // Drawn after the loop with a single multi draw, meshes without a shared vertex layout go through the per subMesh path
+        const bool batched = useDepthPrepass ? prepassBatchedEntities[e] != 0 :
+            useMaterialBatching && MaterialBatchingSupport::AddEntityDraws(app, entity, frustumPlanes, cameraPositionLocal);
+        if (batched)
+        {
+            glPopDebugGroup();
+            continue;
+        }
+
         const u32 subMeshCount = static_cast<u32>(mesh.subMeshes.size());
         for (u32 i = 0; i < subMeshCount; i++)
         {
             const u32 subMeshMaterialIdx = model.materialIdx[i];
             const Material subMeshMaterial = app->materials[subMeshMaterialIdx];
 
-            const std::vector<u32> texturesUniformLocations = { MAT_T_DIFFUSE, MAT_T_NORMALS, MAT_T_SPECULAR, MAT_T_BUMP };
-            const std::vector<u32> texturesUniformHandles = { app->textures[subMeshMaterial.albedoTextureIdx].handle, app->textures[subMeshMaterial.normalsTextureIdx].handle,
-                app->textures[subMeshMaterial.specularTextureIdx].handle, app->textures[subMeshMaterial.bumpTextureIdx].handle };
+            const Program& program = app->programs[ShaderPermutationSupport::GetVariantIdx(app, baseProgramIdx, subMeshMaterial)];
+            if (program.handle != boundProgramHandle)
+            {
+                app->defaultShaderProgram_uTexture = glGetUniformLocation(program.handle, "uTexture");
+                glUseProgram(program.handle);
+                glUniform2f(glGetUniformLocation(program.handle, "uParallaxFade"), app->coneStepMapping.fadeStart, app->coneStepMapping.fadeEnd);
+                boundProgramHandle = program.handle;
+            }
+
+            // Bump and specular come packed in a single texture, the parallax reads the cone step map of the bump
+            std::vector<u32> texturesUniformLocations = { MAT_T_DIFFUSE, MAT_T_NORMALS, MAT_T_MASKS, MAT_T_CONE_STEP };
+            std::vector<u32> texturesUniformHandles = { app->textures[subMeshMaterial.albedoTextureIdx].handle, app->textures[subMeshMaterial.normalsTextureIdx].handle,
+                app->textures[subMeshMaterial.masksTextureIdx].handle, app->textures[subMeshMaterial.coneStepTextureIdx].handle };
+            if (useVirtualTexturing)
+                VirtualTexturingSupport::SetMaterial(app, subMeshMaterialIdx, texturesUniformHandles, texturesUniformLocations);
 
             BufferManagement::BindBufferRange(app->uniformBuffer, STD_140_BINDING_POINT::BP_MATERIAL_PARAMS, subMeshMaterial.paramsSize, subMeshMaterial.paramsOffset);
-            mesh.DrawSubMesh(i, texturesUniformHandles, texturesUniformLocations, program, false);
+
+            if (app->useMeshletCulling && !mesh.subMeshes[i].meshlets.empty())
+            {
+                meshletDrawCounts.clear();
+                meshletDrawOffsets.clear();
+                MeshletSupport::CullMeshlets(mesh.subMeshes[i], frustumPlanes, cameraPositionLocal, app->useBackFaceCulling, meshletDrawCounts, meshletDrawOffsets, app->meshletCullStats);
+                mesh.DrawSubMeshRanges(i, meshletDrawCounts, meshletDrawOffsets, texturesUniformHandles, texturesUniformLocations, program, false);
+            }
+            else
+            {
+                mesh.DrawSubMesh(i, texturesUniformHandles, texturesUniformLocations, program, false);
+            }
         }
 
         glPopDebugGroup();
     }
+
+    MaterialBatchingSupport::FlushDraws(app);
+
+    glDisable(GL_CULL_FACE);
+
+    // The impostors are not in the prepass
+    if (useDepthPrepass)
+    {
+        glDepthFunc(GL_LESS);
+        glDepthMask(GL_TRUE);
+    }
+    ImpostorSupport::RenderImpostors(app);
+    if (countOverdraw)
+        DepthPrepassSupport::EndOverdrawCount(app);
     glPopDebugGroup();
 
-    FrameBufferManagement::UnBindFrameBuffer(app->frameBufferObject);
+    FrameBufferManagement::UnBindFrameBuffer(gBufferObject);
+
+    // Queues the readback of the pages seen this frame
+    if (useVirtualTexturing)
+        VirtualTexturingSupport::EndGeometryPass(app);
 }
 
 void DeferredRenderShadingPass(App* app)
@@ -897,14 +1475,54 @@ void DeferredRenderShadingPass(App* app)
     // Bind the deferred program
     const Program& program = app->programs[app->deferredShadingProgramIdx];
     glUseProgram(program.handle);
+    const bool compactGBuffer = app->gBufferLayout == GBufferLayout::COMPACT;
+    glUniform1i(glGetUniformLocation(program.handle, "uCompactGBuffer"), compactGBuffer ? 1 : 0);
+    glUniform1i(glGetUniformLocation(program.handle, "uClusteredLighting"), app->lightingMode == LightingMode::CLUSTERED ? 1 : 0);
+    glUniform1i(glGetUniformLocation(program.handle, "uDirectionalOnly"), app->lightingMode == LightingMode::LIGHT_VOLUMES ? 1 : 0);
+
+    // The depth target is sampled by the compact layout and the tile classified variants, the quad must not be depth tested against it
+    const bool classifiedTiles = app->tileClassification.enabled;
+    if (compactGBuffer || classifiedTiles)
+        glDisable(GL_DEPTH_TEST);
+
+    std::vector<u32> texturesUniformLocations = compactGBuffer ?
+        std::vector<u32>{ RT_LOCATION_COLOR, RT_LOCATION_SSAO, CG_BINDING_NORMAL_TANGENT, CG_BINDING_MASKS, CG_BINDING_DEPTH } :
+        std::vector<u32>{ RT_LOCATION_COLOR, RT_LOCATION_POSITION_WORLD_SPACE, RT_LOCATION_NORMAL, RT_LOCATION_SPECULAR_ROUGHNESS, RT_LOCATION_SSAO, RT_LOCATION_BUMP, RT_LOCATION_TANGENT };
+    std::vector<u32> texturesUniformHandles = compactGBuffer ?
+        std::vector<u32>{ app->textures[app->gColorTextureIdx].handle, app->textures[app->gSSAOTextureIdx].handle, app->textures[app->gNormalTangentTextureIdx].handle,
+            app->textures[app->gMasksTextureIdx].handle, app->textures[app->gDepthTextureIdx].handle } :
+        std::vector<u32>{ app->textures[app->gColorTextureIdx].handle, app->textures[app->gPositionTextureIdx].handle,
+            app->textures[app->gNormalTextureIdx].handle, app->textures[app->gSpecularTextureIdx].handle, app->textures[app->gSSAOTextureIdx].handle,
+            app->textures[app->gBumpTextureIdx].handle, app->textures[app->gTangentTextureIdx].handle };
 
-    const std::vector<u32> texturesUniformLocations = { RT_LOCATION_COLOR, RT_LOCATION_POSITION_WORLD_SPACE, RT_LOCATION_NORMAL, RT_LOCATION_SPECULAR_ROUGHNESS, RT_LOCATION_SSAO, RT_LOCATION_BUMP, RT_LOCATION_TANGENT };
-    const std::vector<u32> texturesUniformHandles = { app->textures[app->gColorTextureIdx].handle, app->textures[app->gPositionTextureIdx].handle,
-         app->textures[app->gNormalTextureIdx].handle, app->textures[app->gSpecularTextureIdx].handle, app->textures[app->gSSAOTextureIdx].handle,
-        app->textures[app->gBumpTextureIdx].handle, app->textures[app->gTangentTextureIdx].handle };
-
-    
     Model& model = app->models[app->quadModel];
+    if (classifiedTiles)
+    {
+        // The variants discard the pixels without geometry, they read the depth in both layouts
+        if (!compactGBuffer)
+        {
+            texturesUniformLocations.push_back(CG_BINDING_DEPTH);
+            texturesUniformHandles.push_back(app->textures[app->gDepthTextureIdx].handle);
+        }
+        for (u32 i = 0; i < texturesUniformLocations.size(); ++i)
+        {
+            glActiveTexture(GL_TEXTURE0 + texturesUniformLocations[i]);
+            glBindTexture(GL_TEXTURE_2D, texturesUniformHandles[i]);
+        }
+
+        // The parallax reads the height scale of the quad material
+        const Material& quadMaterial = app->materials[model.materialIdx[0]];
+        BufferManagement::BindBufferRange(app->uniformBuffer, STD_140_BINDING_POINT::BP_MATERIAL_PARAMS, quadMaterial.paramsSize, quadMaterial.paramsOffset);
+        TileClassificationSupport::Shade(app);
+
+        FrameBufferManagement::UnBindFrameBuffer(app->frameBufferObject);
+        glEnable(GL_DEPTH_TEST);
+        glDepthMask(GL_TRUE);
+        glPopDebugGroup();
+        return;
+    }
+
+
     Mesh& mesh = app->meshes[model.meshIdx];
     glPushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, 1, -1, model.name.c_str());
     const u32 subMeshCount = static_cast<u32>(mesh.subMeshes.size());
@@ -916,6 +1534,7 @@ void DeferredRenderShadingPass(App* app)
         mesh.DrawSubMesh(i, texturesUniformHandles, texturesUniformLocations, program, false);
     }
     FrameBufferManagement::UnBindFrameBuffer(app->frameBufferObject);
+    glEnable(GL_DEPTH_TEST);
     glDepthMask(GL_TRUE);
     glPopDebugGroup();
     glPopDebugGroup();
@@ -942,35 +1561,39 @@ void DeferredRenderDisplayPass(App* app)
     {
         // Draw the framebuffer onto a quad that covers the whole screen.
         u32 gBufferModeIdx = 0;
+        const bool compactGBuffer = app->gBufferLayout == GBufferLayout::COMPACT;
         switch (app->gBufferMode)
         {
         case GBufferMode::COLOR:
             gBufferModeIdx = app->gColorTextureIdx;
             break;
         case GBufferMode::NORMAL:
-            gBufferModeIdx = app->gNormalTextureIdx;
+            gBufferModeIdx = compactGBuffer ? app->gNormalTangentTextureIdx : app->gNormalTextureIdx;
             break;
         case GBufferMode::TANGENT:
-            gBufferModeIdx = app->gTangentTextureIdx;
+            gBufferModeIdx = compactGBuffer ? app->gNormalTangentTextureIdx : app->gTangentTextureIdx;
             break;
         case GBufferMode::BUMP:
-            gBufferModeIdx = app->gBumpTextureIdx;
+            gBufferModeIdx = compactGBuffer ? app->gMasksTextureIdx : app->gBumpTextureIdx;
             break;
         case GBufferMode::POSITION:
-            gBufferModeIdx = app->gPositionTextureIdx;
+            gBufferModeIdx = compactGBuffer ? app->gDepthTextureIdx : app->gPositionTextureIdx; // Rebuilt from depth in the compact layout
             break;
         case GBufferMode::SPECULAR:
-            gBufferModeIdx = app->gSpecularTextureIdx;
+            gBufferModeIdx = compactGBuffer ? app->gMasksTextureIdx : app->gSpecularTextureIdx;
             break;
         case GBufferMode::DEPTH:
             gBufferModeIdx = app->gDepthTextureIdx;
             break;
         case GBufferMode::FINAL:
-            gBufferModeIdx = app->gFinalResultTextureIdx; // Same as app->colorTextureIdx
+            gBufferModeIdx = TemporalSupport::GetFinalTextureIdx(app); // The TAA history when it was resolved this frame
             break;
         case GBufferMode::SSAO:
             gBufferModeIdx = app->gSSAOTextureIdx; // Same as app->colorTextureIdx
             break;
+        case GBufferMode::OVERDRAW:
+            gBufferModeIdx = app->depthPrepass.overdrawTextureIdx;
+            break;
         default:
             break;
         }
@@ -987,6 +1610,16 @@ void DeferredRenderDisplayPass(App* app)
 void DeferredRenderSSAOPass(App* app)
 {
     glPushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, 1, -1, "Engine Deferred Render SSAO Pass");
+    GpuTimerSupport::Begin(app->ssaoData.timer);
+
+    // Reduced resolution tiers, downsampled, blurred and upsampled back into gSSAOTextureIdx
+    if (app->ssaoData.tier != SSAOTier::FULL)
+    {
+        SSAOSupport::RenderLowResolution(app);
+        GpuTimerSupport::End(app->ssaoData.timer);
+        glPopDebugGroup();
+        return;
+    }
 
     // SSAO FBO Bindings
     FrameBufferManagement::BindFrameBuffer(app->ssaoFrameBufferObject);
@@ -1000,9 +1633,13 @@ void DeferredRenderSSAOPass(App* app)
     glViewport(0, 0, app->displaySizeCurrent.x, app->displaySizeCurrent.y);
 
     // RTT necessary to read in order to do SSAO
-    const std::vector<u32> texturesUniformLocations = { RT_LOCATION_POSITION_WORLD_SPACE, RT_LOCATION_NORMAL, 3 /*Noise texture*/};
-    const std::vector<u32> texturesUniformHandles = { app->textures[app->gPositionTextureIdx].handle, app->textures[app->gNormalTextureIdx].handle,
-        app->textures[app->ssaoNoiseTextureIdx].handle};
+    const bool compactGBuffer = app->gBufferLayout == GBufferLayout::COMPACT;
+    const std::vector<u32> texturesUniformLocations = compactGBuffer ?
+        std::vector<u32>{ CG_BINDING_DEPTH, CG_BINDING_NORMAL_TANGENT, 3 /*Noise texture*/} :
+        std::vector<u32>{ RT_LOCATION_POSITION_WORLD_SPACE, RT_LOCATION_NORMAL, 3 /*Noise texture*/};
+    const std::vector<u32> texturesUniformHandles = compactGBuffer ?
+        std::vector<u32>{ app->textures[app->gDepthTextureIdx].handle, app->textures[app->gNormalTangentTextureIdx].handle, app->textures[app->ssaoNoiseTextureIdx].handle} :
+        std::vector<u32>{ app->textures[app->gPositionTextureIdx].handle, app->textures[app->gNormalTextureIdx].handle, app->textures[app->ssaoNoiseTextureIdx].handle};
 
     // Bind the global params so shader can read kernel sample data
     BufferManagement::BindBufferRange(app->uniformBuffer, STD_140_BINDING_POINT::BP_GLOBAL_PARAMS, app->globalParamsSize, app->globalParamsOffset);
@@ -1011,6 +1648,7 @@ void DeferredRenderSSAOPass(App* app)
     // Draw the framebuffer onto a quad that covers the whole screen.
     const Program& screenProgram = app->programs[app->deferredSSAOProgramIdx];
     glUseProgram(screenProgram.handle);
+    glUniform1i(glGetUniformLocation(screenProgram.handle, "uCompactGBuffer"), compactGBuffer ? 1 : 0);
     Model& model = app->models[app->quadModel];
     Mesh& mesh = app->meshes[model.meshIdx];
 
@@ -1027,6 +1665,7 @@ void DeferredRenderSSAOPass(App* app)
     // Unbind the SSAO FBO
     FrameBufferManagement::UnBindFrameBuffer(app->ssaoFrameBufferObject);
     
+    GpuTimerSupport::End(app->ssaoData.timer);
     glPopDebugGroup();
 }
 
@@ -1043,10 +1682,15 @@ void CheckShadersHotReload(App* app)
                 std::cout << "Program hot reload: " << program.programName << ", TimeStamp: " << currentTimeStamp <<"\n\n";
                 glDeleteProgram(program.handle);
                 const char* programName = program.programName.c_str();
-                if (program.filePaths.size() > 1)
+                if (program.isCompute)
+                {
+                    const std::string programSource = ReadTextFile(program.filePaths[j].c_str());
+                    program.handle = ShaderSupport::CreateComputeProgramFromSource(programSource, programName);
+                }
+                else if (program.filePaths.size() > 1)
                 {
-                    const std::string programSourceVert = ReadTextFile(program.filePaths[0].c_str());
-                    const std::string programSourceFrag = ReadTextFile(program.filePaths[1].c_str());
+                    const std::string programSourceVert = ShaderSupport::InsertDefines(ReadTextFile(program.filePaths[0].c_str()), program.defines);
+                    const std::string programSourceFrag = ShaderSupport::InsertDefines(ReadTextFile(program.filePaths[1].c_str()), program.defines);
                     program.handle = ShaderSupport::CreateProgramFromSource(programSourceVert.c_str(), programSourceFrag.c_str(), programName);
                 }
                 else
@@ -1082,6 +1726,16 @@ void CreateEntity(App* app, const glm::vec3& position, const glm::vec3& orientat
     app->entities.emplace_back(entity);
 }
 
+void DestroyEntity(App* app, const Entity* entity)
+{
+    const auto it = std::find_if(app->entities.begin(), app->entities.end(), [entity](const std::shared_ptr<Entity>& e) { return e.get() == entity; });
+    if (it == app->entities.end())
+        return;
+
+    app->entities.erase(it);
+    selectedEntity = glm::clamp(selectedEntity, 0, static_cast<i32>(app->entities.size()) - 1);
+}
+
 void CreateLight(App* app, LightType lightType, const Attenuation& attenuation, const glm::vec3& position, const glm::vec3& orientation, const glm::vec3& scale, const u32 modelIndex, const u32 programIdx, const glm::vec4& lightColor, const char* name)
 {
     std::shared_ptr<Light> light = std::make_shared<Light>();
@@ -1124,6 +1778,12 @@ void PushTransformUBO(App* app)
         entity.worldViewProjectionMat = app->projectionMat * ModelViewMat;
         entity.normalMatrix = glm::mat3(glm::transpose(glm::inverse(ModelViewMat)));
 
+        // Last frame's transform with this frame's jitter, the motion vectors only keep the movement. New entities do not move
+        const glm::mat4 unjitteredWorldViewProjectionMat = app->temporal.unjitteredProjectionMat * ModelViewMat;
+        entity.prevWorldViewProjectionMat = app->temporal.jitterMat * (entity.hasLastTransform ? entity.lastWorldViewProjectionMat : unjitteredWorldViewProjectionMat);
+        entity.lastWorldViewProjectionMat = unjitteredWorldViewProjectionMat;
+        entity.hasLastTransform = true;
+
         // Set buffer block start and set offset
         BufferManagement::SetBufferBlockStart(uniformBuffer, BufferManagement::uniformBlockAlignment, entity.localParamsOffset);
 
@@ -1131,6 +1791,7 @@ void PushTransformUBO(App* app)
         PUSH_MAT4(uniformBuffer, entity.worldMatrix);
         PUSH_MAT4(uniformBuffer, entity.worldViewProjectionMat);
         PUSH_MAT4(uniformBuffer, entity.normalMatrix);
+        PUSH_MAT4(uniformBuffer, entity.prevWorldViewProjectionMat);
 
         // Set buffer block end and set size
         BufferManagement::SetBufferBlockEnd(uniformBuffer, BufferManagement::uniformBlockAlignment, entity.localParamsSize, entity.localParamsOffset);
@@ -1149,7 +1810,12 @@ void PushGlobalDataUBO(App* app)
     // Set buffer block start and set offset
     BufferManagement::SetBufferBlockStart(uniformBuffer, BufferManagement::uniformBlockAlignment, app->globalParamsOffset);
     
-    const u32 lightsCount = (u32)app->lights.size();
+    // Every light, the clustered shading and the light volumes read the radius of the ones past the uLight array too
+    for (const std::shared_ptr<Light>& light : app->lights)
+        light->attenuation.CalculateRadius(light->color);
+
+    // Only the first ones fit in GlobalParams::uLight, the clustered shading reads every light from its own buffer
+    const u32 lightsCount = glm::min((u32)app->lights.size(), (u32)FORWARD_MAX_LIGHTS);
     PUSH_VEC3(uniformBuffer, app->camera.position);
     PUSH_MAT4(uniformBuffer, app->camera.GetViewMatrix());
     PUSH_MAT4(uniformBuffer, app->projectionMat);
@@ -1159,8 +1825,7 @@ void PushGlobalDataUBO(App* app)
         // Correct if necessary the alignment of array 
         BufferManagement::AlignHead(uniformBuffer, 4 * BASIC_MACHINE_UNIT);
 
-        Light& light = *app->lights[i];
-        light.attenuation.CalculateRadius(light.color);
+        const Light& light = *app->lights[i];
         
         PUSH_U_INT(uniformBuffer, (u32)light.type)
         PUSH_VEC3(uniformBuffer, light.color);
@@ -1195,7 +1860,7 @@ void PushMaterialDataUBO(App* app)
         PUSH_U_INT(uniformBuffer, (material.specularTextureIdx != 0) ? true : false); 
         PUSH_U_INT(uniformBuffer, (material.normalsTextureIdx != 0) ? true : false); 
         PUSH_U_INT(uniformBuffer, (material.bumpTextureIdx != 0) ? true : false); 
-        PUSH_FLOAT(uniformBuffer, material.heightScale);
+        PUSH_FLOAT(uniformBuffer, (material.coneStepTextureIdx != 0) ? material.heightScale : 0.0f); // No parallax without a cone step map
         // Set buffer block end and set size
         BufferManagement::SetBufferBlockEnd(uniformBuffer, BufferManagement::uniformBlockAlignment, material.paramsSize, material.paramsOffset);
     }
@@ -1220,6 +1885,7 @@ void PushSSAODataUBO(App* app)
     PUSH_FLOAT(uniformBuffer, app->ssaoData.radius);
     PUSH_FLOAT(uniformBuffer, app->ssaoData.bias);
     PUSH_VEC2(uniformBuffer, app->ssaoData.noiseScale);
+    PUSH_FLOAT(uniformBuffer, app->ssaoData.falloff);
 
     // Set buffer block end and set size
     BufferManagement::SetBufferBlockEnd(uniformBuffer, BufferManagement::uniformBlockAlignment, app->ssaoData.paramsSize, app->ssaoData.paramsOffset);
@@ -1237,8 +1903,8 @@ void OnScreenResize(App* app)
     for (u32 i = 0; i < app->textures.size(); ++i)
     {
         Texture& tex = app->textures[i];
-        if (tex.type != TextureType::NON_FBO)
-            TextureSupport::ResizeTexture(app, tex, app->displaySizeCurrent.x, app->displaySizeCurrent.y);
+        if (tex.type != TextureType::NON_FBO && tex.screenScale > 0.0f)
+            TextureSupport::ResizeTexture(app, tex, (u32)glm::max(1.0f, app->displaySizeCurrent.x * tex.screenScale), (u32)glm::max(1.0f, app->displaySizeCurrent.y * tex.screenScale));
     }
     //FrameBufferManagement::SetColorAttachment(app->frameBufferObject, app->textures[app->colorTextureIdx].handle, 0);
     //// FrameBufferManagement::SetDepthAttachment(app->frameBufferObject, app->textures[app->depthTextureIdx].handle);
@@ -1325,7 +1991,7 @@ void EditTransform(App* app, const float* cameraView, float* cameraProjection, f
     // Imguizmo for transform
     ImGuizmo::SetRect((float)app->displayPos.x, (float)app->displayPos.y, (float)app->displaySizeCurrent.x, (float)app->displaySizeCurrent.y);
     //ImGuizmo::DrawGrid(cameraView, glm::value_ptr(app->projectionMat), glm::value_ptr(glm::mat4(1.0f)), 100.f);
-    ImGuizmo::Manipulate(cameraView, glm::value_ptr(app->projectionMat), app->imGuizmoData.mCurrentGizmoOperation, app->imGuizmoData.mCurrentGizmoMode, glm::value_ptr(app->entities[selectedEntity]->worldMatrix), nullptr, app->imGuizmoData.useSnap ? &app->imGuizmoData.snap[0] : nullptr, app->imGuizmoData.boundSizing ? app->imGuizmoData.bounds : nullptr, app->imGuizmoData.boundSizingSnap ? app->imGuizmoData.boundsSnap : nullptr);
+    ImGuizmo::Manipulate(cameraView, glm::value_ptr(app->temporal.unjitteredProjectionMat), app->imGuizmoData.mCurrentGizmoOperation, app->imGuizmoData.mCurrentGizmoMode, glm::value_ptr(app->entities[selectedEntity]->worldMatrix), nullptr, app->imGuizmoData.useSnap ? &app->imGuizmoData.snap[0] : nullptr, app->imGuizmoData.boundSizing ? app->imGuizmoData.bounds : nullptr, app->imGuizmoData.boundSizingSnap ? app->imGuizmoData.boundsSnap : nullptr);
 
     constexpr bool alphaPreview = true;
     constexpr bool alphaHalfPreview = false;
@@ -1359,8 +2025,9 @@ void VAOSupport::CreateNewVAO(const Mesh& mesh, const SubMesh& subMesh, const Pr
                 const u32 index = subMesh.vertexBufferLayout.attributes[j].location;
                 const u32 nComp = subMesh.vertexBufferLayout.attributes[j].componentCount;
                 // Since it shares the same buffers in the mesh it will use its corresponding array rang with vertex offset here, and indices offset when glDrawElements
-                const u32 offset = subMesh.vertexBufferLayout.attributes[j].offset + subMesh.vertexOffset; // attribute offset + vertex offset
-                const u32 stride = subMesh.vertexBufferLayout.stride;
+                const VertexBufferAttribute& attribute = subMesh.vertexBufferLayout.attributes[j];
+                const u32 offset = attribute.arrayOffset + attribute.offset + subMesh.vertexOffset; // (array offset) + attribute offset + vertex offset
+                const u32 stride = attribute.arrayStride != 0 ? attribute.arrayStride : subMesh.vertexBufferLayout.stride;
                 glVertexAttribPointer(index, (GLsizei)nComp, GL_FLOAT, GL_FALSE, (GLsizei)stride, (void*)(u64)offset);
                 glEnableVertexAttribArray(index);
 
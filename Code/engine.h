@@ -14,6 +14,8 @@ void Update(App* app);
 
 void Render(App* app);
 
+void Shutdown(App* app);
+
 void ForwardRender(App* app);
 
 void ForwardRenderLightBoxes(App* app);
@@ -33,6 +35,9 @@ void CheckShadersHotReload(App* app);
 void CreateEntity(App* app, const glm::vec3& position, const glm::vec3& orientation, const glm::vec3& scale,
     const u32 modelIndex, const u32 programIdx = 0, const glm::vec4& diffuseColor = glm::vec4(1.0f), const char* name = "None");
 
+// Removes the entity from the scene, the other entities keep their order
+void DestroyEntity(App* app, const Entity* entity);
+
 void CreateLight(App* app, LightType lightType, const Attenuation& attenuation, const glm::vec3& position, const glm::vec3& orientation, const glm::vec3& scale,
     const u32 modelIndex, const u32 programIdx = 0, const glm::vec4& lightColor = glm::vec4(1.0f), const char* name = "None");
 
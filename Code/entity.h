@@ -20,6 +20,11 @@ struct Entity
     glm::mat4 worldMatrix;
     glm::mat4 worldViewProjectionMat;
     glm::mat3 normalMatrix;
+
+    // Motion vectors, see TemporalReprojection
+    glm::mat4 prevWorldViewProjectionMat; // Last frame's, with this frame's jitter
+    glm::mat4 lastWorldViewProjectionMat; // This frame's without jitter, the previous one of the next frame
+    bool hasLastTransform = false;
     
     glm::vec3 position;
     glm::vec3 orientationEuler;
@@ -0,0 +1,82 @@
+﻿#include "forward_plus.h"
+
+#include "app.h"
+
+static void ResizeTileBuffer(ForwardPlus& forwardPlus, const glm::uvec2& tileCount)
+{
+    const u32 tiles = tileCount.x * tileCount.y;
+    forwardPlus.tileCount = tileCount;
+    forwardPlus.bufferBytes = sizeof(TileLightsHeader) + static_cast<u64>(tiles + tiles * FORWARD_PLUS_TILE_MAX_LIGHTS) * sizeof(u32);
+
+    TileLightsHeader header;
+    header.tiles = glm::uvec4(tileCount.x, tileCount.y, FORWARD_PLUS_TILE_MAX_LIGHTS, tiles);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, forwardPlus.tileBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, static_cast<GLsizeiptr>(forwardPlus.bufferBytes), nullptr, GL_DYNAMIC_DRAW);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(TileLightsHeader), &header);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+void ForwardPlusSupport::Init(App* app)
+{
+    ForwardPlus& forwardPlus = app->forwardPlus;
+    forwardPlus.cullingProgramIdx = ShaderSupport::LoadComputeProgram(app, "Shaders\\shader_tile_light_culling.comp", "TILE_LIGHT_CULLING");
+
+    glGenBuffers(1, &forwardPlus.tileBuffer);
+}
+
+void ForwardPlusSupport::Shutdown(App* app)
+{
+    glDeleteBuffers(1, &app->forwardPlus.tileBuffer);
+}
+
+void ForwardPlusSupport::DepthPrepass(App* app)
+{
+    glPushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, 1, -1, "Forward+ Depth Prepass");
+
+    const Program& program = app->programs[app->depthPrepass.programIdx];
+    glUseProgram(program.handle);
+    glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+    glDepthMask(GL_TRUE);
+    glDepthFunc(GL_LESS);
+
+    const std::vector<u32> noTextures;
+    const u32 entityCount = static_cast<u32>(app->entities.size());
+    for (u32 e = 0; e < entityCount; ++e)
+    {
+        const Entity& entity = *app->entities[e];
+        BufferManagement::BindBufferRange(app->uniformBuffer, STD_140_BINDING_POINT::BP_LOCAL_PARAMS, entity.localParamsSize, entity.localParamsOffset);
+
+        Model& model = app->models[entity.modelIndex];
+        Mesh& mesh = app->meshes[model.meshIdx];
+        const u32 subMeshCount = static_cast<u32>(mesh.subMeshes.size());
+        for (u32 i = 0; i < subMeshCount; i++)
+            mesh.DrawSubMesh(i, noTextures, noTextures, program, false);
+    }
+
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+    glPopDebugGroup();
+}
+
+void ForwardPlusSupport::CullLights(App* app)
+{
+    ForwardPlus& forwardPlus = app->forwardPlus;
+    const glm::uvec2 tileCount = (glm::uvec2(app->displaySizeCurrent) + glm::uvec2(FORWARD_PLUS_TILE_SIZE - 1)) / glm::uvec2(FORWARD_PLUS_TILE_SIZE);
+    if (tileCount != forwardPlus.tileCount)
+        ResizeTileBuffer(forwardPlus, tileCount);
+
+    glPushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, 1, -1, "Forward+ Tile Light Culling");
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, STD_430_BINDING_POINT::BP_CLUSTER_LIGHTS, app->clusteredLighting.lightBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, STD_430_BINDING_POINT::BP_TILE_LIGHTS, forwardPlus.tileBuffer);
+    BufferManagement::BindBufferRange(app->uniformBuffer, STD_140_BINDING_POINT::BP_GLOBAL_PARAMS, app->globalParamsSize, app->globalParamsOffset);
+
+    // The prepass depth, read with texelFetch
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, app->textures[app->gDepthTextureIdx].handle);
+
+    glUseProgram(app->programs[forwardPlus.cullingProgramIdx].handle);
+    glDispatchCompute(tileCount.x, tileCount.y, 1);
+
+    // The forward shaders read the tile lists
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    glPopDebugGroup();
+}
@@ -0,0 +1,46 @@
+﻿#ifndef FORWARD_PLUS_H
+#define FORWARD_PLUS_H
+
+#include "platform.h"
+
+struct App;
+
+#define FORWARD_PLUS_TILE_SIZE 16 // Pixels per tile side, local_size_x/y of shader_tile_light_culling.comp
+#define FORWARD_PLUS_TILE_MAX_LIGHTS 256 // Per tile, the lights past it are dropped from the tile
+
+// Header of the tile light buffer, followed by the light count of every tile and FORWARD_PLUS_TILE_MAX_LIGHTS indices per tile (std430)
+struct TileLightsHeader
+{
+    glm::uvec4 tiles; // Tiles on x and y, z: FORWARD_PLUS_TILE_MAX_LIGHTS, w: tile count
+};
+
+/// <summary>
+/// Forward+ (tiled forward) rendering. A depth only prepass (the DepthPrepass program) fills the depth target, a compute pass splits the screen in
+/// FORWARD_PLUS_TILE_SIZE tiles, reduces the depth range of each tile and lists the lights whose sphere touches the tile
+/// frustum, and the forward lit shaders only walk the list of the tile of each pixel. The lights are the ones uploaded
+/// for the clustered lighting, so Forward+ has no FORWARD_MAX_LIGHTS cap and no G-buffer.
+/// </summary>
+struct ForwardPlus
+{
+    u32 cullingProgramIdx = 0;
+
+    GLuint tileBuffer = 0;
+    glm::uvec2 tileCount = glm::uvec2(0);
+
+    // Stats
+    u64 bufferBytes = 0;
+};
+
+struct ForwardPlusSupport
+{
+    static void Init(App* app);
+    static void Shutdown(App* app);
+
+    // Depth only draw of every entity into the bound frame buffer
+    static void DepthPrepass(App* app);
+
+    // Builds the tile light lists from the prepass depth and binds them for the forward shaders
+    static void CullLights(App* app);
+};
+
+#endif // FORWARD_PLUS_H
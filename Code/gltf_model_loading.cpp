@@ -0,0 +1,727 @@
+﻿#include "gltf_model_loading.h"
+
+#include <chrono>
+#include <cstring>
+#include <glm/gtx/matrix_decompose.hpp>
+#include <glm/gtx/quaternion.hpp>
+
+#include "app.h"
+#include "engine.h"
+#include "json_parser.h"
+#include "mesh_processing.h"
+#include "parallel.h"
+#include "stb_image.h"
+
+#define GLB_MAGIC 0x46546C67 // "glTF"
+#define GLB_CHUNK_JSON 0x4E4F534A
+#define GLB_CHUNK_BIN 0x004E4942
+#define GLTF_GPU_ALIGNMENT 16
+
+#define GLTF_BYTE 5120
+#define GLTF_UNSIGNED_BYTE 5121
+#define GLTF_SHORT 5122
+#define GLTF_UNSIGNED_SHORT 5123
+#define GLTF_UNSIGNED_INT 5125
+#define GLTF_FLOAT 5126
+#define GLTF_MODE_TRIANGLES 4
+
+/// <summary>
+/// Everything needed while importing a glTF file: the document, the binary buffers (mapped files, GLB chunk
+/// or decoded base64) and where each directly uploaded bufferView lands in the GPU buffer.
+/// </summary>
+struct GltfContext
+{
+    JsonValue json;
+    std::string directory;
+    std::vector<const u8*> buffers;
+    std::vector<u64> bufferSizes;
+    std::vector<MappedFile> mappedFiles;
+    std::vector<std::vector<u8>> decodedBuffers;
+    std::vector<u64> bufferViewGpuOffsets; // UINT64_MAX when the view is not uploaded as it is
+};
+
+static u32 ComponentSize(const i32 componentType)
+{
+    switch (componentType)
+    {
+    case GLTF_BYTE: case GLTF_UNSIGNED_BYTE: return 1;
+    case GLTF_SHORT: case GLTF_UNSIGNED_SHORT: return 2;
+    case GLTF_UNSIGNED_INT: case GLTF_FLOAT: return 4;
+    default: return 0;
+    }
+}
+
+static u32 ComponentCount(const std::string& type)
+{
+    if (type == "SCALAR") return 1;
+    if (type == "VEC2") return 2;
+    if (type == "VEC3") return 3;
+    if (type == "VEC4") return 4;
+    if (type == "MAT4") return 16;
+    return 0;
+}
+
+static bool DecodeBase64(const std::string& text, const size_t begin, std::vector<u8>& bytes)
+{
+    auto value = [](const char c) -> i32
+    {
+        if (c >= 'A' && c <= 'Z') return c - 'A';
+        if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+        if (c >= '0' && c <= '9') return c - '0' + 52;
+        if (c == '+') return 62;
+        if (c == '/') return 63;
+        return -1;
+    };
+
+    u32 accumulator = 0;
+    i32 bits = 0;
+    for (size_t i = begin; i < text.size() && text[i] != '='; ++i)
+    {
+        const i32 sextet = value(text[i]);
+        if (sextet < 0)
+            return false;
+        accumulator = (accumulator << 6) | static_cast<u32>(sextet);
+        bits += 6;
+        if (bits >= 8)
+        {
+            bits -= 8;
+            bytes.push_back(static_cast<u8>((accumulator >> bits) & 0xFF));
+        }
+    }
+    return true;
+}
+
+// Pointer to the first element of the accessor and its stride, nullptr if it has no data or is out of bounds
+static const u8* AccessorData(const GltfContext& ctx, const JsonValue& accessor, u32& stride)
+{
+    const JsonValue& bufferView = ctx.json["bufferViews"][static_cast<u32>(accessor["bufferView"].AsInt())];
+    const i32 bufferIdx = bufferView["buffer"].AsInt();
+    if (bufferView.IsNull() || bufferIdx < 0 || bufferIdx >= static_cast<i32>(ctx.buffers.size()) || ctx.buffers[bufferIdx] == nullptr)
+        return nullptr;
+
+    const u32 elementSize = ComponentSize(accessor["componentType"].AsInt()) * ComponentCount(accessor["type"].AsString());
+    const u32 count = static_cast<u32>(accessor["count"].AsInt(0));
+    stride = bufferView["byteStride"].AsInt(0) > 0 ? static_cast<u32>(bufferView["byteStride"].AsInt()) : elementSize;
+
+    const u64 offset = static_cast<u64>(bufferView["byteOffset"].AsNumber(0.0)) + static_cast<u64>(accessor["byteOffset"].AsNumber(0.0));
+    if (elementSize == 0 || count == 0 || offset + static_cast<u64>(stride) * (count - 1) + elementSize > ctx.bufferSizes[bufferIdx])
+    {
+        ELOG("glTF accessor out of the bounds of its buffer")
+        return nullptr;
+    }
+    return ctx.buffers[bufferIdx] + offset;
+}
+
+// Converts any accessor to floats, applying the normalization of integer components
+static bool ReadAccessorFloats(const GltfContext& ctx, const JsonValue& accessor, const u32 components, std::vector<f32>& values)
+{
+    u32 stride = 0;
+    const u8* data = AccessorData(ctx, accessor, stride);
+    if (data == nullptr || accessor.IsNull())
+        return false;
+
+    const i32 componentType = accessor["componentType"].AsInt();
+    const bool normalized = accessor["normalized"].AsBool();
+    const u32 accessorComponents = ComponentCount(accessor["type"].AsString());
+    const u32 count = static_cast<u32>(accessor["count"].AsInt(0));
+    values.assign(static_cast<size_t>(count) * components, 0.0f);
+
+    for (u32 e = 0; e < count; ++e)
+    {
+        const u8* element = data + static_cast<u64>(e) * stride;
+        for (u32 c = 0; c < components && c < accessorComponents; ++c)
+        {
+            f32 value = 0.0f;
+            switch (componentType)
+            {
+            case GLTF_FLOAT: memcpy(&value, element + c * 4, 4); break;
+            case GLTF_UNSIGNED_BYTE: value = element[c]; if (normalized) value /= 255.0f; break;
+            case GLTF_BYTE: value = static_cast<i8>(element[c]); if (normalized) value = glm::max(value / 127.0f, -1.0f); break;
+            case GLTF_UNSIGNED_SHORT: { u16 v; memcpy(&v, element + c * 2, 2); value = v; if (normalized) value /= 65535.0f; break; }
+            case GLTF_SHORT: { i16 v; memcpy(&v, element + c * 2, 2); value = v; if (normalized) value = glm::max(value / 32767.0f, -1.0f); break; }
+            case GLTF_UNSIGNED_INT: { u32 v; memcpy(&v, element + c * 4, 4); value = static_cast<f32>(v); break; }
+            default: break;
+            }
+            values[static_cast<size_t>(e) * components + c] = value;
+        }
+    }
+    return true;
+}
+
+static bool ReadAccessorIndices(const GltfContext& ctx, const JsonValue& accessor, std::vector<u32>& indices)
+{
+    u32 stride = 0;
+    const u8* data = AccessorData(ctx, accessor, stride);
+    if (data == nullptr)
+        return false;
+
+    const i32 componentType = accessor["componentType"].AsInt();
+    const u32 count = static_cast<u32>(accessor["count"].AsInt(0));
+    indices.resize(count);
+    for (u32 i = 0; i < count; ++i)
+    {
+        const u8* element = data + static_cast<u64>(i) * stride;
+        switch (componentType)
+        {
+        case GLTF_UNSIGNED_BYTE: indices[i] = element[0]; break;
+        case GLTF_UNSIGNED_SHORT: { u16 v; memcpy(&v, element, 2); indices[i] = v; break; }
+        default: memcpy(&indices[i], element, 4); break;
+        }
+    }
+    return true;
+}
+
+// An accessor goes to the GPU as it is in the file when the engine can read it as it is: floats for the vertex
+// attributes and 32 bit indices, no sparse storage, and aligned offsets and strides the VAO can express
+static bool IsDirectAccessor(const GltfContext& ctx, const JsonValue& accessor, const i32 componentType)
+{
+    if (accessor.IsNull() || accessor["componentType"].AsInt() != componentType || !accessor["sparse"].IsNull() || accessor["bufferView"].AsInt() < 0)
+        return false;
+
+    const JsonValue& bufferView = ctx.json["bufferViews"][static_cast<u32>(accessor["bufferView"].AsInt())];
+    const u32 byteStride = static_cast<u32>(bufferView["byteStride"].AsInt(0));
+    const u64 offset = static_cast<u64>(bufferView["byteOffset"].AsNumber(0.0)) + static_cast<u64>(accessor["byteOffset"].AsNumber(0.0));
+    u32 stride = 0;
+    return byteStride <= 255 && offset % 4 == 0 && AccessorData(ctx, accessor, stride) != nullptr;
+}
+
+static u64 AlignGpuOffset(const u64 offset)
+{
+    return (offset + GLTF_GPU_ALIGNMENT - 1) & ~static_cast<u64>(GLTF_GPU_ALIGNMENT - 1);
+}
+
+// Appends the array to the converted data block and returns its offset in the GPU buffer
+template <typename T>
+static u64 PushConvertedData(std::vector<u8>& convertedData, const u64 convertedDataGpuOffset, const std::vector<T>& values)
+{
+    const u64 offset = AlignGpuOffset(convertedData.size());
+    convertedData.resize(offset + values.size() * sizeof(T));
+    memcpy(convertedData.data() + offset, values.data(), values.size() * sizeof(T));
+    return convertedDataGpuOffset + offset;
+}
+
+static u64 AccessorGpuOffset(const GltfContext& ctx, const JsonValue& accessor)
+{
+    return ctx.bufferViewGpuOffsets[accessor["bufferView"].AsInt()] + static_cast<u64>(accessor["byteOffset"].AsNumber(0.0));
+}
+
+static glm::mat4 NodeLocalMatrix(const JsonValue& node)
+{
+    const JsonValue& matrix = node["matrix"];
+    if (matrix.Size() == 16)
+    {
+        glm::mat4 localMatrix;
+        for (u32 i = 0; i < 16; ++i)
+            glm::value_ptr(localMatrix)[i] = static_cast<f32>(matrix[i].AsNumber()); // Column major like glm
+        return localMatrix;
+    }
+
+    const JsonValue& t = node["translation"];
+    const JsonValue& r = node["rotation"];
+    const JsonValue& s = node["scale"];
+    const glm::vec3 translation = t.Size() == 3 ? glm::vec3(t[0u].AsNumber(), t[1u].AsNumber(), t[2u].AsNumber()) : glm::vec3(0.0f);
+    const glm::quat rotation = r.Size() == 4 ? glm::quat(static_cast<f32>(r[3u].AsNumber()), static_cast<f32>(r[0u].AsNumber()), static_cast<f32>(r[1u].AsNumber()), static_cast<f32>(r[2u].AsNumber())) : glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+    const glm::vec3 scale = s.Size() == 3 ? glm::vec3(s[0u].AsNumber(), s[1u].AsNumber(), s[2u].AsNumber()) : glm::vec3(1.0f);
+    return glm::translate(glm::mat4(1.0f), translation) * glm::toMat4(rotation) * glm::scale(glm::mat4(1.0f), scale);
+}
+
+static bool LoadGltfBuffers(const MappedFile& file, GltfContext& ctx)
+{
+    const u8* binChunk = nullptr;
+    u64 binChunkSize = 0;
+
+    // GLB: 12 bytes header, then a JSON chunk and an optional BIN chunk
+    u32 magic = 0;
+    memcpy(&magic, file.data, sizeof(u32));
+    if (magic == GLB_MAGIC)
+    {
+        u64 head = 12;
+        const char* jsonText = nullptr;
+        u64 jsonLength = 0;
+        while (head + 8 <= file.size)
+        {
+            u32 chunkLength = 0, chunkType = 0;
+            memcpy(&chunkLength, file.data + head, sizeof(u32));
+            memcpy(&chunkType, file.data + head + 4, sizeof(u32));
+            if (head + 8 + chunkLength > file.size)
+                break;
+            if (chunkType == GLB_CHUNK_JSON)
+            {
+                jsonText = reinterpret_cast<const char*>(file.data + head + 8);
+                jsonLength = chunkLength;
+            }
+            else if (chunkType == GLB_CHUNK_BIN && binChunk == nullptr)
+            {
+                binChunk = file.data + head + 8;
+                binChunkSize = chunkLength;
+            }
+            head += 8 + ((chunkLength + 3) & ~3u);
+        }
+        if (jsonText == nullptr || !JsonSupport::Parse(jsonText, jsonLength, ctx.json))
+            return false;
+    }
+    else if (!JsonSupport::Parse(reinterpret_cast<const char*>(file.data), file.size, ctx.json))
+    {
+        return false;
+    }
+
+    const JsonValue& buffers = ctx.json["buffers"];
+    ctx.buffers.assign(buffers.Size(), nullptr);
+    ctx.bufferSizes.assign(buffers.Size(), 0);
+    ctx.decodedBuffers.reserve(buffers.Size());
+    for (u32 b = 0; b < buffers.Size(); ++b)
+    {
+        const std::string& uri = buffers[b]["uri"].AsString();
+        if (uri.empty())
+        {
+            ctx.buffers[b] = binChunk;
+            ctx.bufferSizes[b] = binChunkSize;
+        }
+        else if (uri.compare(0, 5, "data:") == 0)
+        {
+            ctx.decodedBuffers.emplace_back();
+            const size_t comma = uri.find(',');
+            if (comma == std::string::npos || !DecodeBase64(uri, comma + 1, ctx.decodedBuffers.back()))
+            {
+                ELOG("glTF buffer %u has an unsupported data uri", b)
+                continue;
+            }
+            ctx.buffers[b] = ctx.decodedBuffers.back().data();
+            ctx.bufferSizes[b] = ctx.decodedBuffers.back().size();
+        }
+        else
+        {
+            MappedFile bufferFile;
+            if (!MapFile(MakePath(ctx.directory, uri).c_str(), bufferFile))
+            {
+                ELOG("Could not open the glTF buffer %s", uri.c_str())
+                continue;
+            }
+            ctx.mappedFiles.push_back(bufferFile);
+            ctx.buffers[b] = bufferFile.data;
+            ctx.bufferSizes[b] = bufferFile.size;
+        }
+    }
+    return true;
+}
+
+// Decodes every image of the file in parallel, the GL textures are created afterwards in the main thread
+static void LoadGltfImages(App* app, const GltfContext& ctx, const std::string& filename, std::vector<u32>& imageTextureIdxs)
+{
+    const JsonValue& images = ctx.json["images"];
+    const u32 imageCount = images.Size();
+    imageTextureIdxs.assign(imageCount, 0);
+
+    std::vector<std::string> imagePaths(imageCount);
+    std::vector<Image> decodedImages(imageCount, Image{});
+    std::vector<bool> pendingImages(imageCount, false);
+    for (u32 i = 0; i < imageCount; ++i)
+    {
+        const std::string& uri = images[i]["uri"].AsString();
+        imagePaths[i] = uri.empty() || uri.compare(0, 5, "data:") == 0 ? filename + "#image" + std::to_string(i) : MakePath(ctx.directory, uri);
+
+        pendingImages[i] = true;
+        for (u32 t = 0; t < app->textures.size() && pendingImages[i]; ++t)
+        {
+            if (app->textures[t].path == imagePaths[i])
+            {
+                imageTextureIdxs[i] = t;
+                pendingImages[i] = false;
+            }
+        }
+    }
+
+    // Same orientation as TextureSupport::LoadImage, set once before the workers start
+    stbi_set_flip_vertically_on_load(true);
+    ParallelFor(imageCount, [&](const u32 i)
+    {
+        if (!pendingImages[i])
+            return;
+
+        Image& image = decodedImages[i];
+        const JsonValue& gltfImage = images[i];
+        const std::string& uri = gltfImage["uri"].AsString();
+        if (!gltfImage["bufferView"].IsNull())
+        {
+            const JsonValue& bufferView = ctx.json["bufferViews"][static_cast<u32>(gltfImage["bufferView"].AsInt())];
+            const i32 bufferIdx = bufferView["buffer"].AsInt();
+            const u64 offset = static_cast<u64>(bufferView["byteOffset"].AsNumber(0.0));
+            const u64 length = static_cast<u64>(bufferView["byteLength"].AsNumber(0.0));
+            if (bufferIdx >= 0 && bufferIdx < static_cast<i32>(ctx.buffers.size()) && ctx.buffers[bufferIdx] && offset + length <= ctx.bufferSizes[bufferIdx])
+                image.pixels = stbi_load_from_memory(ctx.buffers[bufferIdx] + offset, static_cast<int>(length), &image.size.x, &image.size.y, &image.nchannels, 0);
+        }
+        else if (uri.compare(0, 5, "data:") == 0)
+        {
+            std::vector<u8> bytes;
+            const size_t comma = uri.find(',');
+            if (comma != std::string::npos && DecodeBase64(uri, comma + 1, bytes))
+                image.pixels = stbi_load_from_memory(bytes.data(), static_cast<int>(bytes.size()), &image.size.x, &image.size.y, &image.nchannels, 0);
+        }
+        else
+        {
+            image.pixels = stbi_load(imagePaths[i].c_str(), &image.size.x, &image.size.y, &image.nchannels, 0);
+        }
+        image.stride = image.size.x * image.nchannels;
+    });
+
+    for (u32 i = 0; i < imageCount; ++i)
+    {
+        if (!pendingImages[i])
+            continue;
+        if (decodedImages[i].pixels == nullptr)
+        {
+            ELOG("Could not decode the glTF image %s", imagePaths[i].c_str())
+            imageTextureIdxs[i] = app->defaultTextureIdx;
+            continue;
+        }
+        imageTextureIdxs[i] = TextureSupport::CreateTexture2D(app, decodedImages[i], imagePaths[i].c_str());
+        TextureSupport::FreeImage(decodedImages[i]);
+    }
+}
+
+static u32 TextureIdxOf(const GltfContext& ctx, const JsonValue& textureInfo, const std::vector<u32>& imageTextureIdxs)
+{
+    if (textureInfo.IsNull())
+        return 0;
+    const i32 source = ctx.json["textures"][static_cast<u32>(textureInfo["index"].AsInt())]["source"].AsInt();
+    return source >= 0 && source < static_cast<i32>(imageTextureIdxs.size()) ? imageTextureIdxs[source] : 0;
+}
+
+u32 GltfSupport::LoadGltf(App* app, const char* filename)
+{
+    const auto loadStart = std::chrono::high_resolution_clock::now();
+
+    MappedFile file;
+    if (!MapFile(filename, file))
+    {
+        ELOG("Error loading glTF %s: could not open the file", filename)
+        return UINT32_MAX;
+    }
+
+    GltfContext ctx;
+    ctx.directory = GetDirectoryPart(MakeString(filename));
+    if (!LoadGltfBuffers(file, ctx))
+    {
+        ELOG("Error loading glTF %s: invalid document", filename)
+        UnmapFile(file);
+        return UINT32_MAX;
+    }
+    const JsonValue& json = ctx.json;
+    const JsonValue& accessors = json["accessors"];
+    const JsonValue& meshes = json["meshes"];
+
+    // Textures & materials
+    std::vector<u32> imageTextureIdxs;
+    LoadGltfImages(app, ctx, MakeString(filename), imageTextureIdxs);
+
+    const u32 baseMaterialIdx = static_cast<u32>(app->materials.size());
+    const JsonValue& materials = json["materials"];
+    for (u32 m = 0; m <= materials.Size(); ++m)
+    {
+        // The last one is the default material of the primitives without material
+        const JsonValue& gltfMaterial = materials[m];
+        const JsonValue& pbr = gltfMaterial["pbrMetallicRoughness"];
+        const JsonValue& baseColor = pbr["baseColorFactor"];
+        const JsonValue& emissive = gltfMaterial["emissiveFactor"];
+
+        app->materials.emplace_back();
+        Material& material = app->materials.back();
+        material.name = m < materials.Size() ? gltfMaterial["name"].AsString() : "DefaultMaterial";
+        material.albedo = baseColor.Size() >= 3 ? vec3(baseColor[0u].AsNumber(), baseColor[1u].AsNumber(), baseColor[2u].AsNumber()) : vec3(1.0f);
+        material.emissive = emissive.Size() == 3 ? vec3(emissive[0u].AsNumber(), emissive[1u].AsNumber(), emissive[2u].AsNumber()) : vec3(0.0f);
+        material.smoothness = 1.0f - static_cast<f32>(pbr["roughnessFactor"].AsNumber(1.0));
+        material.albedoTextureIdx = TextureIdxOf(ctx, pbr["baseColorTexture"], imageTextureIdxs);
+        material.normalsTextureIdx = TextureIdxOf(ctx, gltfMaterial["normalTexture"], imageTextureIdxs);
+        material.emissiveTextureIdx = TextureIdxOf(ctx, gltfMaterial["emissiveTexture"], imageTextureIdxs);
+    }
+    const u32 defaultMaterialIdx = baseMaterialIdx + materials.Size();
+
+    // First pass, the bufferViews of the direct accessors are placed at the start of the GPU buffer
+    ctx.bufferViewGpuOffsets.assign(json["bufferViews"].Size(), UINT64_MAX);
+    u64 gpuBufferSize = 0;
+    auto placeBufferView = [&](const JsonValue& accessor)
+    {
+        const u32 bufferViewIdx = static_cast<u32>(accessor["bufferView"].AsInt());
+        if (ctx.bufferViewGpuOffsets[bufferViewIdx] != UINT64_MAX)
+            return;
+        ctx.bufferViewGpuOffsets[bufferViewIdx] = AlignGpuOffset(gpuBufferSize);
+        gpuBufferSize = ctx.bufferViewGpuOffsets[bufferViewIdx] + static_cast<u64>(json["bufferViews"][bufferViewIdx]["byteLength"].AsNumber(0.0));
+    };
+    for (u32 m = 0; m < meshes.Size(); ++m)
+    {
+        const JsonValue& primitives = meshes[m]["primitives"];
+        for (u32 p = 0; p < primitives.Size(); ++p)
+        {
+            const JsonValue& attributes = primitives[p]["attributes"];
+            for (const char* attribute : { "POSITION", "NORMAL", "TANGENT" })
+            {
+                const JsonValue& accessor = accessors[static_cast<u32>(attributes[attribute].AsInt())];
+                if (IsDirectAccessor(ctx, accessor, GLTF_FLOAT))
+                    placeBufferView(accessor);
+            }
+            const JsonValue& indicesAccessor = accessors[static_cast<u32>(primitives[p]["indices"].AsInt())];
+            if (IsDirectAccessor(ctx, indicesAccessor, GLTF_UNSIGNED_INT))
+                placeBufferView(indicesAccessor);
+        }
+    }
+    const u64 convertedDataGpuOffset = AlignGpuOffset(gpuBufferSize);
+
+    // Second pass, one Model per glTF mesh and one SubMesh per primitive. What can not be read as it is
+    // (flipped texture coordinates, bitangents, generated normals/tangents, 8/16 bit indices) is converted
+    std::vector<u8> convertedData;
+    const u32 baseMeshIdx = static_cast<u32>(app->meshes.size());
+    GltfScene scene;
+    scene.name = MakeString(filename);
+    for (u32 m = 0; m < meshes.Size(); ++m)
+    {
+        const JsonValue& gltfMesh = meshes[m];
+        const std::string meshName = gltfMesh["name"].AsString().empty() ? scene.name + "#mesh" + std::to_string(m) : gltfMesh["name"].AsString();
+        Mesh mesh = { ("Mesh_" + meshName).c_str() };
+        Model model = { ("Model_" + meshName).c_str() };
+        model.meshIdx = baseMeshIdx + m;
+        mesh.boundsMin = glm::vec3(FLT_MAX);
+        mesh.boundsMax = glm::vec3(-FLT_MAX);
+
+        const JsonValue& primitives = gltfMesh["primitives"];
+        for (u32 p = 0; p < primitives.Size(); ++p)
+        {
+            const JsonValue& primitive = primitives[p];
+            const JsonValue& attributes = primitive["attributes"];
+            const JsonValue& positionAccessor = accessors[static_cast<u32>(attributes["POSITION"].AsInt())];
+            if (primitive["mode"].AsInt(GLTF_MODE_TRIANGLES) != GLTF_MODE_TRIANGLES || !IsDirectAccessor(ctx, positionAccessor, GLTF_FLOAT))
+            {
+                ELOG("glTF %s: primitive %u of mesh %s is not a triangle list with float positions, skipped", filename, p, meshName.c_str())
+                continue;
+            }
+
+            // The CPU copies of the normals and tangents are indexed per vertex
+            const JsonValue& normalAccessor = accessors[static_cast<u32>(attributes["NORMAL"].AsInt())];
+            const JsonValue& tangentAccessor = accessors[static_cast<u32>(attributes["TANGENT"].AsInt())];
+            const i32 positionCount = positionAccessor["count"].AsInt(0);
+            if ((!normalAccessor.IsNull() && normalAccessor["count"].AsInt(0) != positionCount) ||
+                (!tangentAccessor.IsNull() && tangentAccessor["count"].AsInt(0) != positionCount))
+            {
+                ELOG("glTF %s: primitive %u of mesh %s has a vertex attribute count different from its position count, skipped", filename, p, meshName.c_str())
+                continue;
+            }
+
+            SubMesh subMesh = { (meshName + "_" + std::to_string(p)).c_str() };
+            subMesh.vertexCount = static_cast<u32>(positionAccessor["count"].AsInt(0));
+            subMesh.vertexOffset = 0;
+            VertexBufferLayout& layout = subMesh.vertexBufferLayout;
+            layout.stride = 3 * sizeof(float);
+
+            auto addDirectAttribute = [&](const u8 location, const u8 componentCount, const JsonValue& accessor)
+            {
+                u32 stride = 0;
+                AccessorData(ctx, accessor, stride);
+                layout.attributes.push_back(VertexBufferAttribute{ location, componentCount, 0, static_cast<u8>(stride), static_cast<u32>(AccessorGpuOffset(ctx, accessor)) });
+            };
+            auto addConvertedAttribute = [&](const u8 location, const u8 componentCount, const u64 gpuOffset)
+            {
+                layout.attributes.push_back(VertexBufferAttribute{ location, componentCount, 0, static_cast<u8>(componentCount * sizeof(float)), static_cast<u32>(gpuOffset) });
+            };
+
+            // Positions always go as they are, min/max are mandatory in glTF so the bounds come for free
+            addDirectAttribute(ATTR_LOCATION_POSITION, 3, positionAccessor);
+            const JsonValue& positionMin = positionAccessor["min"];
+            const JsonValue& positionMax = positionAccessor["max"];
+            if (positionMin.Size() == 3 && positionMax.Size() == 3)
+            {
+                mesh.boundsMin = glm::min(mesh.boundsMin, glm::vec3(positionMin[0u].AsNumber(), positionMin[1u].AsNumber(), positionMin[2u].AsNumber()));
+                mesh.boundsMax = glm::max(mesh.boundsMax, glm::vec3(positionMax[0u].AsNumber(), positionMax[1u].AsNumber(), positionMax[2u].AsNumber()));
+            }
+
+            // Indices
+            std::vector<u32> indices;
+            const JsonValue& indicesAccessor = accessors[static_cast<u32>(primitive["indices"].AsInt())];
+            if (IsDirectAccessor(ctx, indicesAccessor, GLTF_UNSIGNED_INT))
+            {
+                subMesh.indexOffset = static_cast<u32>(AccessorGpuOffset(ctx, indicesAccessor));
+            }
+            else
+            {
+                if (indicesAccessor.IsNull() || !ReadAccessorIndices(ctx, indicesAccessor, indices))
+                {
+                    indices.resize(subMesh.vertexCount);
+                    for (u32 i = 0; i < subMesh.vertexCount; ++i)
+                        indices[i] = i;
+                }
+                subMesh.indexOffset = static_cast<u32>(PushConvertedData(convertedData, convertedDataGpuOffset, indices));
+            }
+            subMesh.indexCount = indicesAccessor.IsNull() ? subMesh.vertexCount : static_cast<u32>(indicesAccessor["count"].AsInt(0));
+
+            // The CPU copies are only read when something has to be generated
+            const JsonValue& texCoordAccessor = accessors[static_cast<u32>(attributes["TEXCOORD_0"].AsInt())];
+            const bool directNormals = IsDirectAccessor(ctx, normalAccessor, GLTF_FLOAT);
+            const bool hasTangents = !tangentAccessor.IsNull();
+
+            std::vector<f32> positionValues, normalValues, texCoordValues, tangentValues;
+            std::vector<vec3> positions, normals;
+            std::vector<vec2> texCoords(subMesh.vertexCount, vec2(0.0f));
+            if (!texCoordAccessor.IsNull() && ReadAccessorFloats(ctx, texCoordAccessor, 2, texCoordValues))
+            {
+                for (u32 v = 0; v < subMesh.vertexCount && v * 2 + 1 < texCoordValues.size(); ++v)
+                    texCoords[v] = vec2(texCoordValues[v * 2], 1.0f - texCoordValues[v * 2 + 1]); // Images are flipped on load
+            }
+            addConvertedAttribute(ATTR_LOCATION_TEXTCOORD, 2, PushConvertedData(convertedData, convertedDataGpuOffset, texCoords));
+
+            if (indices.empty() && (!directNormals || !hasTangents))
+                ReadAccessorIndices(ctx, indicesAccessor, indices);
+
+            if (!normalAccessor.IsNull() && ReadAccessorFloats(ctx, normalAccessor, 3, normalValues))
+                normals.assign(reinterpret_cast<const vec3*>(normalValues.data()), reinterpret_cast<const vec3*>(normalValues.data()) + subMesh.vertexCount);
+            if (normals.empty() || !hasTangents)
+            {
+                ReadAccessorFloats(ctx, positionAccessor, 3, positionValues);
+                positions.assign(reinterpret_cast<const vec3*>(positionValues.data()), reinterpret_cast<const vec3*>(positionValues.data()) + subMesh.vertexCount);
+            }
+            if (normals.empty())
+                MeshProcessingSupport::GenerateNormals(positions, indices, normals);
+
+            if (directNormals)
+                addDirectAttribute(ATTR_LOCATION_NORMAL, 3, normalAccessor);
+            else
+                addConvertedAttribute(ATTR_LOCATION_NORMAL, 3, PushConvertedData(convertedData, convertedDataGpuOffset, normals));
+
+            // Tangents, the bitangent is cross(N, T) * w as glTF defines it
+            std::vector<vec3> tangents, bitangents;
+            if (hasTangents && ReadAccessorFloats(ctx, tangentAccessor, 4, tangentValues))
+            {
+                bitangents.resize(subMesh.vertexCount);
+                for (u32 v = 0; v < subMesh.vertexCount; ++v)
+                {
+                    const vec3 tangent = glm::make_vec3(&tangentValues[v * 4]);
+                    bitangents[v] = glm::cross(normals[v], tangent) * tangentValues[v * 4 + 3];
+                }
+                if (IsDirectAccessor(ctx, tangentAccessor, GLTF_FLOAT))
+                {
+                    addDirectAttribute(ATTR_LOCATION_TANGENT, 3, tangentAccessor);
+                }
+                else
+                {
+                    tangents.resize(subMesh.vertexCount);
+                    for (u32 v = 0; v < subMesh.vertexCount; ++v)
+                        tangents[v] = glm::make_vec3(&tangentValues[v * 4]);
+                    addConvertedAttribute(ATTR_LOCATION_TANGENT, 3, PushConvertedData(convertedData, convertedDataGpuOffset, tangents));
+                }
+            }
+            else
+            {
+                MeshProcessingSupport::GenerateTangentSpace(positions, texCoords, normals, indices, tangents, bitangents);
+                addConvertedAttribute(ATTR_LOCATION_TANGENT, 3, PushConvertedData(convertedData, convertedDataGpuOffset, tangents));
+            }
+            addConvertedAttribute(ATTR_LOCATION_BITANGENT, 3, PushConvertedData(convertedData, convertedDataGpuOffset, bitangents));
+
+            mesh.subMeshes.push_back(subMesh);
+            const i32 materialIdx = primitive["material"].AsInt();
+            model.materialIdx.push_back(materialIdx >= 0 && materialIdx < static_cast<i32>(materials.Size()) ? baseMaterialIdx + materialIdx : defaultMaterialIdx);
+        }
+
+        if (mesh.subMeshes.empty())
+        {
+            mesh.boundsMin = glm::vec3(0.0f);
+            mesh.boundsMax = glm::vec3(0.0f);
+        }
+        app->meshes.push_back(mesh);
+        scene.modelIdxs.push_back(static_cast<u32>(app->models.size()));
+        app->models.push_back(model);
+    }
+
+    // Single GPU buffer for the whole file, the direct ranges are copied from the file (or mapping) without repacking
+    gpuBufferSize = convertedDataGpuOffset + convertedData.size();
+    scene.buffer = CREATE_STATIC_VERTEX_BUFFER(static_cast<u32>(gpuBufferSize), nullptr);
+    BufferManagement::BindBuffer(scene.buffer);
+    for (u32 v = 0; v < ctx.bufferViewGpuOffsets.size(); ++v)
+    {
+        if (ctx.bufferViewGpuOffsets[v] == UINT64_MAX)
+            continue;
+        const JsonValue& bufferView = json["bufferViews"][v];
+        const u8* data = ctx.buffers[bufferView["buffer"].AsInt()] + static_cast<u64>(bufferView["byteOffset"].AsNumber(0.0));
+        glBufferSubData(GL_ARRAY_BUFFER, ctx.bufferViewGpuOffsets[v], static_cast<GLsizeiptr>(bufferView["byteLength"].AsNumber(0.0)), data);
+    }
+    glBufferSubData(GL_ARRAY_BUFFER, convertedDataGpuOffset, convertedData.size(), convertedData.data());
+    BufferManagement::UnBindBuffer(scene.buffer);
+
+    // The same buffer object is bound as element array for the indices
+    Buffer indexBuffer = scene.buffer;
+    indexBuffer.type = GL_ELEMENT_ARRAY_BUFFER;
+    for (const u32 modelIdx : scene.modelIdxs)
+    {
+        Mesh& mesh = app->meshes[app->models[modelIdx].meshIdx];
+        mesh.vertexBuffer = scene.buffer;
+        mesh.indexBuffer = indexBuffer;
+    }
+
+    // Node hierarchy
+    const JsonValue& nodes = json["nodes"];
+    scene.nodes.resize(nodes.Size());
+    for (u32 n = 0; n < nodes.Size(); ++n)
+    {
+        GltfNode& node = scene.nodes[n];
+        node.name = nodes[n]["name"].AsString().empty() ? "Node " + std::to_string(n) : nodes[n]["name"].AsString();
+        node.localMatrix = NodeLocalMatrix(nodes[n]);
+        const i32 meshIdx = nodes[n]["mesh"].AsInt();
+        node.modelIdx = meshIdx >= 0 && meshIdx < static_cast<i32>(scene.modelIdxs.size()) ? scene.modelIdxs[meshIdx] : UINT32_MAX;
+        const JsonValue& children = nodes[n]["children"];
+        for (u32 c = 0; c < children.Size(); ++c)
+        {
+            const i32 child = children[c].AsInt();
+            if (child >= 0 && child < static_cast<i32>(nodes.Size()))
+            {
+                node.children.push_back(child);
+                scene.nodes[child].parent = static_cast<i32>(n);
+            }
+        }
+    }
+    const JsonValue& sceneNodes = json["scenes"][static_cast<u32>(json["scene"].AsInt(0))]["nodes"];
+    for (u32 n = 0; n < sceneNodes.Size(); ++n)
+        scene.rootNodes.push_back(sceneNodes[n].AsInt());
+    if (sceneNodes.IsNull())
+    {
+        for (u32 n = 0; n < scene.nodes.size(); ++n)
+            if (scene.nodes[n].parent < 0)
+                scene.rootNodes.push_back(n);
+    }
+
+    for (MappedFile& bufferFile : ctx.mappedFiles)
+        UnmapFile(bufferFile);
+    UnmapFile(file);
+
+    const u32 sceneIdx = static_cast<u32>(app->gltfScenes.size());
+    app->gltfScenes.push_back(scene);
+
+    const f64 loadMs = std::chrono::duration<f64, std::milli>(std::chrono::high_resolution_clock::now() - loadStart).count();
+    ILOG("glTF %s loaded in %.2f ms: %u meshes, %u nodes, %llu bytes uploaded as they are, %llu bytes converted", filename, loadMs,
+        meshes.Size(), nodes.Size(), static_cast<u64>(gpuBufferSize - convertedData.size()), static_cast<u64>(convertedData.size()))
+    return sceneIdx;
+}
+
+void GltfSupport::InstantiateScene(App* app, const u32 sceneIdx, const glm::mat4& transform, const u32 programIdx)
+{
+    const GltfScene& scene = app->gltfScenes[sceneIdx];
+
+    std::vector<std::pair<u32, glm::mat4>> stack;
+    for (const u32 root : scene.rootNodes)
+        stack.emplace_back(root, transform);
+
+    while (!stack.empty())
+    {
+        const u32 nodeIdx = stack.back().first;
+        const GltfNode& node = scene.nodes[nodeIdx];
+        const glm::mat4 worldMatrix = stack.back().second * node.localMatrix;
+        stack.pop_back();
+
+        for (const u32 child : node.children)
+            stack.emplace_back(child, worldMatrix);
+        if (node.modelIdx == UINT32_MAX)
+            continue;
+
+        glm::vec3 scale, translation, skew;
+        glm::vec4 perspective;
+        glm::quat orientation;
+        glm::decompose(worldMatrix, scale, orientation, translation, skew, perspective);
+        CreateEntity(app, translation, glm::degrees(glm::eulerAngles(orientation)), scale, node.modelIdx, programIdx, glm::vec4(1.0f), node.name.c_str());
+        app->entities.back()->worldMatrix = worldMatrix; // Exact, the decomposition is only for the editor fields
+    }
+}
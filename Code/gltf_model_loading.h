@@ -0,0 +1,46 @@
+﻿#ifndef GLTF_MODEL_LOADING_H
+#define GLTF_MODEL_LOADING_H
+#include <vector>
+
+#include "platform.h"
+#include "buffer_management.h"
+
+struct App;
+
+/// <summary>
+/// Node of a glTF scene. Nodes keep their local transform and hierarchy, the meshes are not pre transformed,
+/// so every node that references the same glTF mesh shares its Model (instancing).
+/// </summary>
+/// <param name="modelIdx">Model of the node mesh, UINT32_MAX for nodes without mesh.</param>
+struct GltfNode
+{
+    std::string name;
+    i32 parent = -1;
+    std::vector<u32> children;
+    glm::mat4 localMatrix = glm::mat4(1.0f);
+    u32 modelIdx = UINT32_MAX;
+};
+
+/// <summary>
+/// Imported glTF file. All the meshes of the file share one GPU buffer holding the accessor ranges
+/// uploaded as they are in the file, followed by the data that had to be converted.
+/// </summary>
+struct GltfScene
+{
+    std::string name;
+    std::vector<GltfNode> nodes;
+    std::vector<u32> rootNodes;
+    std::vector<u32> modelIdxs;
+    Buffer buffer;
+};
+
+struct GltfSupport
+{
+    // Imports a .gltf (external or base64 buffers) or .glb file, returns the index into app->gltfScenes or UINT32_MAX
+    static u32 LoadGltf(App* app, const char* filename);
+
+    // Creates an entity for every node with a mesh, transformed by the node hierarchy and the given root transform
+    static void InstantiateScene(App* app, u32 sceneIdx, const glm::mat4& transform, u32 programIdx);
+};
+
+#endif // GLTF_MODEL_LOADING_H
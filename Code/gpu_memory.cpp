@@ -0,0 +1,175 @@
+﻿#include "gpu_memory.h"
+
+#include <algorithm>
+#include <unordered_set>
+
+#include "app.h"
+#include "meshlet.h"
+
+static void CountResources(App* app)
+{
+    GpuMemory& gpuMemory = app->gpuMemory;
+    u64 bytes[GPU_MEMORY_CATEGORY_COUNT] = {};
+
+    // Slots share the default texture's handle until their upload, each handle is counted once
+    std::unordered_set<GLuint> countedHandles;
+    gpuMemory.evictedTextures = 0;
+    for (const Texture& tex : app->textures)
+    {
+        if (tex.sourceOnly || !countedHandles.insert(tex.handle).second)
+            continue;
+        const GpuMemoryCategory category = tex.type == TextureType::NON_FBO ? GPU_MEMORY_TEXTURES : GPU_MEMORY_RENDER_TARGETS;
+        bytes[category] += TextureSupport::GetEstimatedBytes(tex);
+        if (tex.evictedLevels > 0)
+            ++gpuMemory.evictedTextures;
+    }
+
+    // The meshes of a glTF file share one buffer for vertices and indices
+    std::unordered_set<GLuint> countedBuffers;
+    for (const Mesh& mesh : app->meshes)
+    {
+        if (countedBuffers.insert(mesh.vertexBuffer.handle).second)
+            bytes[GPU_MEMORY_GEOMETRY] += mesh.vertexBuffer.size;
+        if (countedBuffers.insert(mesh.indexBuffer.handle).second)
+            bytes[GPU_MEMORY_GEOMETRY] += mesh.indexBuffer.size;
+    }
+
+    bytes[GPU_MEMORY_UNIFORMS] = app->uniformBuffer.size + app->clusteredLighting.bufferBytes + app->forwardPlus.bufferBytes;
+
+    for (const PixelUploadBuffer& pixelBuffer : app->textureStreamer.pixelBuffers)
+        bytes[GPU_MEMORY_STREAMING_STAGING] += pixelBuffer.size;
+
+    bytes[GPU_MEMORY_TEXTURE_ARRAYS] = app->materialBatching.textureArrayBytes;
+
+    // Indirection texels are RGBA8UI and the feedback is one R32UI image plus its readback buffers
+    const VirtualTexturing& virtualTexturing = app->virtualTexturing;
+    bytes[GPU_MEMORY_VIRTUAL_TEXTURING] = virtualTexturing.atlasBytes;
+    for (const VirtualTexture& virtualTexture : virtualTexturing.virtualTextures)
+        for (u32 level = 0; level < virtualTexture.levelCount; ++level)
+            bytes[GPU_MEMORY_VIRTUAL_TEXTURING] += static_cast<u64>(glm::max(virtualTexture.pageCount.x >> level, 1)) * glm::max(virtualTexture.pageCount.y >> level, 1) * 4;
+    bytes[GPU_MEMORY_VIRTUAL_TEXTURING] += static_cast<u64>(virtualTexturing.feedbackSize.x) * virtualTexturing.feedbackSize.y * 4 * (1 + VT_FEEDBACK_READBACK_FRAMES);
+
+    gpuMemory.totalBytes = 0;
+    for (u32 c = 0; c < GPU_MEMORY_CATEGORY_COUNT; ++c)
+    {
+        gpuMemory.currentBytes[c] = bytes[c];
+        gpuMemory.peakBytes[c] = glm::max(gpuMemory.peakBytes[c], bytes[c]);
+        gpuMemory.totalBytes += bytes[c];
+    }
+    gpuMemory.peakTotalBytes = glm::max(gpuMemory.peakTotalBytes, gpuMemory.totalBytes);
+}
+
+static bool CanEvict(const App* app, const u32 texIdx)
+{
+    const Texture& tex = app->textures[texIdx];
+    return tex.type == TextureType::NON_FBO && !tex.streaming && !tex.sourceOnly && texIdx != app->defaultTextureIdx &&
+        tex.handle != app->textures[app->defaultTextureIdx].handle;
+}
+
+static void EnforceTextureBudget(App* app)
+{
+    GpuMemory& gpuMemory = app->gpuMemory;
+    gpuMemory.levelsEvictedLastFrame = 0;
+    const u64 budgetBytes = gpuMemory.enforceTextureBudget ? static_cast<u64>(gpuMemory.textureBudgetMB) * 1024 * 1024 : UINT64_MAX;
+    // The layers of the material texture arrays are copies of their sources, rebuilt after each eviction or reload
+    u64 textureBytes = gpuMemory.currentBytes[GPU_MEMORY_TEXTURES] + gpuMemory.currentBytes[GPU_MEMORY_TEXTURE_ARRAYS];
+
+    if (textureBytes > budgetBytes)
+    {
+        // Least recently visible first, the largest ones first among textures seen in the same frame
+        std::vector<u32> candidates;
+        for (u32 texIdx = 0; texIdx < app->textures.size(); ++texIdx)
+            if (CanEvict(app, texIdx))
+                candidates.push_back(texIdx);
+        std::sort(candidates.begin(), candidates.end(), [app](const u32 a, const u32 b)
+        {
+            const Texture& texA = app->textures[a];
+            const Texture& texB = app->textures[b];
+            if (texA.lastVisibleFrame != texB.lastVisibleFrame)
+                return texA.lastVisibleFrame < texB.lastVisibleFrame;
+            return TextureSupport::GetEstimatedBytes(texA) > TextureSupport::GetEstimatedBytes(texB);
+        });
+
+        for (const u32 texIdx : candidates)
+        {
+            if (textureBytes <= budgetBytes || gpuMemory.levelsEvictedLastFrame == GPU_MEMORY_MAX_EVICTIONS_PER_FRAME)
+                break;
+            const u64 bytesBefore = TextureSupport::GetEstimatedBytes(app->textures[texIdx]);
+            const u64 copies = MaterialBatchingSupport::HasTextureArrayCopy(app, texIdx) ? 2 : 1;
+            if (!TextureSupport::DropTopMipLevel(app, texIdx))
+                continue;
+            textureBytes -= (bytesBefore - TextureSupport::GetEstimatedBytes(app->textures[texIdx])) * copies;
+            ++gpuMemory.levelsEvictedLastFrame;
+            ++gpuMemory.totalLevelsEvicted;
+        }
+        return;
+    }
+
+    // Reloads are not counted until uploaded, one at a time keeps the projection honest
+    if (app->textureStreamer.pendingTextures > 0)
+        return;
+
+    u32 reloads = 0;
+    for (u32 texIdx = 0; texIdx < app->textures.size() && reloads < GPU_MEMORY_MAX_RELOADS_PER_FRAME; ++texIdx)
+    {
+        const Texture& tex = app->textures[texIdx];
+        if (tex.evictedLevels == 0 || tex.streaming || tex.lastVisibleFrame + 1 < gpuMemory.frame)
+            continue;
+
+        Texture fullTexture = tex;
+        fullTexture.size = tex.size * (1 << tex.evictedLevels);
+        const u64 copies = MaterialBatchingSupport::HasTextureArrayCopy(app, texIdx) ? 2 : 1;
+        const u64 projectedBytes = textureBytes + (TextureSupport::GetEstimatedBytes(fullTexture) - TextureSupport::GetEstimatedBytes(tex)) * copies;
+        if (static_cast<f64>(projectedBytes) > static_cast<f64>(budgetBytes) * GPU_MEMORY_RELOAD_THRESHOLD)
+            continue;
+        if (TextureSupport::ReloadTexture(app, texIdx))
+        {
+            textureBytes = projectedBytes;
+            ++reloads;
+            ++gpuMemory.totalReloads;
+        }
+    }
+}
+
+void GpuMemorySupport::Update(App* app)
+{
+    ++app->gpuMemory.frame;
+    CountResources(app);
+    EnforceTextureBudget(app);
+}
+
+void GpuMemorySupport::MarkEntityVisible(App* app, const Entity& entity)
+{
+    const Model& model = app->models[entity.modelIndex];
+    const Mesh& mesh = app->meshes[model.meshIdx];
+
+    // Meshes without bounds count as visible
+    if (mesh.boundsMin != mesh.boundsMax)
+    {
+        glm::vec4 frustumPlanes[6];
+        MeshletSupport::ExtractFrustumPlanes(entity.worldViewProjectionMat, frustumPlanes);
+        for (const glm::vec4& plane : frustumPlanes)
+        {
+            // Corner of the box furthest along the plane normal
+            const glm::vec3 corner = glm::mix(mesh.boundsMin, mesh.boundsMax, glm::greaterThanEqual(glm::vec3(plane), glm::vec3(0.0f)));
+            if (glm::dot(glm::vec3(plane), corner) + plane.w < 0.0f)
+                return;
+        }
+    }
+
+    const u64 frame = app->gpuMemory.frame;
+    for (const u32 materialIdx : model.materialIdx)
+    {
+        const Material& material = app->materials[materialIdx];
+        for (const u32 texIdx : { material.albedoTextureIdx, material.normalsTextureIdx, material.masksTextureIdx, material.coneStepTextureIdx })
+            app->textures[texIdx].lastVisibleFrame = frame;
+    }
+}
+
+void GpuMemorySupport::ResetPeaks(App* app)
+{
+    GpuMemory& gpuMemory = app->gpuMemory;
+    for (u32 c = 0; c < GPU_MEMORY_CATEGORY_COUNT; ++c)
+        gpuMemory.peakBytes[c] = gpuMemory.currentBytes[c];
+    gpuMemory.peakTotalBytes = gpuMemory.totalBytes;
+}
@@ -0,0 +1,61 @@
+﻿#ifndef GPU_MEMORY_H
+#define GPU_MEMORY_H
+#include "platform.h"
+
+struct App;
+struct Entity;
+
+#define GPU_MEMORY_DEFAULT_TEXTURE_BUDGET_MB 1024
+#define GPU_MEMORY_MAX_EVICTIONS_PER_FRAME 4
+#define GPU_MEMORY_MAX_RELOADS_PER_FRAME 1
+#define GPU_MEMORY_RELOAD_THRESHOLD 0.9f // Evicted textures come back while the projected total stays under this fraction of the budget
+
+static const char* GpuMemoryCategoryStr[] = { "Textures", "Render targets", "Geometry", "Uniforms", "Streaming staging", "Texture arrays", "Virtual texturing" };
+enum GpuMemoryCategory
+{
+    GPU_MEMORY_TEXTURES,
+    GPU_MEMORY_RENDER_TARGETS,
+    GPU_MEMORY_GEOMETRY,
+    GPU_MEMORY_UNIFORMS,
+    GPU_MEMORY_STREAMING_STAGING,
+    GPU_MEMORY_TEXTURE_ARRAYS,
+    GPU_MEMORY_VIRTUAL_TEXTURING,
+    GPU_MEMORY_CATEGORY_COUNT
+};
+
+/// <summary>
+/// Video memory accountant. The bytes of every texture, render target and buffer are estimated from their sizes
+/// and formats each frame (GL has no core query for it), grouped by category with the peaks since startup.
+/// With a texture budget the material textures that were not visible for the longest lose their top mip until
+/// the total fits, and get their full resolution streamed back once they are visible and there is room again.
+/// </summary>
+struct GpuMemory
+{
+    u64 frame = 1; // Textures are marked visible with it, 0 means never seen
+    u64 currentBytes[GPU_MEMORY_CATEGORY_COUNT] = {};
+    u64 peakBytes[GPU_MEMORY_CATEGORY_COUNT] = {};
+    u64 totalBytes = 0;
+    u64 peakTotalBytes = 0;
+
+    bool enforceTextureBudget = true;
+    u32 textureBudgetMB = GPU_MEMORY_DEFAULT_TEXTURE_BUDGET_MB;
+
+    // Stats
+    u32 evictedTextures = 0; // Currently with evicted levels
+    u32 levelsEvictedLastFrame = 0;
+    u32 totalLevelsEvicted = 0;
+    u32 totalReloads = 0;
+};
+
+struct GpuMemorySupport
+{
+    // Recounts the categories and enforces the texture budget, called once per frame after the streaming updates
+    static void Update(App* app);
+
+    // Stamps the material textures of the entity when its bounds are in the view frustum
+    static void MarkEntityVisible(App* app, const Entity& entity);
+
+    static void ResetPeaks(App* app);
+};
+
+#endif // GPU_MEMORY_H
@@ -0,0 +1,34 @@
+﻿#include "gpu_timer.h"
+
+void GpuTimerSupport::Init(GpuTimer& timer)
+{
+    glGenQueries(GPU_TIMER_QUERY_COUNT, timer.queries);
+}
+
+void GpuTimerSupport::Shutdown(GpuTimer& timer)
+{
+    glDeleteQueries(GPU_TIMER_QUERY_COUNT, timer.queries);
+}
+
+void GpuTimerSupport::Begin(GpuTimer& timer)
+{
+    // The slot was ended GPU_TIMER_QUERY_COUNT frames ago, the result is there unless the GPU is that far behind
+    const u32 slot = timer.current;
+    if (timer.pending[slot])
+    {
+        GLuint64 elapsedNs = 0;
+        glGetQueryObjectui64v(timer.queries[slot], GL_QUERY_RESULT, &elapsedNs);
+        timer.lastMs = static_cast<f64>(elapsedNs) / 1000000.0;
+        timer.averageMs = timer.readings == 0 ? timer.lastMs : timer.averageMs + (timer.lastMs - timer.averageMs) * GPU_TIMER_SMOOTHING;
+        ++timer.readings;
+        timer.pending[slot] = false;
+    }
+    glBeginQuery(GL_TIME_ELAPSED, timer.queries[slot]);
+}
+
+void GpuTimerSupport::End(GpuTimer& timer)
+{
+    glEndQuery(GL_TIME_ELAPSED);
+    timer.pending[timer.current] = true;
+    timer.current = (timer.current + 1) % GPU_TIMER_QUERY_COUNT;
+}
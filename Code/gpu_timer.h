@@ -0,0 +1,33 @@
+﻿#ifndef GPU_TIMER_H
+#define GPU_TIMER_H
+
+#include "platform.h"
+
+#define GPU_TIMER_QUERY_COUNT 4 // Frames in flight, a query is read back when its slot comes around again
+#define GPU_TIMER_SMOOTHING 0.05f // Weight of the last reading in averageMs
+
+/// <summary>
+/// GL_TIME_ELAPSED queries around a span of GPU work, read back a few frames later so the CPU never waits on them.
+/// Only one timer can be running at a time, GL does not nest elapsed time queries.
+/// </summary>
+struct GpuTimer
+{
+    GLuint queries[GPU_TIMER_QUERY_COUNT] = {};
+    bool pending[GPU_TIMER_QUERY_COUNT] = {};
+    u32 current = 0;
+
+    f64 lastMs = 0.0;
+    f64 averageMs = 0.0;
+    u64 readings = 0;
+};
+
+struct GpuTimerSupport
+{
+    static void Init(GpuTimer& timer);
+    static void Shutdown(GpuTimer& timer);
+
+    static void Begin(GpuTimer& timer);
+    static void End(GpuTimer& timer);
+};
+
+#endif // GPU_TIMER_H
@@ -0,0 +1,164 @@
+﻿#include "impostor.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "app.h"
+
+glm::vec2 ImpostorSupport::HemiOctahedronEncode(glm::vec3 direction)
+{
+    direction.y = glm::max(direction.y, 0.0f); // Views from below the horizon use the closest frame of the hemisphere
+    direction /= (glm::abs(direction.x) + glm::abs(direction.y) + glm::abs(direction.z));
+    return glm::vec2(direction.x - direction.z, direction.x + direction.z) * 0.5f + 0.5f;
+}
+
+glm::vec3 ImpostorSupport::HemiOctahedronDecode(glm::vec2 uv)
+{
+    uv = uv * 2.0f - 1.0f;
+    const glm::vec2 xz = glm::vec2(uv.x + uv.y, uv.y - uv.x) * 0.5f;
+    return glm::normalize(glm::vec3(xz.x, 1.0f - glm::abs(xz.x) - glm::abs(xz.y), xz.y));
+}
+
+u32 ImpostorSupport::BakeImpostor(App* app, const u32 modelIdx, const u32 framesPerSide, const u32 frameResolution)
+{
+    glPushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, 1, -1, "Impostor Bake");
+
+    Model& model = app->models[modelIdx];
+    Mesh& mesh = app->meshes[model.meshIdx];
+
+    Impostor impostor = {};
+    impostor.modelIdx = modelIdx;
+    impostor.framesPerSide = framesPerSide;
+    impostor.frameResolution = frameResolution;
+    impostor.center = (mesh.boundsMin + mesh.boundsMax) * 0.5f;
+    impostor.radius = glm::max(glm::length(mesh.boundsMax - mesh.boundsMin) * 0.5f, 0.001f);
+
+    // Atlas render targets, they keep their size when the screen is resized
+    const u32 atlasSize = framesPerSide * frameResolution;
+    const std::string name = "Impostor " + model.name;
+    impostor.albedoTextureIdx = TextureSupport::CreateEmptyColorTexture_8Bit_RGBA(app, (name + " Albedo").c_str(), atlasSize, atlasSize);
+    impostor.normalDepthTextureIdx = TextureSupport::CreateEmptyColorTexture_16Bit_F_RGBA(app, (name + " Normal Depth").c_str(), atlasSize, atlasSize);
+    const u32 depthTextureIdx = TextureSupport::CreateEmptyDepthTexture(app, (name + " Depth").c_str(), atlasSize, atlasSize);
+    app->textures[impostor.albedoTextureIdx].screenScale = 0.0f;
+    app->textures[impostor.normalDepthTextureIdx].screenScale = 0.0f;
+    app->textures[depthTextureIdx].screenScale = 0.0f;
+
+    const Buffer frameBuffer = FrameBufferManagement::CreateFrameBuffer();
+    FrameBufferManagement::BindFrameBuffer(frameBuffer);
+    FrameBufferManagement::SetColorAttachment(frameBuffer, app->textures[impostor.albedoTextureIdx].handle, 0);
+    FrameBufferManagement::SetColorAttachment(frameBuffer, app->textures[impostor.normalDepthTextureIdx].handle, 1);
+    FrameBufferManagement::SetDepthAttachment(frameBuffer, app->textures[depthTextureIdx].handle);
+    FrameBufferManagement::CheckStatus();
+    FrameBufferManagement::SetDrawBuffersTextures({ 0, 1 });
+
+    glViewport(0, 0, atlasSize, atlasSize);
+    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    glEnable(GL_DEPTH_TEST);
+    glDisable(GL_BLEND);
+
+    const Program& program = app->programs[app->impostorBakeProgramIdx];
+    glUseProgram(program.handle);
+    const GLint viewLocation = glGetUniformLocation(program.handle, "uBakeView");
+    const GLint projectionLocation = glGetUniformLocation(program.handle, "uBakeProjection");
+    const GLint albedoLocation = glGetUniformLocation(program.handle, "uAlbedo");
+    const GLint hasAlbedoTextureLocation = glGetUniformLocation(program.handle, "uHasAlbedoTexture");
+
+    // Orthographic view of the bounding sphere, depth goes from 0 (front of the sphere) to 1 (back of the sphere)
+    const glm::mat4 projection = glm::ortho(-impostor.radius, impostor.radius, -impostor.radius, impostor.radius, 0.0f, 2.0f * impostor.radius);
+    glUniformMatrix4fv(projectionLocation, 1, GL_FALSE, glm::value_ptr(projection));
+
+    // The bake reads the albedo once, it can not wait for the textures still streaming in
+    for (const u32 materialIdx : model.materialIdx)
+        if (app->textures[app->materials[materialIdx].albedoTextureIdx].streaming)
+            TextureStreamingSupport::WaitForTexture(app, app->materials[materialIdx].albedoTextureIdx);
+
+    for (u32 y = 0; y < framesPerSide; ++y)
+    {
+        for (u32 x = 0; x < framesPerSide; ++x)
+        {
+            // Frame (x, y) looks at the model from the direction at the center of its cell
+            const glm::vec3 direction = HemiOctahedronDecode(glm::vec2((x + 0.5f) / framesPerSide, (y + 0.5f) / framesPerSide));
+            const glm::vec3 up = glm::abs(direction.y) > 0.999f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+            const glm::mat4 view = glm::lookAt(impostor.center + direction * impostor.radius, impostor.center, up);
+            glUniformMatrix4fv(viewLocation, 1, GL_FALSE, glm::value_ptr(view));
+
+            glViewport(x * frameResolution, y * frameResolution, frameResolution, frameResolution);
+
+            const u32 subMeshCount = static_cast<u32>(mesh.subMeshes.size());
+            for (u32 i = 0; i < subMeshCount; ++i)
+            {
+                const Material& material = app->materials[model.materialIdx[i]];
+                glUniform3fv(albedoLocation, 1, glm::value_ptr(material.albedo));
+                glUniform1i(hasAlbedoTextureLocation, material.albedoTextureIdx != 0);
+                const std::vector<u32> textureHandles = { app->textures[material.albedoTextureIdx].handle };
+                const std::vector<u32> textureUnits = { MAT_T_DIFFUSE }; // The sampler is bound to the unit in the shader
+                mesh.DrawSubMesh(i, textureHandles, textureUnits, program, false);
+            }
+        }
+    }
+
+    // Only the albedo is filtered, normal and depth are sampled from the base level
+    glBindTexture(GL_TEXTURE_2D, app->textures[impostor.albedoTextureIdx].handle);
+    glGenerateMipmap(GL_TEXTURE_2D);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    app->textures[impostor.albedoTextureIdx].mipmapped = true;
+
+    FrameBufferManagement::UnBindFrameBuffer(frameBuffer);
+    FrameBufferManagement::DeleteFrameBuffer(frameBuffer);
+    glViewport(0, 0, app->displaySizeCurrent.x, app->displaySizeCurrent.y);
+    glEnable(GL_BLEND);
+
+    const u32 impostorIdx = static_cast<u32>(app->impostors.size());
+    app->impostors.push_back(impostor);
+    model.impostorIdx = impostorIdx;
+
+    glPopDebugGroup();
+    return impostorIdx;
+}
+
+bool ImpostorSupport::UseImpostor(const App* app, const Entity& entity)
+{
+    if (!app->useImpostors)
+        return false;
+    if (app->models[entity.modelIndex].impostorIdx == UINT32_MAX)
+        return false;
+
+    const glm::vec3 entityPosition = glm::vec3(entity.worldMatrix[3]);
+    return glm::distance(entityPosition, app->camera.position) > app->impostorDistance;
+}
+
+void ImpostorSupport::RenderImpostors(App* app)
+{
+    glPushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, 1, -1, "Impostors");
+
+    const Program& program = app->programs[app->impostorProgramIdx];
+    glUseProgram(program.handle);
+    const GLint worldMatrixLocation = glGetUniformLocation(program.handle, "uImpostorWorldMatrix");
+    const GLint centerRadiusLocation = glGetUniformLocation(program.handle, "uImpostorCenterRadius");
+    const GLint framesPerSideLocation = glGetUniformLocation(program.handle, "uImpostorFramesPerSide");
+    const GLint prevWorldViewProjectionLocation = glGetUniformLocation(program.handle, "uImpostorPrevWorldViewProjection");
+
+    Model& quadModel = app->models[app->quadModel];
+    Mesh& quadMesh = app->meshes[quadModel.meshIdx];
+
+    app->impostorsDrawn = 0;
+    for (const std::shared_ptr<Entity>& entityPtr : app->entities)
+    {
+        const Entity& entity = *entityPtr;
+        if (!UseImpostor(app, entity))
+            continue;
+
+        const Impostor& impostor = app->impostors[app->models[entity.modelIndex].impostorIdx];
+        glUniformMatrix4fv(worldMatrixLocation, 1, GL_FALSE, glm::value_ptr(entity.worldMatrix));
+        glUniform4f(centerRadiusLocation, impostor.center.x, impostor.center.y, impostor.center.z, impostor.radius);
+        glUniform1f(framesPerSideLocation, static_cast<f32>(impostor.framesPerSide));
+        glUniformMatrix4fv(prevWorldViewProjectionLocation, 1, GL_FALSE, glm::value_ptr(entity.prevWorldViewProjectionMat));
+
+        quadMesh.DrawSubMesh(0, { app->textures[impostor.albedoTextureIdx].handle, app->textures[impostor.normalDepthTextureIdx].handle },
+            { MAT_T_DIFFUSE, MAT_T_NORMALS }, program, false);
+        ++app->impostorsDrawn;
+    }
+
+    glPopDebugGroup();
+}
@@ -0,0 +1,41 @@
+﻿#ifndef IMPOSTOR_H
+#define IMPOSTOR_H
+#include "platform.h"
+
+struct App;
+struct Entity;
+
+/// <summary>
+/// Octahedral impostor of a model. The model is baked from a hemisphere of directions into a grid of frames,
+/// each frame stores albedo and normal + depth. Far entities draw a single quad sampling the closest frame.
+/// </summary>
+/// <param name="framesPerSide">Frames per side of the hemi-octahedral grid.</param>
+/// <param name="center/radius">Local space bounding sphere of the model, the frames are orthographic views of it.</param>
+struct Impostor
+{
+    u32 modelIdx;
+    u32 albedoTextureIdx;
+    u32 normalDepthTextureIdx;
+    u32 framesPerSide;
+    u32 frameResolution;
+    glm::vec3 center;
+    f32 radius;
+};
+
+struct ImpostorSupport
+{
+    // Renders the model into the atlas and links it to the model, returns the impostor index
+    static u32 BakeImpostor(App* app, u32 modelIdx, u32 framesPerSide = 8, u32 frameResolution = 128);
+
+    // True when the entity is far enough to be drawn as an impostor
+    static bool UseImpostor(const App* app, const Entity& entity);
+
+    // Draws the impostors of far entities into the currently bound G-buffer
+    static void RenderImpostors(App* app);
+
+    // Hemi-octahedral mapping (y up) between directions and the [0, 1] frame grid
+    static glm::vec2 HemiOctahedronEncode(glm::vec3 direction);
+    static glm::vec3 HemiOctahedronDecode(glm::vec2 uv);
+};
+
+#endif // IMPOSTOR_H
@@ -0,0 +1,215 @@
+﻿#include "json_parser.h"
+
+#include <cctype>
+#include <cstdlib>
+
+static const JsonValue jsonNull = {};
+
+const JsonValue& JsonValue::operator[](const char* key) const
+{
+    if (type == JsonType::JSON_OBJECT)
+    {
+        for (const std::pair<std::string, JsonValue>& member : members)
+            if (member.first == key)
+                return member.second;
+    }
+    return jsonNull;
+}
+
+const JsonValue& JsonValue::operator[](const u32 index) const
+{
+    return type == JsonType::JSON_ARRAY && index < elements.size() ? elements[index] : jsonNull;
+}
+
+// Recursive descent parser over the whole text
+struct JsonParser
+{
+    const char* c;
+    const char* begin;
+    const char* end;
+
+    void SkipSpaces()
+    {
+        while (c < end && (*c == ' ' || *c == '\t' || *c == '\n' || *c == '\r'))
+            ++c;
+    }
+
+    bool Expect(const char* literal)
+    {
+        for (; *literal; ++literal, ++c)
+            if (c >= end || *c != *literal)
+                return false;
+        return true;
+    }
+
+    static void AppendUtf8(std::string& str, const u32 codePoint)
+    {
+        if (codePoint < 0x80)
+            str += static_cast<char>(codePoint);
+        else if (codePoint < 0x800)
+        {
+            str += static_cast<char>(0xC0 | (codePoint >> 6));
+            str += static_cast<char>(0x80 | (codePoint & 0x3F));
+        }
+        else
+        {
+            str += static_cast<char>(0xE0 | (codePoint >> 12));
+            str += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+            str += static_cast<char>(0x80 | (codePoint & 0x3F));
+        }
+    }
+
+    bool ParseString(std::string& str)
+    {
+        if (c >= end || *c != '"')
+            return false;
+        for (++c; c < end && *c != '"'; ++c)
+        {
+            if (*c != '\\')
+            {
+                str += *c;
+                continue;
+            }
+            if (++c >= end)
+                return false;
+            switch (*c)
+            {
+            case 'b': str += '\b'; break;
+            case 'f': str += '\f'; break;
+            case 'n': str += '\n'; break;
+            case 'r': str += '\r'; break;
+            case 't': str += '\t'; break;
+            case 'u':
+            {
+                if (end - c < 5)
+                    return false;
+                const std::string hex(c + 1, c + 5);
+                AppendUtf8(str, static_cast<u32>(strtoul(hex.c_str(), nullptr, 16)));
+                c += 4;
+                break;
+            }
+            default: str += *c; break; // \\ \" \/
+            }
+        }
+        if (c >= end)
+            return false;
+        ++c;
+        return true;
+    }
+
+    bool ParseValue(JsonValue& value)
+    {
+        SkipSpaces();
+        if (c >= end)
+            return false;
+
+        switch (*c)
+        {
+        case '{':
+        {
+            value.type = JsonType::JSON_OBJECT;
+            ++c;
+            SkipSpaces();
+            if (c < end && *c == '}')
+            {
+                ++c;
+                return true;
+            }
+            while (true)
+            {
+                SkipSpaces();
+                value.members.emplace_back();
+                if (!ParseString(value.members.back().first))
+                    return false;
+                SkipSpaces();
+                if (c >= end || *c++ != ':')
+                    return false;
+                if (!ParseValue(value.members.back().second))
+                    return false;
+                SkipSpaces();
+                if (c < end && *c == ',')
+                {
+                    ++c;
+                    continue;
+                }
+                if (c < end && *c == '}')
+                {
+                    ++c;
+                    return true;
+                }
+                return false;
+            }
+        }
+        case '[':
+        {
+            value.type = JsonType::JSON_ARRAY;
+            ++c;
+            SkipSpaces();
+            if (c < end && *c == ']')
+            {
+                ++c;
+                return true;
+            }
+            while (true)
+            {
+                value.elements.emplace_back();
+                if (!ParseValue(value.elements.back()))
+                    return false;
+                SkipSpaces();
+                if (c < end && *c == ',')
+                {
+                    ++c;
+                    continue;
+                }
+                if (c < end && *c == ']')
+                {
+                    ++c;
+                    return true;
+                }
+                return false;
+            }
+        }
+        case '"':
+            value.type = JsonType::JSON_STRING;
+            return ParseString(value.string);
+        case 't':
+            value.type = JsonType::JSON_BOOL;
+            value.boolean = true;
+            return Expect("true");
+        case 'f':
+            value.type = JsonType::JSON_BOOL;
+            value.boolean = false;
+            return Expect("false");
+        case 'n':
+            value.type = JsonType::JSON_NULL;
+            return Expect("null");
+        default:
+        {
+            // strtod needs a terminated string, numbers are short so they are copied
+            const char* numberEnd = c;
+            while (numberEnd < end && (isdigit(static_cast<u8>(*numberEnd)) || *numberEnd == '-' || *numberEnd == '+' || *numberEnd == '.' || *numberEnd == 'e' || *numberEnd == 'E'))
+                ++numberEnd;
+            if (numberEnd == c)
+                return false;
+            const std::string number(c, numberEnd);
+            value.type = JsonType::JSON_NUMBER;
+            value.number = strtod(number.c_str(), nullptr);
+            c = numberEnd;
+            return true;
+        }
+        }
+    }
+};
+
+bool JsonSupport::Parse(const char* text, const u64 length, JsonValue& root)
+{
+    JsonParser parser = { text, text, text + length };
+    root = {};
+    if (!parser.ParseValue(root))
+    {
+        ELOG("JSON parse error at character %llu", static_cast<u64>(parser.c - parser.begin))
+        root = {};
+        return false;
+    }
+    return true;
+}
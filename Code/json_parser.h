@@ -0,0 +1,48 @@
+﻿#ifndef JSON_PARSER_H
+#define JSON_PARSER_H
+#include <vector>
+
+#include "platform.h"
+
+enum class JsonType
+{
+    JSON_NULL,
+    JSON_BOOL,
+    JSON_NUMBER,
+    JSON_STRING,
+    JSON_ARRAY,
+    JSON_OBJECT
+};
+
+/// <summary>
+/// Small DOM for the JSON documents of the engine assets (e.g. glTF). Missing members and out of range
+/// elements return a null value, so optional properties can be read without checks.
+/// </summary>
+struct JsonValue
+{
+    JsonType type = JsonType::JSON_NULL;
+    bool boolean = false;
+    f64 number = 0.0;
+    std::string string;
+    std::vector<JsonValue> elements;
+    std::vector<std::pair<std::string, JsonValue>> members;
+
+    bool IsNull() const { return type == JsonType::JSON_NULL; }
+    u32 Size() const { return static_cast<u32>(type == JsonType::JSON_ARRAY ? elements.size() : members.size()); }
+
+    const JsonValue& operator[](const char* key) const;
+    const JsonValue& operator[](u32 index) const;
+
+    f64 AsNumber(f64 defaultValue = 0.0) const { return type == JsonType::JSON_NUMBER ? number : defaultValue; }
+    i32 AsInt(i32 defaultValue = -1) const { return type == JsonType::JSON_NUMBER ? static_cast<i32>(number) : defaultValue; }
+    bool AsBool(bool defaultValue = false) const { return type == JsonType::JSON_BOOL ? boolean : defaultValue; }
+    const std::string& AsString() const { return string; }
+};
+
+struct JsonSupport
+{
+    // Returns false and logs the position of the error if the text is not valid JSON
+    static bool Parse(const char* text, u64 length, JsonValue& root);
+};
+
+#endif // JSON_PARSER_H
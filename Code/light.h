@@ -1,6 +1,7 @@
 ﻿#ifndef LIGHT_H
 #define LIGHT_H
 #include "platform.h"
+#include "entity.h"
 
 enum class LightType
 {
@@ -33,4 +34,15 @@ static const char* LightTypeNames[] =
     "DIRECTIONAL",
     "POINT",
     };
+
+// How the deferred shading gathers the lights
+enum class LightingMode
+{
+    FULLSCREEN, // Every pixel loops over GlobalParams::uLight
+    CLUSTERED, // See ClusteredLighting
+    LIGHT_VOLUMES, // See LightVolumes
+    COUNT
+};
+
+static const char* LightingModeStr[] = { "FULLSCREEN", "CLUSTERED", "LIGHT VOLUMES" };
 #endif // LIGHT_H
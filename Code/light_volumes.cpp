@@ -0,0 +1,177 @@
+﻿#include "light_volumes.h"
+
+#include "app.h"
+
+void LightVolumesSupport::Init(App* app)
+{
+    LightVolumes& volumes = app->lightVolumes;
+    volumes.stencilProgramIdx = ShaderSupport::LoadProgram(app, "Shaders\\shader_deferred_light_volume.vert", "Shaders\\shader_deferred_light_stencil.frag", "DEFERRED_LIGHT_STENCIL");
+    volumes.lightProgramIdx = ShaderSupport::LoadProgram(app, "Shaders\\shader_deferred_light_volume.vert", "Shaders\\shader_deferred_light_volume.frag", "DEFERRED_LIGHT_VOLUME");
+}
+
+void LightVolumesSupport::RenderLightVolumes(App* app)
+{
+    LightVolumes& volumes = app->lightVolumes;
+    const ClusteredLighting& clustered = app->clusteredLighting;
+    volumes.drawnVolumes = 0;
+    volumes.culledVolumes = 0;
+    if (volumes.sphereModelIdx == UINT32_MAX)
+        return;
+
+    glPushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, 1, -1, "Engine Deferred Render Light Volumes");
+
+    // Final result and depth stencil are shared by both G-buffer layouts
+    FrameBufferManagement::BindFrameBuffer(app->frameBufferObject);
+    const std::vector<u32> attachments = { RT_LOCATION_FINAL_RESULT };
+    FrameBufferManagement::SetDrawBuffersTextures(attachments);
+    glViewport(0, 0, app->displaySizeCurrent.x, app->displaySizeCurrent.y);
+
+    BufferManagement::BindBufferRange(app->uniformBuffer, STD_140_BINDING_POINT::BP_GLOBAL_PARAMS, app->globalParamsSize, app->globalParamsOffset);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, STD_430_BINDING_POINT::BP_CLUSTER_LIGHTS, clustered.lightBuffer);
+
+    const bool compactGBuffer = app->gBufferLayout == GBufferLayout::COMPACT;
+    const std::vector<u32> texturesUniformLocations = compactGBuffer ?
+        std::vector<u32>{ RT_LOCATION_COLOR, CG_BINDING_NORMAL_TANGENT, CG_BINDING_MASKS, CG_BINDING_DEPTH } :
+        std::vector<u32>{ RT_LOCATION_COLOR, RT_LOCATION_POSITION_WORLD_SPACE, RT_LOCATION_NORMAL, RT_LOCATION_SPECULAR_ROUGHNESS };
+    const std::vector<u32> texturesUniformHandles = compactGBuffer ?
+        std::vector<u32>{ app->textures[app->gColorTextureIdx].handle, app->textures[app->gNormalTangentTextureIdx].handle,
+            app->textures[app->gMasksTextureIdx].handle, app->textures[app->gDepthTextureIdx].handle } :
+        std::vector<u32>{ app->textures[app->gColorTextureIdx].handle, app->textures[app->gPositionTextureIdx].handle,
+            app->textures[app->gNormalTextureIdx].handle, app->textures[app->gSpecularTextureIdx].handle };
+    for (u32 i = 0; i < texturesUniformLocations.size(); ++i)
+    {
+        glActiveTexture(GL_TEXTURE0 + texturesUniformLocations[i]);
+        glBindTexture(GL_TEXTURE_2D, texturesUniformHandles[i]);
+    }
+
+    const glm::mat4 viewProjection = app->projectionMat * app->camera.GetViewMatrix();
+    const glm::mat4 inverseViewProjection = glm::inverse(viewProjection);
+    const Program& stencilProgram = app->programs[volumes.stencilProgramIdx];
+    const Program& lightProgram = app->programs[volumes.lightProgramIdx];
+    const GLint stencilLightIndexLocation = glGetUniformLocation(stencilProgram.handle, "uLightIndex");
+    const GLint lightLightIndexLocation = glGetUniformLocation(lightProgram.handle, "uLightIndex");
+    glUseProgram(stencilProgram.handle);
+    glUniform1f(glGetUniformLocation(stencilProgram.handle, "uVolumeScale"), LIGHT_VOLUME_SPHERE_SCALE);
+    glUseProgram(lightProgram.handle);
+    glUniform1f(glGetUniformLocation(lightProgram.handle, "uVolumeScale"), LIGHT_VOLUME_SPHERE_SCALE);
+    glUniform1i(glGetUniformLocation(lightProgram.handle, "uCompactGBuffer"), compactGBuffer ? 1 : 0);
+    glUniformMatrix4fv(glGetUniformLocation(lightProgram.handle, "uInverseViewProjection"), 1, GL_FALSE, glm::value_ptr(inverseViewProjection));
+
+    Mesh& mesh = app->meshes[app->models[volumes.sphereModelIdx].meshIdx];
+    const SubMesh& subMesh = mesh.subMeshes[0];
+    const GLuint stencilVAO = VAOSupport::FindVAO(mesh, 0, stencilProgram);
+    const GLuint lightVAO = VAOSupport::FindVAO(mesh, 0, lightProgram);
+    const GLsizei indexCount = static_cast<GLsizei>(subMesh.indexCount);
+    const void* indexOffset = reinterpret_cast<void*>(static_cast<u64>(subMesh.indexOffset));
+
+    glm::vec4 frustumPlanes[6];
+    MeshletSupport::ExtractFrustumPlanes(viewProjection, frustumPlanes);
+
+    glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+    glEnable(GL_STENCIL_TEST);
+    glDepthMask(GL_FALSE);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_ONE, GL_ONE);
+    glEnable(GL_CULL_FACE);
+
+    const u32 lightCount = static_cast<u32>(clustered.lights.size());
+    for (u32 l = 0; l < lightCount; ++l)
+    {
+        const ClusterLight& light = clustered.lights[l];
+        if (static_cast<LightType>(static_cast<u32>(light.colorType.w)) != LightType::POINT)
+            continue;
+
+        const glm::vec3 center = glm::vec3(light.positionRadius);
+        const f32 radius = light.positionRadius.w * LIGHT_VOLUME_SPHERE_SCALE;
+        bool outside = false;
+        for (u32 p = 0; p < 6 && !outside; ++p)
+            outside = glm::dot(glm::vec3(frustumPlanes[p]), center) + frustumPlanes[p].w < -radius;
+        if (outside)
+        {
+            ++volumes.culledVolumes;
+            continue;
+        }
+
+        // Marks the pixels whose surface is inside the sphere, both faces are depth tested against the G-buffer depth
+        glUseProgram(stencilProgram.handle);
+        glUniform1ui(stencilLightIndexLocation, l);
+        glBindVertexArray(stencilVAO);
+        glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+        glEnable(GL_DEPTH_TEST);
+        glDisable(GL_CULL_FACE);
+        glStencilFunc(GL_ALWAYS, 0, 0xFF);
+        glStencilOpSeparate(GL_BACK, GL_KEEP, GL_INCR_WRAP, GL_KEEP);
+        glStencilOpSeparate(GL_FRONT, GL_KEEP, GL_DECR_WRAP, GL_KEEP);
+        glDrawElements(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, indexOffset);
+
+        // Back faces still cover the marked pixels with the camera inside the sphere. Shaded pixels go back to 0 for the next light
+        glUseProgram(lightProgram.handle);
+        glUniform1ui(lightLightIndexLocation, l);
+        glBindVertexArray(lightVAO);
+        glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+        glDisable(GL_DEPTH_TEST);
+        glEnable(GL_CULL_FACE);
+        glCullFace(GL_FRONT);
+        glStencilFunc(GL_NOTEQUAL, 0, 0xFF);
+        glStencilOp(GL_KEEP, GL_KEEP, GL_ZERO);
+        glDrawElements(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, indexOffset);
+
+        ++volumes.drawnVolumes;
+    }
+
+    glBindVertexArray(0);
+    glCullFace(GL_BACK);
+    glDisable(GL_CULL_FACE);
+    glDisable(GL_STENCIL_TEST);
+    glEnable(GL_DEPTH_TEST);
+    glDepthMask(GL_TRUE);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+    FrameBufferManagement::UnBindFrameBuffer(app->frameBufferObject);
+    glPopDebugGroup();
+}
+
+void LightVolumesSupport::StartBenchmark(App* app)
+{
+    LightingBenchmark& benchmark = app->lightVolumes.benchmark;
+    if (benchmark.running)
+        return;
+
+    benchmark.running = true;
+    benchmark.modeIdx = 0;
+    benchmark.frame = 0;
+    benchmark.sumMs = 0.0;
+    benchmark.restoreMode = app->lightingMode;
+    benchmark.lightCount = static_cast<u32>(app->clusteredLighting.lights.size());
+    app->lightingMode = static_cast<LightingMode>(benchmark.modeIdx);
+}
+
+void LightVolumesSupport::UpdateBenchmark(App* app)
+{
+    LightingBenchmark& benchmark = app->lightVolumes.benchmark;
+    if (!benchmark.running)
+        return;
+
+    // The reading of the previous frame, the warmup frames still return the times of the previous mode
+    if (benchmark.frame >= LIGHTING_BENCHMARK_WARMUP_FRAMES)
+        benchmark.sumMs += app->lightingTimer.lastMs;
+    ++benchmark.frame;
+    if (benchmark.frame < LIGHTING_BENCHMARK_WARMUP_FRAMES + LIGHTING_BENCHMARK_FRAMES)
+        return;
+
+    benchmark.resultsMs[benchmark.modeIdx] = benchmark.sumMs / LIGHTING_BENCHMARK_FRAMES;
+    benchmark.frame = 0;
+    benchmark.sumMs = 0.0;
+    if (++benchmark.modeIdx < static_cast<u32>(LightingMode::COUNT))
+    {
+        app->lightingMode = static_cast<LightingMode>(benchmark.modeIdx);
+        return;
+    }
+
+    benchmark.running = false;
+    benchmark.hasResults = true;
+    app->lightingMode = benchmark.restoreMode;
+    ILOG("Lighting benchmark, %u lights at %dx%d: fullscreen %.3f ms (first %u lights only), clustered %.3f ms, light volumes %.3f ms",
+        benchmark.lightCount, app->displaySizeCurrent.x, app->displaySizeCurrent.y, benchmark.resultsMs[0], FORWARD_MAX_LIGHTS,
+        benchmark.resultsMs[1], benchmark.resultsMs[2])
+}
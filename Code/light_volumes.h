@@ -0,0 +1,58 @@
+﻿#ifndef LIGHT_VOLUMES_H
+#define LIGHT_VOLUMES_H
+
+#include "platform.h"
+#include "light.h"
+
+struct App;
+
+#define LIGHT_VOLUME_SPHERE_SCALE 1.05f // The sphere mesh is inscribed in the unit sphere, its faces sit up to ~1.5% inside it
+#define LIGHTING_BENCHMARK_WARMUP_FRAMES 8 // Covers the GpuTimer readback latency after a mode switch
+#define LIGHTING_BENCHMARK_FRAMES 120
+
+struct LightingBenchmark
+{
+    bool running = false;
+    u32 modeIdx = 0;
+    u32 frame = 0;
+    f64 sumMs = 0.0;
+    LightingMode restoreMode = LightingMode::CLUSTERED;
+
+    // Last run
+    bool hasResults = false;
+    u32 lightCount = 0;
+    f64 resultsMs[static_cast<u32>(LightingMode::COUNT)] = {};
+};
+
+/// <summary>
+/// Point lights drawn as spheres of their attenuation radius over the result of the shading pass, which then only shades the
+/// ambient and the directional lights. Per light a stencil pass marks the pixels whose surface lies inside the sphere (back
+/// faces behind the surface increment, front faces behind it decrement, so pixels in front of or behind the volume stay at 0)
+/// and an additive pass shades those pixels and resets their stencil, so no clear is needed between lights.
+/// </summary>
+struct LightVolumes
+{
+    u32 stencilProgramIdx = 0;
+    u32 lightProgramIdx = 0;
+    u32 sphereModelIdx = UINT32_MAX; // Set once the primitives are loaded
+
+    // Stats
+    u32 drawnVolumes = 0;
+    u32 culledVolumes = 0;
+
+    LightingBenchmark benchmark;
+};
+
+struct LightVolumesSupport
+{
+    static void Init(App* app);
+
+    // Additive pass after the shading pass, reads the light buffer of the clustered lighting
+    static void RenderLightVolumes(App* app);
+
+    // Times the lighting of every mode over LIGHTING_BENCHMARK_FRAMES frames and logs the averages
+    static void StartBenchmark(App* app);
+    static void UpdateBenchmark(App* app);
+};
+
+#endif // LIGHT_VOLUMES_H
@@ -0,0 +1,564 @@
+﻿#include "material_batching.h"
+
+#include <algorithm>
+#include <GLFW/glfw3.h>
+
+#include "app.h"
+#include "meshlet.h"
+
+#define MATERIAL_TEXTURE_NONE glm::uvec2(~0u)
+
+// GL_ARB_bindless_texture entry points, glad is generated for the core profile only
+typedef GLuint64 (APIENTRY* GetTextureHandleProc)(GLuint texture);
+typedef void (APIENTRY* MakeTextureHandleResidentProc)(GLuint64 handle);
+typedef void (APIENTRY* MakeTextureHandleNonResidentProc)(GLuint64 handle);
+
+static GetTextureHandleProc GetTextureHandle = nullptr;
+static MakeTextureHandleResidentProc MakeTextureHandleResident = nullptr;
+static MakeTextureHandleNonResidentProc MakeTextureHandleNonResident = nullptr;
+
+static bool LoadBindlessTextureFunctions()
+{
+    bool extensionFound = false;
+    GLint extensionCount = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &extensionCount);
+    for (GLint e = 0; e < extensionCount; ++e)
+        if (strcmp(reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, e)), "GL_ARB_bindless_texture") == 0)
+            extensionFound = true;
+    if (!extensionFound)
+        return false;
+
+    GetTextureHandle = reinterpret_cast<GetTextureHandleProc>(glfwGetProcAddress("glGetTextureHandleARB"));
+    MakeTextureHandleResident = reinterpret_cast<MakeTextureHandleResidentProc>(glfwGetProcAddress("glMakeTextureHandleResidentARB"));
+    MakeTextureHandleNonResident = reinterpret_cast<MakeTextureHandleNonResidentProc>(glfwGetProcAddress("glMakeTextureHandleNonResidentARB"));
+    return GetTextureHandle && MakeTextureHandleResident && MakeTextureHandleNonResident;
+}
+
+static void ReleaseMaterialTextures(MaterialBatching& batching)
+{
+    for (const MaterialTextureArray& textureArray : batching.textureArrays)
+        glDeleteTextures(1, &textureArray.handle);
+    batching.textureArrays.clear();
+    batching.textureArrayBytes = 0;
+
+    for (const GLuint64 handle : batching.residentHandles)
+        MakeTextureHandleNonResident(handle);
+    batching.residentHandles.clear();
+
+    batching.textureRefs.clear();
+    batching.ready = false;
+}
+
+// Places the texture in the array of its size/format, the arrays are filled once all the layers are known
+static bool AddToTextureArray(MaterialBatching& batching, const GLuint textureHandle, glm::uvec2& textureRef)
+{
+    glBindTexture(GL_TEXTURE_2D, textureHandle);
+    GLint width, height, internalFormat, compressed, immutableLevels;
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &width);
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &height);
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_INTERNAL_FORMAT, &internalFormat);
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_COMPRESSED, &compressed);
+    glGetTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_IMMUTABLE_LEVELS, &immutableLevels);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    // Mutable textures may have an incomplete mip chain, glCopyImageSubData needs every level
+    if (immutableLevels == 0)
+    {
+        ELOG("Material batching: texture %u (%dx%d) has mutable storage and can't be copied into a texture array", textureHandle, width, height)
+        return false;
+    }
+
+    const ivec2 size = ivec2(width, height);
+    for (u32 a = 0; a < batching.textureArrays.size(); ++a)
+    {
+        MaterialTextureArray& textureArray = batching.textureArrays[a];
+        if (textureArray.size == size && textureArray.internalFormat == static_cast<GLenum>(internalFormat) && textureArray.mipLevels == static_cast<u32>(immutableLevels))
+        {
+            textureRef = glm::uvec2(a, static_cast<u32>(textureArray.layers.size()));
+            textureArray.layers.push_back(textureHandle);
+            return true;
+        }
+    }
+
+    if (batching.textureArrays.size() == MATERIAL_BATCHING_MAX_TEXTURE_ARRAYS)
+    {
+        ELOG("Material batching: no texture array left for texture %u (%dx%d, format 0x%X, %d mips), the %u arrays are taken", textureHandle, width, height,
+            internalFormat, immutableLevels, MATERIAL_BATCHING_MAX_TEXTURE_ARRAYS)
+        return false;
+    }
+
+    MaterialTextureArray textureArray;
+    textureArray.size = size;
+    textureArray.internalFormat = static_cast<GLenum>(internalFormat);
+    textureArray.mipLevels = static_cast<u32>(immutableLevels);
+    textureArray.compressed = compressed != GL_FALSE;
+    textureArray.layers.push_back(textureHandle);
+    textureRef = glm::uvec2(static_cast<u32>(batching.textureArrays.size()), 0);
+    batching.textureArrays.push_back(textureArray);
+    return true;
+}
+
+static void CreateTextureArrays(MaterialBatching& batching)
+{
+    for (MaterialTextureArray& textureArray : batching.textureArrays)
+    {
+        const GLsizei layerCount = static_cast<GLsizei>(textureArray.layers.size());
+        glGenTextures(1, &textureArray.handle);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, textureArray.handle);
+        glTexStorage3D(GL_TEXTURE_2D_ARRAY, static_cast<GLsizei>(textureArray.mipLevels), textureArray.internalFormat, textureArray.size.x, textureArray.size.y, layerCount);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+
+        // GPU side copies, the source textures stay for the forward path and the resources GUI
+        for (GLsizei layer = 0; layer < layerCount; ++layer)
+        {
+            for (u32 level = 0; level < textureArray.mipLevels; ++level)
+            {
+                const GLsizei levelWidth = std::max(textureArray.size.x >> level, 1);
+                const GLsizei levelHeight = std::max(textureArray.size.y >> level, 1);
+                glCopyImageSubData(textureArray.layers[layer], GL_TEXTURE_2D, static_cast<GLint>(level), 0, 0, 0,
+                    textureArray.handle, GL_TEXTURE_2D_ARRAY, static_cast<GLint>(level), 0, 0, layer, levelWidth, levelHeight, 1);
+            }
+        }
+
+        for (u32 level = 0; level < textureArray.mipLevels; ++level)
+        {
+            if (textureArray.compressed)
+            {
+                GLint levelBytes = 0;
+                glGetTexLevelParameteriv(GL_TEXTURE_2D_ARRAY, static_cast<GLint>(level), GL_TEXTURE_COMPRESSED_IMAGE_SIZE, &levelBytes);
+                batching.textureArrayBytes += static_cast<u64>(levelBytes);
+            }
+            else
+            {
+                // Uncompressed material textures are RGB8/RGBA8, drivers keep both at 4 bytes per texel
+                batching.textureArrayBytes += static_cast<u64>(std::max(textureArray.size.x >> level, 1)) * std::max(textureArray.size.y >> level, 1) * layerCount * 4;
+            }
+        }
+    }
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+}
+
+static glm::uvec2 GetBindlessTextureRef(MaterialBatching& batching, const GLuint textureHandle)
+{
+    const GLuint64 handle = GetTextureHandle(textureHandle);
+    if (std::find(batching.residentHandles.begin(), batching.residentHandles.end(), handle) == batching.residentHandles.end())
+    {
+        MakeTextureHandleResident(handle);
+        batching.residentHandles.push_back(handle);
+    }
+    return glm::uvec2(static_cast<u32>(handle & 0xFFFFFFFFu), static_cast<u32>(handle >> 32));
+}
+
+static void BuildMaterialTextures(App* app)
+{
+    MaterialBatching& batching = app->materialBatching;
+    ReleaseMaterialTextures(batching);
+
+    batching.builtWithBindless = batching.bindlessSupported && batching.useBindless;
+    batching.builtTextureCount = static_cast<u32>(app->textures.size());
+    batching.builtMaterialCount = static_cast<u32>(app->materials.size());
+    batching.dirtyTextures.clear();
+    batching.rebuildTextureArrays = false;
+    batching.texturesUnplaced = false;
+    batching.textureRefs.assign(app->textures.size(), MATERIAL_TEXTURE_NONE);
+
+    bool allTexturesPlaced = true;
+    for (const Material& material : app->materials)
+    {
+        for (const u32 textureIdx : { material.albedoTextureIdx, material.normalsTextureIdx, material.masksTextureIdx, material.coneStepTextureIdx })
+        {
+            if (textureIdx == 0 || batching.textureRefs[textureIdx] != MATERIAL_TEXTURE_NONE)
+                continue;
+
+            const GLuint textureHandle = app->textures[textureIdx].handle;
+            if (batching.builtWithBindless)
+            {
+                batching.textureRefs[textureIdx] = GetBindlessTextureRef(batching, textureHandle);
+                continue;
+            }
+
+            // Textures shared by several materials (or slots sharing the default handle) take a single layer
+            bool layerFound = false;
+            for (u32 a = 0; a < batching.textureArrays.size() && !layerFound; ++a)
+            {
+                const std::vector<GLuint>& layers = batching.textureArrays[a].layers;
+                const auto it = std::find(layers.begin(), layers.end(), textureHandle);
+                if (it != layers.end())
+                {
+                    batching.textureRefs[textureIdx] = glm::uvec2(a, static_cast<u32>(it - layers.begin()));
+                    layerFound = true;
+                }
+            }
+            if (!layerFound && !AddToTextureArray(batching, textureHandle, batching.textureRefs[textureIdx]))
+                allTexturesPlaced = false;
+        }
+    }
+
+    if (!allTexturesPlaced)
+    {
+        ELOG("Material batching disabled: the material textures need more than %u texture arrays or have mutable storage, the geometry pass falls back to the per subMesh draws", MATERIAL_BATCHING_MAX_TEXTURE_ARRAYS)
+        batching.textureArrays.clear();
+        batching.texturesUnplaced = true;
+        return;
+    }
+
+    if (!batching.builtWithBindless)
+        CreateTextureArrays(batching);
+
+    // Source of the instanced material attribute, a command reads its entry at the base instance
+    std::vector<u32> materialIndices(app->materials.size());
+    for (u32 m = 0; m < materialIndices.size(); ++m)
+        materialIndices[m] = m;
+    glBindBuffer(GL_ARRAY_BUFFER, batching.materialIndexBuffer);
+    glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(materialIndices.size() * sizeof(u32)), materialIndices.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, batching.materialBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, static_cast<GLsizeiptr>(app->materials.size() * sizeof(BatchedMaterial)), nullptr, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    ILOG("Material batching: %u materials, %s", batching.builtMaterialCount, batching.builtWithBindless ? "bindless textures" : "texture arrays")
+    batching.ready = true;
+}
+
+// All the subMeshes of the mesh have to share the same vertex layout, with vertex offsets that are whole vertices
+// (the base vertex of the commands selects the subMesh)
+static GLuint CreateMeshVAO(const App* app, const Mesh& mesh)
+{
+    const MaterialBatching& batching = app->materialBatching;
+    if (mesh.subMeshes.empty())
+        return 0;
+
+    const VertexBufferLayout& layout = mesh.subMeshes[0].vertexBufferLayout;
+    if (layout.stride == 0)
+        return 0;
+    for (const SubMesh& subMesh : mesh.subMeshes)
+    {
+        const VertexBufferLayout& subMeshLayout = subMesh.vertexBufferLayout;
+        if (subMeshLayout.stride != layout.stride || subMeshLayout.attributes.size() != layout.attributes.size() || subMesh.vertexOffset % layout.stride != 0)
+            return 0;
+        for (u32 a = 0; a < layout.attributes.size(); ++a)
+        {
+            const VertexBufferAttribute& attribute = subMeshLayout.attributes[a];
+            if (attribute.location != layout.attributes[a].location || attribute.componentCount != layout.attributes[a].componentCount ||
+                attribute.offset != layout.attributes[a].offset || attribute.arrayStride != 0)
+                return 0;
+        }
+    }
+
+    GLuint vaoHandle;
+    glGenVertexArrays(1, &vaoHandle);
+    glBindVertexArray(vaoHandle);
+    BufferManagement::BindBuffer(mesh.vertexBuffer);
+    BufferManagement::BindBuffer(mesh.indexBuffer);
+
+    const Program& program = app->programs[batching.batchedProgramIdx];
+    for (const VertexShaderAttribute& programAttribute : program.vertexInputLayout.attributes)
+    {
+        if (programAttribute.location == ATTR_LOCATION_MATERIAL_INDEX)
+            continue;
+
+        bool attributeWasLinked = false;
+        for (const VertexBufferAttribute& attribute : layout.attributes)
+        {
+            if (attribute.location == programAttribute.location)
+            {
+                glVertexAttribPointer(attribute.location, attribute.componentCount, GL_FLOAT, GL_FALSE, layout.stride, reinterpret_cast<void*>(static_cast<u64>(attribute.offset)));
+                glEnableVertexAttribArray(attribute.location);
+                attributeWasLinked = true;
+                break;
+            }
+        }
+        if (!attributeWasLinked)
+        {
+            glBindVertexArray(0);
+            glDeleteVertexArrays(1, &vaoHandle);
+            return 0;
+        }
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, batching.materialIndexBuffer);
+    glVertexAttribIPointer(ATTR_LOCATION_MATERIAL_INDEX, 1, GL_UNSIGNED_INT, 0, nullptr);
+    glVertexAttribDivisor(ATTR_LOCATION_MATERIAL_INDEX, 1);
+    glEnableVertexAttribArray(ATTR_LOCATION_MATERIAL_INDEX);
+
+    glBindVertexArray(0);
+    return vaoHandle;
+}
+
+void MaterialBatchingSupport::Init(App* app)
+{
+    MaterialBatching& batching = app->materialBatching;
+    batching.bindlessSupported = LoadBindlessTextureFunctions();
+
+    batching.batchedProgramIdx = ShaderSupport::LoadProgram(app, "Shaders\\shader_deferred_geometry_batched.vert", "Shaders\\shader_deferred_geometry_batched.frag", "DEFERRED_GEOMETRY_BATCHED");
+    if (batching.bindlessSupported)
+        batching.bindlessProgramIdx = ShaderSupport::LoadProgram(app, "Shaders\\shader_deferred_geometry_batched.vert", "Shaders\\shader_deferred_geometry_bindless.frag", "DEFERRED_GEOMETRY_BINDLESS");
+
+    glGenBuffers(1, &batching.materialBuffer);
+    glGenBuffers(1, &batching.materialIndexBuffer);
+    glGenBuffers(1, &batching.indirectBuffer);
+}
+
+void MaterialBatchingSupport::Shutdown(App* app)
+{
+    MaterialBatching& batching = app->materialBatching;
+    ReleaseMaterialTextures(batching);
+
+    for (const MeshBatchVAO& meshVAO : batching.meshVAOs)
+        if (meshVAO.handle != 0)
+            glDeleteVertexArrays(1, &meshVAO.handle);
+    batching.meshVAOs.clear();
+
+    glDeleteBuffers(1, &batching.materialBuffer);
+    glDeleteBuffers(1, &batching.materialIndexBuffer);
+    glDeleteBuffers(1, &batching.indirectBuffer);
+}
+
+void MaterialBatchingSupport::Update(App* app)
+{
+    MaterialBatching& batching = app->materialBatching;
+
+    // The arrays copy the final textures, streamed textures still have the default handle
+    if (app->textureStreamer.pendingTextures == 0)
+    {
+        const bool useBindless = batching.bindlessSupported && batching.useBindless;
+        if (batching.builtTextureCount != app->textures.size() || batching.builtMaterialCount != app->materials.size() || batching.builtWithBindless != useBindless ||
+            batching.rebuildTextureArrays)
+            BuildMaterialTextures(app);
+    }
+
+    if (!batching.ready)
+        return;
+
+    // Only the slots that changed get a new handle, an eviction never rebuilds the whole set
+    if (batching.builtWithBindless)
+        for (const u32 textureIdx : batching.dirtyTextures)
+            batching.textureRefs[textureIdx] = GetBindlessTextureRef(batching, app->textures[textureIdx].handle);
+    batching.dirtyTextures.clear();
+
+    // Rewritten every frame like the material UBO, so edits from the GUI show up in the batched path too
+    std::vector<BatchedMaterial> batchedMaterials(batching.builtMaterialCount);
+    for (u32 m = 0; m < batching.builtMaterialCount; ++m)
+    {
+        const Material& material = app->materials[m];
+        BatchedMaterial& batchedMaterial = batchedMaterials[m];
+        batchedMaterial.albedoSmoothness = glm::vec4(material.albedo, material.smoothness);
+        batchedMaterial.albedoTexture = batching.textureRefs[material.albedoTextureIdx];
+        batchedMaterial.normalsTexture = batching.textureRefs[material.normalsTextureIdx];
+        batchedMaterial.masksTexture = batching.textureRefs[material.masksTextureIdx];
+        batchedMaterial.coneStepTexture = batching.textureRefs[material.coneStepTextureIdx];
+        batchedMaterial.textureFlags = glm::uvec4(
+            material.albedoTextureIdx != 0 && batchedMaterial.albedoTexture != MATERIAL_TEXTURE_NONE,
+            material.normalsTextureIdx != 0 && batchedMaterial.normalsTexture != MATERIAL_TEXTURE_NONE,
+            (material.specularTextureIdx != 0 || material.bumpTextureIdx != 0) && batchedMaterial.masksTexture != MATERIAL_TEXTURE_NONE,
+            material.coneStepTextureIdx != 0 && batchedMaterial.coneStepTexture != MATERIAL_TEXTURE_NONE);
+        const ConeStepMapping& coneStep = app->coneStepMapping;
+        batchedMaterial.parallax = glm::vec4(material.heightScale, coneStep.fadeStart, coneStep.fadeEnd, 0.0f);
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, batching.materialBuffer);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, static_cast<GLsizeiptr>(batchedMaterials.size() * sizeof(BatchedMaterial)), batchedMaterials.data());
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+void MaterialBatchingSupport::RetireTexture(App* app, const u32 texIdx)
+{
+    MaterialBatching& batching = app->materialBatching;
+    if (texIdx >= batching.textureRefs.size() || batching.textureRefs[texIdx] == MATERIAL_TEXTURE_NONE)
+        return;
+
+    // The layers are copies of the sources, they would keep the full resolution of an evicted texture
+    if (!batching.builtWithBindless)
+    {
+        batching.rebuildTextureArrays = true;
+        return;
+    }
+
+    const bool hadDefaultTexture = app->textures[texIdx].handle == app->textures[app->defaultTextureIdx].handle;
+
+    // The default texture is shared by the released slots and stays resident. A slot retired twice before the
+    // next Update still holds the first handle, which is no longer in the list
+    if (!hadDefaultTexture)
+    {
+        const glm::uvec2 textureRef = batching.textureRefs[texIdx];
+        const GLuint64 handle = static_cast<GLuint64>(textureRef.x) | (static_cast<GLuint64>(textureRef.y) << 32);
+        const auto it = std::find(batching.residentHandles.begin(), batching.residentHandles.end(), handle);
+        if (it != batching.residentHandles.end())
+        {
+            MakeTextureHandleNonResident(handle);
+            batching.residentHandles.erase(it);
+        }
+    }
+    batching.dirtyTextures.push_back(texIdx);
+}
+
+bool MaterialBatchingSupport::IsReady(const App* app)
+{
+    return app->materialBatching.ready;
+}
+
+bool MaterialBatchingSupport::HasTextureArrayCopy(const App* app, const u32 texIdx)
+{
+    const MaterialBatching& batching = app->materialBatching;
+    return batching.ready && !batching.builtWithBindless && texIdx < batching.textureRefs.size() && batching.textureRefs[texIdx] != MATERIAL_TEXTURE_NONE;
+}
+
+u32 MaterialBatchingSupport::GetProgramIdx(const App* app)
+{
+    const MaterialBatching& batching = app->materialBatching;
+    return batching.builtWithBindless ? batching.bindlessProgramIdx : batching.batchedProgramIdx;
+}
+
+void MaterialBatchingSupport::ReleaseMeshVAO(App* app, const u32 meshIdx)
+{
+    MaterialBatching& batching = app->materialBatching;
+    if (meshIdx >= batching.meshVAOs.size())
+        return;
+
+    MeshBatchVAO& meshVAO = batching.meshVAOs[meshIdx];
+    if (meshVAO.handle != 0)
+        glDeleteVertexArrays(1, &meshVAO.handle);
+    meshVAO = MeshBatchVAO();
+}
+
+bool MaterialBatchingSupport::AddEntityDraws(App* app, const Entity& entity, const glm::vec4 frustumPlanes[6], const glm::vec3& cameraPositionLocal)
+{
+    MaterialBatching& batching = app->materialBatching;
+    const Model& model = app->models[entity.modelIndex];
+    const Mesh& mesh = app->meshes[model.meshIdx];
+
+    // Models imported at runtime wait on the per subMesh path until their materials are in the batched buffer
+    for (const u32 materialIdx : model.materialIdx)
+        if (materialIdx >= batching.builtMaterialCount)
+            return false;
+
+    if (batching.meshVAOs.size() < app->meshes.size())
+        batching.meshVAOs.resize(app->meshes.size());
+    MeshBatchVAO& meshVAO = batching.meshVAOs[model.meshIdx];
+    if (!meshVAO.checked)
+    {
+        meshVAO.handle = CreateMeshVAO(app, mesh);
+        meshVAO.checked = true;
+    }
+    if (meshVAO.handle == 0)
+        return false;
+
+    BatchedEntityDraw entityDraw;
+    entityDraw.vao = meshVAO.handle;
+    entityDraw.localParamsOffset = entity.localParamsOffset;
+    entityDraw.localParamsSize = entity.localParamsSize;
+    entityDraw.firstCommand = static_cast<u32>(batching.commands.size());
+
+    const u32 stride = mesh.subMeshes[0].vertexBufferLayout.stride;
+    const u32 subMeshCount = static_cast<u32>(mesh.subMeshes.size());
+    for (u32 i = 0; i < subMeshCount; ++i)
+    {
+        const SubMesh& subMesh = mesh.subMeshes[i];
+        const i32 baseVertex = static_cast<i32>(subMesh.vertexOffset / stride);
+        const u32 materialIdx = model.materialIdx[i];
+
+        if (app->useMeshletCulling && !subMesh.meshlets.empty())
+        {
+            batching.meshletDrawCounts.clear();
+            batching.meshletDrawOffsets.clear();
+            MeshletSupport::CullMeshlets(subMesh, frustumPlanes, cameraPositionLocal, app->useBackFaceCulling, batching.meshletDrawCounts, batching.meshletDrawOffsets, app->meshletCullStats);
+            for (u32 r = 0; r < batching.meshletDrawCounts.size(); ++r)
+            {
+                const u32 firstIndex = static_cast<u32>(reinterpret_cast<u64>(batching.meshletDrawOffsets[r]) / sizeof(u32));
+                batching.commands.push_back({ static_cast<u32>(batching.meshletDrawCounts[r]), 1, firstIndex, baseVertex, materialIdx });
+            }
+        }
+        else
+        {
+            batching.commands.push_back({ subMesh.indexCount, 1, subMesh.indexOffset / static_cast<u32>(sizeof(u32)), baseVertex, materialIdx });
+        }
+    }
+
+    entityDraw.commandCount = static_cast<u32>(batching.commands.size()) - entityDraw.firstCommand;
+    if (entityDraw.commandCount > 0)
+        batching.entityDraws.push_back(entityDraw);
+    return true;
+}
+
+void MaterialBatchingSupport::FlushDraws(App* app)
+{
+    MaterialBatching& batching = app->materialBatching;
+    batching.multiDrawCalls = static_cast<u32>(batching.entityDraws.size());
+    batching.drawCommands = static_cast<u32>(batching.commands.size());
+    if (batching.entityDraws.empty())
+    {
+        batching.commands.clear();
+        return;
+    }
+
+    glPushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, 1, -1, "Material Batches");
+
+    const Program& program = app->programs[GetProgramIdx(app)];
+    glUseProgram(program.handle);
+    glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, batching.indirectBuffer);
+    if (!batching.commandsUploaded)
+        glBufferData(GL_DRAW_INDIRECT_BUFFER, static_cast<GLsizeiptr>(batching.commands.size() * sizeof(DrawElementsIndirectCommand)), batching.commands.data(), GL_STREAM_DRAW);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, STD_430_BINDING_POINT::BP_BATCHED_MATERIALS, batching.materialBuffer);
+
+    // Bound once for the whole pass, the materials select their array and layer
+    for (u32 a = 0; a < batching.textureArrays.size(); ++a)
+    {
+        glActiveTexture(GL_TEXTURE0 + a);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, batching.textureArrays[a].handle);
+    }
+
+    for (const BatchedEntityDraw& entityDraw : batching.entityDraws)
+    {
+        BufferManagement::BindBufferRange(app->uniformBuffer, STD_140_BINDING_POINT::BP_LOCAL_PARAMS, entityDraw.localParamsSize, entityDraw.localParamsOffset);
+        glBindVertexArray(entityDraw.vao);
+        glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, reinterpret_cast<void*>(static_cast<u64>(entityDraw.firstCommand) * sizeof(DrawElementsIndirectCommand)),
+            static_cast<GLsizei>(entityDraw.commandCount), 0);
+    }
+
+    glBindVertexArray(0);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    for (u32 a = 0; a < batching.textureArrays.size(); ++a)
+    {
+        glActiveTexture(GL_TEXTURE0 + a);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+    }
+    glActiveTexture(GL_TEXTURE0);
+
+    batching.commands.clear();
+    batching.entityDraws.clear();
+    batching.commandsUploaded = false;
+    glPopDebugGroup();
+}
+
+void MaterialBatchingSupport::DrawDepthOnly(App* app, const Program& program)
+{
+    MaterialBatching& batching = app->materialBatching;
+    if (batching.entityDraws.empty())
+        return;
+
+    glPushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, 1, -1, "Material Batches Depth");
+    glUseProgram(program.handle);
+    glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, batching.indirectBuffer);
+    glBufferData(GL_DRAW_INDIRECT_BUFFER, static_cast<GLsizeiptr>(batching.commands.size() * sizeof(DrawElementsIndirectCommand)), batching.commands.data(), GL_STREAM_DRAW);
+    batching.commandsUploaded = true;
+
+    // The batch VAOs also feed the position only program, aPosition is at location 0 in both
+    for (const BatchedEntityDraw& entityDraw : batching.entityDraws)
+    {
+        BufferManagement::BindBufferRange(app->uniformBuffer, STD_140_BINDING_POINT::BP_LOCAL_PARAMS, entityDraw.localParamsSize, entityDraw.localParamsOffset);
+        glBindVertexArray(entityDraw.vao);
+        glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, reinterpret_cast<void*>(static_cast<u64>(entityDraw.firstCommand) * sizeof(DrawElementsIndirectCommand)),
+            static_cast<GLsizei>(entityDraw.commandCount), 0);
+    }
+
+    glBindVertexArray(0);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    glPopDebugGroup();
+}
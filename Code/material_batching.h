@@ -0,0 +1,141 @@
+﻿#ifndef MATERIAL_BATCHING_H
+#define MATERIAL_BATCHING_H
+#include <vector>
+
+#include "platform.h"
+
+struct App;
+struct Entity;
+struct Mesh;
+struct Program;
+
+#define MATERIAL_BATCHING_MAX_TEXTURE_ARRAYS 12 // Texture units 0..N-1 of the batched geometry program
+
+// Material as read by the batched geometry program (std430, 80 bytes). A texture reference is
+// (array, layer) with texture arrays or the two halves of the 64 bit handle with bindless textures.
+struct BatchedMaterial
+{
+    glm::vec4 albedoSmoothness;
+    glm::uvec4 textureFlags; // x: albedo, y: normals, z: masks, w: cone step map
+    glm::uvec2 albedoTexture;
+    glm::uvec2 normalsTexture;
+    glm::uvec2 masksTexture;
+    glm::uvec2 coneStepTexture;
+    glm::vec4 parallax; // x: height scale, y: fade start, z: fade end, see ConeStepMapping
+};
+
+// Textures with the same size, format and mip count share a GL_TEXTURE_2D_ARRAY
+struct MaterialTextureArray
+{
+    GLuint handle = 0;
+    ivec2 size;
+    GLenum internalFormat;
+    u32 mipLevels;
+    bool compressed;
+    std::vector<GLuint> layers; // Source textures, copied with glCopyImageSubData
+};
+
+// Single VAO for all the subMeshes of a mesh, the subMesh is selected by the base vertex of each draw
+struct MeshBatchVAO
+{
+    bool checked = false;
+    GLuint handle = 0; // 0 when the subMeshes can't share a VAO, those meshes keep the per subMesh path
+};
+
+struct BatchedEntityDraw
+{
+    GLuint vao;
+    u32 localParamsOffset;
+    u32 localParamsSize;
+    u32 firstCommand;
+    u32 commandCount;
+};
+
+// Layout of glMultiDrawElementsIndirect commands
+struct DrawElementsIndirectCommand
+{
+    u32 count;
+    u32 instanceCount;
+    u32 firstIndex;
+    i32 baseVertex;
+    u32 baseInstance; // The material index, the instanced material attribute is read at this offset
+};
+
+/// <summary>
+/// Material batching for the deferred geometry pass. Every material lives in a shader storage buffer and its
+/// textures are either layers of shared texture arrays or bindless handles (GL_ARB_bindless_texture), so the
+/// subMeshes of a mesh are drawn with one glMultiDrawElementsIndirect and no texture binds in between.
+/// GL 4.3 has no gl_DrawID, the material index reaches the shader through an instanced attribute read at
+/// the base instance of each command. The arrays are built once the texture streaming is done.
+/// </summary>
+struct MaterialBatching
+{
+    bool bindlessSupported = false;
+    bool useBindless = true;
+    u32 batchedProgramIdx = 0;
+    u32 bindlessProgramIdx = 0;
+
+    bool ready = false;
+    bool builtWithBindless = false;
+    u32 builtTextureCount = 0;
+    u32 builtMaterialCount = 0;
+    std::vector<u32> dirtyTextures; // Slots whose handle changed since the build, see RetireTexture
+    bool rebuildTextureArrays = false; // A slot changed its handle, the array layers are copies of the old one
+    bool texturesUnplaced = false; // The last build ran out of texture arrays, the geometry pass draws per subMesh until the next one
+
+    std::vector<MaterialTextureArray> textureArrays;
+    std::vector<glm::uvec2> textureRefs; // Per texture slot, all ones when the texture is not used by a material
+    std::vector<GLuint64> residentHandles;
+    std::vector<MeshBatchVAO> meshVAOs;
+
+    GLuint materialBuffer = 0;
+    GLuint materialIndexBuffer = 0; // 0..materialCount-1, source of the instanced material attribute
+    GLuint indirectBuffer = 0;
+
+    // Draws collected during the geometry pass
+    std::vector<DrawElementsIndirectCommand> commands;
+    std::vector<BatchedEntityDraw> entityDraws;
+    bool commandsUploaded = false; // By DrawDepthOnly, FlushDraws reuses them
+    std::vector<i32> meshletDrawCounts;
+    std::vector<const void*> meshletDrawOffsets;
+
+    // Stats
+    u32 multiDrawCalls = 0;
+    u32 drawCommands = 0;
+    u64 textureArrayBytes = 0;
+};
+
+struct MaterialBatchingSupport
+{
+    // Loads the batched programs, call before the vertex input layouts are reflected
+    static void Init(App* app);
+    static void Shutdown(App* app);
+
+    // (Re)builds the material buffer and the texture arrays/handles when new materials or textures are done loading
+    static void Update(App* app);
+
+    static bool IsReady(const App* app);
+    static u32 GetProgramIdx(const App* app);
+
+    // Call before the handle of a texture slot is deleted or replaced (mip eviction, release, streamed upload). The bindless
+    // handle stops being resident and the slot is refreshed by the next Update, the texture arrays are copied again from the
+    // new sources so the evictions free their layers too
+    static void RetireTexture(App* app, u32 texIdx);
+
+    // The texture has a layer in the built texture arrays, its memory is spent twice (see GpuMemorySupport)
+    static bool HasTextureArrayCopy(const App* app, u32 texIdx);
+
+    // Deletes the shared VAO of a mesh whose buffers are released, it is built again on the next draw
+    static void ReleaseMeshVAO(App* app, u32 meshIdx);
+
+    // Collects the draws of the entity, false when its mesh or its materials can't be batched (yet) and must be drawn per subMesh
+    static bool AddEntityDraws(App* app, const Entity& entity, const glm::vec4 frustumPlanes[6], const glm::vec3& cameraPositionLocal);
+
+    // Uploads the collected commands and issues one multi draw per entity
+    static void FlushDraws(App* app);
+
+    // Same multi draws with a position only program (see DepthPrepass), the commands stay collected for FlushDraws
+    static void DrawDepthOnly(App* app, const Program& program);
+};
+
+#endif // MATERIAL_BATCHING_H
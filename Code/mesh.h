@@ -4,6 +4,7 @@
 #include <vector>
 
 #include "buffer_management.h"
+#include "meshlet.h"
 #include "program.h"
 
 struct Model
@@ -15,6 +16,7 @@ struct Model
     std::string name;
     u32 meshIdx;
     std::vector<u32> materialIdx;
+    u32 impostorIdx = UINT32_MAX; // Baked far field representation, see ImpostorSupport
 };
 
 struct Material
@@ -28,11 +30,23 @@ struct Material
     u32 specularTextureIdx;
     u32 normalsTextureIdx;
     u32 bumpTextureIdx;
+    u32 masksTextureIdx = 0; // Bump and specular packed together, the two above only keep the source paths
     f32 heightScale = 0.01f;
+    u32 coneStepTextureIdx = 0; // Relaxed cone step map of the bump, see ConeStepMapSupport
     u32 paramsOffset;
     u32 paramsSize;
 };
 
+static const char* GeometryResidencyStr[] = { "KEEP_ALL", "RELEASE", "POSITIONS_AND_INDICES" };
+
+// What the subMeshes keep in system memory once their GPU buffers are created
+enum class GeometryResidency
+{
+    KEEP_ALL,             // Vertices and indices as uploaded
+    RELEASE,              // Nothing, only the counts and offsets into the GPU buffers
+    POSITIONS_AND_INDICES // Packed positions and the indices, for CPU side queries (e.g. picking), none of the passes reads them yet
+};
+
 struct SubMesh
 {
     SubMesh(const char* name) : name(name), vertexBufferLayout(), vertexOffset(0), indexOffset(0)
@@ -43,8 +57,15 @@ struct SubMesh
     VertexBufferLayout vertexBufferLayout;
     std::vector<float> vertices;
     std::vector<u32> indices;
+    std::vector<vec3> positions; // Only with GeometryResidency::POSITIONS_AND_INDICES, vertices is released then. Not read by the renderer
     u32 vertexOffset;
     u32 indexOffset;
+    u32 vertexCount = 0; // Counts of the uploaded geometry, the CPU side vectors may be empty (e.g. loaded from the mesh cache)
+    u32 indexCount = 0;
+
+    // Optional clusters for per meshlet culling, see MeshletSupport
+    std::vector<Meshlet> meshlets;
+    MeshletBounds meshletBounds;
 
     std::vector<VAO> vaoList;
 };
@@ -57,11 +78,14 @@ struct Mesh
 
     std::string name;
     std::vector<SubMesh> subMeshes;
+    glm::vec3 boundsMin = glm::vec3(0.0f); // Local space AABB of all the subMeshes
+    glm::vec3 boundsMax = glm::vec3(0.0f);
     Buffer vertexBuffer;
     Buffer indexBuffer;
 
     void DrawSubMesh(u32 subMeshIndex, const Texture& texture, const u32 textureUniform, const Program& program, const bool drawWireFrame = false);
     void DrawSubMesh(u32 subMeshIndex, const std::vector<u32>& textureUniformsHandles, const std::vector<u32>& textureUniformsLocations, const Program& program, const bool drawWireFrame = false);
+    void DrawSubMeshRanges(u32 subMeshIndex, const std::vector<i32>& counts, const std::vector<const void*>& offsets, const std::vector<u32>& textureUniformsHandles, const std::vector<u32>& textureUniformsLocations, const Program& program, const bool drawWireFrame = false);
 };
 
 
@@ -89,7 +113,7 @@ inline void Mesh::DrawSubMesh(u32 subMeshIndex, const Texture& texture, const u3
     glBindTexture(GL_TEXTURE_2D, texture.handle);
     glUniform1i(static_cast<GLint>(textureUniform), 0); // stackoverflow.com/questions/23687102/gluniform1f-vs-gluniform1i-confusion
 
-    glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(subMesh.indices.size()), GL_UNSIGNED_INT, reinterpret_cast<void*>(static_cast<u64>(subMesh.indexOffset)));
+    glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(subMesh.indexCount), GL_UNSIGNED_INT, reinterpret_cast<void*>(static_cast<u64>(subMesh.indexOffset)));
     glPopDebugGroup();
 }
 inline void Mesh::DrawSubMesh(u32 subMeshIndex, const std::vector<u32>& textureUniformsHandles, const std::vector<u32>& textureUniformsLocations, const Program& program, const bool drawWireFrame)
@@ -115,7 +139,37 @@ inline void Mesh::DrawSubMesh(u32 subMeshIndex, const std::vector<u32>& textureU
     
     glBindVertexArray(vao);
 
-    glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(subMesh.indices.size()), GL_UNSIGNED_INT, reinterpret_cast<void*>(static_cast<u64>(subMesh.indexOffset)));
+    glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(subMesh.indexCount), GL_UNSIGNED_INT, reinterpret_cast<void*>(static_cast<u64>(subMesh.indexOffset)));
+    glPopDebugGroup();
+}
+inline void Mesh::DrawSubMeshRanges(u32 subMeshIndex, const std::vector<i32>& counts, const std::vector<const void*>& offsets, const std::vector<u32>& textureUniformsHandles, const std::vector<u32>& textureUniformsLocations, const Program& program, const bool drawWireFrame)
+{
+    if (counts.empty())
+        return;
+
+    const SubMesh& subMesh = subMeshes[subMeshIndex];
+
+    glPushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, 1, -1, subMesh.name.c_str());
+    const GLuint vao = VAOSupport::FindVAO(*this, subMeshIndex, program);
+
+    if (drawWireFrame)
+        glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+    else
+        glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+
+    assert(counts.size() == offsets.size());
+    assert(textureUniformsHandles.size() == textureUniformsLocations.size());
+
+    for (u32 i = 0; i < textureUniformsLocations.size(); ++i)
+    {
+        glActiveTexture(GL_TEXTURE0 + textureUniformsLocations[i]);
+        glBindTexture(GL_TEXTURE_2D, textureUniformsHandles[i]);
+    }
+
+    glBindVertexArray(vao);
+
+    // Offsets are absolute inside the index buffer of the mesh, so they already include subMesh.indexOffset
+    glMultiDrawElements(GL_TRIANGLES, counts.data(), GL_UNSIGNED_INT, offsets.data(), static_cast<GLsizei>(counts.size()));
     glPopDebugGroup();
 }
 
@@ -0,0 +1,362 @@
+﻿#include "mesh_cache.h"
+
+#include <cstring>
+
+#include "app.h"
+#include "assimp_model_loading.h"
+
+// Appends the cache file in memory, written to disk at once
+struct MeshCacheWriter
+{
+    std::vector<u8> bytes;
+
+    void Write(const void* data, const u64 size)
+    {
+        const u8* first = static_cast<const u8*>(data);
+        bytes.insert(bytes.end(), first, first + size);
+    }
+    template <typename T> void Write(const T& value) { Write(&value, sizeof(T)); }
+
+    void WriteString(const std::string& str)
+    {
+        Write(static_cast<u32>(str.size()));
+        Write(str.data(), str.size());
+    }
+    void WriteFloats(const std::vector<f32>& values)
+    {
+        Write(static_cast<u32>(values.size()));
+        Write(values.data(), values.size() * sizeof(f32));
+    }
+    void Align(const u64 alignment)
+    {
+        bytes.resize((bytes.size() + alignment - 1) & ~(alignment - 1), 0);
+    }
+    void Patch(const u64 offset, const u64 value)
+    {
+        memcpy(&bytes[offset], &value, sizeof(value));
+    }
+};
+
+// Reads the mapped cache file, any read out of bounds invalidates the whole file
+struct MeshCacheReader
+{
+    const u8* data;
+    u64 size;
+    u64 head;
+    bool valid;
+
+    void Read(void* out, const u64 count)
+    {
+        if (!valid || head + count > size)
+        {
+            valid = false;
+            return;
+        }
+        memcpy(out, data + head, count);
+        head += count;
+    }
+    template <typename T> T Read() { T value = {}; Read(&value, sizeof(T)); return value; }
+
+    std::string ReadString()
+    {
+        const u32 length = Read<u32>();
+        if (!valid || head + length > size)
+        {
+            valid = false;
+            return {};
+        }
+        std::string str(reinterpret_cast<const char*>(data + head), length);
+        head += length;
+        return str;
+    }
+    void ReadFloats(std::vector<f32>& values)
+    {
+        const u32 count = Read<u32>();
+        if (!valid || head + count * sizeof(f32) > size)
+        {
+            valid = false;
+            return;
+        }
+        values.resize(count);
+        Read(values.data(), count * sizeof(f32));
+    }
+};
+
+std::string MeshCacheSupport::GetCachePath(const char* filename)
+{
+    return MakeString(filename) + MESH_CACHE_EXTENSION;
+}
+
+// FNV-1a 64, continued from hash
+static u64 HashBytes(u64 hash, const u8* data, const u64 size)
+{
+    for (u64 i = 0; i < size; ++i)
+    {
+        hash ^= data[i];
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+u64 MeshCacheSupport::HashFile(const char* filename)
+{
+    MappedFile file;
+    if (!MapFile(filename, file))
+        return 0;
+
+    const u64 hash = HashBytes(0xcbf29ce484222325ull, file.data, file.size);
+    UnmapFile(file);
+    return hash;
+}
+
+u64 MeshCacheSupport::HashSource(const char* filename)
+{
+    MappedFile file;
+    if (!MapFile(filename, file))
+        return 0;
+    u64 hash = HashBytes(0xcbf29ce484222325ull, file.data, file.size);
+
+    // The materials of an .obj come from its mtllib files, assimp reads the same ones
+    const std::string path = MakeString(filename);
+    const std::string extension = path.substr(path.find_last_of('.') + 1);
+    if (extension == "obj" || extension == "OBJ")
+    {
+        const char* c = reinterpret_cast<const char*>(file.data);
+        const char* end = c + file.size;
+        while (c < end)
+        {
+            const char* lineEnd = static_cast<const char*>(memchr(c, '\n', static_cast<size_t>(end - c)));
+            if (lineEnd == nullptr)
+                lineEnd = end;
+            if (lineEnd - c > 7 && strncmp(c, "mtllib", 6) == 0 && (c[6] == ' ' || c[6] == '\t'))
+            {
+                std::string library(c + 7, lineEnd);
+                library.erase(0, library.find_first_not_of(" \t"));
+                library.erase(library.find_last_not_of(" \t\r") + 1);
+
+                // A missing library still changes the key, so the cache is rebuilt once it is there
+                MappedFile libraryFile;
+                const std::string libraryPath = MakePath(GetDirectoryPart(path), library);
+                hash = HashBytes(hash, reinterpret_cast<const u8*>(libraryPath.data()), libraryPath.size());
+                if (MapFile(libraryPath.c_str(), libraryFile))
+                {
+                    hash = HashBytes(hash, libraryFile.data, libraryFile.size);
+                    UnmapFile(libraryFile);
+                }
+            }
+            c = lineEnd + 1;
+        }
+    }
+
+    UnmapFile(file);
+    return hash;
+}
+
+bool MeshCacheSupport::ReadModelCache(const char* filename, const u64 sourceHash, const u32 importFlags, const u32 loadingFlags, ModelImport& import)
+{
+    const std::string cachePath = GetCachePath(filename);
+    MappedFile file;
+    if (!MapFile(cachePath.c_str(), file))
+        return false;
+
+    MeshCacheReader reader = { file.data, file.size, 0, true };
+    const MeshCacheHeader header = reader.Read<MeshCacheHeader>();
+    if (!reader.valid || header.magic != MESH_CACHE_MAGIC || header.version != MESH_CACHE_VERSION || header.sourceHash != sourceHash ||
+        header.importFlags != importFlags || header.loadingFlags != loadingFlags)
+    {
+        ILOG("Mesh cache %s is stale, importing the source again", cachePath.c_str())
+        UnmapFile(file);
+        return false;
+    }
+
+    // Parse everything before filling the import, so a truncated file does not leave a half read model
+    const std::string modelName = reader.ReadString();
+    const std::string meshName = reader.ReadString();
+
+    std::vector<Material> materials(header.materialCount);
+    std::vector<std::string> texturePaths(header.materialCount * MMT_COUNT);
+    for (u32 m = 0; m < header.materialCount && reader.valid; ++m)
+    {
+        Material& material = materials[m];
+        material.name = reader.ReadString();
+        material.albedo = reader.Read<vec3>();
+        material.emissive = reader.Read<vec3>();
+        material.smoothness = reader.Read<f32>();
+        material.heightScale = reader.Read<f32>();
+        for (u32 t = 0; t < MMT_COUNT; ++t)
+            texturePaths[m * MMT_COUNT + t] = reader.ReadString();
+    }
+
+    Mesh mesh = { meshName.c_str() };
+    mesh.boundsMin = glm::make_vec3(header.boundsMin);
+    mesh.boundsMax = glm::make_vec3(header.boundsMax);
+    std::vector<u32> subMeshMaterials(header.subMeshCount);
+    std::vector<const void*> subMeshVertices(header.subMeshCount);
+    std::vector<const void*> subMeshIndices(header.subMeshCount);
+    for (u32 s = 0; s < header.subMeshCount && reader.valid; ++s)
+    {
+        mesh.subMeshes.emplace_back(reader.ReadString().c_str());
+        SubMesh& subMesh = mesh.subMeshes.back();
+        subMeshMaterials[s] = reader.Read<u32>();
+
+        const u8 attributeCount = reader.Read<u8>();
+        subMesh.vertexBufferLayout.attributes.resize(attributeCount);
+        reader.Read(subMesh.vertexBufferLayout.attributes.data(), attributeCount * sizeof(VertexBufferAttribute));
+        subMesh.vertexBufferLayout.stride = reader.Read<u8>();
+        subMesh.vertexCount = reader.Read<u32>();
+        subMesh.indexCount = reader.Read<u32>();
+
+        subMesh.meshlets.resize(reader.Read<u32>());
+        reader.Read(subMesh.meshlets.data(), subMesh.meshlets.size() * sizeof(Meshlet));
+        MeshletBounds& bounds = subMesh.meshletBounds;
+        reader.ReadFloats(bounds.centerX);
+        reader.ReadFloats(bounds.centerY);
+        reader.ReadFloats(bounds.centerZ);
+        reader.ReadFloats(bounds.radius);
+        reader.ReadFloats(bounds.coneAxisX);
+        reader.ReadFloats(bounds.coneAxisY);
+        reader.ReadFloats(bounds.coneAxisZ);
+        reader.ReadFloats(bounds.coneCutoff);
+
+        const u64 verticesOffset = reader.Read<u64>();
+        const u64 indicesOffset = reader.Read<u64>();
+        const u64 verticesSize = static_cast<u64>(subMesh.vertexCount) * subMesh.vertexBufferLayout.stride;
+        const u64 indicesSize = static_cast<u64>(subMesh.indexCount) * sizeof(u32);
+        if (verticesOffset + verticesSize > file.size || indicesOffset + indicesSize > file.size || subMeshMaterials[s] >= header.materialCount)
+            reader.valid = false;
+
+        // Zero copy, the GPU buffers are filled straight from the mapping
+        subMeshVertices[s] = file.data + verticesOffset;
+        subMeshIndices[s] = file.data + indicesOffset;
+    }
+
+    if (!reader.valid)
+    {
+        ELOG("Mesh cache %s is corrupted, importing the source again", cachePath.c_str())
+        UnmapFile(file);
+        return false;
+    }
+
+    import.modelName = modelName;
+    import.mesh = std::move(mesh);
+    import.materials.swap(materials);
+    import.texturePaths.swap(texturePaths);
+    import.subMeshMaterials.swap(subMeshMaterials);
+    import.subMeshVertices.swap(subMeshVertices);
+    import.subMeshIndices.swap(subMeshIndices);
+    import.cacheFile = file;
+    return true;
+}
+
+bool MeshCacheSupport::WriteModelCache(const App* app, const u32 modelIdx, const char* filename, const u64 sourceHash, const u32 importFlags, const u32 loadingFlags)
+{
+    const Model& model = app->models[modelIdx];
+    const Mesh& mesh = app->meshes[model.meshIdx];
+
+    // Only the materials used by the subMeshes are stored, indexed relative to the cache
+    std::vector<u32> materials;
+    std::vector<u32> subMeshMaterials;
+    for (const u32 materialIdx : model.materialIdx)
+    {
+        u32 cacheMaterialIdx = 0;
+        while (cacheMaterialIdx < materials.size() && materials[cacheMaterialIdx] != materialIdx)
+            ++cacheMaterialIdx;
+        if (cacheMaterialIdx == materials.size())
+            materials.push_back(materialIdx);
+        subMeshMaterials.push_back(cacheMaterialIdx);
+    }
+
+    MeshCacheHeader header = {};
+    header.magic = MESH_CACHE_MAGIC;
+    header.version = MESH_CACHE_VERSION;
+    header.sourceHash = sourceHash;
+    header.importFlags = importFlags;
+    header.loadingFlags = loadingFlags;
+    header.materialCount = static_cast<u32>(materials.size());
+    header.subMeshCount = static_cast<u32>(mesh.subMeshes.size());
+    memcpy(header.boundsMin, glm::value_ptr(mesh.boundsMin), sizeof(header.boundsMin));
+    memcpy(header.boundsMax, glm::value_ptr(mesh.boundsMax), sizeof(header.boundsMax));
+
+    MeshCacheWriter writer;
+    writer.Write(header);
+    writer.WriteString(model.name);
+    writer.WriteString(mesh.name);
+
+    for (const u32 materialIdx : materials)
+    {
+        const Material& material = app->materials[materialIdx];
+        writer.WriteString(material.name);
+        writer.Write(material.albedo);
+        writer.Write(material.emissive);
+        writer.Write(material.smoothness);
+        writer.Write(material.heightScale);
+
+        const u32 textureIdxs[MMT_COUNT] = { material.albedoTextureIdx, material.emissiveTextureIdx, material.specularTextureIdx,
+            material.normalsTextureIdx, material.bumpTextureIdx };
+        for (const u32 textureIdx : textureIdxs)
+        {
+            const bool hasTexture = textureIdx != 0 && textureIdx != app->defaultTextureIdx;
+            writer.WriteString(hasTexture ? app->textures[textureIdx].path : std::string());
+        }
+    }
+
+    // The data offsets are patched once the data blocks are placed at the end of the file
+    std::vector<u64> dataOffsetPositions(mesh.subMeshes.size());
+    for (u32 s = 0; s < mesh.subMeshes.size(); ++s)
+    {
+        const SubMesh& subMesh = mesh.subMeshes[s];
+        writer.WriteString(subMesh.name);
+        writer.Write(subMeshMaterials[s]);
+
+        writer.Write(static_cast<u8>(subMesh.vertexBufferLayout.attributes.size()));
+        writer.Write(subMesh.vertexBufferLayout.attributes.data(), subMesh.vertexBufferLayout.attributes.size() * sizeof(VertexBufferAttribute));
+        writer.Write(subMesh.vertexBufferLayout.stride);
+        writer.Write(subMesh.vertexCount);
+        writer.Write(subMesh.indexCount);
+
+        writer.Write(static_cast<u32>(subMesh.meshlets.size()));
+        writer.Write(subMesh.meshlets.data(), subMesh.meshlets.size() * sizeof(Meshlet));
+        const MeshletBounds& bounds = subMesh.meshletBounds;
+        writer.WriteFloats(bounds.centerX);
+        writer.WriteFloats(bounds.centerY);
+        writer.WriteFloats(bounds.centerZ);
+        writer.WriteFloats(bounds.radius);
+        writer.WriteFloats(bounds.coneAxisX);
+        writer.WriteFloats(bounds.coneAxisY);
+        writer.WriteFloats(bounds.coneAxisZ);
+        writer.WriteFloats(bounds.coneCutoff);
+
+        dataOffsetPositions[s] = writer.bytes.size();
+        writer.Write(static_cast<u64>(0));
+        writer.Write(static_cast<u64>(0));
+    }
+
+    for (u32 s = 0; s < mesh.subMeshes.size(); ++s)
+    {
+        const SubMesh& subMesh = mesh.subMeshes[s];
+        writer.Align(MESH_CACHE_DATA_ALIGNMENT);
+        writer.Patch(dataOffsetPositions[s], writer.bytes.size());
+        writer.Write(subMesh.vertices.data(), subMesh.vertices.size() * sizeof(float));
+
+        writer.Align(MESH_CACHE_DATA_ALIGNMENT);
+        writer.Patch(dataOffsetPositions[s] + sizeof(u64), writer.bytes.size());
+        writer.Write(subMesh.indices.data(), subMesh.indices.size() * sizeof(u32));
+    }
+
+    const std::string cachePath = GetCachePath(filename);
+    FILE* file = fopen(cachePath.c_str(), "wb");
+    if (!file)
+    {
+        ELOG("Could not write the mesh cache %s", cachePath.c_str())
+        return false;
+    }
+    const bool written = fwrite(writer.bytes.data(), 1, writer.bytes.size(), file) == writer.bytes.size();
+    fclose(file);
+
+    if (!written)
+    {
+        ELOG("Could not write the mesh cache %s", cachePath.c_str())
+        remove(cachePath.c_str());
+    }
+    return written;
+}
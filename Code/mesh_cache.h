@@ -0,0 +1,60 @@
+﻿#ifndef MESH_CACHE_H
+#define MESH_CACHE_H
+#include <vector>
+
+#include "platform.h"
+
+struct App;
+struct ModelImport;
+
+#define MESH_CACHE_MAGIC 0x4348534D // "MSHC"
+#define MESH_CACHE_VERSION 2
+#define MESH_CACHE_EXTENSION ".meshcache"
+#define MESH_CACHE_DATA_ALIGNMENT 16
+
+/// <summary>
+/// Header of a binary mesh cache file. The cache is only valid for the same source file contents,
+/// import flags and loading flags it was written with.
+/// </summary>
+/// <param name="sourceHash">FNV-1a hash of the source model file and its dependencies, see HashSource.</param>
+/// <param name="importFlags">Assimp post processing flags used on the import.</param>
+/// <param name="loadingFlags">MODEL_LOADING_FLAGS that change the cached data (e.g. meshlets).</param>
+struct MeshCacheHeader
+{
+    u32 magic;
+    u32 version;
+    u64 sourceHash;
+    u32 importFlags;
+    u32 loadingFlags;
+    u32 materialCount;
+    u32 subMeshCount;
+    f32 boundsMin[3];
+    f32 boundsMax[3];
+};
+
+/*
+ *  File layout, all the values are little endian and strings are stored as u32 length + chars:
+ *  MeshCacheHeader
+ *  model name, mesh name
+ *  materials: name, albedo, emissive, smoothness, heightScale, albedo/emissive/specular/normals/bump texture paths
+ *  subMeshes: name, material index, vertex layout, vertex count, index count, meshlets, meshlet bounds,
+ *             file offsets of the vertex and index data
+ *  vertex and index data of every subMesh, aligned to MESH_CACHE_DATA_ALIGNMENT
+ */
+struct MeshCacheSupport
+{
+    static std::string GetCachePath(const char* filename);
+    static u64 HashFile(const char* filename);
+    // Key of the cache: the model file and the files it pulls the materials from (the mtllib files of an .obj)
+    static u64 HashSource(const char* filename);
+
+    // Maps the cache and reads the model into the import, which keeps the mapping so the vertices and indices go from it
+    // straight to the GPU buffers (see AssimpSupport::CreateModel). No app or OpenGL access, safe on worker threads.
+    // Returns false when there is no valid cache for this source.
+    static bool ReadModelCache(const char* filename, u64 sourceHash, u32 importFlags, u32 loadingFlags, ModelImport& import);
+
+    // Writes the model just imported, reading the CPU side geometry it still holds
+    static bool WriteModelCache(const App* app, u32 modelIdx, const char* filename, u64 sourceHash, u32 importFlags, u32 loadingFlags);
+};
+
+#endif // MESH_CACHE_H
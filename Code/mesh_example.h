@@ -76,6 +76,8 @@ inline u32 CreateSampleMesh(App* app)
     }
     
     subMesh.indices = std::vector<u32>(indices, indices + std::size(indices));
+    subMesh.vertexCount = verticesSize;
+    subMesh.indexCount = static_cast<u32>(std::size(indices));
     mesh.subMeshes.push_back(subMesh);
 
     app->meshes.push_back(mesh);
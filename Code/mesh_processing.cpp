@@ -0,0 +1,58 @@
+﻿#include "mesh_processing.h"
+
+void MeshProcessingSupport::GenerateNormals(const std::vector<vec3>& positions, const std::vector<u32>& indices, std::vector<vec3>& normals)
+{
+    normals.assign(positions.size(), vec3(0.0f));
+    for (u32 i = 0; i + 2 < indices.size(); i += 3)
+    {
+        const vec3& a = positions[indices[i + 0]];
+        const vec3& b = positions[indices[i + 1]];
+        const vec3& c = positions[indices[i + 2]];
+        const vec3 faceNormal = glm::cross(b - a, c - a);
+        for (u32 k = 0; k < 3; ++k)
+            normals[indices[i + k]] += faceNormal;
+    }
+    for (vec3& normal : normals)
+        normal = glm::dot(normal, normal) > 0.0f ? glm::normalize(normal) : vec3(0.0f, 1.0f, 0.0f);
+}
+
+void MeshProcessingSupport::GenerateTangentSpace(const std::vector<vec3>& positions, const std::vector<vec2>& texCoords, const std::vector<vec3>& normals,
+    const std::vector<u32>& indices, std::vector<vec3>& tangents, std::vector<vec3>& bitangents)
+{
+    const u32 vertexCount = static_cast<u32>(positions.size());
+    tangents.assign(vertexCount, vec3(0.0f));
+    bitangents.assign(vertexCount, vec3(0.0f));
+    for (u32 i = 0; i + 2 < indices.size(); i += 3)
+    {
+        const u32 i0 = indices[i + 0], i1 = indices[i + 1], i2 = indices[i + 2];
+        const vec3 e1 = positions[i1] - positions[i0];
+        const vec3 e2 = positions[i2] - positions[i0];
+        const vec2 d1 = texCoords[i1] - texCoords[i0];
+        const vec2 d2 = texCoords[i2] - texCoords[i0];
+        const f32 determinant = d1.x * d2.y - d2.x * d1.y;
+        if (glm::abs(determinant) < 1e-12f)
+            continue;
+
+        const f32 r = 1.0f / determinant;
+        const vec3 tangent = (e1 * d2.y - e2 * d1.y) * r;
+        const vec3 bitangent = (e2 * d1.x - e1 * d2.x) * r;
+        for (const u32 v : { i0, i1, i2 })
+        {
+            tangents[v] += tangent;
+            bitangents[v] += bitangent;
+        }
+    }
+
+    for (u32 v = 0; v < vertexCount; ++v)
+    {
+        const vec3& n = normals[v];
+        vec3 t = tangents[v] - n * glm::dot(n, tangents[v]);
+        if (glm::dot(t, t) < 1e-12f)
+            t = glm::abs(n.x) < 0.9f ? glm::cross(n, vec3(1.0f, 0.0f, 0.0f)) : glm::cross(n, vec3(0.0f, 1.0f, 0.0f));
+        t = glm::normalize(t);
+
+        const vec3 b = glm::cross(n, t);
+        tangents[v] = t;
+        bitangents[v] = glm::dot(b, bitangents[v]) < 0.0f ? -b : b;
+    }
+}
@@ -0,0 +1,18 @@
+﻿#ifndef MESH_PROCESSING_H
+#define MESH_PROCESSING_H
+#include <vector>
+
+#include "platform.h"
+
+struct MeshProcessingSupport
+{
+    // Area weighted smooth normals of an indexed triangle list
+    static void GenerateNormals(const std::vector<vec3>& positions, const std::vector<u32>& indices, std::vector<vec3>& normals);
+
+    // Per vertex tangents from the texture coordinates derivatives, orthonormalized against the normals.
+    // Bitangents follow the engine convention (the flipped assimp ones), pointing to +v in texture space.
+    static void GenerateTangentSpace(const std::vector<vec3>& positions, const std::vector<vec2>& texCoords, const std::vector<vec3>& normals,
+        const std::vector<u32>& indices, std::vector<vec3>& tangents, std::vector<vec3>& bitangents);
+};
+
+#endif // MESH_PROCESSING_H
@@ -0,0 +1,238 @@
+﻿#include "meshlet.h"
+#include <cfloat>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define MESHLET_CULLING_SSE
+#include <xmmintrin.h>
+#endif
+
+#include "mesh.h"
+
+static void PushMeshletBounds(MeshletBounds& bounds, const glm::vec3& center, const f32 radius, const glm::vec3& coneAxis, const f32 coneCutoff)
+{
+    bounds.centerX.push_back(center.x);
+    bounds.centerY.push_back(center.y);
+    bounds.centerZ.push_back(center.z);
+    bounds.radius.push_back(radius);
+    bounds.coneAxisX.push_back(coneAxis.x);
+    bounds.coneAxisY.push_back(coneAxis.y);
+    bounds.coneAxisZ.push_back(coneAxis.z);
+    bounds.coneCutoff.push_back(coneCutoff);
+}
+
+static void ComputeMeshletBounds(const SubMesh& subMesh, const Meshlet& meshlet, MeshletBounds& bounds)
+{
+    const u32 floatStride = subMesh.vertexBufferLayout.stride / sizeof(float);
+    auto position = [&](const u32 index) { return glm::make_vec3(&subMesh.vertices[index * floatStride]); };
+
+    // Bounding sphere centered on the AABB of the meshlet
+    glm::vec3 aabbMin(FLT_MAX);
+    glm::vec3 aabbMax(-FLT_MAX);
+    for (u32 i = meshlet.indexOffset; i < meshlet.indexOffset + meshlet.indexCount; ++i)
+    {
+        const glm::vec3 p = position(subMesh.indices[i]);
+        aabbMin = glm::min(aabbMin, p);
+        aabbMax = glm::max(aabbMax, p);
+    }
+    const glm::vec3 center = (aabbMin + aabbMax) * 0.5f;
+    f32 radius = 0.0f;
+    for (u32 i = meshlet.indexOffset; i < meshlet.indexOffset + meshlet.indexCount; ++i)
+        radius = glm::max(radius, glm::length(position(subMesh.indices[i]) - center));
+
+    // Normal cone, built from the face normals (counter clock wise winding)
+    std::vector<glm::vec3> faceNormals;
+    faceNormals.reserve(meshlet.indexCount / 3);
+    glm::vec3 coneAxis(0.0f);
+    for (u32 i = meshlet.indexOffset; i < meshlet.indexOffset + meshlet.indexCount; i += 3)
+    {
+        const glm::vec3 a = position(subMesh.indices[i + 0]);
+        const glm::vec3 b = position(subMesh.indices[i + 1]);
+        const glm::vec3 c = position(subMesh.indices[i + 2]);
+        const glm::vec3 n = glm::cross(b - a, c - a);
+        const f32 area = glm::length(n);
+        if (area <= FLT_EPSILON) // Degenerate triangle, it does not constrain the cone
+            continue;
+        faceNormals.push_back(n / area);
+        coneAxis += n / area;
+    }
+
+    // A cutoff of 1 never passes the back-face test, used whenever the cone is wider than a hemisphere
+    f32 coneCutoff = 1.0f;
+    const f32 axisLength = glm::length(coneAxis);
+    if (axisLength > FLT_EPSILON)
+    {
+        coneAxis /= axisLength;
+        f32 minDot = 1.0f;
+        for (const glm::vec3& n : faceNormals)
+            minDot = glm::min(minDot, glm::dot(n, coneAxis));
+        if (minDot > 0.0f)
+            coneCutoff = std::sqrt(1.0f - minDot * minDot);
+    }
+
+    PushMeshletBounds(bounds, center, radius, coneAxis, coneCutoff);
+}
+
+void MeshletSupport::BuildMeshlets(SubMesh& subMesh, const u32 maxVertices, const u32 maxTriangles)
+{
+    ASSERT(maxVertices >= 3 && maxTriangles >= 1, "A meshlet must be able to hold at least one triangle");
+
+    subMesh.meshlets.clear();
+    subMesh.meshletBounds = {};
+
+    const u32 floatStride = subMesh.vertexBufferLayout.stride / sizeof(float);
+    const u32 vertexCount = floatStride > 0 ? (u32)subMesh.vertices.size() / floatStride : 0;
+    const u32 indexCount = (u32)subMesh.indices.size();
+    if (vertexCount == 0 || indexCount < 3)
+        return;
+
+    // Last meshlet that referenced each vertex, to count unique vertices without clearing a set per meshlet
+    std::vector<u32> vertexMeshlet(vertexCount, UINT32_MAX);
+
+    // Triangles are consumed in index buffer order (already optimized for cache locality by the importer),
+    // so every meshlet is a contiguous index range and the index buffer does not need to be reordered.
+    Meshlet meshlet = {0, 0, 0};
+    u32 meshletId = 0;
+    for (u32 i = 0; i + 2 < indexCount; i += 3)
+    {
+        const u32* triangle = &subMesh.indices[i];
+
+        u32 newVertices = 0;
+        for (u32 j = 0; j < 3; ++j)
+        {
+            const bool repeatedInTriangle = (j > 0 && triangle[j] == triangle[0]) || (j > 1 && triangle[j] == triangle[1]);
+            if (vertexMeshlet[triangle[j]] != meshletId && !repeatedInTriangle)
+                ++newVertices;
+        }
+
+        if (meshlet.vertexCount + newVertices > maxVertices || meshlet.indexCount / 3 + 1 > maxTriangles)
+        {
+            subMesh.meshlets.push_back(meshlet);
+            meshlet = {i, 0, 0};
+            ++meshletId;
+            newVertices = 0;
+            for (u32 j = 0; j < 3; ++j)
+            {
+                const bool repeatedInTriangle = (j > 0 && triangle[j] == triangle[0]) || (j > 1 && triangle[j] == triangle[1]);
+                if (!repeatedInTriangle)
+                    ++newVertices;
+            }
+        }
+
+        for (u32 j = 0; j < 3; ++j)
+            vertexMeshlet[triangle[j]] = meshletId;
+
+        meshlet.vertexCount += newVertices;
+        meshlet.indexCount += 3;
+    }
+    if (meshlet.indexCount > 0)
+        subMesh.meshlets.push_back(meshlet);
+
+    for (const Meshlet& m : subMesh.meshlets)
+        ComputeMeshletBounds(subMesh, m, subMesh.meshletBounds);
+
+    // Pad the SoA arrays so the culling can always load 4 lanes
+    while (subMesh.meshletBounds.centerX.size() % 4 != 0)
+        PushMeshletBounds(subMesh.meshletBounds, glm::vec3(0.0f), 0.0f, glm::vec3(0.0f), 1.0f);
+}
+
+void MeshletSupport::ExtractFrustumPlanes(const glm::mat4& viewProjection, glm::vec4 planes[6])
+{
+    // Gribb & Hartmann, planes pointing inwards. glm matrices are column major, so the rows are built by hand.
+    const glm::mat4 m = glm::transpose(viewProjection);
+    planes[0] = m[3] + m[0]; // Left
+    planes[1] = m[3] - m[0]; // Right
+    planes[2] = m[3] + m[1]; // Bottom
+    planes[3] = m[3] - m[1]; // Top
+    planes[4] = m[3] + m[2]; // Near
+    planes[5] = m[3] - m[2]; // Far
+
+    for (u32 i = 0; i < 6; ++i)
+        planes[i] /= glm::length(glm::vec3(planes[i]));
+}
+
+void MeshletSupport::CullMeshlets(const SubMesh& subMesh, const glm::vec4 planes[6], const glm::vec3& cameraPositionLocal, const bool cullBackFacing,
+    std::vector<i32>& drawCounts, std::vector<const void*>& drawOffsets, MeshletCullStats& stats)
+{
+    const MeshletBounds& b = subMesh.meshletBounds;
+    const u32 meshletCount = (u32)subMesh.meshlets.size();
+    u32 previousEnd = UINT32_MAX;
+
+    for (u32 base = 0; base < meshletCount; base += 4)
+    {
+        u32 outsideMask = 0;
+        u32 backFacingMask = 0;
+
+#ifdef MESHLET_CULLING_SSE
+        const __m128 cx = _mm_loadu_ps(&b.centerX[base]);
+        const __m128 cy = _mm_loadu_ps(&b.centerY[base]);
+        const __m128 cz = _mm_loadu_ps(&b.centerZ[base]);
+        const __m128 r = _mm_loadu_ps(&b.radius[base]);
+        const __m128 negR = _mm_sub_ps(_mm_setzero_ps(), r);
+
+        __m128 outside = _mm_setzero_ps();
+        for (u32 p = 0; p < 6; ++p)
+        {
+            __m128 d = _mm_mul_ps(cx, _mm_set1_ps(planes[p].x));
+            d = _mm_add_ps(d, _mm_mul_ps(cy, _mm_set1_ps(planes[p].y)));
+            d = _mm_add_ps(d, _mm_mul_ps(cz, _mm_set1_ps(planes[p].z)));
+            d = _mm_add_ps(d, _mm_set1_ps(planes[p].w));
+            outside = _mm_or_ps(outside, _mm_cmplt_ps(d, negR));
+        }
+
+        const __m128 vx = _mm_sub_ps(cx, _mm_set1_ps(cameraPositionLocal.x));
+        const __m128 vy = _mm_sub_ps(cy, _mm_set1_ps(cameraPositionLocal.y));
+        const __m128 vz = _mm_sub_ps(cz, _mm_set1_ps(cameraPositionLocal.z));
+        __m128 viewDot = _mm_mul_ps(vx, _mm_loadu_ps(&b.coneAxisX[base]));
+        viewDot = _mm_add_ps(viewDot, _mm_mul_ps(vy, _mm_loadu_ps(&b.coneAxisY[base])));
+        viewDot = _mm_add_ps(viewDot, _mm_mul_ps(vz, _mm_loadu_ps(&b.coneAxisZ[base])));
+        const __m128 viewLength = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(vx, vx), _mm_mul_ps(vy, vy)), _mm_mul_ps(vz, vz)));
+        const __m128 threshold = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(&b.coneCutoff[base]), viewLength), r);
+
+        outsideMask = (u32)_mm_movemask_ps(outside);
+        backFacingMask = cullBackFacing ? (u32)_mm_movemask_ps(_mm_cmpge_ps(viewDot, threshold)) : 0u;
+#else
+        for (u32 lane = 0; lane < 4; ++lane)
+        {
+            const u32 i = base + lane;
+            const glm::vec3 center(b.centerX[i], b.centerY[i], b.centerZ[i]);
+            for (u32 p = 0; p < 6; ++p)
+                if (glm::dot(glm::vec3(planes[p]), center) + planes[p].w < -b.radius[i])
+                    outsideMask |= 1u << lane;
+
+            const glm::vec3 view = center - cameraPositionLocal;
+            const glm::vec3 axis(b.coneAxisX[i], b.coneAxisY[i], b.coneAxisZ[i]);
+            if (cullBackFacing && glm::dot(view, axis) >= b.coneCutoff[i] * glm::length(view) + b.radius[i])
+                backFacingMask |= 1u << lane;
+        }
+#endif
+
+        const u32 laneCount = glm::min(4u, meshletCount - base);
+        for (u32 lane = 0; lane < laneCount; ++lane)
+        {
+            ++stats.totalMeshlets;
+            if (outsideMask & (1u << lane))
+            {
+                ++stats.frustumCulled;
+                continue;
+            }
+            if (backFacingMask & (1u << lane))
+            {
+                ++stats.backFaceCulled;
+                continue;
+            }
+            ++stats.visibleMeshlets;
+
+            const Meshlet& meshlet = subMesh.meshlets[base + lane];
+            if (meshlet.indexOffset == previousEnd)
+            {
+                drawCounts.back() += (i32)meshlet.indexCount;
+            }
+            else
+            {
+                drawCounts.push_back((i32)meshlet.indexCount);
+                drawOffsets.push_back(reinterpret_cast<const void*>(static_cast<u64>(subMesh.indexOffset + meshlet.indexOffset * sizeof(u32))));
+            }
+            previousEnd = meshlet.indexOffset + meshlet.indexCount;
+        }
+    }
+}
@@ -0,0 +1,61 @@
+﻿#ifndef MESHLET_H
+#define MESHLET_H
+#include <vector>
+
+#include "platform.h"
+
+struct SubMesh;
+
+#define MESHLET_MAX_VERTICES 64
+#define MESHLET_MAX_TRIANGLES 124
+
+/// <summary>
+/// Small cluster of triangles of a subMesh. The triangles of a meshlet are contiguous in the index buffer,
+/// so a meshlet can be drawn as a plain index range.
+/// </summary>
+/// <param name="indexOffset">First index of the meshlet, relative to the subMesh indices.</param>
+/// <param name="indexCount">Num of indices (3 per triangle).</param>
+/// <param name="vertexCount">Num of unique vertices referenced by the meshlet.</param>
+struct Meshlet
+{
+    u32 indexOffset;
+    u32 indexCount;
+    u32 vertexCount;
+};
+
+/// <summary>
+/// Culling data of all the meshlets of a subMesh in SoA layout, padded to a multiple of 4 so it can be tested with SSE.
+/// Bounds are in the local space of the mesh.
+/// </summary>
+/// <param name="center/radius">Bounding sphere.</param>
+/// <param name="coneAxis/coneCutoff">Normal cone, a cutoff of 1 means the cone can never be back-facing.</param>
+struct MeshletBounds
+{
+    std::vector<f32> centerX, centerY, centerZ, radius;
+    std::vector<f32> coneAxisX, coneAxisY, coneAxisZ, coneCutoff;
+};
+
+struct MeshletCullStats
+{
+    u32 totalMeshlets = 0;
+    u32 visibleMeshlets = 0;
+    u32 frustumCulled = 0;
+    u32 backFaceCulled = 0;
+};
+
+struct MeshletSupport
+{
+    // Splits the subMesh indices into meshlets and computes their bounds and normal cones
+    static void BuildMeshlets(SubMesh& subMesh, u32 maxVertices = MESHLET_MAX_VERTICES, u32 maxTriangles = MESHLET_MAX_TRIANGLES);
+
+    // Frustum planes from a (world) view projection matrix, normalized so they can be tested against spheres
+    static void ExtractFrustumPlanes(const glm::mat4& viewProjection, glm::vec4 planes[6]);
+
+    // Tests every meshlet against the frustum and the camera and outputs the visible index ranges (adjacent ranges are merged).
+    // Offsets are in bytes inside the index buffer of the mesh, ready for glMultiDrawElements. The normal cone test only
+    // runs with cullBackFacing, which is only valid when the draws cull back faces (GL_CULL_FACE) as well.
+    static void CullMeshlets(const SubMesh& subMesh, const glm::vec4 planes[6], const glm::vec3& cameraPositionLocal, bool cullBackFacing,
+        std::vector<i32>& drawCounts, std::vector<const void*>& drawOffsets, MeshletCullStats& stats);
+};
+
+#endif // MESHLET_H
@@ -0,0 +1,624 @@
+﻿#include "obj_model_loading.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+
+#include "app.h"
+#include "assimp_model_loading.h"
+#include "mesh_processing.h"
+#include "parallel.h"
+
+#define OBJ_MIN_CHUNK_SIZE KB(256)
+#define OBJ_DEFAULT_MATERIAL_NAME "DefaultMaterial"
+
+// Components of a face corner given with a negative (relative) index
+#define OBJ_RELATIVE_V  (1 << 0)
+#define OBJ_RELATIVE_VT (1 << 1)
+#define OBJ_RELATIVE_VN (1 << 2)
+
+/// <summary>
+/// Face corner, 0 based indices into the positions, texture coordinates and normals of the file, -1 when missing.
+/// </summary>
+struct ObjCorner
+{
+    i32 v;
+    i32 vt;
+    i32 vn;
+
+    bool operator==(const ObjCorner& other) const { return v == other.v && vt == other.vt && vn == other.vn; }
+};
+
+struct ObjCornerHash
+{
+    size_t operator()(const ObjCorner& corner) const
+    {
+        u64 hash = static_cast<u32>(corner.v) * 0x9E3779B97F4A7C15ull;
+        hash ^= static_cast<u32>(corner.vt) * 0xC2B2AE3D27D4EB4Full + (hash << 6) + (hash >> 2);
+        hash ^= static_cast<u32>(corner.vn) * 0x165667B19E3779F9ull + (hash << 6) + (hash >> 2);
+        return static_cast<size_t>(hash);
+    }
+};
+
+/// <summary>
+/// Result of parsing a range of lines of the OBJ. Faces are already triangulated (3 corners per triangle).
+/// Relative indices are resolved against the chunk counts and fixed once the counts of the previous chunks are known.
+/// </summary>
+struct ObjChunk
+{
+    const char* begin;
+    const char* end;
+
+    std::vector<vec3> positions;
+    std::vector<vec2> texCoords;
+    std::vector<vec3> normals;
+    std::vector<ObjCorner> corners;
+    std::vector<std::pair<u32, u8>> relativeCorners;
+    std::vector<std::pair<u32, std::string>> materialSwitches; // First corner drawn with each usemtl
+    std::vector<std::string> materialLibraries;
+};
+
+/// <summary>
+/// Corners of all the chunks that use the same material, as ranges to avoid copying them.
+/// </summary>
+struct ObjMaterialGroup
+{
+    std::string materialName;
+    std::vector<std::pair<const ObjCorner*, u32>> ranges;
+};
+
+static const char* SkipSpaces(const char* c, const char* end)
+{
+    while (c < end && (*c == ' ' || *c == '\t' || *c == '\r'))
+        ++c;
+    return c;
+}
+
+static const char* SkipLine(const char* c, const char* end)
+{
+    while (c < end && *c != '\n')
+        ++c;
+    return c < end ? c + 1 : end;
+}
+
+static bool StartsWith(const char* c, const char* end, const char* keyword)
+{
+    const size_t length = strlen(keyword);
+    return static_cast<size_t>(end - c) > length && strncmp(c, keyword, length) == 0;
+}
+
+static bool IsLineEnd(const char* c, const char* end)
+{
+    return c >= end || *c == '\n' || *c == '#';
+}
+
+// Rest of the line without the leading and trailing spaces
+static std::string ReadLineString(const char* c, const char* end)
+{
+    c = SkipSpaces(c, end);
+    const char* last = c;
+    while (last < end && *last != '\n')
+        ++last;
+    while (last > c && (last[-1] == ' ' || last[-1] == '\t' || last[-1] == '\r'))
+        --last;
+    return std::string(c, last);
+}
+
+// Last token of the line, texture statements may have options before the file name (e.g. "bump -bm 0 file.png")
+static std::string ReadLastToken(const char* c, const char* end)
+{
+    const std::string line = ReadLineString(c, end);
+    const size_t lastSpace = line.find_last_of(" \t");
+    return lastSpace == std::string::npos ? line : line.substr(lastSpace + 1);
+}
+
+// Decimal parser without locale or error handling, enough for the floats exported by DCC tools
+static f32 ParseFloat(const char*& c, const char* end)
+{
+    static const f64 powersOf10[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18 };
+
+    c = SkipSpaces(c, end);
+    bool negative = false;
+    if (c < end && (*c == '-' || *c == '+'))
+        negative = *c++ == '-';
+
+    u64 mantissa = 0;
+    i32 exponent = 0;
+    u32 digits = 0;
+    for (; c < end && *c >= '0' && *c <= '9'; ++c)
+    {
+        if (digits++ < 18)
+            mantissa = mantissa * 10 + (*c - '0');
+        else
+            ++exponent;
+    }
+    if (c < end && *c == '.')
+    {
+        for (++c; c < end && *c >= '0' && *c <= '9'; ++c)
+        {
+            if (digits++ < 18)
+            {
+                mantissa = mantissa * 10 + (*c - '0');
+                --exponent;
+            }
+        }
+    }
+    if (c < end && (*c == 'e' || *c == 'E'))
+    {
+        ++c;
+        bool negativeExponent = false;
+        if (c < end && (*c == '-' || *c == '+'))
+            negativeExponent = *c++ == '-';
+        i32 explicitExponent = 0;
+        for (; c < end && *c >= '0' && *c <= '9'; ++c)
+            explicitExponent = explicitExponent * 10 + (*c - '0');
+        exponent += negativeExponent ? -explicitExponent : explicitExponent;
+    }
+
+    f64 value = static_cast<f64>(mantissa);
+    if (exponent != 0)
+    {
+        const u32 absExponent = static_cast<u32>(exponent < 0 ? -exponent : exponent);
+        const f64 scale = absExponent < ARRAY_COUNT(powersOf10) ? powersOf10[absExponent] : pow(10.0, absExponent);
+        value = exponent < 0 ? value / scale : value * scale;
+    }
+    return static_cast<f32>(negative ? -value : value);
+}
+
+static i32 ParseInt(const char*& c, const char* end)
+{
+    bool negative = false;
+    if (c < end && (*c == '-' || *c == '+'))
+        negative = *c++ == '-';
+    i32 value = 0;
+    for (; c < end && *c >= '0' && *c <= '9'; ++c)
+        value = value * 10 + (*c - '0');
+    return negative ? -value : value;
+}
+
+// OBJ indices are 1 based, negative indices are relative to the elements read so far
+static i32 ResolveIndex(const i32 index, const u32 countSoFar, u8& relativeFlags, const u8 relativeFlag)
+{
+    if (index > 0)
+        return index - 1;
+    if (index < 0)
+    {
+        relativeFlags |= relativeFlag;
+        return static_cast<i32>(countSoFar) + index;
+    }
+    return -1;
+}
+
+static void ParseObjChunk(ObjChunk& chunk)
+{
+    std::vector<ObjCorner> polygon;
+    std::vector<u8> polygonRelativeFlags;
+
+    const char* end = chunk.end;
+    const char* c = chunk.begin;
+    while (c < end)
+    {
+        c = SkipSpaces(c, end);
+        if (c + 1 >= end)
+            break;
+
+        if (c[0] == 'v' && (c[1] == ' ' || c[1] == '\t'))
+        {
+            c += 1;
+            vec3 position;
+            position.x = ParseFloat(c, end);
+            position.y = ParseFloat(c, end);
+            position.z = ParseFloat(c, end);
+            chunk.positions.push_back(position);
+        }
+        else if (c[0] == 'v' && c[1] == 't')
+        {
+            c += 2;
+            vec2 texCoord;
+            texCoord.x = ParseFloat(c, end);
+            texCoord.y = ParseFloat(c, end);
+            chunk.texCoords.push_back(texCoord);
+        }
+        else if (c[0] == 'v' && c[1] == 'n')
+        {
+            c += 2;
+            vec3 normal;
+            normal.x = ParseFloat(c, end);
+            normal.y = ParseFloat(c, end);
+            normal.z = ParseFloat(c, end);
+            chunk.normals.push_back(normal);
+        }
+        else if (c[0] == 'f' && (c[1] == ' ' || c[1] == '\t'))
+        {
+            c += 1;
+            polygon.clear();
+            polygonRelativeFlags.clear();
+            for (c = SkipSpaces(c, end); !IsLineEnd(c, end); c = SkipSpaces(c, end))
+            {
+                u8 relativeFlags = 0;
+                ObjCorner corner = { -1, -1, -1 };
+                corner.v = ResolveIndex(ParseInt(c, end), static_cast<u32>(chunk.positions.size()), relativeFlags, OBJ_RELATIVE_V);
+                if (c < end && *c == '/')
+                {
+                    ++c;
+                    if (c < end && *c != '/')
+                        corner.vt = ResolveIndex(ParseInt(c, end), static_cast<u32>(chunk.texCoords.size()), relativeFlags, OBJ_RELATIVE_VT);
+                    if (c < end && *c == '/')
+                    {
+                        ++c;
+                        corner.vn = ResolveIndex(ParseInt(c, end), static_cast<u32>(chunk.normals.size()), relativeFlags, OBJ_RELATIVE_VN);
+                    }
+                }
+                // Skip anything unexpected so a malformed corner can not stall the parser
+                while (c < end && *c != ' ' && *c != '\t' && *c != '\r' && *c != '\n')
+                    ++c;
+
+                polygon.push_back(corner);
+                polygonRelativeFlags.push_back(relativeFlags);
+            }
+
+            // Triangle fan
+            for (u32 k = 1; k + 1 < polygon.size(); ++k)
+            {
+                const u32 fan[3] = { 0, k, k + 1 };
+                for (const u32 f : fan)
+                {
+                    if (polygonRelativeFlags[f] != 0)
+                        chunk.relativeCorners.emplace_back(static_cast<u32>(chunk.corners.size()), polygonRelativeFlags[f]);
+                    chunk.corners.push_back(polygon[f]);
+                }
+            }
+        }
+        else if (StartsWith(c, end, "usemtl"))
+        {
+            chunk.materialSwitches.emplace_back(static_cast<u32>(chunk.corners.size()), ReadLineString(c + 6, end));
+        }
+        else if (StartsWith(c, end, "mtllib"))
+        {
+            chunk.materialLibraries.push_back(ReadLineString(c + 6, end));
+        }
+
+        c = SkipLine(c, end);
+    }
+}
+
+// Dedupes the corners of a material group into indexed vertices, generating smooth normals and tangents when needed
+static void BuildObjSubMesh(const ObjMaterialGroup& group, const std::vector<vec3>& positions, const std::vector<vec2>& texCoords,
+    const std::vector<vec3>& normals, SubMesh& subMesh)
+{
+    bool hasTexCoords = false;
+    bool generateNormals = false;
+    u32 cornerCount = 0;
+    for (const std::pair<const ObjCorner*, u32>& range : group.ranges)
+    {
+        for (u32 i = 0; i < range.second; ++i)
+        {
+            hasTexCoords |= range.first[i].vt >= 0;
+            generateNormals |= range.first[i].vn < 0;
+        }
+        cornerCount += range.second;
+    }
+
+    std::unordered_map<ObjCorner, u32, ObjCornerHash> uniqueCorners;
+    uniqueCorners.reserve(cornerCount / 2);
+    std::vector<i32> vertexPositions;
+    std::vector<vec2> vertexTexCoords;
+    std::vector<vec3> vertexNormals;
+    std::vector<u32> indices;
+    indices.reserve(cornerCount);
+
+    for (const std::pair<const ObjCorner*, u32>& range : group.ranges)
+    {
+        for (u32 i = 0; i + 2 < range.second; i += 3)
+        {
+            const ObjCorner* triangle = range.first + i;
+            bool valid = true;
+            for (u32 k = 0; k < 3; ++k)
+            {
+                valid &= triangle[k].v >= 0 && triangle[k].v < static_cast<i32>(positions.size());
+                valid &= triangle[k].vt < static_cast<i32>(texCoords.size()) && triangle[k].vn < static_cast<i32>(normals.size());
+            }
+            if (!valid)
+                continue;
+
+            for (u32 k = 0; k < 3; ++k)
+            {
+                const ObjCorner key = { triangle[k].v, hasTexCoords ? triangle[k].vt : -1, generateNormals ? -1 : triangle[k].vn };
+                const auto inserted = uniqueCorners.emplace(key, static_cast<u32>(vertexPositions.size()));
+                if (inserted.second)
+                {
+                    vertexPositions.push_back(key.v);
+                    vertexTexCoords.push_back(key.vt >= 0 ? texCoords[key.vt] : vec2(0.0f));
+                    vertexNormals.push_back(key.vn >= 0 ? normals[key.vn] : vec3(0.0f));
+                }
+                indices.push_back(inserted.first->second);
+            }
+        }
+    }
+    const u32 vertexCount = static_cast<u32>(vertexPositions.size());
+
+    // Smooth normals shared by all the vertices in the same position, weighted by the triangle area
+    if (generateNormals)
+    {
+        std::unordered_map<i32, vec3> positionNormals;
+        positionNormals.reserve(vertexCount);
+        for (u32 i = 0; i + 2 < indices.size(); i += 3)
+        {
+            const vec3& a = positions[vertexPositions[indices[i + 0]]];
+            const vec3& b = positions[vertexPositions[indices[i + 1]]];
+            const vec3& c = positions[vertexPositions[indices[i + 2]]];
+            const vec3 faceNormal = glm::cross(b - a, c - a);
+            for (u32 k = 0; k < 3; ++k)
+                positionNormals[vertexPositions[indices[i + k]]] += faceNormal;
+        }
+        for (u32 v = 0; v < vertexCount; ++v)
+        {
+            const vec3 normal = positionNormals[vertexPositions[v]];
+            vertexNormals[v] = glm::dot(normal, normal) > 0.0f ? glm::normalize(normal) : vec3(0.0f, 1.0f, 0.0f);
+        }
+    }
+
+    // Tangent space from the texture coordinates derivatives
+    std::vector<vec3> vertexTangents;
+    std::vector<vec3> vertexBitangents;
+    if (hasTexCoords)
+    {
+        std::vector<vec3> vertexPositionValues(vertexCount);
+        for (u32 v = 0; v < vertexCount; ++v)
+            vertexPositionValues[v] = positions[vertexPositions[v]];
+        MeshProcessingSupport::GenerateTangentSpace(vertexPositionValues, vertexTexCoords, vertexNormals, indices, vertexTangents, vertexBitangents);
+    }
+
+    // Same vertex format as AssimpSupport::ProcessAssimpMesh
+    VertexBufferLayout vertexBufferLayout = {};
+    vertexBufferLayout.attributes.push_back( VertexBufferAttribute{ static_cast<int>(VERTEX_ATTRIBUTE_LOCATION::ATTR_LOCATION_POSITION), 3, 0 } );
+    vertexBufferLayout.attributes.push_back( VertexBufferAttribute{ static_cast<int>(VERTEX_ATTRIBUTE_LOCATION::ATTR_LOCATION_NORMAL), 3, 3*sizeof(float) } );
+    vertexBufferLayout.stride = 6 * sizeof(float);
+    if (hasTexCoords)
+    {
+        vertexBufferLayout.attributes.push_back( VertexBufferAttribute{ static_cast<int>(VERTEX_ATTRIBUTE_LOCATION::ATTR_LOCATION_TEXTCOORD), 2, vertexBufferLayout.stride } );
+        vertexBufferLayout.stride += 2 * sizeof(float);
+        vertexBufferLayout.attributes.push_back( VertexBufferAttribute{ static_cast<int>(VERTEX_ATTRIBUTE_LOCATION::ATTR_LOCATION_TANGENT), 3, vertexBufferLayout.stride } );
+        vertexBufferLayout.stride += 3 * sizeof(float);
+        vertexBufferLayout.attributes.push_back( VertexBufferAttribute{ static_cast<int>(VERTEX_ATTRIBUTE_LOCATION::ATTR_LOCATION_BITANGENT), 3, vertexBufferLayout.stride } );
+        vertexBufferLayout.stride += 3 * sizeof(float);
+    }
+
+    std::vector<float>& vertices = subMesh.vertices;
+    vertices.reserve(vertexCount * (vertexBufferLayout.stride / sizeof(float)));
+    for (u32 v = 0; v < vertexCount; ++v)
+    {
+        const vec3& position = positions[vertexPositions[v]];
+        vertices.insert(vertices.end(), { position.x, position.y, position.z, vertexNormals[v].x, vertexNormals[v].y, vertexNormals[v].z });
+        if (hasTexCoords)
+        {
+            vertices.insert(vertices.end(), { vertexTexCoords[v].x, vertexTexCoords[v].y });
+            vertices.insert(vertices.end(), { vertexTangents[v].x, vertexTangents[v].y, vertexTangents[v].z });
+            vertices.insert(vertices.end(), { vertexBitangents[v].x, vertexBitangents[v].y, vertexBitangents[v].z });
+        }
+    }
+
+    subMesh.vertexBufferLayout = vertexBufferLayout;
+    subMesh.indices.swap(indices);
+    subMesh.vertexCount = vertexCount;
+    subMesh.indexCount = static_cast<u32>(subMesh.indices.size());
+}
+
+bool ObjSupport::ParseObj(const char* filename, ObjScene& scene)
+{
+    MappedFile file;
+    if (!MapFile(filename, file))
+    {
+        ELOG("Error loading mesh %s: could not open the file", filename)
+        return false;
+    }
+
+    const char* data = reinterpret_cast<const char*>(file.data);
+    const char* dataEnd = data + file.size;
+
+    // Split at line boundaries, every chunk is parsed by its own task
+    const u32 maxChunks = std::max(std::thread::hardware_concurrency(), 1u) * 4;
+    const u32 chunkCount = static_cast<u32>(std::clamp<u64>(file.size / OBJ_MIN_CHUNK_SIZE, 1, maxChunks));
+    std::vector<ObjChunk> chunks(chunkCount);
+    const char* chunkBegin = data;
+    for (u32 k = 0; k < chunkCount; ++k)
+    {
+        const char* chunkEnd = k + 1 == chunkCount ? dataEnd : SkipLine(std::max(chunkBegin, data + file.size * (k + 1) / chunkCount), dataEnd);
+        chunks[k].begin = chunkBegin;
+        chunks[k].end = chunkEnd;
+        chunkBegin = chunkEnd;
+    }
+    ParallelFor(chunkCount, [&](const u32 k) { ParseObjChunk(chunks[k]); });
+
+    // Global element arrays, each chunk is copied at its base offset
+    std::vector<u32> positionBase(chunkCount), texCoordBase(chunkCount), normalBase(chunkCount);
+    u32 positionCount = 0, texCoordCount = 0, normalCount = 0;
+    for (u32 k = 0; k < chunkCount; ++k)
+    {
+        positionBase[k] = positionCount;
+        texCoordBase[k] = texCoordCount;
+        normalBase[k] = normalCount;
+        positionCount += static_cast<u32>(chunks[k].positions.size());
+        texCoordCount += static_cast<u32>(chunks[k].texCoords.size());
+        normalCount += static_cast<u32>(chunks[k].normals.size());
+    }
+    std::vector<vec3> positions(positionCount);
+    std::vector<vec2> texCoords(texCoordCount);
+    std::vector<vec3> normals(normalCount);
+    ParallelFor(chunkCount, [&](const u32 k)
+    {
+        ObjChunk& chunk = chunks[k];
+        std::copy(chunk.positions.begin(), chunk.positions.end(), positions.begin() + positionBase[k]);
+        std::copy(chunk.texCoords.begin(), chunk.texCoords.end(), texCoords.begin() + texCoordBase[k]);
+        std::copy(chunk.normals.begin(), chunk.normals.end(), normals.begin() + normalBase[k]);
+        for (const std::pair<u32, u8>& relative : chunk.relativeCorners)
+        {
+            ObjCorner& corner = chunk.corners[relative.first];
+            if (relative.second & OBJ_RELATIVE_V)  corner.v  += static_cast<i32>(positionBase[k]);
+            if (relative.second & OBJ_RELATIVE_VT) corner.vt += static_cast<i32>(texCoordBase[k]);
+            if (relative.second & OBJ_RELATIVE_VN) corner.vn += static_cast<i32>(normalBase[k]);
+        }
+    });
+
+    // Group the corners by material, the current material carries over from one chunk to the next
+    std::vector<ObjMaterialGroup> groups;
+    std::unordered_map<std::string, u32> groupByMaterial;
+    std::string currentMaterial = OBJ_DEFAULT_MATERIAL_NAME;
+    std::vector<std::string> materialLibraries;
+    for (const ObjChunk& chunk : chunks)
+    {
+        materialLibraries.insert(materialLibraries.end(), chunk.materialLibraries.begin(), chunk.materialLibraries.end());
+
+        u32 rangeBegin = 0;
+        for (u32 s = 0; s <= chunk.materialSwitches.size(); ++s)
+        {
+            const u32 rangeEnd = s < chunk.materialSwitches.size() ? chunk.materialSwitches[s].first : static_cast<u32>(chunk.corners.size());
+            if (rangeEnd > rangeBegin)
+            {
+                const auto inserted = groupByMaterial.emplace(currentMaterial, static_cast<u32>(groups.size()));
+                if (inserted.second)
+                    groups.push_back({ currentMaterial, {} });
+                groups[inserted.first->second].ranges.emplace_back(chunk.corners.data() + rangeBegin, rangeEnd - rangeBegin);
+            }
+            if (s < chunk.materialSwitches.size())
+                currentMaterial = chunk.materialSwitches[s].second;
+            rangeBegin = rangeEnd;
+        }
+    }
+
+    // Materials of every library, plus the default one for faces without (known) material
+    const std::string directory = GetDirectoryPart(MakeString(filename));
+    for (const std::string& materialLibrary : materialLibraries)
+        ParseMtl(MakePath(directory, materialLibrary).c_str(), scene.materials);
+
+    scene.subMeshes.reserve(groups.size());
+    for (const ObjMaterialGroup& group : groups)
+    {
+        u32 materialIdx = 0;
+        while (materialIdx < scene.materials.size() && scene.materials[materialIdx].name != group.materialName)
+            ++materialIdx;
+        if (materialIdx == scene.materials.size())
+        {
+            ObjMaterial defaultMaterial;
+            defaultMaterial.name = group.materialName;
+            scene.materials.push_back(defaultMaterial);
+        }
+        scene.subMeshes.emplace_back(group.materialName.c_str());
+        scene.subMeshMaterials.push_back(materialIdx);
+    }
+    ParallelFor(static_cast<u32>(groups.size()), [&](const u32 g) { BuildObjSubMesh(groups[g], positions, texCoords, normals, scene.subMeshes[g]); });
+
+    const std::string path = MakeString(filename);
+    scene.name = path.substr(path.find_last_of("\\/") + 1);
+
+    UnmapFile(file);
+    return true;
+}
+
+void ObjSupport::ParseMtl(const char* filename, std::vector<ObjMaterial>& materials)
+{
+    const std::string text = ReadTextFile(filename);
+    const char* end = text.data() + text.size();
+    ObjMaterial* material = nullptr;
+
+    for (const char* c = text.data(); c < end; c = SkipLine(c, end))
+    {
+        c = SkipSpaces(c, end);
+        if (strncmp(c, "newmtl", 6) == 0)
+        {
+            materials.emplace_back();
+            material = &materials.back();
+            material->name = ReadLineString(c + 6, end);
+            continue;
+        }
+        if (material == nullptr)
+            continue;
+
+        if (strncmp(c, "Kd", 2) == 0)
+        {
+            c += 2;
+            material->albedo.r = ParseFloat(c, end);
+            material->albedo.g = ParseFloat(c, end);
+            material->albedo.b = ParseFloat(c, end);
+        }
+        else if (strncmp(c, "Ke", 2) == 0)
+        {
+            c += 2;
+            material->emissive.r = ParseFloat(c, end);
+            material->emissive.g = ParseFloat(c, end);
+            material->emissive.b = ParseFloat(c, end);
+        }
+        else if (strncmp(c, "Ns", 2) == 0)
+        {
+            c += 2;
+            material->shininess = ParseFloat(c, end);
+        }
+        else if (strncmp(c, "map_Kd", 6) == 0)
+            material->albedoMap = ReadLastToken(c + 6, end);
+        else if (strncmp(c, "map_Ke", 6) == 0)
+            material->emissiveMap = ReadLastToken(c + 6, end);
+        else if (strncmp(c, "map_Ks", 6) == 0)
+            material->specularMap = ReadLastToken(c + 6, end);
+        else if (strncmp(c, "map_bump", 8) == 0 || strncmp(c, "map_Bump", 8) == 0)
+            material->heightMap = ReadLastToken(c + 8, end);
+        else if (strncmp(c, "bump", 4) == 0)
+            material->heightMap = ReadLastToken(c + 4, end);
+    }
+}
+
+bool ObjSupport::ImportModel(const char* filename, ModelImport& import)
+{
+    ObjScene scene;
+    if (!ParseObj(filename, scene))
+        return false;
+
+    // Mesh and model named like the assimp import
+    import.modelName = "Model_" + scene.name;
+    import.mesh = Mesh(("Mesh_" + scene.name).c_str());
+
+    const std::string directory = GetDirectoryPart(MakeString(filename));
+
+    // Materials, read the same way as AssimpSupport::ProcessAssimpMaterial
+    import.materials.resize(scene.materials.size());
+    import.texturePaths.resize(scene.materials.size() * MMT_COUNT);
+    for (u32 m = 0; m < scene.materials.size(); ++m)
+    {
+        const ObjMaterial& objMaterial = scene.materials[m];
+        Material& material = import.materials[m];
+        material.name = objMaterial.name;
+        material.albedo = objMaterial.albedo;
+        material.emissive = objMaterial.emissive;
+        material.smoothness = objMaterial.shininess / 256.0f;
+
+        std::string* texturePaths = &import.texturePaths[m * MMT_COUNT];
+        if (!objMaterial.albedoMap.empty())
+            texturePaths[MMT_ALBEDO] = MakePath(directory, objMaterial.albedoMap);
+        if (!objMaterial.emissiveMap.empty())
+            texturePaths[MMT_EMISSIVE] = MakePath(directory, objMaterial.emissiveMap);
+        if (!objMaterial.specularMap.empty())
+            texturePaths[MMT_SPECULAR] = MakePath(directory, objMaterial.specularMap);
+        if (!objMaterial.heightMap.empty())
+            AssimpSupport::GetHeightMapTexturePaths(directory, objMaterial.heightMap, texturePaths);
+    }
+
+    import.mesh.subMeshes.swap(scene.subMeshes);
+    import.subMeshMaterials.swap(scene.subMeshMaterials);
+    return true;
+}
+
+void ObjSupport::BenchmarkAgainstAssimp(const char* filename)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+    const aiScene* assimpScene = aiImportFile(filename, ASSIMP_IMPORT_FLAGS);
+    const f64 assimpMs = std::chrono::duration<f64, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    aiReleaseImport(assimpScene);
+
+    start = std::chrono::high_resolution_clock::now();
+    ObjScene scene;
+    ParseObj(filename, scene);
+    const f64 nativeMs = std::chrono::duration<f64, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+    ILOG("OBJ benchmark %s: assimp %.2f ms, native parser %.2f ms (%.1fx, %u threads)", filename, assimpMs, nativeMs,
+        nativeMs > 0.0 ? assimpMs / nativeMs : 0.0, std::thread::hardware_concurrency())
+}
@@ -0,0 +1,49 @@
+﻿#ifndef OBJ_MODEL_LOADING_H
+#define OBJ_MODEL_LOADING_H
+#include <vector>
+
+#include "platform.h"
+
+struct SubMesh;
+struct ModelImport;
+
+/// <summary>
+/// Material as described in a MTL file, textures are file names relative to the model directory.
+/// </summary>
+struct ObjMaterial
+{
+    std::string name;
+    vec3 albedo = vec3(0.6f);
+    vec3 emissive = vec3(0.0f);
+    f32 shininess = 0.0f;
+    std::string albedoMap;
+    std::string emissiveMap;
+    std::string specularMap;
+    std::string heightMap;
+};
+
+/// <summary>
+/// CPU side result of parsing an OBJ file, one subMesh per used material (like assimp after OptimizeMeshes).
+/// </summary>
+struct ObjScene
+{
+    std::string name;
+    std::vector<ObjMaterial> materials;
+    std::vector<SubMesh> subMeshes;
+    std::vector<u32> subMeshMaterials;
+};
+
+struct ObjSupport
+{
+    // Same output as AssimpSupport::ImportModel (Mesh, SubMeshes, Materials) without going through assimp
+    static bool ImportModel(const char* filename, ModelImport& import);
+
+    // Parses the OBJ in parallel chunks, then dedupes vertices and generates normals and tangents per subMesh in parallel
+    static bool ParseObj(const char* filename, ObjScene& scene);
+    static void ParseMtl(const char* filename, std::vector<ObjMaterial>& materials);
+
+    // Logs the time of parsing the file with assimp and with ParseObj (CPU only, nothing is uploaded)
+    static void BenchmarkAgainstAssimp(const char* filename);
+};
+
+#endif // OBJ_MODEL_LOADING_H
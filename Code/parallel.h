@@ -0,0 +1,31 @@
+﻿#ifndef PARALLEL_H
+#define PARALLEL_H
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <thread>
+#include <vector>
+
+#include "platform.h"
+
+// Runs body(i) for every i in [0, count) spread over the hardware threads, returns when all of them are done.
+// The body must not touch OpenGL, the context only lives in the main thread.
+inline void ParallelFor(const u32 count, const std::function<void(u32)>& body)
+{
+    const u32 threadCount = std::min(count, std::max(std::thread::hardware_concurrency(), 1u));
+    if (threadCount <= 1)
+    {
+        for (u32 i = 0; i < count; ++i)
+            body(i);
+        return;
+    }
+
+    std::atomic<u32> next = 0;
+    std::vector<std::thread> threads;
+    for (u32 t = 0; t < threadCount; ++t)
+        threads.emplace_back([&]() { for (u32 i = next++; i < count; i = next++) body(i); });
+    for (std::thread& thread : threads)
+        thread.join();
+}
+
+#endif // PARALLEL_H
@@ -12,6 +12,8 @@
 #else
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
 #include <unistd.h>
 #endif
 
@@ -323,6 +325,8 @@ int main()
         GlobalFrameArenaHead = 0;
     }
 
+    Shutdown(&app);
+
     free(GlobalFrameArenaMemory);
 
     ImGui_ImplOpenGL3_Shutdown();
@@ -391,6 +395,14 @@ std::string GetDirectoryPart(const std::string& path) {
     return path.substr(0, pos);
 }
 
+std::string GetFilenamePart(const std::string& path) {
+    size_t pos = path.find_last_of("/\\");
+    if (pos == std::string::npos) {
+        return path;
+    }
+    return path.substr(pos + 1);
+}
+
 std::string ReadTextFile(const char* filepath) {
     std::string fileText;
     FILE* file = fopen(filepath, "rb");
@@ -435,6 +447,77 @@ u64 GetFileLastWriteTimestamp(const char* filepath)
     return 0;
 }
 
+bool MapFile(const char* filepath, MappedFile& mappedFile)
+{
+    mappedFile = {};
+#ifdef _WIN32
+    HANDLE file = CreateFileA(filepath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+    {
+        CloseHandle(file);
+        return false;
+    }
+
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (mapping == NULL)
+    {
+        CloseHandle(file);
+        return false;
+    }
+
+    const void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (view == NULL)
+    {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+
+    mappedFile.data = static_cast<const u8*>(view);
+    mappedFile.size = static_cast<u64>(fileSize.QuadPart);
+    mappedFile.fileHandle = file;
+    mappedFile.mappingHandle = mapping;
+#else
+    const int file = open(filepath, O_RDONLY);
+    if (file < 0)
+        return false;
+
+    struct stat attrib;
+    if (fstat(file, &attrib) != 0 || attrib.st_size == 0)
+    {
+        close(file);
+        return false;
+    }
+
+    void* view = mmap(nullptr, attrib.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+    close(file); // The mapping keeps its own reference to the file
+    if (view == MAP_FAILED)
+        return false;
+
+    mappedFile.data = static_cast<const u8*>(view);
+    mappedFile.size = static_cast<u64>(attrib.st_size);
+#endif
+    return true;
+}
+
+void UnmapFile(MappedFile& mappedFile)
+{
+    if (mappedFile.data == nullptr)
+        return;
+#ifdef _WIN32
+    UnmapViewOfFile(mappedFile.data);
+    CloseHandle(mappedFile.mappingHandle);
+    CloseHandle(mappedFile.fileHandle);
+#else
+    munmap(const_cast<u8*>(mappedFile.data), mappedFile.size);
+#endif
+    mappedFile = {};
+}
+
 void LogString(const char* str)
 {
 #ifdef _WIN32
@@ -74,6 +74,8 @@ std::string MakePath(const std::string& dir, const std::string& filename);
 
 std::string GetDirectoryPart(const std::string& path);
 
+std::string GetFilenamePart(const std::string& path);
+
 /**
  * Reads a whole file and returns a string with its contents. The returned string
  * is temporary and should be copied if it needs to persist for several frames.
@@ -86,6 +88,26 @@ std::string ReadTextFile(const char *filepath);
  */
 u64 GetFileLastWriteTimestamp(const char *filepath);
 
+/**
+ * Read-only memory mapping of a whole file. The contents can be handed straight to
+ * the GPU without copying them into the heap first.
+ */
+struct MappedFile
+{
+    const u8* data = nullptr;
+    u64       size = 0;
+    void*     fileHandle = nullptr;
+    void*     mappingHandle = nullptr;
+};
+
+/**
+ * Maps a file for reading. Returns false (and an empty MappedFile) when the file
+ * does not exist or can not be mapped.
+ */
+bool MapFile(const char *filepath, MappedFile& mappedFile);
+
+void UnmapFile(MappedFile& mappedFile);
+
 /**
  * It logs a string to whichever outputs are configured in the platform layer.
  * By default, the string is printed in the output console of VisualStudio.
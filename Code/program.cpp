@@ -133,6 +133,42 @@ GLuint ShaderSupport::CreateProgramFromSource(const std::string& shaderSourceVer
     return programHandle;
 }
 
+GLuint ShaderSupport::CreateComputeProgramFromSource(const std::string& shaderSource, const char* shaderName)
+{
+    GLchar infoLogBuffer[1024] = {};
+    GLsizei infoLogBufferSize = sizeof(infoLogBuffer);
+    GLsizei infoLogSize;
+    GLint success;
+    const char* cShaderSource = shaderSource.c_str();
+
+    const GLuint cShader = glCreateShader(GL_COMPUTE_SHADER);
+    glShaderSource(cShader, 1, &cShaderSource, NULL);
+    glCompileShader(cShader);
+    glGetShaderiv(cShader, GL_COMPILE_STATUS, &success);
+    if (!success)
+    {
+        glGetShaderInfoLog(cShader, infoLogBufferSize, &infoLogSize, infoLogBuffer);
+        ELOG("glCompileShader() failed with compute shader %s\nReported message:\n%s\n", shaderName, infoLogBuffer)
+    }
+
+    const GLuint programHandle = glCreateProgram();
+    glAttachShader(programHandle, cShader);
+    glLinkProgram(programHandle);
+    glGetProgramiv(programHandle, GL_LINK_STATUS, &success);
+    if (!success)
+    {
+        glGetProgramInfoLog(programHandle, infoLogBufferSize, &infoLogSize, infoLogBuffer);
+        ELOG("glLinkProgram() failed with program %s\nReported message:\n%s\n", shaderName, infoLogBuffer)
+    }
+
+    glUseProgram(0);
+
+    glDetachShader(programHandle, cShader);
+    glDeleteShader(cShader);
+
+    return programHandle;
+}
+
 u32 ShaderSupport::LoadProgram(App* app, const char* filepath, const char* programName)
 {
     const std::string programSource = ReadTextFile(filepath);
@@ -159,4 +195,74 @@ u32 ShaderSupport::LoadProgram(App* app, const char* filepathVert, const char* f
     app->programs.push_back(program);
 
     return app->programs.size() - 1;
-}
\ No newline at end of file
+}
+
+u32 ShaderSupport::LoadProgram(App* app, const char* filepathVert, const char* filepathFrag, const char* programName, const std::string& defines)
+{
+    const std::string programSourceVert = InsertDefines(ReadTextFile(filepathVert), defines);
+    const std::string programSourceFrag = InsertDefines(ReadTextFile(filepathFrag), defines);
+    Program program = {};
+    program.handle = CreateProgramFromSource(programSourceVert, programSourceFrag, programName);
+    program.filePaths.emplace_back(filepathVert);
+    program.filePaths.emplace_back(filepathFrag);
+    program.programName = programName;
+    program.lastWriteTimestamp = GetFileLastWriteTimestamp(filepathVert);
+    program.defines = defines;
+    app->programs.push_back(program);
+
+    return app->programs.size() - 1;
+}
+
+std::string ShaderSupport::InsertDefines(const std::string& source, const std::string& defines)
+{
+    if (defines.empty())
+        return source;
+
+    // The #version directive must stay the first statement of the source
+    const size_t versionPos = source.find("#version");
+    if (versionPos == std::string::npos)
+        return defines + source;
+
+    const size_t lineEnd = source.find('\n', versionPos);
+    if (lineEnd == std::string::npos)
+        return source + "\n" + defines;
+
+    std::string result = source;
+    result.insert(lineEnd + 1, defines);
+    return result;
+}
+
+u32 ShaderSupport::LoadComputeProgram(App* app, const char* filepath, const char* programName)
+{
+    const std::string programSource = ReadTextFile(filepath);
+    Program program = {};
+    program.handle = CreateComputeProgramFromSource(programSource, programName);
+    program.filePaths.emplace_back(filepath);
+    program.programName = programName;
+    program.lastWriteTimestamp = GetFileLastWriteTimestamp(filepath);
+    program.isCompute = true;
+    app->programs.push_back(program);
+
+    return app->programs.size() - 1;
+}
+
+void ShaderSupport::FillVertexInputLayout(Program& program)
+{
+    int programAttributesCount = 0;
+    glGetProgramiv(program.handle, GL_ACTIVE_ATTRIBUTES, &programAttributesCount);
+    for (int i = 0; i < programAttributesCount; ++i)
+    {
+        // Vertex Shader Attribute debug info
+        char attributeName[64];
+        i32 attributeNameLength;
+        i32 attributeSize;
+        u32 attributeType;
+        glGetActiveAttrib(program.handle, i, std::size(attributeName), &attributeNameLength, &attributeSize, &attributeType, attributeName);
+        const u32 attributeLocation = glGetAttribLocation(program.handle, attributeName);
+        std::cout << "Program name: " << program.programName << ", Attribute index: " << i << ", Name: " << attributeName << ", Size: " << attributeSize <<
+            ", Type: " << convertOpenGLDataTypeToString(attributeType) << ", Layout Location: " << attributeLocation << '\n';
+
+        // Vertex Shader Attribute fill
+        program.vertexInputLayout.attributes.push_back({static_cast<u8>(attributeLocation), static_cast<u8>(attributeSize)});
+    }
+}
@@ -15,13 +15,26 @@ struct Program
     std::string        programName;
     u64                lastWriteTimestamp; // What is this for?
     VertexShaderLayout  vertexInputLayout;
+    bool               isCompute = false;
+    std::string        defines; // Inserted after the #version line of every stage, kept for the hot reload
+    bool               isPermutation = false; // Variant compiled by ShaderPermutationSupport, not listed for the entities
 };
 
 struct ShaderSupport
 {
     static GLuint CreateProgramFromSource(std::string programSource, const char* shaderName);
     static GLuint CreateProgramFromSource(const std::string& shaderSourceVert, const std::string& shaderSourceFrag, const char* shaderName);
+    static GLuint CreateComputeProgramFromSource(const std::string& shaderSource, const char* shaderName);
     static u32 LoadProgram(App* app, const char* filepath, const char* programName);
     static u32 LoadProgram(App* app, const char* filepathVert, const char* filepathFrag, const char* programName);
+    // Variant of the program with the given "#define X\n" lines, see InsertDefines
+    static u32 LoadProgram(App* app, const char* filepathVert, const char* filepathFrag, const char* programName, const std::string& defines);
+
+    // Sources that start with their own #version directive get the defines right after it
+    static std::string InsertDefines(const std::string& source, const std::string& defines);
+    static u32 LoadComputeProgram(App* app, const char* filepath, const char* programName);
+
+    // Active vertex attributes of the linked program, matched against the subMesh layouts when creating the VAOs
+    static void FillVertexInputLayout(Program& program);
 };
 #endif // PROGRAM_H
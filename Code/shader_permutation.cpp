@@ -0,0 +1,68 @@
+﻿#include "shader_permutation.h"
+#include <algorithm>
+#include <chrono>
+
+#include "app.h"
+
+void ShaderPermutationSupport::RegisterProgram(App* app, const u32 programIdx)
+{
+    assert(!app->programs[programIdx].isCompute && app->programs[programIdx].filePaths.size() == 2);
+    app->shaderPermutations.basePrograms.push_back(programIdx);
+}
+
+u32 ShaderPermutationSupport::GetFeatureMask(const Material& material)
+{
+    // The same flags PushMaterialDataUBO writes to the material UBO
+    u32 featureMask = SF_NONE;
+    featureMask |= material.albedoTextureIdx != 0 ? SF_ALBEDO_TEXTURE : SF_NONE;
+    featureMask |= material.emissiveTextureIdx != 0 ? SF_EMISSIVE_TEXTURE : SF_NONE;
+    featureMask |= material.specularTextureIdx != 0 ? SF_SPECULAR_TEXTURE : SF_NONE;
+    featureMask |= material.normalsTextureIdx != 0 ? SF_NORMALS_TEXTURE : SF_NONE;
+    featureMask |= material.bumpTextureIdx != 0 ? SF_BUMP_TEXTURE : SF_NONE;
+    return featureMask;
+}
+
+std::string ShaderPermutationSupport::GetDefines(const u32 featureMask)
+{
+    std::string defines = "#define SHADER_PERMUTATION\n";
+    for (u32 f = 0; f < SF_COUNT; ++f)
+    {
+        defines += "#define ";
+        defines += ShaderFeatureDefineStr[f];
+        defines += (featureMask & (1u << f)) != 0 ? " true\n" : " false\n";
+    }
+    return defines;
+}
+
+u32 ShaderPermutationSupport::GetVariantIdx(App* app, const u32 programIdx, const Material& material)
+{
+    ShaderPermutations& permutations = app->shaderPermutations;
+    if (!permutations.enabled ||
+        std::find(permutations.basePrograms.begin(), permutations.basePrograms.end(), programIdx) == permutations.basePrograms.end())
+        return programIdx;
+
+    const u32 featureMask = GetFeatureMask(material);
+    const auto found = permutations.variantLookup.find({ programIdx, featureMask });
+    if (found != permutations.variantLookup.end())
+        return found->second;
+
+    const auto start = std::chrono::high_resolution_clock::now();
+
+    // Copied, LoadProgram grows App::programs
+    const Program baseProgram = app->programs[programIdx];
+    char variantName[128];
+    sprintf(variantName, "%s_SF%02X", baseProgram.programName.c_str(), featureMask);
+    const u32 variantIdx = ShaderSupport::LoadProgram(app, baseProgram.filePaths[0].c_str(), baseProgram.filePaths[1].c_str(), variantName,
+        baseProgram.defines + GetDefines(featureMask));
+    Program& variant = app->programs[variantIdx];
+    variant.isPermutation = true;
+    ShaderSupport::FillVertexInputLayout(variant);
+    permutations.variantLookup[{ programIdx, featureMask }] = variantIdx;
+
+    const f64 elapsedMs = std::chrono::duration<f64, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    ++permutations.variantsCompiled;
+    permutations.compileMs += elapsedMs;
+    ILOG("Shader permutation %s compiled in %.2f ms", variantName, elapsedMs)
+
+    return variantIdx;
+}
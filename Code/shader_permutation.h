@@ -0,0 +1,59 @@
+﻿#ifndef SHADER_PERMUTATION_H
+#define SHADER_PERMUTATION_H
+#include <map>
+#include <string>
+#include <vector>
+
+#include "platform.h"
+
+struct App;
+struct Material;
+
+// Material features a permutation is specialized for, one bit of the feature mask each
+enum SHADER_FEATURE_FLAGS
+{
+    SF_NONE = 0,
+    SF_ALBEDO_TEXTURE = 1 << 0,
+    SF_EMISSIVE_TEXTURE = 1 << 1,
+    SF_SPECULAR_TEXTURE = 1 << 2,
+    SF_NORMALS_TEXTURE = 1 << 3,
+    SF_BUMP_TEXTURE = 1 << 4,
+    SF_COUNT = 5
+};
+
+// Define of every feature, true when its bit is set and false otherwise, same order as SHADER_FEATURE_FLAGS
+static const char* ShaderFeatureDefineStr[] = { "HAS_ALBEDO_TEXTURE", "HAS_EMISSIVE_TEXTURE", "HAS_SPECULAR_TEXTURE", "HAS_NORMALS_TEXTURE", "HAS_BUMP_TEXTURE" };
+
+/// <summary>
+/// Shader permutations of the material programs. A program registered here is compiled again for every feature mask its
+/// materials use, with "#define SHADER_PERMUTATION" and one "#define HAS_X true|false" per feature inserted after #version, so
+/// the material branches fold away and the unused samplers are dropped. Variants compile the first time a draw asks for them
+/// and are cached by (base program, feature mask). They are regular entries of App::programs carrying their defines, so the
+/// hot reload rebuilds every live variant. Without the define the shaders read the same flags from the material UBO.
+/// </summary>
+struct ShaderPermutations
+{
+    bool enabled = true;
+
+    std::vector<u32> basePrograms; // Programs with permutations, the others are always drawn as they are
+    std::map<std::pair<u32, u32>, u32> variantLookup; // (base program, feature mask) -> program
+
+    // Stats
+    u32 variantsCompiled = 0;
+    f64 compileMs = 0.0;
+};
+
+struct ShaderPermutationSupport
+{
+    // The program sources must read the material flags through the HAS_X macros
+    static void RegisterProgram(App* app, u32 programIdx);
+
+    static u32 GetFeatureMask(const Material& material);
+    static std::string GetDefines(u32 featureMask);
+
+    // Minimal variant of the program for the material, compiled on the first request. The program itself when it has no
+    // permutations or they are disabled. Compiling adds to App::programs, so references into it don't survive this call
+    static u32 GetVariantIdx(App* app, u32 programIdx, const Material& material);
+};
+
+#endif // SHADER_PERMUTATION_H
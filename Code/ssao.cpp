@@ -1 +1,191 @@
 ﻿#include "ssao.h"
+
+#include <random>
+#include "app.h"
+
+static void DrawScreenQuad(App* app, const Program& program, const std::vector<u32>& texturesUniformHandles, const std::vector<u32>& texturesUniformLocations)
+{
+    Model& model = app->models[app->quadModel];
+    Mesh& mesh = app->meshes[model.meshIdx];
+    const u32 subMeshCount = static_cast<u32>(mesh.subMeshes.size());
+    for (u32 i = 0; i < subMeshCount; i++)
+    {
+        mesh.DrawSubMesh(i, texturesUniformHandles, texturesUniformLocations, program, false);
+    }
+}
+
+void SSAOSupport::Init(App* app)
+{
+    ScreenSpaceAmbientOcclusion& ssao = app->ssaoData;
+    ssao.downsampleProgramIdx = ShaderSupport::LoadProgram(app, "Shaders\\shader_deferred_ssao.vert", "Shaders\\shader_ssao_downsample.frag", "SSAO_DOWNSAMPLE");
+    ssao.lowResProgramIdx = ShaderSupport::LoadProgram(app, "Shaders\\shader_deferred_ssao.vert", "Shaders\\shader_ssao_low_res.frag", "SSAO_LOW_RES");
+    ssao.blurProgramIdx = ShaderSupport::LoadProgram(app, "Shaders\\shader_deferred_ssao.vert", "Shaders\\shader_ssao_blur.frag", "SSAO_BLUR");
+    ssao.upsampleProgramIdx = ShaderSupport::LoadProgram(app, "Shaders\\shader_deferred_ssao.vert", "Shaders\\shader_ssao_upsample.frag", "SSAO_UPSAMPLE");
+
+    // Sized by SetTier, OnScreenResize keeps them at screenScale afterwards
+    const u32 width = static_cast<u32>(app->displaySizeCurrent.x);
+    const u32 height = static_cast<u32>(app->displaySizeCurrent.y);
+    ssao.lowResDepthTextureIdx = TextureSupport::CreateEmptyColorTexture_32Bit_F_R(app, "SSAO Low Res Depth", width, height);
+    ssao.lowResNormalTextureIdx = TextureSupport::CreateEmptyColorTexture_8Bit_RGBA(app, "SSAO Low Res Normal", width, height);
+    ssao.lowResOcclusionTextureIdx = TextureSupport::CreateEmptyColorTexture_8Bit_R(app, "SSAO Low Res Occlusion", width, height);
+    ssao.lowResBlurTextureIdx = TextureSupport::CreateEmptyColorTexture_8Bit_R(app, "SSAO Low Res Blur", width, height);
+
+    ssao.lowResFrameBufferObject = FrameBufferManagement::CreateFrameBuffer();
+    FrameBufferManagement::BindFrameBuffer(ssao.lowResFrameBufferObject);
+    FrameBufferManagement::SetColorAttachment(ssao.lowResFrameBufferObject, app->textures[ssao.lowResDepthTextureIdx].handle, SSAO_RT_DEPTH);
+    FrameBufferManagement::SetColorAttachment(ssao.lowResFrameBufferObject, app->textures[ssao.lowResNormalTextureIdx].handle, SSAO_RT_NORMAL);
+    FrameBufferManagement::SetColorAttachment(ssao.lowResFrameBufferObject, app->textures[ssao.lowResOcclusionTextureIdx].handle, SSAO_RT_OCCLUSION);
+    FrameBufferManagement::SetColorAttachment(ssao.lowResFrameBufferObject, app->textures[ssao.lowResBlurTextureIdx].handle, SSAO_RT_BLUR);
+    FrameBufferManagement::CheckStatus();
+    FrameBufferManagement::UnBindFrameBuffer(ssao.lowResFrameBufferObject);
+
+    GpuTimerSupport::Init(ssao.timer);
+    SetTier(app, ssao.tier);
+}
+
+void SSAOSupport::Shutdown(App* app)
+{
+    GpuTimerSupport::Shutdown(app->ssaoData.timer);
+}
+
+void SSAOSupport::GenerateKernel(ScreenSpaceAmbientOcclusion& ssao, const u32 sampleCount)
+{
+    // Same seed every time, a tier always gets the same kernel
+    std::uniform_real_distribution<float> randomFloats(0.0, 1.0); // random floats between [0.0, 1.0]
+    std::default_random_engine generator;
+    ssao.kernel.clear();
+    for (u32 i = 0; i < static_cast<u32>(ssao.maxSamples); ++i)
+    {
+        glm::vec3 sample(
+            randomFloats(generator) * 2.0 - 1.0, 
+            randomFloats(generator) * 2.0 - 1.0, 
+            randomFloats(generator)
+        );
+        sample  = glm::normalize(sample);
+        sample *= randomFloats(generator);
+
+        // More samples close to the fragment, the first sampleCount ones (the ones read) go from 0.1 to the full radius
+        float scale = static_cast<float>(i % sampleCount) / static_cast<float>(sampleCount);
+        scale = glm::mix(0.1f, 1.0f, scale * scale);
+        sample *= scale;
+        ssao.kernel.push_back(sample);
+    }
+}
+
+void SSAOSupport::SetTier(App* app, const SSAOTier tier)
+{
+    ScreenSpaceAmbientOcclusion& ssao = app->ssaoData;
+    const SSAOTierSettings& settings = SSAOTiers[static_cast<u32>(tier)];
+    ssao.tier = tier;
+    ssao.kernelSize = settings.kernelSize;
+    ssao.radius = settings.radius;
+    ssao.falloff = settings.falloff;
+    ssao.resolutionDivisor = settings.resolutionDivisor;
+    GenerateKernel(ssao, static_cast<u32>(ssao.kernelSize));
+
+    const f32 screenScale = 1.0f / static_cast<f32>(ssao.resolutionDivisor);
+    const u32 width = static_cast<u32>(glm::max(1.0f, app->displaySizeCurrent.x * screenScale));
+    const u32 height = static_cast<u32>(glm::max(1.0f, app->displaySizeCurrent.y * screenScale));
+    const u32 lowResTextures[] = { ssao.lowResDepthTextureIdx, ssao.lowResNormalTextureIdx, ssao.lowResOcclusionTextureIdx, ssao.lowResBlurTextureIdx };
+    for (const u32 texIdx : lowResTextures)
+    {
+        Texture& tex = app->textures[texIdx];
+        tex.screenScale = screenScale;
+        TextureSupport::ResizeTexture(app, tex, width, height);
+    }
+}
+
+void SSAOSupport::RenderLowResolution(App* app)
+{
+    ScreenSpaceAmbientOcclusion& ssao = app->ssaoData;
+    glPushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, 1, -1, "SSAO Low Resolution");
+
+    const ivec2 lowResSize = app->textures[ssao.lowResDepthTextureIdx].size;
+    const u32 lowResDepthHandle = app->textures[ssao.lowResDepthTextureIdx].handle;
+    const u32 lowResNormalHandle = app->textures[ssao.lowResNormalTextureIdx].handle;
+    const u32 noiseHandle = app->textures[app->ssaoNoiseTextureIdx].handle;
+    const bool compactGBuffer = app->gBufferLayout == GBufferLayout::COMPACT;
+    const std::vector<u32> gBufferLocations = compactGBuffer ?
+        std::vector<u32>{ CG_BINDING_DEPTH, CG_BINDING_NORMAL_TANGENT } :
+        std::vector<u32>{ RT_LOCATION_POSITION_WORLD_SPACE, RT_LOCATION_NORMAL };
+    const std::vector<u32> gBufferHandles = compactGBuffer ?
+        std::vector<u32>{ app->textures[app->gDepthTextureIdx].handle, app->textures[app->gNormalTangentTextureIdx].handle } :
+        std::vector<u32>{ app->textures[app->gPositionTextureIdx].handle, app->textures[app->gNormalTextureIdx].handle };
+
+    BufferManagement::BindBufferRange(app->uniformBuffer, STD_140_BINDING_POINT::BP_GLOBAL_PARAMS, app->globalParamsSize, app->globalParamsOffset);
+    BufferManagement::BindBufferRange(app->uniformBuffer, STD_140_BINDING_POINT::BP_SSAO_PARAMS, app->ssaoData.paramsSize, app->ssaoData.paramsOffset);
+
+    FrameBufferManagement::BindFrameBuffer(ssao.lowResFrameBufferObject);
+    glViewport(0, 0, lowResSize.x, lowResSize.y);
+
+    // Point sampled linear depth and view space normal, every later pass reads these instead of the G-buffer
+    {
+        glPushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, 1, -1, "SSAO Downsample");
+        const std::vector<u32> attachments = { SSAO_RT_DEPTH, SSAO_RT_NORMAL };
+        FrameBufferManagement::SetDrawBuffersTextures(attachments);
+        const Program& program = app->programs[ssao.downsampleProgramIdx];
+        glUseProgram(program.handle);
+        glUniform1i(glGetUniformLocation(program.handle, "uCompactGBuffer"), compactGBuffer ? 1 : 0);
+        glUniform1i(glGetUniformLocation(program.handle, "uResolutionDivisor"), static_cast<GLint>(ssao.resolutionDivisor));
+        DrawScreenQuad(app, program, gBufferHandles, gBufferLocations);
+        glPopDebugGroup();
+    }
+
+    // Kernel evaluation
+    {
+        glPushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, 1, -1, "SSAO Occlusion");
+        const std::vector<u32> attachments = { SSAO_RT_OCCLUSION };
+        FrameBufferManagement::SetDrawBuffersTextures(attachments);
+        const Program& program = app->programs[ssao.lowResProgramIdx];
+        glUseProgram(program.handle);
+        DrawScreenQuad(app, program, { lowResDepthHandle, lowResNormalHandle, noiseHandle }, { SSAO_BINDING_LOW_RES_DEPTH, SSAO_BINDING_LOW_RES_NORMAL, SSAO_BINDING_NOISE });
+        glPopDebugGroup();
+    }
+
+    // Separable bilateral blur, occlusion -> blur horizontally and back vertically
+    {
+        glPushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, 1, -1, "SSAO Blur");
+        const Program& program = app->programs[ssao.blurProgramIdx];
+        glUseProgram(program.handle);
+        glUniform1f(glGetUniformLocation(program.handle, "uDepthSharpness"), ssao.blurDepthSharpness);
+        const GLint directionLocation = glGetUniformLocation(program.handle, "uDirection");
+
+        const std::vector<u32> horizontalAttachments = { SSAO_RT_BLUR };
+        FrameBufferManagement::SetDrawBuffersTextures(horizontalAttachments);
+        glUniform2i(directionLocation, 1, 0);
+        DrawScreenQuad(app, program, { app->textures[ssao.lowResOcclusionTextureIdx].handle, lowResDepthHandle, lowResNormalHandle }, { SSAO_BINDING_OCCLUSION, SSAO_BINDING_LOW_RES_DEPTH, SSAO_BINDING_LOW_RES_NORMAL });
+
+        const std::vector<u32> verticalAttachments = { SSAO_RT_OCCLUSION };
+        FrameBufferManagement::SetDrawBuffersTextures(verticalAttachments);
+        glUniform2i(directionLocation, 0, 1);
+        DrawScreenQuad(app, program, { app->textures[ssao.lowResBlurTextureIdx].handle, lowResDepthHandle, lowResNormalHandle }, { SSAO_BINDING_OCCLUSION, SSAO_BINDING_LOW_RES_DEPTH, SSAO_BINDING_LOW_RES_NORMAL });
+        glPopDebugGroup();
+    }
+    FrameBufferManagement::UnBindFrameBuffer(ssao.lowResFrameBufferObject);
+
+    // Joint bilateral upsample into the full resolution target read by the shading pass
+    {
+        glPushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, 1, -1, "SSAO Upsample");
+        FrameBufferManagement::BindFrameBuffer(app->ssaoFrameBufferObject);
+        const std::vector<u32> attachments = { RT_LOCATION_SSAO };
+        FrameBufferManagement::SetDrawBuffersTextures(attachments);
+        glViewport(0, 0, app->displaySizeCurrent.x, app->displaySizeCurrent.y);
+
+        std::vector<u32> handles = gBufferHandles;
+        std::vector<u32> locations = gBufferLocations;
+        handles.insert(handles.end(), { app->textures[ssao.lowResOcclusionTextureIdx].handle, lowResDepthHandle, lowResNormalHandle });
+        locations.insert(locations.end(), { SSAO_BINDING_OCCLUSION, SSAO_BINDING_LOW_RES_DEPTH, SSAO_BINDING_LOW_RES_NORMAL });
+
+        const Program& program = app->programs[ssao.upsampleProgramIdx];
+        glUseProgram(program.handle);
+        glUniform1i(glGetUniformLocation(program.handle, "uCompactGBuffer"), compactGBuffer ? 1 : 0);
+        glUniform1i(glGetUniformLocation(program.handle, "uResolutionDivisor"), static_cast<GLint>(ssao.resolutionDivisor));
+        glUniform1f(glGetUniformLocation(program.handle, "uDepthSharpness"), ssao.blurDepthSharpness);
+        DrawScreenQuad(app, program, handles, locations);
+
+        FrameBufferManagement::UnBindFrameBuffer(app->ssaoFrameBufferObject);
+        glPopDebugGroup();
+    }
+
+    glPopDebugGroup();
+}
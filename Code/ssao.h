@@ -1,7 +1,65 @@
 ﻿#pragma once
 #include <vector>
 #include "platform.h"
+#include "buffer_management.h"
+#include "gpu_timer.h"
 
+struct App;
+
+#define SSAO_BLUR_RADIUS 4 // Taps on each side of the separable bilateral blur, see shader_ssao_blur.frag
+
+static const char* SSAOTierStr[] = { "LOW", "MEDIUM", "HIGH", "FULL" };
+
+// FULL is the reference: every kernel sample at full resolution without blur
+enum class SSAOTier
+{
+    LOW,
+    MEDIUM,
+    HIGH,
+    FULL,
+    COUNT
+};
+
+struct SSAOTierSettings
+{
+    int kernelSize;
+    u32 resolutionDivisor; // 1 full, 2 half, 4 quarter resolution
+    float radius;
+    float falloff; // Exponent of the range check, higher fades the occluders far in depth faster
+};
+
+static const SSAOTierSettings SSAOTiers[] =
+{
+    { 8, 4, 0.5f, 2.0f },
+    { 16, 2, 0.5f, 1.5f },
+    { 32, 2, 0.5f, 1.0f },
+    { 64, 1, 0.5f, 1.0f },
+};
+
+// Attachments of the reduced resolution frame buffer
+enum SSAO_LOW_RES_LOCATION
+{
+    SSAO_RT_DEPTH = 0, // Linear view depth (R32F)
+    SSAO_RT_NORMAL = 1, // View space normal
+    SSAO_RT_OCCLUSION = 2,
+    SSAO_RT_BLUR = 3 // Horizontal blur result
+};
+
+// Texture units of the reduced resolution targets, clear of the G-buffer ones read by the upsample
+enum SSAO_BINDING
+{
+    SSAO_BINDING_NOISE = 3,
+    SSAO_BINDING_OCCLUSION = 4,
+    SSAO_BINDING_LOW_RES_DEPTH = 5,
+    SSAO_BINDING_LOW_RES_NORMAL = 6
+};
+
+/// <summary>
+/// Below the FULL tier the occlusion runs at a fraction of the resolution: the G-buffer is point sampled to a linear depth
+/// and normal target, the kernel is evaluated there, a separable bilateral blur (depth and normal aware) removes the noise
+/// of the 4x4 rotation pattern and a joint bilateral upsample brings it back to gSSAOTextureIdx, weighting the four low
+/// resolution texels by how well their depth and normal match the full resolution pixel.
+/// </summary>
 struct ScreenSpaceAmbientOcclusion
 {
     std::vector<glm::vec3> kernel;
@@ -10,10 +68,42 @@ struct ScreenSpaceAmbientOcclusion
     int kernelSize = 64;
     float radius = 0.5f;
     float bias = 0.025f;
+    float falloff = 1.0f;
 
     // tile noise texture over screen based on screen dimensions divided by noise size
     glm::vec2 noiseScale;
 
     u32 paramsOffset;
     u32 paramsSize;
+
+    SSAOTier tier = SSAOTier::MEDIUM;
+    u32 resolutionDivisor = 1;
+    float blurDepthSharpness = 40.0f; // Relative depth difference that drops a blur or upsample tap
+
+    Buffer lowResFrameBufferObject;
+    u32 lowResDepthTextureIdx = 0;
+    u32 lowResNormalTextureIdx = 0;
+    u32 lowResOcclusionTextureIdx = 0;
+    u32 lowResBlurTextureIdx = 0;
+
+    u32 downsampleProgramIdx = 0;
+    u32 lowResProgramIdx = 0;
+    u32 blurProgramIdx = 0;
+    u32 upsampleProgramIdx = 0;
+
+    GpuTimer timer;
+};
+
+struct SSAOSupport
+{
+    // Programs and reduced resolution targets, call before the vertex input layouts are reflected
+    static void Init(App* app);
+    static void Shutdown(App* app);
+
+    // Kernel of sampleCount samples, scaled so that this count covers the whole hemisphere
+    static void GenerateKernel(ScreenSpaceAmbientOcclusion& ssao, const u32 sampleCount);
+    static void SetTier(App* app, const SSAOTier tier);
+
+    // Occlusion of the tiers below FULL, written to gSSAOTextureIdx
+    static void RenderLowResolution(App* app);
 };
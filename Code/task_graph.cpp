@@ -0,0 +1,169 @@
+﻿#include "task_graph.h"
+
+#include <chrono>
+
+f64 TaskGraphSupport::TimeMs()
+{
+    return std::chrono::duration<f64, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Called with the lock held
+static void EnqueueReadyTask(TaskGraph& graph, const u32 taskIdx)
+{
+    if (graph.tasks[taskIdx].mainThread)
+    {
+        graph.mainThreadQueue.push_back(taskIdx);
+        graph.mainThreadTaskAvailable.notify_one();
+    }
+    else
+    {
+        graph.workerQueue.push_back(taskIdx);
+        graph.workerTaskAvailable.notify_one();
+    }
+}
+
+static void RunTask(TaskGraph& graph, const u32 taskIdx)
+{
+    Task* task;
+    {
+        std::lock_guard<std::mutex> lock(graph.mutex);
+        task = &graph.tasks[taskIdx];
+        task->startMs = TaskGraphSupport::TimeMs();
+    }
+
+    task->work();
+
+    std::lock_guard<std::mutex> lock(graph.mutex);
+    task->done = true;
+    task->endMs = TaskGraphSupport::TimeMs();
+    ++graph.doneTasks;
+    graph.doneCost += task->cost;
+    for (const u32 dependent : task->dependents)
+        if (--graph.tasks[dependent].pendingDependencies == 0)
+            EnqueueReadyTask(graph, dependent);
+    if (graph.doneTasks == graph.tasks.size())
+    {
+        graph.endMs = task->endMs;
+        graph.mainThreadTaskAvailable.notify_all(); // Wakes RunMainThreadTasks waiting for the end
+    }
+}
+
+static void Worker(TaskGraph* graph)
+{
+    while (true)
+    {
+        u32 taskIdx;
+        {
+            std::unique_lock<std::mutex> lock(graph->mutex);
+            graph->workerTaskAvailable.wait(lock, [graph]() { return graph->stopping || !graph->workerQueue.empty(); });
+            if (graph->stopping)
+                return;
+            taskIdx = graph->workerQueue.front();
+            graph->workerQueue.pop_front();
+        }
+        RunTask(*graph, taskIdx);
+    }
+}
+
+void TaskGraphSupport::Start(TaskGraph& graph, const u32 workerCount)
+{
+    graph.stopping = false;
+    for (u32 w = 0; w < glm::max(workerCount, 1u); ++w)
+        graph.workers.emplace_back(Worker, &graph);
+}
+
+void TaskGraphSupport::Stop(TaskGraph& graph)
+{
+    {
+        std::lock_guard<std::mutex> lock(graph.mutex);
+        graph.stopping = true;
+    }
+    graph.workerTaskAvailable.notify_all();
+    for (std::thread& worker : graph.workers)
+        worker.join();
+    graph.workers.clear();
+}
+
+void TaskGraphSupport::Reset(TaskGraph& graph)
+{
+    std::lock_guard<std::mutex> lock(graph.mutex);
+    if (graph.doneTasks != graph.tasks.size())
+        return;
+    graph.tasks.clear();
+    graph.doneTasks = 0;
+    graph.totalCost = 0;
+    graph.doneCost = 0;
+}
+
+u32 TaskGraphSupport::AddTask(TaskGraph& graph, const std::string& name, std::function<void()> work, const bool mainThread, const std::vector<u32>& dependencies, const u64 cost)
+{
+    std::lock_guard<std::mutex> lock(graph.mutex);
+    if (graph.doneTasks == graph.tasks.size())
+        graph.startMs = TimeMs(); // First task since the graph was idle
+
+    const u32 taskIdx = static_cast<u32>(graph.tasks.size());
+    graph.tasks.emplace_back();
+    Task& task = graph.tasks.back();
+    task.name = name;
+    task.work = std::move(work);
+    task.mainThread = mainThread;
+    task.cost = cost;
+    graph.totalCost += cost;
+
+    for (const u32 dependency : dependencies)
+    {
+        Task& dependencyTask = graph.tasks[dependency];
+        if (!dependencyTask.done)
+        {
+            dependencyTask.dependents.push_back(taskIdx);
+            ++task.pendingDependencies;
+        }
+    }
+    if (task.pendingDependencies == 0)
+        EnqueueReadyTask(graph, taskIdx);
+    return taskIdx;
+}
+
+bool TaskGraphSupport::RunMainThreadTasks(TaskGraph& graph, const f64 budgetMs, const f64 waitMs)
+{
+    const f64 startMs = TimeMs();
+    while (true)
+    {
+        u32 taskIdx;
+        {
+            std::unique_lock<std::mutex> lock(graph.mutex);
+            if (graph.mainThreadQueue.empty() && waitMs > 0.0)
+                graph.mainThreadTaskAvailable.wait_for(lock, std::chrono::duration<f64, std::milli>(waitMs),
+                    [&graph]() { return !graph.mainThreadQueue.empty() || graph.doneTasks == graph.tasks.size(); });
+            if (graph.mainThreadQueue.empty())
+                return graph.doneTasks != graph.tasks.size();
+            taskIdx = graph.mainThreadQueue.front();
+            graph.mainThreadQueue.pop_front();
+        }
+        RunTask(graph, taskIdx);
+
+        if (TimeMs() - startMs >= budgetMs)
+            return !IsDone(graph);
+    }
+}
+
+bool TaskGraphSupport::IsDone(TaskGraph& graph)
+{
+    std::lock_guard<std::mutex> lock(graph.mutex);
+    return graph.doneTasks == graph.tasks.size();
+}
+
+f32 TaskGraphSupport::GetProgress(TaskGraph& graph)
+{
+    std::lock_guard<std::mutex> lock(graph.mutex);
+    return graph.totalCost > 0 ? static_cast<f32>(static_cast<f64>(graph.doneCost) / static_cast<f64>(graph.totalCost)) : 1.0f;
+}
+
+f64 TaskGraphSupport::GetEtaMs(TaskGraph& graph)
+{
+    std::lock_guard<std::mutex> lock(graph.mutex);
+    if (graph.doneCost == 0 || graph.doneCost >= graph.totalCost)
+        return 0.0;
+    const f64 elapsedMs = TimeMs() - graph.startMs;
+    return elapsedMs * static_cast<f64>(graph.totalCost - graph.doneCost) / static_cast<f64>(graph.doneCost);
+}
@@ -0,0 +1,77 @@
+﻿#ifndef TASK_GRAPH_H
+#define TASK_GRAPH_H
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "platform.h"
+
+/// <summary>
+/// Unit of work of a TaskGraph, it becomes ready once all its dependencies are done.
+/// </summary>
+/// <param name="mainThread">Runs on the thread that owns the OpenGL context (RunMainThreadTasks), the others on the workers.</param>
+/// <param name="cost">Relative weight of the task for the progress and the ETA (e.g. the bytes of the file it reads).</param>
+struct Task
+{
+    std::string name;
+    std::function<void()> work;
+    bool mainThread = false;
+    u64 cost = 1;
+    u32 pendingDependencies = 0;
+    std::vector<u32> dependents;
+    bool done = false;
+    f64 startMs = 0.0;
+    f64 endMs = 0.0;
+};
+
+/// <summary>
+/// Tasks with explicit dependencies run by a pool of worker threads, with a separate queue for the tasks that have to run
+/// on the main thread (OpenGL). Tasks can be added while the graph runs, the ids stay valid until Reset.
+/// </summary>
+struct TaskGraph
+{
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable workerTaskAvailable;
+    std::condition_variable mainThreadTaskAvailable;
+    std::deque<Task> tasks; // A deque keeps the references valid while tasks are added
+    std::deque<u32> workerQueue;
+    std::deque<u32> mainThreadQueue;
+    bool stopping = false;
+
+    // Progress
+    u32 doneTasks = 0;
+    u64 totalCost = 0;
+    u64 doneCost = 0;
+    f64 startMs = 0.0;
+    f64 endMs = 0.0;
+};
+
+struct TaskGraphSupport
+{
+    static void Start(TaskGraph& graph, u32 workerCount);
+    static void Stop(TaskGraph& graph);
+
+    // Forgets the done tasks, only when there is nothing pending
+    static void Reset(TaskGraph& graph);
+
+    // Returns the id of the task, the dependencies are ids of tasks already added
+    static u32 AddTask(TaskGraph& graph, const std::string& name, std::function<void()> work, bool mainThread, const std::vector<u32>& dependencies = {}, u64 cost = 1);
+
+    // Runs the ready main thread tasks until the time budget is spent, waiting up to waitMs for one when none is ready.
+    // Returns false once every task of the graph is done
+    static bool RunMainThreadTasks(TaskGraph& graph, f64 budgetMs, f64 waitMs = 0.0);
+
+    static bool IsDone(TaskGraph& graph);
+
+    // Done fraction of the total cost, and the remaining time extrapolated from the cost done so far
+    static f32 GetProgress(TaskGraph& graph);
+    static f64 GetEtaMs(TaskGraph& graph);
+
+    static f64 TimeMs();
+};
+
+#endif // TASK_GRAPH_H
@@ -0,0 +1,136 @@
+﻿#include "temporal.h"
+
+#include "app.h"
+
+// Low discrepancy sequence, the jitter covers the pixel evenly in a few frames
+static f32 Halton(u32 index, const u32 base)
+{
+    f32 result = 0.0f;
+    f32 fraction = 1.0f;
+    while (index > 0)
+    {
+        fraction /= static_cast<f32>(base);
+        result += fraction * static_cast<f32>(index % base);
+        index /= base;
+    }
+    return result;
+}
+
+void TemporalSupport::Init(App* app)
+{
+    TemporalReprojection& temporal = app->temporal;
+    temporal.motionVectorsTextureIdx = TextureSupport::CreateEmptyColorTexture_16Bit_F_RG(app, "FBO Motion Vectors", app->displaySizeCurrent.x, app->displaySizeCurrent.y);
+    temporal.resolveProgramIdx = ShaderSupport::LoadProgram(app, "Shaders\\shader_unlit_screen.vert", "Shaders\\shader_taa_resolve.frag", "TAA_RESOLVE");
+    temporal.resolveFrameBufferObject = FrameBufferManagement::CreateFrameBuffer();
+    temporal.taaHistory = CreateHistoryBuffer(app, "TAA", TextureSupport::CreateEmptyColorTexture_8Bit_RGBA);
+    GpuTimerSupport::Init(temporal.resolveTimer);
+}
+
+void TemporalSupport::Shutdown(App* app)
+{
+    GpuTimerSupport::Shutdown(app->temporal.resolveTimer);
+}
+
+void TemporalSupport::BeginFrame(App* app)
+{
+    TemporalReprojection& temporal = app->temporal;
+    ++temporal.frame;
+    temporal.resolvedThisFrame = false;
+    temporal.unjitteredProjectionMat = app->projectionMat;
+
+    temporal.jittered = temporal.taaEnabled && app->renderingMode == RenderingMode::DEFERRED;
+    if (!temporal.jittered)
+    {
+        temporal.jitter = glm::vec2(0.0f);
+        temporal.jitterMat = glm::mat4(1.0f);
+        return;
+    }
+
+    // Index 0 of the sequence is the pixel corner, start at 1
+    const u32 sample = static_cast<u32>(temporal.frame % TEMPORAL_JITTER_SAMPLES) + 1;
+    temporal.jitter = glm::vec2(Halton(sample, 2), Halton(sample, 3)) - 0.5f;
+
+    // Translating clip space by offset * w moves every projected point by offset in NDC
+    const glm::vec2 ndcOffset = temporal.jitter * 2.0f / glm::vec2(glm::max(app->displaySizeCurrent, ivec2(1)));
+    temporal.jitterMat = glm::translate(glm::mat4(1.0f), glm::vec3(ndcOffset, 0.0f));
+    app->projectionMat = temporal.jitterMat * app->projectionMat;
+}
+
+HistoryBuffer TemporalSupport::CreateHistoryBuffer(App* app, const char* name, HistoryTextureCreator createTexture)
+{
+    HistoryBuffer history;
+    const std::string baseName = name;
+    for (u32 i = 0; i < 2; ++i)
+    {
+        const std::string textureName = baseName + " History " + std::to_string(i);
+        history.textureIdx[i] = createTexture(app, textureName.c_str(), app->displaySizeCurrent.x, app->displaySizeCurrent.y);
+    }
+    return history;
+}
+
+bool TemporalSupport::IsHistoryValid(const App* app, const HistoryBuffer& history)
+{
+    return history.lastWrittenFrame != 0 && history.lastWrittenFrame + 1 == app->temporal.frame && history.size == app->displaySizeCurrent;
+}
+
+void TemporalSupport::AdvanceHistory(App* app, HistoryBuffer& history)
+{
+    history.current = 1 - history.current;
+    history.lastWrittenFrame = app->temporal.frame;
+    history.size = app->displaySizeCurrent;
+}
+
+void TemporalSupport::ResolveTAA(App* app)
+{
+    TemporalReprojection& temporal = app->temporal;
+    if (!temporal.jittered)
+        return;
+
+    glPushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, 1, -1, "Engine TAA Resolve");
+    GpuTimerSupport::Begin(temporal.resolveTimer);
+
+    // Checked before the advance, which marks this frame as written
+    HistoryBuffer& history = temporal.taaHistory;
+    const bool historyValid = IsHistoryValid(app, history);
+    const u32 previousTextureIdx = history.textureIdx[history.current];
+    AdvanceHistory(app, history);
+    const u32 resolvedTextureIdx = history.textureIdx[history.current];
+
+    FrameBufferManagement::BindFrameBuffer(temporal.resolveFrameBufferObject);
+    FrameBufferManagement::SetColorAttachment(temporal.resolveFrameBufferObject, app->textures[resolvedTextureIdx].handle, 0);
+    const std::vector<u32> attachments = { 0 };
+    FrameBufferManagement::SetDrawBuffersTextures(attachments);
+    glViewport(0, 0, app->displaySizeCurrent.x, app->displaySizeCurrent.y);
+    glDisable(GL_DEPTH_TEST);
+    glDisable(GL_BLEND);
+
+    const Program& program = app->programs[temporal.resolveProgramIdx];
+    glUseProgram(program.handle);
+    glUniform1i(glGetUniformLocation(program.handle, "uHistoryValid"), historyValid ? 1 : 0);
+    glUniform1f(glGetUniformLocation(program.handle, "uHistoryWeight"), temporal.historyWeight);
+
+    const std::vector<u32> texturesUniformLocations = { 0, 1, 2, CG_BINDING_DEPTH };
+    const std::vector<u32> texturesUniformHandles = { app->textures[app->gFinalResultTextureIdx].handle, app->textures[previousTextureIdx].handle,
+        app->textures[temporal.motionVectorsTextureIdx].handle, app->textures[app->gDepthTextureIdx].handle };
+    Model& model = app->models[app->quadModel];
+    Mesh& mesh = app->meshes[model.meshIdx];
+    const u32 subMeshCount = static_cast<u32>(mesh.subMeshes.size());
+    for (u32 i = 0; i < subMeshCount; i++)
+    {
+        mesh.DrawSubMesh(i, texturesUniformHandles, texturesUniformLocations, program, false);
+    }
+
+    FrameBufferManagement::UnBindFrameBuffer(temporal.resolveFrameBufferObject);
+    glEnable(GL_BLEND);
+    glEnable(GL_DEPTH_TEST);
+    temporal.resolvedThisFrame = true;
+
+    GpuTimerSupport::End(temporal.resolveTimer);
+    glPopDebugGroup();
+}
+
+u32 TemporalSupport::GetFinalTextureIdx(const App* app)
+{
+    const TemporalReprojection& temporal = app->temporal;
+    return temporal.resolvedThisFrame ? temporal.taaHistory.textureIdx[temporal.taaHistory.current] : app->gFinalResultTextureIdx;
+}
@@ -0,0 +1,76 @@
+﻿#ifndef TEMPORAL_H
+#define TEMPORAL_H
+
+#include "platform.h"
+#include "buffer_management.h"
+#include "gpu_timer.h"
+
+struct App;
+
+#define TEMPORAL_JITTER_SAMPLES 8 // Length of the Halton (2, 3) sub-pixel jitter sequence
+
+// Creates an empty render target of the display size, e.g. TextureSupport::CreateEmptyColorTexture_16Bit_F_RGBA
+typedef u32 (*HistoryTextureCreator)(App* app, const char* name, const u32 width, const u32 height);
+
+/// <summary>
+/// Two targets of an effect that accumulates across frames: once advanced, current is written this frame while the other one
+/// holds the previous frame's result. The previous one is only valid if it was written the frame before at the same size, an effect
+/// that was skipped for a frame (mode switch, resize) starts over from the current frame.
+/// </summary>
+struct HistoryBuffer
+{
+    u32 textureIdx[2] = {};
+    u32 current = 0;
+    u64 lastWrittenFrame = 0; // TemporalReprojection::frame, 0 means never written
+    ivec2 size = {};
+};
+
+/// <summary>
+/// Motion vectors and sub-pixel jitter shared by the temporal effects. The geometry pass writes per pixel motion in texture
+/// coordinates (current minus previous) from each entity's worldViewProjectionMat of this and the previous frame, so the
+/// previous position of a pixel is texCoord - motion. The previous matrix is pushed with this frame's jitter applied, the
+/// jitter cancels out and the motion vectors only hold the movement. The TAA resolve is the first client: the projection
+/// is jittered every frame and the resolve blends the shaded frame with its reprojected, neighborhood clamped history.
+/// </summary>
+struct TemporalReprojection
+{
+    bool taaEnabled = false;
+    f32 historyWeight = 0.9f; // Share of the reprojected history in the resolved color
+
+    u64 frame = 0;
+    bool jittered = false; // Only while the deferred TAA resolve runs
+    glm::vec2 jitter = glm::vec2(0.0f); // In pixels, within [-0.5, 0.5]
+    glm::mat4 jitterMat = glm::mat4(1.0f); // Clip space translation applied on top of the projection
+    glm::mat4 unjitteredProjectionMat = glm::mat4(1.0f);
+
+    u32 motionVectorsTextureIdx = 0;
+
+    u32 resolveProgramIdx = 0;
+    Buffer resolveFrameBufferObject;
+    HistoryBuffer taaHistory;
+    bool resolvedThisFrame = false;
+    GpuTimer resolveTimer;
+};
+
+struct TemporalSupport
+{
+    // Programs and targets, before the G-buffer frame buffers attach the motion vectors
+    static void Init(App* app);
+    static void Shutdown(App* app);
+
+    // Jitters app->projectionMat, call once per frame after the projection is built and before the transforms are pushed
+    static void BeginFrame(App* app);
+
+    static HistoryBuffer CreateHistoryBuffer(App* app, const char* name, HistoryTextureCreator createTexture);
+    // Whether current holds last frame's result, check before AdvanceHistory
+    static bool IsHistoryValid(const App* app, const HistoryBuffer& history);
+    // Before writing: current becomes the target written this frame, the previous current holds last frame's result
+    static void AdvanceHistory(App* app, HistoryBuffer& history);
+
+    // Resolves gFinalResultTextureIdx into the TAA history, after the shading
+    static void ResolveTAA(App* app);
+    // What the FINAL view shows, the resolved color when the TAA ran this frame
+    static u32 GetFinalTextureIdx(const App* app);
+};
+
+#endif // TEMPORAL_H
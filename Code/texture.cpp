@@ -4,6 +4,8 @@
 
 #include "app.h"
 #include "stb_image.h"
+#include "texture_compression.h"
+#include "texture_streaming.h"
 
 Image TextureSupport::LoadImage(const char* filename)
 {
@@ -40,10 +42,14 @@ GLuint TextureSupport::CreateTexture2DFromImage(const Image& image)
     default: ELOG("LoadTexture2D() - Unsupported number of channels")
     }
 
+    // Immutable storage for the whole mip chain, the driver does not have to track later redefinitions
     GLuint texHandle;
     glGenTextures(1, &texHandle);
     glBindTexture(GL_TEXTURE_2D, texHandle);
-    glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, image.size.x, image.size.y, 0, dataFormat, dataType, image.pixels);
+    glTexStorage2D(GL_TEXTURE_2D, static_cast<GLsizei>(GetMipLevelCount(image.size)), internalFormat, image.size.x, image.size.y);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1); // Rows of RGB/red images are not 4 byte aligned
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, image.size.x, image.size.y, dataFormat, dataType, image.pixels);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
     //https://www.khronos.org/opengl/wiki/Common_Mistakes#:~:text=requires%20GL%203.0).-,Checking%20for%20OpenGL%20Errors,-%5Bedit%5D
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
@@ -56,24 +62,76 @@ GLuint TextureSupport::CreateTexture2DFromImage(const Image& image)
     return texHandle;
 }
 
-u32 TextureSupport::LoadTexture2D(App* app, const char* filepath)
+u32 TextureSupport::GetMipLevelCount(const ivec2 size)
 {
+    u32 levels = 1;
+    for (i32 maxSize = glm::max(size.x, size.y); maxSize > 1; maxSize >>= 1)
+        ++levels;
+    return levels;
+}
+
+GLuint TextureSupport::CreateTexture2DFromCompressedImage(const CompressedImage& image, const u8* data)
+{
+    GLuint texHandle;
+    glGenTextures(1, &texHandle);
+    glBindTexture(GL_TEXTURE_2D, texHandle);
+    glTexStorage2D(GL_TEXTURE_2D, static_cast<GLsizei>(image.mips.size()), image.format, image.size.x, image.size.y);
+    for (u32 level = 0; level < image.mips.size(); ++level)
+    {
+        const CompressedMip& mip = image.mips[level];
+        glCompressedTexSubImage2D(GL_TEXTURE_2D, static_cast<GLint>(level), 0, 0, mip.width, mip.height, image.format, static_cast<GLsizei>(mip.size),
+            data ? data + mip.offset : reinterpret_cast<const void*>(mip.offset));
+    }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    return texHandle;
+}
+
+u32 TextureSupport::LoadTexture2D(App* app, const char* filepath, const TextureRole role)
+{
+    u32 sourceTexIdx = UINT32_MAX;
     for (u32 texIdx = 0; texIdx < app->textures.size(); ++texIdx)
+    {
         if (app->textures[texIdx].path == filepath)
-            return texIdx;
+        {
+            if (!app->textures[texIdx].sourceOnly)
+                return texIdx;
+            sourceTexIdx = texIdx; // Also sampled on its own, the slot gets its upload now
+        }
+    }
+
+    // The slot is returned now with the default texture, the real one replaces its handle once uploaded
+    if (TextureStreamingSupport::IsEnabled(app))
+    {
+        if (sourceTexIdx == UINT32_MAX)
+        {
+            sourceTexIdx = AddTextureSource(app, filepath);
+        }
+        Texture& tex = app->textures[sourceTexIdx];
+        tex.sourceOnly = false;
+        tex.streaming = true;
+        tex.role = role;
+        TextureStreamingSupport::RequestTexture(app, sourceTexIdx, role);
+        return sourceTexIdx;
+    }
 
     Image image = LoadImage(filepath);
+    if (image.pixels && sourceTexIdx != UINT32_MAX)
+    {
+        app->textures[sourceTexIdx].handle = CreateTexture2DFromImage(image);
+        app->textures[sourceTexIdx].size = image.size;
+        app->textures[sourceTexIdx].sourceOnly = false;
+        FreeImage(image);
+        return sourceTexIdx;
+    }
 
     if (image.pixels)
     {
-        Texture tex = {};
-        tex.handle = CreateTexture2DFromImage(image);
-        tex.path = filepath;
-        tex.size = image.size;
-        
-        const u32 texIdx = static_cast<u32>(app->textures.size());
-        app->textures.push_back(tex);
-
+        const u32 texIdx = CreateTexture2D(app, image, filepath);
         FreeImage(image);
         return texIdx;
     }
@@ -84,6 +142,109 @@ u32 TextureSupport::LoadTexture2D(App* app, const char* filepath)
     }
 }
 
+u32 TextureSupport::AddTextureSource(App* app, const char* filepath)
+{
+    for (u32 texIdx = 0; texIdx < app->textures.size(); ++texIdx)
+        if (app->textures[texIdx].path == filepath)
+            return texIdx;
+
+    Texture tex = {};
+    tex.handle = app->textures[app->defaultTextureIdx].handle;
+    tex.path = filepath;
+    tex.size = app->textures[app->defaultTextureIdx].size;
+    tex.sourceOnly = true;
+
+    const u32 texIdx = static_cast<u32>(app->textures.size());
+    app->textures.push_back(tex);
+    return texIdx;
+}
+
+u32 TextureSupport::LoadPackedMaskTexture2D(App* app, const u32 bumpTextureIdx, const u32 specularTextureIdx)
+{
+    const std::string bumpPath = bumpTextureIdx != 0 ? app->textures[bumpTextureIdx].path : std::string();
+    const std::string specularPath = specularTextureIdx != 0 ? app->textures[specularTextureIdx].path : std::string();
+
+    // Named after both sources so the slot is shared by the materials with the same pair, e.g. "dir/a_bump.png+a_spec.png"
+    const std::string firstPath = bumpPath.empty() ? specularPath : bumpPath;
+    const std::string packedPath = MakePath(GetDirectoryPart(firstPath), (bumpPath.empty() ? "" : GetFilenamePart(bumpPath)) + "+" + (specularPath.empty() ? "" : GetFilenamePart(specularPath)));
+    for (u32 texIdx = 0; texIdx < app->textures.size(); ++texIdx)
+        if (app->textures[texIdx].path == packedPath)
+            return texIdx;
+
+    if (TextureStreamingSupport::IsEnabled(app))
+    {
+        const u32 texIdx = AddTextureSource(app, packedPath.c_str());
+        Texture& tex = app->textures[texIdx];
+        tex.sourceOnly = false;
+        tex.streaming = true;
+        tex.role = TextureRole::PACKED_MASKS;
+        TextureStreamingSupport::RequestPackedMaskTexture(app, texIdx, bumpPath, specularPath);
+        return texIdx;
+    }
+
+    const Image bump = bumpPath.empty() ? Image{} : LoadImage(bumpPath.c_str());
+    const Image specular = specularPath.empty() ? Image{} : LoadImage(specularPath.c_str());
+    const Image packed = PackMaskImages(bump, specular);
+    if (bump.pixels)
+        FreeImage(bump);
+    if (specular.pixels)
+        FreeImage(specular);
+
+    const u32 texIdx = CreateTexture2D(app, packed, packedPath.c_str());
+    app->textures[texIdx].role = TextureRole::PACKED_MASKS;
+    FreeImage(packed);
+    return texIdx;
+}
+
+Image TextureSupport::PackMaskImages(const Image& bump, const Image& specular)
+{
+    // The largest source decides the size, the other one is sampled with nearest filtering
+    const ivec2 bumpSize = bump.pixels ? bump.size : ivec2(0);
+    const ivec2 specularSize = specular.pixels ? specular.size : ivec2(0);
+    Image packed = {};
+    packed.size = bumpSize.x * bumpSize.y >= specularSize.x * specularSize.y ? bumpSize : specularSize;
+    packed.size = glm::max(packed.size, ivec2(1));
+    packed.nchannels = 4;
+    packed.stride = packed.size.x * 4;
+    packed.pixels = malloc(static_cast<size_t>(packed.stride) * packed.size.y); // Released with FreeImage like the stb images
+
+    auto sample = [](const Image& image, const i32 x, const i32 y, const ivec2 size, const u8 defaultValue) -> u8
+    {
+        if (image.pixels == nullptr)
+            return defaultValue;
+        const i32 sourceX = x * image.size.x / size.x;
+        const i32 sourceY = y * image.size.y / size.y;
+        return static_cast<const u8*>(image.pixels)[static_cast<size_t>(sourceY) * image.stride + static_cast<size_t>(sourceX) * image.nchannels];
+    };
+
+    u8* pixels = static_cast<u8*>(packed.pixels);
+    for (i32 y = 0; y < packed.size.y; ++y)
+    {
+        for (i32 x = 0; x < packed.size.x; ++x)
+        {
+            u8* pixel = pixels + static_cast<size_t>(y) * packed.stride + static_cast<size_t>(x) * 4;
+            pixel[0] = sample(bump, x, y, packed.size, PACKED_MASK_DEFAULT_BUMP);
+            pixel[1] = sample(specular, x, y, packed.size, PACKED_MASK_DEFAULT_SPECULAR);
+            pixel[2] = 0;
+            pixel[3] = 255;
+        }
+    }
+    return packed;
+}
+
+u32 TextureSupport::CreateTexture2D(App* app, const Image& image, const char* path)
+{
+    Texture tex = {};
+    tex.handle = CreateTexture2DFromImage(image);
+    tex.path = path;
+    tex.size = image.size;
+
+    const u32 texIdx = static_cast<u32>(app->textures.size());
+    app->textures.push_back(tex);
+
+    return texIdx;
+}
+
 u32 TextureSupport::CreateEmptyColorTexture_8Bit_RGBA(App* app, const char* name, const u32 width, const u32 height)
 {
     Texture tex = {};
@@ -96,10 +257,9 @@ u32 TextureSupport::CreateEmptyColorTexture_8Bit_RGBA(App* app, const char* name
     glBindTexture(GL_TEXTURE_2D, tex.handle);
     glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, static_cast<GLsizei>(width), static_cast<GLsizei>(height), 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR); // Render targets have a single level, see Texture::mipmapped
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glGenerateMipmap(GL_TEXTURE_2D);
     glBindTexture(GL_TEXTURE_2D, 0);
 
     const u32 texIdx = static_cast<u32>(app->textures.size());
@@ -120,10 +280,9 @@ u32 TextureSupport::CreateEmptyColorTexture_16Bit_F_RGBA(App* app, const char* n
     glBindTexture(GL_TEXTURE_2D, tex.handle);
     glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, static_cast<GLsizei>(width), static_cast<GLsizei>(height), 0, GL_RGBA, GL_FLOAT, nullptr);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR); // Render targets have a single level, see Texture::mipmapped
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glGenerateMipmap(GL_TEXTURE_2D);
     glBindTexture(GL_TEXTURE_2D, 0);
 
     const u32 texIdx = static_cast<u32>(app->textures.size());
@@ -144,10 +303,31 @@ u32 TextureSupport::CreateEmptyDepthTexture(App* app, const char* name, const u3
     glBindTexture(GL_TEXTURE_2D, tex.handle);
     glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, static_cast<GLsizei>(width), static_cast<GLsizei>(height), 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR); // Render targets have a single level, see Texture::mipmapped
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    const u32 texIdx = static_cast<u32>(app->textures.size());
+    app->textures.push_back(tex);
+
+    return texIdx;
+}
+u32 TextureSupport::CreateEmptyDepthStencilTexture(App* app, const char* name, const u32 width, const u32 height)
+{
+    Texture tex = {};
+    tex.path = name;
+    tex.type = TextureType::FBO_DEPTH_STENCIL;
+    tex.size.x = static_cast<i32>(width);
+    tex.size.y = static_cast<i32>(height);
+    
+    glGenTextures(1, &tex.handle);
+    glBindTexture(GL_TEXTURE_2D, tex.handle);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH24_STENCIL8, static_cast<GLsizei>(width), static_cast<GLsizei>(height), 0, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR); // Render targets have a single level, see Texture::mipmapped
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glGenerateMipmap(GL_TEXTURE_2D);
     glBindTexture(GL_TEXTURE_2D, 0);
 
     const u32 texIdx = static_cast<u32>(app->textures.size());
@@ -167,10 +347,97 @@ u32 TextureSupport::CreateEmptyColorTexture_8Bit_R(App* app, const char* name, c
     glBindTexture(GL_TEXTURE_2D, tex.handle);
     glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, static_cast<GLsizei>(width), static_cast<GLsizei>(height), 0, GL_RED, GL_UNSIGNED_BYTE, nullptr);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR); // Render targets have a single level, see Texture::mipmapped
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    const u32 texIdx = static_cast<u32>(app->textures.size());
+    app->textures.push_back(tex);
+
+    return texIdx;
+}
+u32 TextureSupport::CreateEmptyColorTexture_16Bit_RGBA(App* app, const char* name, const u32 width, const u32 height)
+{
+    Texture tex = {};
+    tex.path = name;
+    tex.type = TextureType::FBO_COLOR_16_BIT_RGBA;
+    tex.size.x = static_cast<i32>(width);
+    tex.size.y = static_cast<i32>(height);
+
+    glGenTextures(1, &tex.handle);
+    glBindTexture(GL_TEXTURE_2D, tex.handle);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16, static_cast<GLsizei>(width), static_cast<GLsizei>(height), 0, GL_RGBA, GL_UNSIGNED_SHORT, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST); // Interpolating encoded values across the octahedron folds gives wrong vectors
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    const u32 texIdx = static_cast<u32>(app->textures.size());
+    app->textures.push_back(tex);
+
+    return texIdx;
+}
+u32 TextureSupport::CreateEmptyColorTexture_8Bit_RG(App* app, const char* name, const u32 width, const u32 height)
+{
+    Texture tex = {};
+    tex.path = name;
+    tex.type = TextureType::FBO_COLOR_8_BIT_RG;
+    tex.size.x = static_cast<i32>(width);
+    tex.size.y = static_cast<i32>(height);
+
+    glGenTextures(1, &tex.handle);
+    glBindTexture(GL_TEXTURE_2D, tex.handle);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RG8, static_cast<GLsizei>(width), static_cast<GLsizei>(height), 0, GL_RG, GL_UNSIGNED_BYTE, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR); // Render targets have a single level, see Texture::mipmapped
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    const u32 texIdx = static_cast<u32>(app->textures.size());
+    app->textures.push_back(tex);
+
+    return texIdx;
+}
+u32 TextureSupport::CreateEmptyColorTexture_32Bit_F_R(App* app, const char* name, const u32 width, const u32 height)
+{
+    Texture tex = {};
+    tex.path = name;
+    tex.type = TextureType::FBO_COLOR_32_BIT_FLOAT_RED;
+    tex.size.x = static_cast<i32>(width);
+    tex.size.y = static_cast<i32>(height);
+
+    glGenTextures(1, &tex.handle);
+    glBindTexture(GL_TEXTURE_2D, tex.handle);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, static_cast<GLsizei>(width), static_cast<GLsizei>(height), 0, GL_RED, GL_FLOAT, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST); // Render targets have a single level, see Texture::mipmapped
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    const u32 texIdx = static_cast<u32>(app->textures.size());
+    app->textures.push_back(tex);
+
+    return texIdx;
+}
+u32 TextureSupport::CreateEmptyColorTexture_16Bit_F_RG(App* app, const char* name, const u32 width, const u32 height)
+{
+    Texture tex = {};
+    tex.path = name;
+    tex.type = TextureType::FBO_COLOR_16_BIT_FLOAT_RG;
+    tex.size.x = static_cast<i32>(width);
+    tex.size.y = static_cast<i32>(height);
+
+    glGenTextures(1, &tex.handle);
+    glBindTexture(GL_TEXTURE_2D, tex.handle);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RG16F, static_cast<GLsizei>(width), static_cast<GLsizei>(height), 0, GL_RG, GL_FLOAT, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST); // Render targets have a single level, see Texture::mipmapped
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glGenerateMipmap(GL_TEXTURE_2D);
     glBindTexture(GL_TEXTURE_2D, 0);
 
     const u32 texIdx = static_cast<u32>(app->textures.size());
@@ -193,7 +460,6 @@ u32 TextureSupport::CreateNoiseColorTexture_16Bit_F_RGBA(App* app, const char* n
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    glGenerateMipmap(GL_TEXTURE_2D);
     glBindTexture(GL_TEXTURE_2D, 0);
 
     const u32 texIdx = static_cast<u32>(app->textures.size());
@@ -203,6 +469,10 @@ u32 TextureSupport::CreateNoiseColorTexture_16Bit_F_RGBA(App* app, const char* n
 }
 void TextureSupport::ResizeTexture(App* app, Texture& texToResize, const u32 newWidth, const u32 newHeight)
 {
+    // Respecifying the storage frees and allocates it again, skip the targets that keep their size
+    if (texToResize.size.x == static_cast<i32>(newWidth) && texToResize.size.y == static_cast<i32>(newHeight))
+        return;
+
     switch (texToResize.type) {
         case TextureType::FBO_COLOR_8_BIT_RGBA:
         {
@@ -244,6 +514,56 @@ void TextureSupport::ResizeTexture(App* app, Texture& texToResize, const u32 new
             glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE); 
         }
         break;
+    case TextureType::FBO_COLOR_16_BIT_RGBA:
+        {
+            glBindTexture(GL_TEXTURE_2D, texToResize.handle);
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16, static_cast<GLsizei>(newWidth), static_cast<GLsizei>(newHeight), 0, GL_RGBA, GL_UNSIGNED_SHORT, nullptr);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE); 
+        }
+        break;
+    case TextureType::FBO_COLOR_8_BIT_RG:
+        {
+            glBindTexture(GL_TEXTURE_2D, texToResize.handle);
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RG8, static_cast<GLsizei>(newWidth), static_cast<GLsizei>(newHeight), 0, GL_RG, GL_UNSIGNED_BYTE, nullptr);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE); 
+        }
+        break;
+    case TextureType::FBO_DEPTH_STENCIL:
+        {
+            glBindTexture(GL_TEXTURE_2D, texToResize.handle);
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH24_STENCIL8, static_cast<GLsizei>(newWidth), static_cast<GLsizei>(newHeight), 0, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8, nullptr);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE); 
+        }
+        break;
+    case TextureType::FBO_COLOR_32_BIT_FLOAT_RED:
+        {
+            glBindTexture(GL_TEXTURE_2D, texToResize.handle);
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, static_cast<GLsizei>(newWidth), static_cast<GLsizei>(newHeight), 0, GL_RED, GL_FLOAT, nullptr);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE); 
+        }
+        break;
+    case TextureType::FBO_COLOR_16_BIT_FLOAT_RG:
+        {
+            glBindTexture(GL_TEXTURE_2D, texToResize.handle);
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RG16F, static_cast<GLsizei>(newWidth), static_cast<GLsizei>(newHeight), 0, GL_RG, GL_FLOAT, nullptr);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE); 
+        }
+        break;
     case TextureType::FBO_STENCIL:
         break;
     default: ;
@@ -252,21 +572,185 @@ void TextureSupport::ResizeTexture(App* app, Texture& texToResize, const u32 new
     texToResize.size.y = static_cast<i32>(newHeight);
     glBindTexture(GL_TEXTURE_2D, 0);
 }
+
+u64 TextureSupport::GetEstimatedBytes(const Texture& tex)
+{
+    if (tex.sourceOnly || tex.released)
+        return 0;
+
+    // Drivers pad RGB8 and 24 bit depth to 4 bytes per texel
+    u64 texelBytes = 4;
+    switch (tex.type)
+    {
+    case TextureType::FBO_COLOR_16_BIT_FLOAT_RGBA: texelBytes = 8; break;
+    case TextureType::FBO_COLOR_16_BIT_RGBA: texelBytes = 8; break;
+    case TextureType::FBO_COLOR_8_BIT_RG: texelBytes = 2; break;
+    case TextureType::FBO_STENCIL: texelBytes = 1; break;
+    default: ;
+    }
+
+    const bool hasMips = tex.type == TextureType::NON_FBO || tex.mipmapped;
+    const u32 levelCount = hasMips ? GetMipLevelCount(tex.size) : 1;
+    u64 bytes = 0;
+    for (u32 level = 0; level < levelCount; ++level)
+    {
+        const u64 width = static_cast<u64>(glm::max(tex.size.x >> level, 1));
+        const u64 height = static_cast<u64>(glm::max(tex.size.y >> level, 1));
+        if (tex.compressedFormat != 0)
+            bytes += ((width + 3) / 4) * ((height + 3) / 4) * TextureCompressionSupport::GetBlockBytes(tex.compressedFormat);
+        else
+            bytes += width * height * texelBytes;
+    }
+    return bytes;
+}
+
+bool TextureSupport::DropTopMipLevel(App* app, const u32 texIdx)
+{
+    Texture& tex = app->textures[texIdx];
+    if (tex.type != TextureType::NON_FBO || tex.handle == app->textures[app->defaultTextureIdx].handle)
+        return false;
+    if (glm::max(tex.size.x, tex.size.y) / 2 < TEXTURE_MIN_EVICTED_SIZE)
+        return false;
+
+    // BASE_LEVEL alone would keep the immutable storage of level 0 allocated
+    GLint immutable = GL_FALSE;
+    GLint levelCount = 0;
+    GLint internalFormat = 0;
+    glBindTexture(GL_TEXTURE_2D, tex.handle);
+    glGetTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_IMMUTABLE_FORMAT, &immutable);
+    glGetTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_IMMUTABLE_LEVELS, &levelCount);
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_INTERNAL_FORMAT, &internalFormat);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    if (immutable == GL_FALSE || levelCount < 2)
+        return false;
+
+    const ivec2 newSize = glm::max(tex.size / 2, ivec2(1));
+    GLuint newHandle;
+    glGenTextures(1, &newHandle);
+    glBindTexture(GL_TEXTURE_2D, newHandle);
+    glTexStorage2D(GL_TEXTURE_2D, levelCount - 1, static_cast<GLenum>(internalFormat), newSize.x, newSize.y);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    for (GLint level = 0; level < levelCount - 1; ++level)
+    {
+        const GLsizei width = glm::max(newSize.x >> level, 1);
+        const GLsizei height = glm::max(newSize.y >> level, 1);
+        glCopyImageSubData(tex.handle, GL_TEXTURE_2D, level + 1, 0, 0, 0, newHandle, GL_TEXTURE_2D, level, 0, 0, 0, width, height, 1);
+    }
+
+    MaterialBatchingSupport::RetireTexture(app, texIdx);
+    glDeleteTextures(1, &tex.handle);
+    tex.handle = newHandle;
+    tex.size = newSize;
+    ++tex.evictedLevels;
+    return true;
+}
+
+bool TextureSupport::ReloadTexture(App* app, const u32 texIdx)
+{
+    Texture& tex = app->textures[texIdx];
+    if (tex.streaming)
+        return false;
+
+    // The sources of packed textures are in their name, see LoadPackedMaskTexture2D
+    std::string bumpPath;
+    std::string specularPath;
+    if (tex.role == TextureRole::PACKED_MASKS)
+    {
+        const std::string directory = GetDirectoryPart(tex.path);
+        const std::string filename = GetFilenamePart(tex.path);
+        const size_t separator = filename.find('+');
+        const std::string bumpName = filename.substr(0, separator);
+        const std::string specularName = separator != std::string::npos ? filename.substr(separator + 1) : std::string();
+        bumpPath = bumpName.empty() ? std::string() : MakePath(directory, bumpName);
+        specularPath = specularName.empty() ? std::string() : MakePath(directory, specularName);
+    }
+
+    // Cone maps come from their own cache, the streaming workers only decode images
+    if (TextureStreamingSupport::IsEnabled(app) && tex.role != TextureRole::CONE_STEP_MAP)
+    {
+        tex.streaming = true;
+        tex.released = false;
+        if (tex.role != TextureRole::PACKED_MASKS)
+            TextureStreamingSupport::RequestTexture(app, texIdx, tex.role);
+        else
+            TextureStreamingSupport::RequestPackedMaskTexture(app, texIdx, bumpPath, specularPath);
+        return true;
+    }
+
+    // Without the streaming workers (always for the cone maps) the texture is read and uploaded right away, like in LoadTexture2D
+    Image image = {};
+    if (tex.role == TextureRole::PACKED_MASKS)
+    {
+        const Image bump = bumpPath.empty() ? Image{} : LoadImage(bumpPath.c_str());
+        const Image specular = specularPath.empty() ? Image{} : LoadImage(specularPath.c_str());
+        image = PackMaskImages(bump, specular);
+        if (bump.pixels)
+            FreeImage(bump);
+        if (specular.pixels)
+            FreeImage(specular);
+    }
+    else if (tex.role == TextureRole::CONE_STEP_MAP)
+    {
+        bool cached = false;
+        const std::string bumpPath = tex.path.substr(0, tex.path.size() - strlen(CONE_STEP_MAP_EXTENSION));
+        image = ConeStepMapSupport::ReadOrBuildConeMap(bumpPath.c_str(), cached);
+    }
+    else
+    {
+        image = LoadImage(tex.path.c_str());
+    }
+    if (image.pixels == nullptr)
+        return false;
+
+    MaterialBatchingSupport::RetireTexture(app, texIdx);
+    if (tex.handle != app->textures[app->defaultTextureIdx].handle)
+        glDeleteTextures(1, &tex.handle);
+    tex.handle = CreateTexture2DFromImage(image);
+    tex.size = image.size;
+    tex.compressedFormat = 0;
+    tex.evictedLevels = 0;
+    tex.released = false;
+    FreeImage(image);
+    return true;
+}
+
+bool TextureSupport::ReleaseTexture(App* app, const u32 texIdx)
+{
+    Texture& tex = app->textures[texIdx];
+    const GLuint defaultHandle = app->textures[app->defaultTextureIdx].handle;
+    if (tex.type != TextureType::NON_FBO || tex.sourceOnly || tex.streaming || tex.handle == defaultHandle)
+        return false;
+
+    MaterialBatchingSupport::RetireTexture(app, texIdx);
+    glDeleteTextures(1, &tex.handle);
+    tex.handle = defaultHandle;
+    tex.evictedLevels = 0;
+    tex.released = true;
+    return true;
+}
+
 std::string TextureSupport::GetInfoString(const Texture& tex)
 {
     std::string info = "Size: ";
     info += glm::to_string(tex.size);
     info += ", ";
     info += "Mega bytes size: ";
-    float sizeBytes = 0;
-    if (tex.type != TextureType::FBO_DEPTH)
+    info += std::to_string(static_cast<f64>(GetEstimatedBytes(tex)) / 1000000.0);
+    if (tex.compressedFormat != 0)
     {
-        sizeBytes = static_cast<float>(tex.size.x) * static_cast<float>(tex.size.y) * 4.0f/1000000.0f; // 4 bits per channel = 1 byte per channel (4 channels) from bytes to megabytes
+        info += ", ";
+        info += TextureCompressionSupport::GetFormatName(tex.compressedFormat);
     }
-    else
+    if (tex.evictedLevels > 0)
     {
-        sizeBytes = static_cast<float>(tex.size.x) * static_cast<float>(tex.size.y) * 3.0f/1000000.0f; // 24 bits per channel, single channel, conversion from bytes to megabytes
+        info += ", ";
+        info += std::to_string(tex.evictedLevels);
+        info += " mips evicted";
     }
-    info += std::to_string(sizeBytes);
     return info;
 }
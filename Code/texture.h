@@ -5,6 +5,24 @@
 #include "platform.h"
 
 struct App;
+struct CompressedImage;
+
+// What the texture holds, it decides the block format and how the mips are filtered
+enum class TextureRole : u32
+{
+    COLOR,  // sRGB content (albedo, emissive), mips averaged in linear space
+    NORMAL, // Tangent space normal map, only x/y are kept and z is rebuilt in the shaders
+    MASK,   // Single channel data read from .r
+    PACKED_MASKS, // Bump height in .r and specular mask in .g, see TextureSupport::LoadPackedMaskTexture2D
+    CONE_STEP_MAP // Built from a bump source and cached next to it, see ConeStepMapSupport
+};
+
+#define PACKED_MASK_DEFAULT_BUMP 0
+#define PACKED_MASK_DEFAULT_SPECULAR 204 // 0.8, the specular strength of materials without specular map
+
+// DropTopMipLevel stops once the largest side would go below this
+#define TEXTURE_MIN_EVICTED_SIZE 64
+
 struct Image
 {
     void* pixels;
@@ -13,7 +31,7 @@ struct Image
     i32   stride;
 };
 
-static const char* TextureTypeStr[] = {"NON_FBO", "FBO_COLOR_8_BIT_RGBA", "FBO_COLOR_8_BIT_RED", "FBO_COLOR_16_BIT_FLOAT_RGBA", "FBO_DEPTH", "FBO_STENCIL"}; 
+static const char* TextureTypeStr[] = {"NON_FBO", "FBO_COLOR_8_BIT_RGBA", "FBO_COLOR_8_BIT_RED", "FBO_COLOR_16_BIT_FLOAT_RGBA", "FBO_DEPTH", "FBO_STENCIL", "FBO_COLOR_16_BIT_RGBA", "FBO_COLOR_8_BIT_RG", "FBO_DEPTH_STENCIL", "FBO_COLOR_32_BIT_FLOAT_RED", "FBO_COLOR_16_BIT_FLOAT_RG"}; 
 enum class TextureType
 {
     NON_FBO,
@@ -21,7 +39,12 @@ enum class TextureType
     FBO_COLOR_8_BIT_RED,
     FBO_COLOR_16_BIT_FLOAT_RGBA,
     FBO_DEPTH,
-    FBO_STENCIL
+    FBO_STENCIL,
+    FBO_COLOR_16_BIT_RGBA, // Unsigned normalized, unfiltered (e.g. octahedral encoded normals)
+    FBO_COLOR_8_BIT_RG,
+    FBO_DEPTH_STENCIL, // Sampled as depth
+    FBO_COLOR_32_BIT_FLOAT_RED, // Unfiltered (e.g. linear view depth)
+    FBO_COLOR_16_BIT_FLOAT_RG // Unfiltered (e.g. motion vectors)
 };
 
 struct Texture
@@ -30,6 +53,17 @@ struct Texture
     std::string path;
     TextureType type = TextureType::NON_FBO;
     ivec2 size;
+    f32 screenScale = 1.0f; // Size of FBO targets relative to the display, 0 for targets with a fixed size (e.g. baked atlases)
+    bool streaming = false; // Still decoding/uploading in the background, the handle is the default texture's until then
+    GLenum compressedFormat = 0; // Block compression format, 0 for uncompressed textures
+    bool sourceOnly = false; // Only read to build packed textures (e.g. specular/bump masks), never uploaded
+    TextureRole role = TextureRole::COLOR; // Kept to request the texture again after its mips were evicted
+    bool mipmapped = false; // FBO targets with a generated mip chain (e.g. the impostor atlases), the others have a single level
+
+    // GPU memory budget, see GpuMemorySupport
+    u32 evictedLevels = 0; // Top mips dropped to stay in budget, size is the one of the remaining first level
+    u64 lastVisibleFrame = 0;
+    bool released = false; // Unloaded with its model, the handle is the default texture's until ReloadTexture
 };
 
 struct TextureSupport
@@ -37,16 +71,47 @@ struct TextureSupport
     static Image LoadImage(const char* filename);
     static void FreeImage(const Image& image);
     static GLuint CreateTexture2DFromImage(const Image& image);
-    static u32 LoadTexture2D(App* app, const char* filepath);
+    // Every mip comes from the image, data nullptr reads the mips from the bound pixel unpack buffer
+    static GLuint CreateTexture2DFromCompressedImage(const CompressedImage& image, const u8* data);
+    static u32 GetMipLevelCount(ivec2 size);
+    static u32 LoadTexture2D(App* app, const char* filepath, TextureRole role = TextureRole::COLOR);
+
+    // Slot that only keeps the path of an image packed into another texture, see LoadPackedMaskTexture2D
+    static u32 AddTextureSource(App* app, const char* filepath);
+
+    // Bump height (r) and specular mask (g) of a material in one texture, a missing source gets its default value.
+    // The sources are AddTextureSource slots (or 0 when the material has none)
+    static u32 LoadPackedMaskTexture2D(App* app, u32 bumpTextureIdx, u32 specularTextureIdx);
+    static Image PackMaskImages(const Image& bump, const Image& specular);
+    static u32 CreateTexture2D(App* app, const Image& image, const char* path);
 
     static u32 CreateEmptyColorTexture_8Bit_RGBA(App* app, const char* name, const u32 width, const u32 height);
     static u32 CreateEmptyColorTexture_16Bit_F_RGBA(App* app, const char* name, const u32 width, const u32 height);
     static u32 CreateEmptyDepthTexture(App* app, const char* name, const u32 width, const u32 height);
+    static u32 CreateEmptyDepthStencilTexture(App* app, const char* name, const u32 width, const u32 height);
     static u32 CreateEmptyColorTexture_8Bit_R(App* app, const char* name, const u32 width, const u32 height);
+    static u32 CreateEmptyColorTexture_16Bit_RGBA(App* app, const char* name, const u32 width, const u32 height);
+    static u32 CreateEmptyColorTexture_8Bit_RG(App* app, const char* name, const u32 width, const u32 height);
+    static u32 CreateEmptyColorTexture_32Bit_F_R(App* app, const char* name, const u32 width, const u32 height);
+    static u32 CreateEmptyColorTexture_16Bit_F_RG(App* app, const char* name, const u32 width, const u32 height);
     static u32 CreateNoiseColorTexture_16Bit_F_RGBA(App* app, const char* name, const u32 width, const u32 height, const std::vector<glm::vec3>& ssaoNoise);
 
     static void ResizeTexture(App* app, Texture& texToResize, const u32 newWidth, const u32 newHeight);
 
+    // Video memory of the texture with its mip chain, estimated from the size and format
+    static u64 GetEstimatedBytes(const Texture& tex);
+
+    // Replaces the immutable storage with one without the first level, the other mips are copied on the GPU.
+    // False when the texture is already at TEXTURE_MIN_EVICTED_SIZE or is not an immutable mip chain
+    static bool DropTopMipLevel(App* app, u32 texIdx);
+
+    // Streams the full resolution texture again from its path (or its packed sources), e.g. after DropTopMipLevel
+    static bool ReloadTexture(App* app, u32 texIdx);
+
+    // Frees the video memory of a loaded texture, the slot keeps its path and samples the default texture meanwhile.
+    // False for render targets and for textures that are still streaming
+    static bool ReleaseTexture(App* app, u32 texIdx);
+
     static std::string GetInfoString(const Texture& tex);
 };
 
@@ -0,0 +1,494 @@
+﻿#include "texture_compression.h"
+
+#include <cmath>
+#include <cstring>
+
+#define BC_BLOCK_SIZE 4
+
+// Floating point texels of one mip, rgb is linear for color and a [-1, 1] vector for normal maps
+struct MipLevel
+{
+    i32 width;
+    i32 height;
+    std::vector<glm::vec4> texels;
+};
+
+static f32 SrgbToLinear(const f32 value)
+{
+    return value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+}
+
+static f32 LinearToSrgb(const f32 value)
+{
+    return value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+}
+
+static MipLevel ConvertImage(const Image& image, const TextureRole role)
+{
+    static f32 srgbToLinear[256];
+    static const bool srgbTableReady = [](){ for (u32 i = 0; i < 256; ++i) srgbToLinear[i] = SrgbToLinear(i / 255.0f); return true; }();
+    (void)srgbTableReady;
+
+    MipLevel level = { image.size.x, image.size.y, {} };
+    level.texels.resize(static_cast<size_t>(image.size.x) * image.size.y);
+    const u8* pixels = static_cast<const u8*>(image.pixels);
+    for (i32 y = 0; y < image.size.y; ++y)
+    {
+        for (i32 x = 0; x < image.size.x; ++x)
+        {
+            const u8* pixel = pixels + static_cast<size_t>(y) * image.stride + static_cast<size_t>(x) * image.nchannels;
+            u8 rgba[4] = { pixel[0], pixel[0], pixel[0], 255 };
+            if (image.nchannels == 2)
+                rgba[3] = pixel[1];
+            if (image.nchannels >= 3)
+            {
+                rgba[1] = pixel[1];
+                rgba[2] = pixel[2];
+            }
+            if (image.nchannels == 4)
+                rgba[3] = pixel[3];
+
+            glm::vec4 texel = glm::vec4(rgba[0], rgba[1], rgba[2], rgba[3]) / 255.0f;
+            if (role == TextureRole::COLOR)
+                texel = glm::vec4(srgbToLinear[rgba[0]], srgbToLinear[rgba[1]], srgbToLinear[rgba[2]], texel.a);
+            else if (role == TextureRole::NORMAL)
+                texel = glm::vec4(glm::vec3(texel) * 2.0f - 1.0f, texel.a);
+            level.texels[static_cast<size_t>(y) * image.size.x + x] = texel;
+        }
+    }
+    return level;
+}
+
+// 2x2 box filter, normal maps are renormalized so the lower mips do not get shorter (darker) normals
+static MipLevel DownsampleLevel(const MipLevel& source, const TextureRole role)
+{
+    MipLevel level = { glm::max(source.width / 2, 1), glm::max(source.height / 2, 1), {} };
+    level.texels.resize(static_cast<size_t>(level.width) * level.height);
+    for (i32 y = 0; y < level.height; ++y)
+    {
+        for (i32 x = 0; x < level.width; ++x)
+        {
+            const i32 x0 = glm::min(x * 2, source.width - 1), x1 = glm::min(x * 2 + 1, source.width - 1);
+            const i32 y0 = glm::min(y * 2, source.height - 1), y1 = glm::min(y * 2 + 1, source.height - 1);
+            glm::vec4 texel = (source.texels[static_cast<size_t>(y0) * source.width + x0] + source.texels[static_cast<size_t>(y0) * source.width + x1] +
+                source.texels[static_cast<size_t>(y1) * source.width + x0] + source.texels[static_cast<size_t>(y1) * source.width + x1]) * 0.25f;
+            if (role == TextureRole::NORMAL && glm::length(glm::vec3(texel)) > 1e-6f)
+                texel = glm::vec4(glm::normalize(glm::vec3(texel)), texel.a);
+            level.texels[static_cast<size_t>(y) * level.width + x] = texel;
+        }
+    }
+    return level;
+}
+
+// Back to 8 bits in the encoding of the source, pixels outside the level repeat the border (mips smaller than a block)
+static void ReadBlock(const MipLevel& level, const TextureRole role, const i32 blockX, const i32 blockY, u8 block[16][4])
+{
+    for (u32 i = 0; i < 16; ++i)
+    {
+        const i32 x = glm::min(blockX * BC_BLOCK_SIZE + static_cast<i32>(i % 4), level.width - 1);
+        const i32 y = glm::min(blockY * BC_BLOCK_SIZE + static_cast<i32>(i / 4), level.height - 1);
+        glm::vec4 texel = level.texels[static_cast<size_t>(y) * level.width + x];
+        if (role == TextureRole::COLOR)
+            texel = glm::vec4(LinearToSrgb(texel.r), LinearToSrgb(texel.g), LinearToSrgb(texel.b), texel.a);
+        else if (role == TextureRole::NORMAL)
+            texel = glm::vec4(glm::normalize(glm::vec3(texel) + glm::vec3(0.0f, 0.0f, 1e-6f)) * 0.5f + 0.5f, texel.a);
+        for (u32 c = 0; c < 4; ++c)
+            block[i][c] = static_cast<u8>(glm::clamp(texel[c] * 255.0f + 0.5f, 0.0f, 255.0f));
+    }
+}
+
+// Main axis of the colors of a block by power iteration on their covariance
+template <typename Vec, typename Mat>
+static Vec PrincipalAxis(const Vec* values, const Vec& mean)
+{
+    Mat covariance(0.0f);
+    for (u32 i = 0; i < 16; ++i)
+    {
+        const Vec delta = values[i] - mean;
+        covariance += glm::outerProduct(delta, delta);
+    }
+    Vec axis(1.0f);
+    for (u32 iteration = 0; iteration < 8; ++iteration)
+    {
+        axis = covariance * axis;
+        const f32 length = glm::length(axis);
+        if (length < 1e-6f)
+            return Vec(0.0f);
+        axis /= length;
+    }
+    return axis;
+}
+
+static u16 PackRGB565(const glm::vec3& color)
+{
+    const glm::vec3 c = glm::clamp(color, 0.0f, 255.0f);
+    return static_cast<u16>((static_cast<u32>(c.r * 31.0f / 255.0f + 0.5f) << 11) | (static_cast<u32>(c.g * 63.0f / 255.0f + 0.5f) << 5) | static_cast<u32>(c.b * 31.0f / 255.0f + 0.5f));
+}
+
+static glm::vec3 UnpackRGB565(const u16 packed)
+{
+    const u32 r = (packed >> 11) & 31, g = (packed >> 5) & 63, b = packed & 31;
+    return glm::vec3((r << 3) | (r >> 2), (g << 2) | (g >> 4), (b << 3) | (b >> 2));
+}
+
+// BC1 color block: two 565 endpoints on the main axis of the block and 2 bit indices, always in 4 color mode
+static void EncodeBC1Block(const u8 block[16][4], u8* out)
+{
+    glm::vec3 colors[16];
+    glm::vec3 mean(0.0f);
+    for (u32 i = 0; i < 16; ++i)
+    {
+        colors[i] = glm::vec3(block[i][0], block[i][1], block[i][2]);
+        mean += colors[i] / 16.0f;
+    }
+    const glm::vec3 axis = PrincipalAxis<glm::vec3, glm::mat3>(colors, mean);
+    f32 minT = 0.0f, maxT = 0.0f;
+    for (u32 i = 0; i < 16; ++i)
+    {
+        const f32 t = glm::dot(colors[i] - mean, axis);
+        minT = glm::min(minT, t);
+        maxT = glm::max(maxT, t);
+    }
+
+    u16 color0 = PackRGB565(mean + axis * maxT);
+    u16 color1 = PackRGB565(mean + axis * minT);
+    if (color0 < color1)
+        std::swap(color0, color1);
+
+    u32 indices = 0;
+    if (color0 != color1)
+    {
+        const glm::vec3 endpoint0 = UnpackRGB565(color0), endpoint1 = UnpackRGB565(color1);
+        const glm::vec3 palette[4] = { endpoint0, endpoint1, (endpoint0 * 2.0f + endpoint1) / 3.0f, (endpoint0 + endpoint1 * 2.0f) / 3.0f };
+        for (u32 i = 0; i < 16; ++i)
+        {
+            u32 best = 0;
+            f32 bestDistance = FLT_MAX;
+            for (u32 p = 0; p < 4; ++p)
+            {
+                const glm::vec3 delta = colors[i] - palette[p];
+                const f32 distance = glm::dot(delta, delta);
+                if (distance < bestDistance)
+                {
+                    bestDistance = distance;
+                    best = p;
+                }
+            }
+            indices |= best << (i * 2);
+        }
+    }
+
+    memcpy(out, &color0, 2);
+    memcpy(out + 2, &color1, 2);
+    memcpy(out + 4, &indices, 4);
+}
+
+// BC4 single channel block: 8 bit endpoints and 3 bit indices in the 8 value mode (red0 > red1)
+static void EncodeBC4Block(const u8 block[16][4], const u32 channel, u8* out)
+{
+    u8 minValue = 255, maxValue = 0;
+    for (u32 i = 0; i < 16; ++i)
+    {
+        minValue = glm::min(minValue, block[i][channel]);
+        maxValue = glm::max(maxValue, block[i][channel]);
+    }
+
+    u64 indices = 0;
+    if (maxValue != minValue)
+    {
+        for (u32 i = 0; i < 16; ++i)
+        {
+            // Step 0 is red1 (min) and step 7 is red0 (max), index i in [2, 7] is ((8 - i) * red0 + (i - 1) * red1) / 7
+            const u32 step = static_cast<u32>((block[i][channel] - minValue) * 7.0f / (maxValue - minValue) + 0.5f);
+            const u64 index = step == 7 ? 0 : step == 0 ? 1 : 8 - step;
+            indices |= index << (i * 3);
+        }
+    }
+
+    out[0] = maxValue;
+    out[1] = minValue;
+    for (u32 b = 0; b < 6; ++b)
+        out[2 + b] = static_cast<u8>((indices >> (b * 8)) & 0xFF);
+}
+
+struct BlockBitWriter
+{
+    u8* out;
+    u32 bit = 0;
+
+    void Write(const u32 value, const u32 count)
+    {
+        for (u32 i = 0; i < count; ++i, ++bit)
+            if ((value >> i) & 1)
+                out[bit >> 3] |= static_cast<u8>(1 << (bit & 7));
+    }
+};
+
+// BC7 mode 6: a single subset with RGBA 7 bit endpoints + a p-bit each and 4 bit indices
+static void EncodeBC7Block(const u8 block[16][4], u8* out)
+{
+    static const u32 weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+    glm::vec4 colors[16];
+    glm::vec4 mean(0.0f);
+    for (u32 i = 0; i < 16; ++i)
+    {
+        colors[i] = glm::vec4(block[i][0], block[i][1], block[i][2], block[i][3]);
+        mean += colors[i] / 16.0f;
+    }
+    const glm::vec4 axis = PrincipalAxis<glm::vec4, glm::mat4>(colors, mean);
+    f32 minT = 0.0f, maxT = 0.0f;
+    for (u32 i = 0; i < 16; ++i)
+    {
+        const f32 t = glm::dot(colors[i] - mean, axis);
+        minT = glm::min(minT, t);
+        maxT = glm::max(maxT, t);
+    }
+
+    // Quantize both endpoints, the p-bit is the shared low bit of the 4 channels so try both
+    glm::uvec4 quantized[2];
+    u32 pBits[2];
+    glm::vec4 endpoints[2];
+    const glm::vec4 targets[2] = { glm::clamp(mean + axis * minT, 0.0f, 255.0f), glm::clamp(mean + axis * maxT, 0.0f, 255.0f) };
+    for (u32 e = 0; e < 2; ++e)
+    {
+        f32 bestError = FLT_MAX;
+        for (u32 p = 0; p < 2; ++p)
+        {
+            const glm::uvec4 q = glm::uvec4(glm::clamp(glm::floor((targets[e] - static_cast<f32>(p)) * 0.5f + 0.5f), 0.0f, 127.0f));
+            const glm::vec4 reconstructed = glm::vec4(q * 2u + p);
+            const glm::vec4 delta = reconstructed - targets[e];
+            const f32 error = glm::dot(delta, delta);
+            if (error < bestError)
+            {
+                bestError = error;
+                quantized[e] = q;
+                pBits[e] = p;
+                endpoints[e] = reconstructed;
+            }
+        }
+    }
+
+    glm::vec4 palette[16];
+    for (u32 p = 0; p < 16; ++p)
+        palette[p] = glm::floor((endpoints[0] * static_cast<f32>(64 - weights[p]) + endpoints[1] * static_cast<f32>(weights[p]) + 32.0f) / 64.0f);
+
+    u32 indices[16];
+    for (u32 i = 0; i < 16; ++i)
+    {
+        f32 bestDistance = FLT_MAX;
+        for (u32 p = 0; p < 16; ++p)
+        {
+            const glm::vec4 delta = colors[i] - palette[p];
+            const f32 distance = glm::dot(delta, delta);
+            if (distance < bestDistance)
+            {
+                bestDistance = distance;
+                indices[i] = p;
+            }
+        }
+    }
+
+    // The first index is stored with 3 bits, its top bit must be 0
+    if (indices[0] >= 8)
+    {
+        std::swap(quantized[0], quantized[1]);
+        std::swap(pBits[0], pBits[1]);
+        for (u32& index : indices)
+            index = 15 - index;
+    }
+
+    memset(out, 0, 16);
+    BlockBitWriter writer = { out };
+    writer.Write(1 << 6, 7); // Mode 6
+    for (u32 c = 0; c < 4; ++c)
+    {
+        writer.Write(quantized[0][c], 7);
+        writer.Write(quantized[1][c], 7);
+    }
+    writer.Write(pBits[0], 1);
+    writer.Write(pBits[1], 1);
+    writer.Write(indices[0], 3);
+    for (u32 i = 1; i < 16; ++i)
+        writer.Write(indices[i], 4);
+}
+
+static void EncodeBlock(const u8 block[16][4], const GLenum format, u8* out)
+{
+    switch (format)
+    {
+    case GL_COMPRESSED_RGB_S3TC_DXT1_EXT: EncodeBC1Block(block, out); break;
+    case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT: EncodeBC4Block(block, 3, out); EncodeBC1Block(block, out + 8); break;
+    case GL_COMPRESSED_RED_RGTC1: EncodeBC4Block(block, 0, out); break;
+    case GL_COMPRESSED_RG_RGTC2: EncodeBC4Block(block, 0, out); EncodeBC4Block(block, 1, out + 8); break;
+    case GL_COMPRESSED_RGBA_BPTC_UNORM: EncodeBC7Block(block, out); break;
+    default: break;
+    }
+}
+
+static u32 PackSettings(const TextureCompressionSettings& settings)
+{
+    return (settings.s3tcSupported ? 1u : 0u) | (settings.useBC7ForColor ? 2u : 0u);
+}
+
+GLenum TextureCompressionSupport::ChooseFormat(const TextureRole role, const Image& image, const TextureCompressionSettings& settings)
+{
+    switch (role)
+    {
+    case TextureRole::NORMAL: return GL_COMPRESSED_RG_RGTC2;
+    case TextureRole::MASK: return GL_COMPRESSED_RED_RGTC1;
+    case TextureRole::PACKED_MASKS: return GL_COMPRESSED_RG_RGTC2;
+    case TextureRole::COLOR:
+    default:
+        {
+            if (settings.useBC7ForColor || !settings.s3tcSupported)
+                return GL_COMPRESSED_RGBA_BPTC_UNORM;
+
+            bool hasAlpha = false;
+            if (image.nchannels == 2 || image.nchannels == 4)
+            {
+                const u8* pixels = static_cast<const u8*>(image.pixels);
+                for (i32 y = 0; y < image.size.y && !hasAlpha; ++y)
+                    for (i32 x = 0; x < image.size.x && !hasAlpha; ++x)
+                        hasAlpha = pixels[static_cast<size_t>(y) * image.stride + static_cast<size_t>(x + 1) * image.nchannels - 1] != 255;
+            }
+            return hasAlpha ? GL_COMPRESSED_RGBA_S3TC_DXT5_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+        }
+    }
+}
+
+bool TextureCompressionSupport::CompressImage(const Image& image, const TextureRole role, const GLenum format, CompressedImage& compressed)
+{
+    if (image.pixels == nullptr || image.size.x % BC_BLOCK_SIZE != 0 || image.size.y % BC_BLOCK_SIZE != 0)
+        return false;
+
+    compressed = CompressedImage{};
+    compressed.format = format;
+    compressed.size = image.size;
+
+    const u32 blockBytes = GetBlockBytes(format);
+    MipLevel level = ConvertImage(image, role);
+    for (;;)
+    {
+        const i32 blocksX = (level.width + BC_BLOCK_SIZE - 1) / BC_BLOCK_SIZE;
+        const i32 blocksY = (level.height + BC_BLOCK_SIZE - 1) / BC_BLOCK_SIZE;
+        CompressedMip mip = { level.width, level.height, compressed.data.size(), static_cast<u64>(blocksX) * blocksY * blockBytes };
+        compressed.data.resize(mip.offset + mip.size);
+
+        u8 block[16][4];
+        u8* out = compressed.data.data() + mip.offset;
+        for (i32 blockY = 0; blockY < blocksY; ++blockY)
+        {
+            for (i32 blockX = 0; blockX < blocksX; ++blockX, out += blockBytes)
+            {
+                ReadBlock(level, role, blockX, blockY, block);
+                EncodeBlock(block, format, out);
+            }
+        }
+        compressed.mips.push_back(mip);
+
+        if (level.width == 1 && level.height == 1)
+            break;
+        level = DownsampleLevel(level, role);
+    }
+    return true;
+}
+
+std::string TextureCompressionSupport::GetCachePath(const char* filename)
+{
+    return MakeString(filename) + TEXTURE_CACHE_EXTENSION;
+}
+
+bool TextureCompressionSupport::LoadCachedTexture(const char* filename, const u64 sourceHash, const TextureRole role, const TextureCompressionSettings& settings, CompressedImage& compressed)
+{
+    const std::string cachePath = GetCachePath(filename);
+    MappedFile file;
+    if (!MapFile(cachePath.c_str(), file))
+        return false;
+
+    TextureCacheHeader header = {};
+    bool valid = file.size >= sizeof(TextureCacheHeader);
+    if (valid)
+    {
+        memcpy(&header, file.data, sizeof(TextureCacheHeader));
+        valid = header.magic == TEXTURE_CACHE_MAGIC && header.version == TEXTURE_CACHE_VERSION && header.sourceHash == sourceHash &&
+            header.role == static_cast<u32>(role) && header.settings == PackSettings(settings) && GetBlockBytes(header.format) != 0;
+    }
+
+    const u64 mipsOffset = sizeof(TextureCacheHeader);
+    const u64 dataOffset = mipsOffset + static_cast<u64>(header.mipCount) * sizeof(CompressedMip);
+    valid = valid && dataOffset <= file.size;
+    if (valid)
+    {
+        compressed.format = header.format;
+        compressed.size = ivec2(header.width, header.height);
+        compressed.mips.resize(header.mipCount);
+        memcpy(compressed.mips.data(), file.data + mipsOffset, header.mipCount * sizeof(CompressedMip));
+        for (const CompressedMip& mip : compressed.mips)
+            valid = valid && dataOffset + mip.offset + mip.size <= file.size;
+        if (valid)
+            compressed.data.assign(file.data + dataOffset, file.data + file.size);
+    }
+    UnmapFile(file);
+
+    if (!valid)
+        ELOG("Texture cache %s is outdated or corrupted, compressing the source again", cachePath.c_str())
+    return valid;
+}
+
+bool TextureCompressionSupport::WriteCachedTexture(const char* filename, const u64 sourceHash, const TextureRole role, const TextureCompressionSettings& settings, const CompressedImage& compressed)
+{
+    const std::string cachePath = GetCachePath(filename);
+    FILE* file = fopen(cachePath.c_str(), "wb");
+    if (!file)
+    {
+        ELOG("Could not write the texture cache %s", cachePath.c_str())
+        return false;
+    }
+
+    TextureCacheHeader header = {};
+    header.magic = TEXTURE_CACHE_MAGIC;
+    header.version = TEXTURE_CACHE_VERSION;
+    header.sourceHash = sourceHash;
+    header.role = static_cast<u32>(role);
+    header.settings = PackSettings(settings);
+    header.format = compressed.format;
+    header.width = compressed.size.x;
+    header.height = compressed.size.y;
+    header.mipCount = static_cast<u32>(compressed.mips.size());
+
+    bool written = fwrite(&header, sizeof(header), 1, file) == 1;
+    written = written && fwrite(compressed.mips.data(), sizeof(CompressedMip), compressed.mips.size(), file) == compressed.mips.size();
+    written = written && fwrite(compressed.data.data(), 1, compressed.data.size(), file) == compressed.data.size();
+    fclose(file);
+
+    if (!written)
+    {
+        ELOG("Could not write the texture cache %s", cachePath.c_str())
+        remove(cachePath.c_str());
+    }
+    return written;
+}
+
+u32 TextureCompressionSupport::GetBlockBytes(const GLenum format)
+{
+    switch (format)
+    {
+    case GL_COMPRESSED_RGB_S3TC_DXT1_EXT: case GL_COMPRESSED_RED_RGTC1: return 8;
+    case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT: case GL_COMPRESSED_RG_RGTC2: case GL_COMPRESSED_RGBA_BPTC_UNORM: return 16;
+    default: return 0;
+    }
+}
+
+const char* TextureCompressionSupport::GetFormatName(const GLenum format)
+{
+    switch (format)
+    {
+    case GL_COMPRESSED_RGB_S3TC_DXT1_EXT: return "BC1";
+    case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT: return "BC3";
+    case GL_COMPRESSED_RED_RGTC1: return "BC4";
+    case GL_COMPRESSED_RG_RGTC2: return "BC5";
+    case GL_COMPRESSED_RGBA_BPTC_UNORM: return "BC7";
+    default: return "Uncompressed";
+    }
+}
@@ -0,0 +1,84 @@
+﻿#ifndef TEXTURE_COMPRESSION_H
+#define TEXTURE_COMPRESSION_H
+#include <string>
+#include <vector>
+
+#include "platform.h"
+#include "texture.h"
+
+// S3TC comes from an extension (exposed by every desktop driver), glad only has the core enums
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+
+#define TEXTURE_CACHE_MAGIC 0x48435854 // "TXCH"
+#define TEXTURE_CACHE_VERSION 1
+#define TEXTURE_CACHE_EXTENSION ".texcache"
+
+struct CompressedMip
+{
+    i32 width;
+    i32 height;
+    u64 offset; // From the start of the data
+    u64 size;
+};
+
+/// <summary>
+/// Block compressed texture with its whole mip chain, ready for glCompressedTexSubImage2D.
+/// </summary>
+struct CompressedImage
+{
+    GLenum format = 0;
+    ivec2 size = ivec2(0);
+    std::vector<CompressedMip> mips;
+    std::vector<u8> data;
+};
+
+struct TextureCompressionSettings
+{
+    bool s3tcSupported = true; // BC7 is used for color when the driver has no S3TC
+    bool useBC7ForColor = false; // Higher quality than BC1/BC3 but twice the size of BC1
+};
+
+/// <summary>
+/// Header of a cooked texture file. The cache is only valid for the same source contents, role and settings.
+/// </summary>
+/// <param name="settings">TextureCompressionSettings packed as bits, they change the format chosen for color.</param>
+struct TextureCacheHeader
+{
+    u32 magic;
+    u32 version;
+    u64 sourceHash;
+    u32 role;
+    u32 settings;
+    u32 format;
+    i32 width;
+    i32 height;
+    u32 mipCount;
+};
+
+/*
+ *  File layout: TextureCacheHeader, mipCount CompressedMip, compressed data of every mip
+ */
+struct TextureCompressionSupport
+{
+    // BC1/BC3 (or BC7) for color, BC5 for normal maps and BC4 for masks
+    static GLenum ChooseFormat(TextureRole role, const Image& image, const TextureCompressionSettings& settings);
+
+    // Builds the filtered mip chain and compresses every level. False when the size is not a multiple of the block size
+    static bool CompressImage(const Image& image, TextureRole role, GLenum format, CompressedImage& compressed);
+
+    static std::string GetCachePath(const char* filename);
+
+    // Returns false when there is no valid cache for this source
+    static bool LoadCachedTexture(const char* filename, u64 sourceHash, TextureRole role, const TextureCompressionSettings& settings, CompressedImage& compressed);
+    static bool WriteCachedTexture(const char* filename, u64 sourceHash, TextureRole role, const TextureCompressionSettings& settings, const CompressedImage& compressed);
+
+    static u32 GetBlockBytes(GLenum format);
+    static const char* GetFormatName(GLenum format);
+};
+
+#endif // TEXTURE_COMPRESSION_H
@@ -0,0 +1,316 @@
+﻿#include "texture_streaming.h"
+
+#include <chrono>
+#include <cstring>
+
+#include "app.h"
+#include "mesh_cache.h"
+#include "stb_image.h"
+
+static f64 StreamingTimeMs()
+{
+    return std::chrono::duration<f64, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// The vertical flip is set once in Init, stb keeps it in a global shared by all the workers
+static Image DecodeImage(const std::string& path)
+{
+    Image image = {};
+    if (path.empty())
+        return image;
+    image.pixels = stbi_load(path.c_str(), &image.size.x, &image.size.y, &image.nchannels, 0);
+    image.stride = image.size.x * image.nchannels;
+    return image;
+}
+
+static void DecodeWorker(TextureStreamer* streamer)
+{
+    for (;;)
+    {
+        TextureLoadJob job;
+        {
+            std::unique_lock<std::mutex> lock(streamer->mutex);
+            streamer->decodeAvailable.wait(lock, [streamer]() { return streamer->stopping || !streamer->decodeQueue.empty(); });
+            if (streamer->stopping)
+                return;
+            job = std::move(streamer->decodeQueue.front());
+            streamer->decodeQueue.pop_front();
+        }
+
+        // Cooked textures are keyed by the hash of the sources, a valid cache skips the decode entirely
+        const bool packed = job.role == TextureRole::PACKED_MASKS;
+        u64 sourceHash = 0;
+        if (job.compress)
+            sourceHash = packed ? MeshCacheSupport::HashFile(job.packedSourcePaths[0].c_str()) ^ (MeshCacheSupport::HashFile(job.packedSourcePaths[1].c_str()) * 1099511628211ull)
+                : MeshCacheSupport::HashFile(job.path.c_str());
+        const bool fromCache = sourceHash != 0 && TextureCompressionSupport::LoadCachedTexture(job.path.c_str(), sourceHash, job.role, job.compressionSettings, job.compressed);
+
+        if (!fromCache)
+        {
+            Image& image = job.image;
+            if (packed)
+            {
+                const Image bump = DecodeImage(job.packedSourcePaths[0]);
+                const Image specular = DecodeImage(job.packedSourcePaths[1]);
+                image = TextureSupport::PackMaskImages(bump, specular);
+                if (bump.pixels)
+                    TextureSupport::FreeImage(bump);
+                if (specular.pixels)
+                    TextureSupport::FreeImage(specular);
+            }
+            else
+            {
+                image = DecodeImage(job.path);
+            }
+
+            const GLenum format = TextureCompressionSupport::ChooseFormat(job.role, image, job.compressionSettings);
+            if (sourceHash != 0 && TextureCompressionSupport::CompressImage(image, job.role, format, job.compressed))
+            {
+                TextureCompressionSupport::WriteCachedTexture(job.path.c_str(), sourceHash, job.role, job.compressionSettings, job.compressed);
+                TextureSupport::FreeImage(image);
+                image.pixels = nullptr;
+            }
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(streamer->mutex);
+            streamer->textureCacheHits += fromCache ? 1 : 0;
+            streamer->uploadQueue.push_back(std::move(job));
+        }
+        streamer->uploadAvailable.notify_all();
+    }
+}
+
+static u64 UploadBytes(const TextureLoadJob& job)
+{
+    return job.compressed.format != 0 ? job.compressed.data.size() : static_cast<u64>(job.image.stride) * job.image.size.y;
+}
+
+// Copies the image into the next buffer of the ring and creates the texture from it. False when the buffer
+// is still being read by the GPU, the caller tries again next frame
+static bool UploadTexture(App* app, TextureLoadJob& job)
+{
+    TextureStreamer& streamer = app->textureStreamer;
+    PixelUploadBuffer& pixelBuffer = streamer.pixelBuffers[streamer.nextPixelBuffer];
+    if (pixelBuffer.fence != nullptr)
+    {
+        if (glClientWaitSync(pixelBuffer.fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+            return false;
+        glDeleteSync(pixelBuffer.fence);
+        pixelBuffer.fence = nullptr;
+    }
+
+    Texture& tex = app->textures[job.textureIdx];
+    tex.streaming = false;
+    const bool compressed = job.compressed.format != 0;
+    if (!compressed && job.image.pixels == nullptr)
+    {
+        ELOG("Could not open file %s", job.path.c_str())
+        return true;
+    }
+
+    const Image& image = job.image;
+    const u64 imageBytes = UploadBytes(job);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pixelBuffer.handle);
+    if (pixelBuffer.size < imageBytes)
+    {
+        pixelBuffer.size = imageBytes;
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, static_cast<GLsizeiptr>(imageBytes), nullptr, GL_STREAM_DRAW);
+    }
+    // The fence guarantees the GPU is done with the previous contents, no need to let the driver synchronize
+    void* staging = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, static_cast<GLsizeiptr>(imageBytes), GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+    memcpy(staging, compressed ? job.compressed.data.data() : image.pixels, imageBytes);
+    glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+    // Slots start with the default texture, a reload after an eviction replaces a texture of its own
+    MaterialBatchingSupport::RetireTexture(app, job.textureIdx);
+    if (tex.handle != app->textures[app->defaultTextureIdx].handle)
+        glDeleteTextures(1, &tex.handle);
+    tex.evictedLevels = 0;
+
+    // The pixels are read from offset 0 of the bound unpack buffer
+    if (compressed)
+    {
+        tex.handle = TextureSupport::CreateTexture2DFromCompressedImage(job.compressed, nullptr);
+        tex.size = job.compressed.size;
+        tex.compressedFormat = job.compressed.format;
+        ++streamer.compressedTextures;
+    }
+    else
+    {
+        Image stagedImage = image;
+        stagedImage.pixels = nullptr;
+        tex.handle = TextureSupport::CreateTexture2DFromImage(stagedImage);
+        tex.size = image.size;
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    pixelBuffer.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    streamer.nextPixelBuffer = (streamer.nextPixelBuffer + 1) % TEXTURE_STREAMING_PIXEL_BUFFERS;
+    streamer.uploadedBytesLastFrame += imageBytes;
+    return true;
+}
+
+// Uploads from the queue until the budget runs out, at least one texture per call so the queue always drains
+static void ProcessUploadQueue(App* app, const u64 budgetBytes)
+{
+    TextureStreamer& streamer = app->textureStreamer;
+    bool firstUpload = true;
+    for (;;)
+    {
+        TextureLoadJob job;
+        {
+            std::lock_guard<std::mutex> lock(streamer.mutex);
+            if (streamer.uploadQueue.empty())
+                break;
+            const u64 imageBytes = UploadBytes(streamer.uploadQueue.front());
+            if (!firstUpload && streamer.uploadedBytesLastFrame + imageBytes > budgetBytes)
+                break;
+            job = std::move(streamer.uploadQueue.front());
+            streamer.uploadQueue.pop_front();
+        }
+
+        if (!UploadTexture(app, job))
+        {
+            std::lock_guard<std::mutex> lock(streamer.mutex);
+            streamer.uploadQueue.push_front(std::move(job));
+            break;
+        }
+        if (job.image.pixels != nullptr)
+            TextureSupport::FreeImage(job.image);
+        firstUpload = false;
+
+        --streamer.pendingTextures;
+        ++streamer.streamedTextures;
+        if (streamer.pendingTextures == 0)
+            ILOG("Texture streaming: %u textures decoded and uploaded in %.2f ms", streamer.streamedTextures, StreamingTimeMs() - streamer.streamingStartTime)
+    }
+}
+
+bool TextureStreamingSupport::IsEnabled(const App* app)
+{
+    return !app->textureStreamer.workers.empty();
+}
+
+void TextureStreamingSupport::Init(App* app)
+{
+    TextureStreamer& streamer = app->textureStreamer;
+    stbi_set_flip_vertically_on_load(true);
+
+    for (PixelUploadBuffer& pixelBuffer : streamer.pixelBuffers)
+        glGenBuffers(1, &pixelBuffer.handle);
+
+    // BPTC and RGTC are core, S3TC is an extension
+    GLint extensionCount = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &extensionCount);
+    streamer.compressionSettings.s3tcSupported = false;
+    for (GLint e = 0; e < extensionCount; ++e)
+        if (strcmp(reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, e)), "GL_EXT_texture_compression_s3tc") == 0)
+            streamer.compressionSettings.s3tcSupported = true;
+
+    // One thread is left for the main thread, which keeps loading models while the workers decode
+    const u32 workerCount = std::max(std::thread::hardware_concurrency(), 2u) - 1;
+    for (u32 w = 0; w < workerCount; ++w)
+        streamer.workers.emplace_back(DecodeWorker, &streamer);
+}
+
+void TextureStreamingSupport::Shutdown(App* app)
+{
+    TextureStreamer& streamer = app->textureStreamer;
+    {
+        std::lock_guard<std::mutex> lock(streamer.mutex);
+        streamer.stopping = true;
+    }
+    streamer.decodeAvailable.notify_all();
+    for (std::thread& worker : streamer.workers)
+        worker.join();
+    streamer.workers.clear();
+
+    for (TextureLoadJob& job : streamer.uploadQueue)
+        if (job.image.pixels != nullptr)
+            TextureSupport::FreeImage(job.image);
+    streamer.uploadQueue.clear();
+    streamer.decodeQueue.clear();
+
+    for (PixelUploadBuffer& pixelBuffer : streamer.pixelBuffers)
+    {
+        if (pixelBuffer.fence != nullptr)
+            glDeleteSync(pixelBuffer.fence);
+        glDeleteBuffers(1, &pixelBuffer.handle);
+        pixelBuffer = PixelUploadBuffer{};
+    }
+}
+
+static void EnqueueJob(App* app, TextureLoadJob& job)
+{
+    TextureStreamer& streamer = app->textureStreamer;
+    if (streamer.pendingTextures == 0)
+    {
+        streamer.streamingStartTime = StreamingTimeMs();
+        streamer.streamedTextures = 0;
+    }
+    ++streamer.pendingTextures;
+
+    job.compress = streamer.compressTextures;
+    job.compressionSettings = streamer.compressionSettings;
+    {
+        std::lock_guard<std::mutex> lock(streamer.mutex);
+        streamer.decodeQueue.push_back(std::move(job));
+    }
+    streamer.decodeAvailable.notify_one();
+}
+
+void TextureStreamingSupport::RequestTexture(App* app, const u32 textureIdx, const TextureRole role)
+{
+    TextureLoadJob job = {};
+    job.textureIdx = textureIdx;
+    job.path = app->textures[textureIdx].path;
+    job.role = role;
+    EnqueueJob(app, job);
+}
+
+void TextureStreamingSupport::RequestPackedMaskTexture(App* app, const u32 textureIdx, const std::string& bumpPath, const std::string& specularPath)
+{
+    TextureLoadJob job = {};
+    job.textureIdx = textureIdx;
+    job.path = app->textures[textureIdx].path;
+    job.role = TextureRole::PACKED_MASKS;
+    job.packedSourcePaths[0] = bumpPath;
+    job.packedSourcePaths[1] = specularPath;
+    EnqueueJob(app, job);
+}
+
+void TextureStreamingSupport::Update(App* app)
+{
+    app->textureStreamer.uploadedBytesLastFrame = 0;
+    ProcessUploadQueue(app, app->textureStreamer.uploadBudgetBytes);
+}
+
+void TextureStreamingSupport::WaitForTexture(App* app, const u32 textureIdx)
+{
+    TextureStreamer& streamer = app->textureStreamer;
+    {
+        std::lock_guard<std::mutex> lock(streamer.mutex);
+        for (auto it = streamer.decodeQueue.begin(); it != streamer.decodeQueue.end(); ++it)
+        {
+            if (it->textureIdx == textureIdx)
+            {
+                TextureLoadJob job = std::move(*it);
+                streamer.decodeQueue.erase(it);
+                streamer.decodeQueue.push_front(std::move(job));
+                break;
+            }
+        }
+    }
+
+    while (app->textures[textureIdx].streaming)
+    {
+        {
+            std::unique_lock<std::mutex> lock(streamer.mutex);
+            streamer.uploadAvailable.wait(lock, [&streamer]() { return !streamer.uploadQueue.empty(); });
+        }
+        ProcessUploadQueue(app, UINT64_MAX);
+        if (app->textures[textureIdx].streaming)
+            glFinish(); // Every buffer of the ring may be in use, let the GPU catch up
+    }
+}
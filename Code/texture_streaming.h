@@ -0,0 +1,91 @@
+﻿#ifndef TEXTURE_STREAMING_H
+#define TEXTURE_STREAMING_H
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "platform.h"
+#include "texture.h"
+#include "texture_compression.h"
+
+struct App;
+
+#define TEXTURE_STREAMING_PIXEL_BUFFERS 4
+#define TEXTURE_STREAMING_DEFAULT_BUDGET_MB 16
+
+struct TextureLoadJob
+{
+    u32 textureIdx;
+    std::string path;
+    std::string packedSourcePaths[2]; // Bump and specular images of PACKED_MASKS textures, empty when missing
+    TextureRole role;
+    bool compress; // Settings copied at request time, the GUI may change them while the workers run
+    TextureCompressionSettings compressionSettings;
+    Image image; // Only when the texture could not be block compressed
+    CompressedImage compressed;
+};
+
+// Staging buffer of the upload ring, the fence tells when the GPU finished reading it
+struct PixelUploadBuffer
+{
+    GLuint handle = 0;
+    u64 size = 0;
+    GLsync fence = nullptr;
+};
+
+/// <summary>
+/// Background texture loading. Worker threads decode the images, the main thread copies them into a ring of
+/// pixel buffer objects and creates immutable textures from them, at most uploadBudgetBytes per frame.
+/// A requested texture keeps the handle of the default texture until its upload is done, so materials can
+/// reference it from the start. With compressTextures the workers cook the image into a BC format (or read it
+/// from the texture cache) and the compressed mip chain is uploaded instead.
+/// </summary>
+struct TextureStreamer
+{
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable decodeAvailable;
+    std::condition_variable uploadAvailable;
+    std::deque<TextureLoadJob> decodeQueue;
+    std::deque<TextureLoadJob> uploadQueue;
+    bool stopping = false;
+
+    bool compressTextures = true;
+    TextureCompressionSettings compressionSettings;
+
+    PixelUploadBuffer pixelBuffers[TEXTURE_STREAMING_PIXEL_BUFFERS];
+    u32 nextPixelBuffer = 0;
+    u64 uploadBudgetBytes = TEXTURE_STREAMING_DEFAULT_BUDGET_MB * 1024 * 1024;
+
+    // Stats
+    u32 pendingTextures = 0;
+    u32 streamedTextures = 0;
+    u32 compressedTextures = 0;
+    u32 textureCacheHits = 0;
+    u64 uploadedBytesLastFrame = 0;
+    f64 streamingStartTime = 0.0;
+};
+
+struct TextureStreamingSupport
+{
+    static void Init(App* app);
+    static void Shutdown(App* app);
+
+    // Queues the decode of the texture slot, its path must be set
+    static void RequestTexture(App* app, u32 textureIdx, TextureRole role);
+    static void RequestPackedMaskTexture(App* app, u32 textureIdx, const std::string& bumpPath, const std::string& specularPath);
+
+    // Uploads the decoded textures that fit in the frame budget, called once per frame
+    static void Update(App* app);
+
+    // Blocks until the texture is uploaded, moving it to the front of the queue (e.g. before baking with it)
+    static void WaitForTexture(App* app, u32 textureIdx);
+
+    // False until Init, textures are loaded synchronously before (e.g. the default texture)
+    static bool IsEnabled(const App* app);
+};
+
+#endif // TEXTURE_STREAMING_H
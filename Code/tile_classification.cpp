@@ -0,0 +1,155 @@
+﻿#include "tile_classification.h"
+
+#include "app.h"
+
+#define TILE_CLASS_COUNT static_cast<u32>(ShadingTileClass::COUNT)
+
+static void ResizeTileBuffer(TileClassification& classification, const glm::uvec2& tileCount)
+{
+    const u32 tiles = tileCount.x * tileCount.y;
+    classification.tileCount = tileCount;
+    const u64 bufferBytes = sizeof(TileClassHeader) + TILE_CLASS_COUNT * sizeof(TileDrawCommand) + static_cast<u64>(tiles) * TILE_CLASS_COUNT * sizeof(u32);
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, classification.tileBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, static_cast<GLsizeiptr>(bufferBytes), nullptr, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+// Tile counts of an earlier frame, skipped while the GPU has not reached the copy
+static void ReadStats(TileClassification& classification)
+{
+    if (classification.statsFence == nullptr)
+        return;
+
+    const GLenum waitResult = glClientWaitSync(classification.statsFence, 0, 0);
+    if (waitResult == GL_TIMEOUT_EXPIRED)
+        return;
+
+    glDeleteSync(classification.statsFence);
+    classification.statsFence = nullptr;
+    if (waitResult == GL_WAIT_FAILED)
+        return;
+
+    TileDrawCommand commands[TILE_CLASS_COUNT];
+    glBindBuffer(GL_COPY_READ_BUFFER, classification.statsBuffer);
+    glGetBufferSubData(GL_COPY_READ_BUFFER, 0, sizeof(commands), commands);
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    for (u32 c = 0; c < TILE_CLASS_COUNT; ++c)
+        classification.classTiles[c] = commands[c].instanceCount;
+}
+
+void TileClassificationSupport::Init(App* app)
+{
+    TileClassification& classification = app->tileClassification;
+    classification.classificationProgramIdx = ShaderSupport::LoadComputeProgram(app, "Shaders\\shader_shading_tile_classification.comp", "SHADING_TILE_CLASSIFICATION");
+
+    // One variant of the shading pass per drawn class, see the TILE_ defines in shader_deferred_shading_pass.frag
+    char maxLightsDefine[64];
+    sprintf(maxLightsDefine, "#define TILE_MAX_LIGHTS %u\n", TILE_CLASS_MAX_SIMPLE_LIGHTS);
+    const std::string classifiedDefine = "#define TILE_CLASSIFIED\n";
+    classification.shadingProgramIdx[static_cast<u32>(ShadingTileClass::SIMPLE)] = ShaderSupport::LoadProgram(app, "Shaders\\shader_deferred_shading_tiles.vert",
+        "Shaders\\shader_deferred_shading_pass.frag", "DEFERRED_SHADING_TILES_SIMPLE", classifiedDefine + maxLightsDefine);
+    classification.shadingProgramIdx[static_cast<u32>(ShadingTileClass::MANY_LIGHTS)] = ShaderSupport::LoadProgram(app, "Shaders\\shader_deferred_shading_tiles.vert",
+        "Shaders\\shader_deferred_shading_pass.frag", "DEFERRED_SHADING_TILES_MANY_LIGHTS", classifiedDefine);
+
+    glGenBuffers(1, &classification.tileBuffer);
+    glGenVertexArrays(1, &classification.emptyVAO);
+
+    glGenBuffers(1, &classification.statsBuffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, classification.statsBuffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, TILE_CLASS_COUNT * sizeof(TileDrawCommand), nullptr, GL_STREAM_READ);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+void TileClassificationSupport::Shutdown(App* app)
+{
+    TileClassification& classification = app->tileClassification;
+    if (classification.statsFence != nullptr)
+        glDeleteSync(classification.statsFence);
+    classification.statsFence = nullptr;
+    glDeleteBuffers(1, &classification.tileBuffer);
+    glDeleteBuffers(1, &classification.statsBuffer);
+    glDeleteVertexArrays(1, &classification.emptyVAO);
+}
+
+void TileClassificationSupport::Classify(App* app)
+{
+    TileClassification& classification = app->tileClassification;
+    const glm::uvec2 screenSize = glm::uvec2(app->displaySizeCurrent);
+    const glm::uvec2 tileCount = (screenSize + glm::uvec2(TILE_CLASS_SIZE - 1)) / glm::uvec2(TILE_CLASS_SIZE);
+    if (tileCount != classification.tileCount)
+        ResizeTileBuffer(classification, tileCount);
+
+    ReadStats(classification);
+
+    glPushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, 1, -1, "Shading Tile Classification");
+
+    // Header and empty draw commands, the compute pass counts the instances
+    TileClassHeader header;
+    header.tiles = glm::uvec4(tileCount.x, tileCount.y, tileCount.x * tileCount.y, TILE_CLASS_MAX_SIMPLE_LIGHTS);
+    header.screenSize = glm::uvec4(screenSize, 0, 0);
+    TileDrawCommand commands[TILE_CLASS_COUNT];
+    for (TileDrawCommand& command : commands)
+        command = TileDrawCommand{ 6, 0, 0, 0 };
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, classification.tileBuffer);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(header), &header);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, sizeof(header), sizeof(commands), commands);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, STD_430_BINDING_POINT::BP_TILE_CLASSES, classification.tileBuffer);
+    BufferManagement::BindBufferRange(app->uniformBuffer, STD_140_BINDING_POINT::BP_GLOBAL_PARAMS, app->globalParamsSize, app->globalParamsOffset);
+
+    // Depth, read with texelFetch. The cluster buffers are still bound by the light culling
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, app->textures[app->gDepthTextureIdx].handle);
+
+    const Program& program = app->programs[classification.classificationProgramIdx];
+    glUseProgram(program.handle);
+    glUniform1i(glGetUniformLocation(program.handle, "uClusteredLighting"), app->lightingMode == LightingMode::CLUSTERED ? 1 : 0);
+    glUniform1i(glGetUniformLocation(program.handle, "uDirectionalOnly"), app->lightingMode == LightingMode::LIGHT_VOLUMES ? 1 : 0);
+    glDispatchCompute(tileCount.x, tileCount.y, 1);
+
+    // The tile lists are read by the vertex shader and the commands by the indirect draws
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT);
+    glPopDebugGroup();
+}
+
+void TileClassificationSupport::Shade(App* app)
+{
+    TileClassification& classification = app->tileClassification;
+    const bool compactGBuffer = app->gBufferLayout == GBufferLayout::COMPACT;
+    const u32 tiles = classification.tileCount.x * classification.tileCount.y;
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, STD_430_BINDING_POINT::BP_TILE_CLASSES, classification.tileBuffer);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, classification.tileBuffer);
+    glBindVertexArray(classification.emptyVAO);
+    glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+
+    // The sky tiles keep the clear color
+    for (u32 c = static_cast<u32>(ShadingTileClass::SIMPLE); c < TILE_CLASS_COUNT; ++c)
+    {
+        glPushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, 1, -1, ShadingTileClassStr[c]);
+        const Program& program = app->programs[classification.shadingProgramIdx[c]];
+        glUseProgram(program.handle);
+        glUniform1i(glGetUniformLocation(program.handle, "uCompactGBuffer"), compactGBuffer ? 1 : 0);
+        glUniform1i(glGetUniformLocation(program.handle, "uClusteredLighting"), app->lightingMode == LightingMode::CLUSTERED ? 1 : 0);
+        glUniform1i(glGetUniformLocation(program.handle, "uDirectionalOnly"), app->lightingMode == LightingMode::LIGHT_VOLUMES ? 1 : 0);
+        glUniform1ui(glGetUniformLocation(program.handle, "uTileListOffset"), c * tiles);
+        glDrawArraysIndirect(GL_TRIANGLES, reinterpret_cast<const void*>(sizeof(TileClassHeader) + c * sizeof(TileDrawCommand)));
+        glPopDebugGroup();
+    }
+
+    glBindVertexArray(0);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+    // Tile counts for the GUI, read back by a later Classify
+    if (classification.statsFence == nullptr)
+    {
+        glBindBuffer(GL_COPY_READ_BUFFER, classification.tileBuffer);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, classification.statsBuffer);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, sizeof(TileClassHeader), 0, TILE_CLASS_COUNT * sizeof(TileDrawCommand));
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        classification.statsFence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+}
@@ -0,0 +1,72 @@
+﻿#ifndef TILE_CLASSIFICATION_H
+#define TILE_CLASSIFICATION_H
+
+#include "platform.h"
+
+struct App;
+
+#define TILE_CLASS_SIZE 16 // Pixels per tile side, local_size_x/y of shader_shading_tile_classification.comp
+#define TILE_CLASS_MAX_SIMPLE_LIGHTS 8 // Tiles whose fullest cluster holds more lights go to ShadingTileClass::MANY_LIGHTS
+
+static const char* ShadingTileClassStr[] = { "SKY", "SIMPLE", "MANY LIGHTS" };
+
+enum class ShadingTileClass : u32
+{
+    SKY, // No geometry, keeps the clear color and is never drawn
+    SIMPLE, // Up to TILE_CLASS_MAX_SIMPLE_LIGHTS lights per pixel, the light loop has a constant trip count
+    MANY_LIGHTS, // The unspecialized shading pass
+    COUNT
+};
+
+// glDrawArraysIndirect arguments, one per class. count is the 6 vertices of a tile quad, instanceCount the tiles of the class
+struct TileDrawCommand
+{
+    u32 count;
+    u32 instanceCount;
+    u32 first;
+    u32 baseInstance;
+};
+
+// Header of the tile class buffer, followed by the draw command of every class and a list of tileCount indices per class (std430)
+struct TileClassHeader
+{
+    glm::uvec4 tiles; // Tiles on x and y, z: tile count, w: TILE_CLASS_MAX_SIMPLE_LIGHTS
+    glm::uvec4 screenSize;
+};
+
+/// <summary>
+/// Tile classification of the deferred shading pass. A compute pass reads the depth and cluster light counts of every
+/// TILE_CLASS_SIZE tile and appends the tile to the list of its ShadingTileClass, the shading pass then draws the tiles of
+/// each class instanced from indirect commands with a variant of the shading program compiled for it. Sky tiles are not drawn
+/// and the simple tiles unroll a short light loop, so each pixel only pays for the lights around it.
+/// </summary>
+struct TileClassification
+{
+    bool enabled = false;
+
+    u32 classificationProgramIdx = 0;
+    u32 shadingProgramIdx[static_cast<u32>(ShadingTileClass::COUNT)] = {}; // SKY has no program
+
+    GLuint tileBuffer = 0;
+    GLuint emptyVAO = 0; // The tile quads are built from gl_VertexID and gl_InstanceID
+    glm::uvec2 tileCount = glm::uvec2(0);
+
+    // Draw commands copied after the shading pass and read once their fence is signaled, the CPU never waits on them
+    GLuint statsBuffer = 0;
+    GLsync statsFence = nullptr;
+    u32 classTiles[static_cast<u32>(ShadingTileClass::COUNT)] = {};
+};
+
+struct TileClassificationSupport
+{
+    static void Init(App* app);
+    static void Shutdown(App* app);
+
+    // Fills the tile lists and draw commands from the G-buffer of this frame, after the light culling
+    static void Classify(App* app);
+
+    // Draws the tiles of every class into the bound frame buffer, the G-buffer textures must be bound already
+    static void Shade(App* app);
+};
+
+#endif // TILE_CLASSIFICATION_H
@@ -36,11 +36,15 @@ struct VertexV3V2
 /// <param name="location">Layout qualifier in GLSL.</param>
 /// <param name="componentCount">Num of components.</param>
 /// <param name="offset">Offset inside the array stride.</param>
+/// <param name="arrayOffset/arrayStride">Optional separate (non interleaved) array of this attribute, offset from the subMesh vertex offset.
+/// A stride of 0 means the attribute is interleaved with the layout stride.</param>
 struct VertexBufferAttribute
 {
     u8 location;
     u8 componentCount;
     u8 offset;
+    u8 arrayStride = 0;
+    u32 arrayOffset = 0;
 };
 
 /// <summary>
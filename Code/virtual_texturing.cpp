@@ -0,0 +1,618 @@
+﻿#include "virtual_texturing.h"
+
+#include <algorithm>
+
+#include "app.h"
+
+static const u32 AtlasSize = VT_ATLAS_PAGES_PER_SIDE * VT_PHYSICAL_PAGE_SIZE;
+static const u32 PageBlocks = VT_PHYSICAL_PAGE_SIZE / 4;
+
+// Copies the blocks of a page and its border out of the mapped texture cache, the border wraps like GL_REPEAT
+static void ExtractPage(PageLoadJob& job)
+{
+    job.data.resize(static_cast<size_t>(PageBlocks) * PageBlocks * job.blockBytes);
+    const i32 firstBlockX = static_cast<i32>(job.x * (VT_PAGE_SIZE / 4)) - VT_PAGE_BORDER / 4;
+    const i32 firstBlockY = static_cast<i32>(job.y * (VT_PAGE_SIZE / 4)) - VT_PAGE_BORDER / 4;
+    const i32 blocksX = static_cast<i32>(job.blocksX);
+    const i32 blocksY = static_cast<i32>(job.blocksY);
+
+    for (u32 by = 0; by < PageBlocks; ++by)
+    {
+        const i32 sourceY = ((firstBlockY + static_cast<i32>(by)) % blocksY + blocksY) % blocksY;
+        for (u32 bx = 0; bx < PageBlocks; ++bx)
+        {
+            const i32 sourceX = ((firstBlockX + static_cast<i32>(bx)) % blocksX + blocksX) % blocksX;
+            memcpy(job.data.data() + (static_cast<size_t>(by) * PageBlocks + bx) * job.blockBytes,
+                job.mipData + (static_cast<size_t>(sourceY) * blocksX + sourceX) * job.blockBytes, job.blockBytes);
+        }
+    }
+}
+
+static void PageLoader(VirtualTexturing* virtualTexturing)
+{
+    for (;;)
+    {
+        PageLoadJob job;
+        {
+            std::unique_lock<std::mutex> lock(virtualTexturing->mutex);
+            virtualTexturing->loadAvailable.wait(lock, [virtualTexturing]() { return virtualTexturing->stopping || !virtualTexturing->loadQueue.empty(); });
+            if (virtualTexturing->stopping)
+                return;
+            job = std::move(virtualTexturing->loadQueue.front());
+            virtualTexturing->loadQueue.pop_front();
+        }
+
+        // Page faults of the mapped cache happen here and not on the main thread
+        ExtractPage(job);
+
+        std::lock_guard<std::mutex> lock(virtualTexturing->mutex);
+        virtualTexturing->uploadQueue.push_back(std::move(job));
+    }
+}
+
+static PageLoadJob MakePageLoadJob(const VirtualTexture& virtualTexture, const u32 virtualTextureIdx, const u32 level, const u32 x, const u32 y)
+{
+    PageLoadJob job;
+    job.virtualTextureIdx = virtualTextureIdx;
+    job.level = level;
+    job.x = x;
+    job.y = y;
+    job.mipData = virtualTexture.mipData[level];
+    job.blocksX = static_cast<u32>(virtualTexture.mips[level].width + 3) / 4;
+    job.blocksY = static_cast<u32>(virtualTexture.mips[level].height + 3) / 4;
+    job.blockBytes = TextureCompressionSupport::GetBlockBytes(virtualTexture.format);
+    return job;
+}
+
+// Free slot first, then the least recently used page that was not seen this frame
+static i32 AllocatePhysicalPage(VirtualTexturing& virtualTexturing, PhysicalPageAtlas& atlas)
+{
+    i32 candidate = -1;
+    for (u32 p = 0; p < atlas.pages.size(); ++p)
+    {
+        const PhysicalPage& page = atlas.pages[p];
+        if (page.virtualTextureIdx < 0)
+            return static_cast<i32>(p);
+        if (!page.pinned && page.lastUsedFrame < virtualTexturing.frame && (candidate < 0 || page.lastUsedFrame < atlas.pages[candidate].lastUsedFrame))
+            candidate = static_cast<i32>(p);
+    }
+
+    if (candidate >= 0)
+    {
+        PhysicalPage& evicted = atlas.pages[candidate];
+        VirtualTexture& owner = virtualTexturing.virtualTextures[evicted.virtualTextureIdx];
+        const u32 levelPagesX = static_cast<u32>(owner.pageCount.x) >> evicted.level;
+        owner.pageSlots[evicted.level][evicted.y * levelPagesX + evicted.x] = VT_PAGE_NOT_RESIDENT;
+        owner.indirectionDirty = true;
+        evicted = PhysicalPage{};
+        --virtualTexturing.residentPages;
+        ++virtualTexturing.pagesEvicted;
+    }
+    return candidate;
+}
+
+static bool UploadPage(VirtualTexturing& virtualTexturing, const PageLoadJob& job, const bool pinned)
+{
+    VirtualTexture& virtualTexture = virtualTexturing.virtualTextures[job.virtualTextureIdx];
+    PhysicalPageAtlas& atlas = virtualTexturing.atlases[virtualTexture.atlasIdx];
+    const u32 levelPagesX = static_cast<u32>(virtualTexture.pageCount.x) >> job.level;
+    i32& pageSlot = virtualTexture.pageSlots[job.level][job.y * levelPagesX + job.x];
+
+    const i32 slot = AllocatePhysicalPage(virtualTexturing, atlas);
+    if (slot < 0)
+    {
+        // Every slot is in use this frame, the page will be requested again by a later feedback
+        pageSlot = VT_PAGE_NOT_RESIDENT;
+        return false;
+    }
+
+    const GLint slotX = slot % VT_ATLAS_PAGES_PER_SIDE;
+    const GLint slotY = slot / VT_ATLAS_PAGES_PER_SIDE;
+    glBindTexture(GL_TEXTURE_2D, atlas.handle);
+    glCompressedTexSubImage2D(GL_TEXTURE_2D, 0, slotX * VT_PHYSICAL_PAGE_SIZE, slotY * VT_PHYSICAL_PAGE_SIZE, VT_PHYSICAL_PAGE_SIZE, VT_PHYSICAL_PAGE_SIZE,
+        atlas.format, static_cast<GLsizei>(job.data.size()), job.data.data());
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    PhysicalPage& page = atlas.pages[slot];
+    page.virtualTextureIdx = static_cast<i32>(job.virtualTextureIdx);
+    page.level = job.level;
+    page.x = job.x;
+    page.y = job.y;
+    page.lastUsedFrame = virtualTexturing.frame;
+    page.pinned = pinned;
+    pageSlot = slot;
+    virtualTexture.indirectionDirty = true;
+    ++virtualTexturing.residentPages;
+    return true;
+}
+
+static void UpdateIndirection(VirtualTexture& virtualTexture)
+{
+    std::vector<u8> parentEntries;
+    std::vector<u8> entries;
+    glBindTexture(GL_TEXTURE_2D, virtualTexture.indirectionHandle);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+    // From the coarsest level, so missing pages can take the entry of their parent
+    for (i32 level = static_cast<i32>(virtualTexture.levelCount) - 1; level >= 0; --level)
+    {
+        const u32 pagesX = static_cast<u32>(virtualTexture.pageCount.x) >> level;
+        const u32 pagesY = static_cast<u32>(virtualTexture.pageCount.y) >> level;
+        const u32 parentPagesX = pagesX / 2;
+        entries.assign(static_cast<size_t>(pagesX) * pagesY * 4, 255);
+
+        for (u32 y = 0; y < pagesY; ++y)
+        {
+            for (u32 x = 0; x < pagesX; ++x)
+            {
+                u8* entry = &entries[(y * pagesX + x) * 4];
+                const i32 slot = virtualTexture.pageSlots[level][y * pagesX + x];
+                if (slot >= 0)
+                {
+                    entry[0] = static_cast<u8>(slot % VT_ATLAS_PAGES_PER_SIDE);
+                    entry[1] = static_cast<u8>(slot / VT_ATLAS_PAGES_PER_SIDE);
+                    entry[2] = static_cast<u8>(level);
+                    entry[3] = static_cast<u8>(virtualTexture.atlasIdx);
+                }
+                else if (!parentEntries.empty())
+                {
+                    memcpy(entry, &parentEntries[((y / 2) * parentPagesX + x / 2) * 4], 4);
+                }
+            }
+        }
+
+        glTexSubImage2D(GL_TEXTURE_2D, level, 0, 0, static_cast<GLsizei>(pagesX), static_cast<GLsizei>(pagesY), GL_RGBA_INTEGER, GL_UNSIGNED_BYTE, entries.data());
+        std::swap(parentEntries, entries);
+    }
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+    virtualTexture.indirectionDirty = false;
+}
+
+static i32 FindOrCreateAtlas(VirtualTexturing& virtualTexturing, const GLenum format)
+{
+    for (u32 a = 0; a < virtualTexturing.atlases.size(); ++a)
+        if (virtualTexturing.atlases[a].format == format)
+            return static_cast<i32>(a);
+    if (virtualTexturing.atlases.size() == VT_MAX_PHYSICAL_ATLASES)
+        return -1;
+
+    PhysicalPageAtlas atlas;
+    atlas.format = format;
+    atlas.pages.resize(VT_ATLAS_PAGES_PER_SIDE * VT_ATLAS_PAGES_PER_SIDE);
+    glGenTextures(1, &atlas.handle);
+    glBindTexture(GL_TEXTURE_2D, atlas.handle);
+    glTexStorage2D(GL_TEXTURE_2D, 1, format, AtlasSize, AtlasSize);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    virtualTexturing.atlasBytes += static_cast<u64>(AtlasSize / 4) * (AtlasSize / 4) * TextureCompressionSupport::GetBlockBytes(format);
+    virtualTexturing.atlases.push_back(atlas);
+    return static_cast<i32>(virtualTexturing.atlases.size() - 1);
+}
+
+// Only block compressed textures with a texture cache can be virtual, the pages are cut from the cached blocks
+static void RegisterTexture(App* app, const u32 textureIdx)
+{
+    VirtualTexturing& virtualTexturing = app->virtualTexturing;
+    const Texture& texture = app->textures[textureIdx];
+    if (texture.compressedFormat == 0 || texture.size.x < VT_PAGE_SIZE || texture.size.y < VT_PAGE_SIZE)
+        return;
+
+    VirtualTexture virtualTexture;
+    virtualTexture.textureIdx = textureIdx;
+    virtualTexture.format = texture.compressedFormat;
+    virtualTexture.size = texture.size;
+    virtualTexture.pageCount = texture.size / VT_PAGE_SIZE;
+
+    const std::string cachePath = TextureCompressionSupport::GetCachePath(texture.path.c_str());
+    if (!MapFile(cachePath.c_str(), virtualTexture.cacheFile))
+        return;
+
+    const MappedFile& file = virtualTexture.cacheFile;
+    TextureCacheHeader header = {};
+    bool valid = file.size >= sizeof(TextureCacheHeader);
+    if (valid)
+    {
+        memcpy(&header, file.data, sizeof(TextureCacheHeader));
+        valid = header.magic == TEXTURE_CACHE_MAGIC && header.version == TEXTURE_CACHE_VERSION && header.format == texture.compressedFormat &&
+            header.width == texture.size.x && header.height == texture.size.y;
+    }
+    const u64 dataOffset = sizeof(TextureCacheHeader) + static_cast<u64>(header.mipCount) * sizeof(CompressedMip);
+    valid = valid && dataOffset <= file.size;
+    if (valid)
+    {
+        virtualTexture.mips.resize(header.mipCount);
+        memcpy(virtualTexture.mips.data(), file.data + sizeof(TextureCacheHeader), header.mipCount * sizeof(CompressedMip));
+    }
+
+    // Virtual levels are the ones made of whole pages, the coarsest of them stays resident
+    virtualTexture.levelCount = 0;
+    while (valid && virtualTexture.levelCount < virtualTexture.mips.size() && virtualTexture.levelCount < std::size(virtualTexture.mipData))
+    {
+        const CompressedMip& mip = virtualTexture.mips[virtualTexture.levelCount];
+        const ivec2 expectedSize = glm::max(texture.size >> static_cast<i32>(virtualTexture.levelCount), ivec2(1));
+        if (mip.width != expectedSize.x || mip.height != expectedSize.y || mip.width % VT_PAGE_SIZE != 0 || mip.height % VT_PAGE_SIZE != 0 ||
+            dataOffset + mip.offset + mip.size > file.size)
+            break;
+        virtualTexture.mipData[virtualTexture.levelCount] = file.data + dataOffset + mip.offset;
+        ++virtualTexture.levelCount;
+    }
+
+    const i32 atlasIdx = virtualTexture.levelCount > 0 ? FindOrCreateAtlas(virtualTexturing, texture.compressedFormat) : -1;
+    if (atlasIdx < 0)
+    {
+        UnmapFile(virtualTexture.cacheFile);
+        return;
+    }
+    virtualTexture.atlasIdx = static_cast<u32>(atlasIdx);
+
+    virtualTexture.pageSlots.resize(virtualTexture.levelCount);
+    for (u32 level = 0; level < virtualTexture.levelCount; ++level)
+        virtualTexture.pageSlots[level].assign(static_cast<size_t>(virtualTexture.pageCount.x >> level) * (virtualTexture.pageCount.y >> level), VT_PAGE_NOT_RESIDENT);
+
+    glGenTextures(1, &virtualTexture.indirectionHandle);
+    glBindTexture(GL_TEXTURE_2D, virtualTexture.indirectionHandle);
+    glTexStorage2D(GL_TEXTURE_2D, static_cast<GLsizei>(virtualTexture.levelCount), GL_RGBA8UI, virtualTexture.pageCount.x, virtualTexture.pageCount.y);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, static_cast<GLint>(virtualTexture.levelCount - 1));
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    const u32 virtualTextureIdx = static_cast<u32>(virtualTexturing.virtualTextures.size());
+    virtualTexturing.virtualTextures.push_back(std::move(virtualTexture));
+    virtualTexturing.textureToVirtual[textureIdx] = static_cast<i32>(virtualTextureIdx);
+
+    // The coarsest level is the fallback of every lookup, it is loaded right away and never evicted
+    const VirtualTexture& registered = virtualTexturing.virtualTextures[virtualTextureIdx];
+    const u32 coarsestLevel = registered.levelCount - 1;
+    for (u32 y = 0; y < static_cast<u32>(registered.pageCount.y >> coarsestLevel); ++y)
+    {
+        for (u32 x = 0; x < static_cast<u32>(registered.pageCount.x >> coarsestLevel); ++x)
+        {
+            PageLoadJob job = MakePageLoadJob(registered, virtualTextureIdx, coarsestLevel, x, y);
+            ExtractPage(job);
+            UploadPage(virtualTexturing, job, true);
+        }
+    }
+}
+
+static ivec2 GetMaterialVirtualSize(const App* app, const Material& material)
+{
+    const VirtualTexturing& virtualTexturing = app->virtualTexturing;
+    ivec2 virtualSize = ivec2(0);
+    for (const u32 textureIdx : { material.albedoTextureIdx, material.normalsTextureIdx, material.masksTextureIdx })
+    {
+        const i32 virtualTextureIdx = textureIdx < virtualTexturing.textureToVirtual.size() ? virtualTexturing.textureToVirtual[textureIdx] : -1;
+        if (textureIdx != 0 && virtualTextureIdx >= 0)
+            virtualSize = glm::max(virtualSize, virtualTexturing.virtualTextures[virtualTextureIdx].size);
+    }
+    return virtualSize;
+}
+
+struct PageRequest
+{
+    u32 virtualTextureIdx;
+    u32 level;
+    u32 x;
+    u32 y;
+};
+
+// Maps a feedback page (in the space of the largest texture of the material) to the texture, touches its resident
+// ancestors and requests the missing ones
+static void ResolveFeedbackPage(VirtualTexturing& virtualTexturing, const u32 virtualTextureIdx, const ivec2 virtualSize, const u32 feedbackLevel,
+    const u32 feedbackX, const u32 feedbackY, std::vector<PageRequest>& requests)
+{
+    VirtualTexture& virtualTexture = virtualTexturing.virtualTextures[virtualTextureIdx];
+
+    // Textures smaller than the material space reach the same texel density that many levels earlier
+    i32 levelShift = 0;
+    while ((virtualTexture.size.x << levelShift) < virtualSize.x)
+        ++levelShift;
+    const u32 level = static_cast<u32>(glm::clamp(static_cast<i32>(feedbackLevel) - levelShift, 0, static_cast<i32>(virtualTexture.levelCount) - 1));
+
+    const u32 feedbackPagesX = std::max(static_cast<u32>(virtualSize.x / VT_PAGE_SIZE) >> feedbackLevel, 1u);
+    const u32 feedbackPagesY = std::max(static_cast<u32>(virtualSize.y / VT_PAGE_SIZE) >> feedbackLevel, 1u);
+    const u32 pagesX = static_cast<u32>(virtualTexture.pageCount.x) >> level;
+    const u32 pagesY = static_cast<u32>(virtualTexture.pageCount.y) >> level;
+    u32 x = std::min(static_cast<u32>((static_cast<u64>(feedbackX) * pagesX) / feedbackPagesX), pagesX - 1);
+    u32 y = std::min(static_cast<u32>((static_cast<u64>(feedbackY) * pagesY) / feedbackPagesY), pagesY - 1);
+
+    for (u32 l = level; l < virtualTexture.levelCount; ++l, x /= 2, y /= 2)
+    {
+        const u32 levelPagesX = static_cast<u32>(virtualTexture.pageCount.x) >> l;
+        i32& pageSlot = virtualTexture.pageSlots[l][y * levelPagesX + x];
+        if (pageSlot >= 0)
+        {
+            virtualTexturing.atlases[virtualTexture.atlasIdx].pages[pageSlot].lastUsedFrame = virtualTexturing.frame;
+        }
+        else if (pageSlot == VT_PAGE_NOT_RESIDENT)
+        {
+            requests.push_back({ virtualTextureIdx, l, x, y });
+            pageSlot = VT_PAGE_REQUESTED;
+        }
+    }
+}
+
+static void ProcessFeedback(App* app, const u32* feedback, const u32 count)
+{
+    VirtualTexturing& virtualTexturing = app->virtualTexturing;
+
+    // Most of the screen asks for the same few pages
+    std::vector<u32> values(feedback, feedback + count);
+    std::sort(values.begin(), values.end());
+    values.erase(std::unique(values.begin(), values.end()), values.end());
+
+    std::vector<PageRequest> requests;
+    for (const u32 value : values)
+    {
+        if (value == VT_NO_FEEDBACK)
+            continue;
+
+        const u32 materialIdx = value >> 20;
+        if (materialIdx >= app->materials.size())
+            continue;
+
+        const Material& material = app->materials[materialIdx];
+        const ivec2 virtualSize = GetMaterialVirtualSize(app, material);
+        for (const u32 textureIdx : { material.albedoTextureIdx, material.normalsTextureIdx, material.masksTextureIdx })
+        {
+            const i32 virtualTextureIdx = textureIdx < virtualTexturing.textureToVirtual.size() ? virtualTexturing.textureToVirtual[textureIdx] : -1;
+            if (textureIdx != 0 && virtualTextureIdx >= 0)
+                ResolveFeedbackPage(virtualTexturing, static_cast<u32>(virtualTextureIdx), virtualSize, (value >> 16) & 0xF, value & 0xFF, (value >> 8) & 0xFF, requests);
+        }
+    }
+
+    // Coarse pages first, they improve the most pixels. The rest is requested again by a later feedback
+    std::stable_sort(requests.begin(), requests.end(), [](const PageRequest& a, const PageRequest& b) { return a.level > b.level; });
+    if (requests.size() > VT_MAX_PAGE_REQUESTS_PER_FRAME)
+    {
+        for (u32 r = VT_MAX_PAGE_REQUESTS_PER_FRAME; r < requests.size(); ++r)
+        {
+            VirtualTexture& virtualTexture = virtualTexturing.virtualTextures[requests[r].virtualTextureIdx];
+            const u32 levelPagesX = static_cast<u32>(virtualTexture.pageCount.x) >> requests[r].level;
+            virtualTexture.pageSlots[requests[r].level][requests[r].y * levelPagesX + requests[r].x] = VT_PAGE_NOT_RESIDENT;
+        }
+        requests.resize(VT_MAX_PAGE_REQUESTS_PER_FRAME);
+    }
+    virtualTexturing.pagesRequestedLastFrame = static_cast<u32>(requests.size());
+
+    if (requests.empty())
+        return;
+    {
+        std::lock_guard<std::mutex> lock(virtualTexturing.mutex);
+        for (const PageRequest& request : requests)
+            virtualTexturing.loadQueue.push_back(MakePageLoadJob(virtualTexturing.virtualTextures[request.virtualTextureIdx], request.virtualTextureIdx, request.level, request.x, request.y));
+    }
+    virtualTexturing.loadAvailable.notify_one();
+}
+
+static void ResizeFeedback(VirtualTexturing& virtualTexturing, const ivec2 displaySize)
+{
+    const ivec2 feedbackSize = (displaySize + (VT_FEEDBACK_SCALE - 1)) / VT_FEEDBACK_SCALE;
+    if (feedbackSize == virtualTexturing.feedbackSize)
+        return;
+    virtualTexturing.feedbackSize = feedbackSize;
+
+    if (virtualTexturing.feedbackTexture != 0)
+        glDeleteTextures(1, &virtualTexturing.feedbackTexture);
+    glGenTextures(1, &virtualTexturing.feedbackTexture);
+    glBindTexture(GL_TEXTURE_2D, virtualTexturing.feedbackTexture);
+    glTexStorage2D(GL_TEXTURE_2D, 1, GL_R32UI, feedbackSize.x, feedbackSize.y);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, virtualTexturing.feedbackFrameBuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, virtualTexturing.feedbackTexture, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    // Readbacks of the old size are dropped
+    for (FeedbackReadback& readback : virtualTexturing.readbacks)
+    {
+        if (readback.fence != nullptr)
+            glDeleteSync(readback.fence);
+        readback.fence = nullptr;
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.pixelBuffer);
+        glBufferData(GL_PIXEL_PACK_BUFFER, static_cast<GLsizeiptr>(feedbackSize.x) * feedbackSize.y * sizeof(u32), nullptr, GL_STREAM_READ);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+void VirtualTexturingSupport::Init(App* app)
+{
+    VirtualTexturing& virtualTexturing = app->virtualTexturing;
+    virtualTexturing.programIdx = ShaderSupport::LoadProgram(app, "Shaders\\shader_deferred_geometry_pass.vert", "Shaders\\shader_deferred_geometry_virtual.frag", "DEFERRED_GEOMETRY_VIRTUAL");
+
+    glGenFramebuffers(1, &virtualTexturing.feedbackFrameBuffer);
+    for (FeedbackReadback& readback : virtualTexturing.readbacks)
+        glGenBuffers(1, &readback.pixelBuffer);
+
+    virtualTexturing.loader = std::thread(PageLoader, &virtualTexturing);
+}
+
+void VirtualTexturingSupport::Shutdown(App* app)
+{
+    VirtualTexturing& virtualTexturing = app->virtualTexturing;
+    {
+        std::lock_guard<std::mutex> lock(virtualTexturing.mutex);
+        virtualTexturing.stopping = true;
+    }
+    virtualTexturing.loadAvailable.notify_all();
+    if (virtualTexturing.loader.joinable())
+        virtualTexturing.loader.join();
+    virtualTexturing.loadQueue.clear();
+    virtualTexturing.uploadQueue.clear();
+
+    for (VirtualTexture& virtualTexture : virtualTexturing.virtualTextures)
+    {
+        UnmapFile(virtualTexture.cacheFile);
+        glDeleteTextures(1, &virtualTexture.indirectionHandle);
+    }
+    virtualTexturing.virtualTextures.clear();
+    for (const PhysicalPageAtlas& atlas : virtualTexturing.atlases)
+        glDeleteTextures(1, &atlas.handle);
+    virtualTexturing.atlases.clear();
+
+    for (FeedbackReadback& readback : virtualTexturing.readbacks)
+    {
+        if (readback.fence != nullptr)
+            glDeleteSync(readback.fence);
+        glDeleteBuffers(1, &readback.pixelBuffer);
+        readback = FeedbackReadback{};
+    }
+    glDeleteTextures(1, &virtualTexturing.feedbackTexture);
+    glDeleteFramebuffers(1, &virtualTexturing.feedbackFrameBuffer);
+}
+
+void VirtualTexturingSupport::Update(App* app)
+{
+    VirtualTexturing& virtualTexturing = app->virtualTexturing;
+    if (!virtualTexturing.enabled)
+        return;
+    ++virtualTexturing.frame;
+
+    // The pages are cut from the texture caches, so the textures are registered once they are all cooked
+    if (app->textureStreamer.pendingTextures == 0 && virtualTexturing.registeredTextureCount != app->textures.size())
+    {
+        virtualTexturing.textureToVirtual.resize(app->textures.size(), -1);
+        std::vector<bool> usedByMaterial(app->textures.size(), false);
+        for (const Material& material : app->materials)
+            for (const u32 textureIdx : { material.albedoTextureIdx, material.normalsTextureIdx, material.masksTextureIdx })
+                usedByMaterial[textureIdx] = textureIdx != 0;
+
+        for (u32 t = virtualTexturing.registeredTextureCount; t < app->textures.size(); ++t)
+            if (usedByMaterial[t])
+                RegisterTexture(app, t);
+        virtualTexturing.registeredTextureCount = static_cast<u32>(app->textures.size());
+        ILOG("Virtual texturing: %u virtual textures in %u physical atlases", static_cast<u32>(virtualTexturing.virtualTextures.size()), static_cast<u32>(virtualTexturing.atlases.size()))
+    }
+
+    // Oldest readback, it is skipped (not waited for) while the GPU has not reached its fence
+    FeedbackReadback& readback = virtualTexturing.readbacks[virtualTexturing.nextReadback];
+    if (readback.fence != nullptr)
+    {
+        const GLenum waitResult = glClientWaitSync(readback.fence, 0, 0);
+        if (waitResult == GL_ALREADY_SIGNALED || waitResult == GL_CONDITION_SATISFIED)
+        {
+            glDeleteSync(readback.fence);
+            readback.fence = nullptr;
+
+            const u32 count = static_cast<u32>(virtualTexturing.feedbackSize.x * virtualTexturing.feedbackSize.y);
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.pixelBuffer);
+            const u32* feedback = static_cast<const u32*>(glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, count * sizeof(u32), GL_MAP_READ_BIT));
+            if (feedback != nullptr)
+                ProcessFeedback(app, feedback, count);
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        }
+    }
+
+    // Pages loaded since last frame
+    std::deque<PageLoadJob> uploads;
+    {
+        std::lock_guard<std::mutex> lock(virtualTexturing.mutex);
+        while (!virtualTexturing.uploadQueue.empty() && uploads.size() < VT_MAX_PAGE_UPLOADS_PER_FRAME)
+        {
+            uploads.push_back(std::move(virtualTexturing.uploadQueue.front()));
+            virtualTexturing.uploadQueue.pop_front();
+        }
+    }
+    virtualTexturing.pagesUploadedLastFrame = 0;
+    for (const PageLoadJob& job : uploads)
+        if (UploadPage(virtualTexturing, job, false))
+            ++virtualTexturing.pagesUploadedLastFrame;
+
+    for (VirtualTexture& virtualTexture : virtualTexturing.virtualTextures)
+        if (virtualTexture.indirectionDirty)
+            UpdateIndirection(virtualTexture);
+}
+
+bool VirtualTexturingSupport::IsActive(const App* app)
+{
+    const VirtualTexturing& virtualTexturing = app->virtualTexturing;
+    return virtualTexturing.enabled && !virtualTexturing.virtualTextures.empty();
+}
+
+void VirtualTexturingSupport::BeginGeometryPass(App* app)
+{
+    VirtualTexturing& virtualTexturing = app->virtualTexturing;
+    ResizeFeedback(virtualTexturing, app->displaySizeCurrent);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, virtualTexturing.feedbackFrameBuffer);
+    const GLuint clearValue[4] = { VT_NO_FEEDBACK, 0, 0, 0 };
+    glClearBufferuiv(GL_COLOR, 0, clearValue);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    glBindImageTexture(0, virtualTexturing.feedbackTexture, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32UI);
+
+    // A different pixel of every 8x8 cell each frame, over 64 frames all of them are sampled
+    const GLuint programHandle = app->programs[virtualTexturing.programIdx].handle;
+    const u32 jitterIdx = static_cast<u32>(virtualTexturing.frame % (VT_FEEDBACK_SCALE * VT_FEEDBACK_SCALE));
+    glProgramUniform2ui(programHandle, glGetUniformLocation(programHandle, "uFeedbackJitter"), jitterIdx % VT_FEEDBACK_SCALE, jitterIdx / VT_FEEDBACK_SCALE);
+    glProgramUniform1f(programHandle, glGetUniformLocation(programHandle, "uPhysicalAtlasSize"), static_cast<f32>(AtlasSize));
+}
+
+void VirtualTexturingSupport::SetMaterial(App* app, const u32 materialIdx, std::vector<u32>& textureHandles, std::vector<u32>& textureLocations)
+{
+    const VirtualTexturing& virtualTexturing = app->virtualTexturing;
+    const Material& material = app->materials[materialIdx];
+    const GLuint defaultHandle = app->textures[app->defaultTextureIdx].handle;
+    const GLuint programHandle = app->programs[virtualTexturing.programIdx].handle;
+
+    textureHandles = { app->textures[material.albedoTextureIdx].handle, app->textures[material.normalsTextureIdx].handle, app->textures[material.masksTextureIdx].handle };
+    textureLocations = { MAT_T_DIFFUSE, MAT_T_NORMALS, MAT_T_MASKS };
+
+    // Indirection textures at units 3..5 and the physical atlases at 6..9
+    glm::uvec3 virtualTextures = glm::uvec3(0);
+    glm::vec4 virtualInfo[3] = {};
+    const u32 roleTextures[3] = { material.albedoTextureIdx, material.normalsTextureIdx, material.masksTextureIdx };
+    for (u32 r = 0; r < 3; ++r)
+    {
+        const i32 virtualTextureIdx = roleTextures[r] < virtualTexturing.textureToVirtual.size() ? virtualTexturing.textureToVirtual[roleTextures[r]] : -1;
+        GLuint indirectionHandle = defaultHandle;
+        if (roleTextures[r] != 0 && virtualTextureIdx >= 0)
+        {
+            const VirtualTexture& virtualTexture = virtualTexturing.virtualTextures[virtualTextureIdx];
+            virtualTextures[r] = 1;
+            virtualInfo[r] = glm::vec4(virtualTexture.pageCount.x, virtualTexture.pageCount.y, virtualTexture.levelCount, 0.0f);
+            indirectionHandle = virtualTexture.indirectionHandle;
+        }
+        textureHandles.push_back(indirectionHandle);
+        textureLocations.push_back(3 + r);
+    }
+    for (u32 a = 0; a < VT_MAX_PHYSICAL_ATLASES; ++a)
+    {
+        textureHandles.push_back(a < virtualTexturing.atlases.size() ? virtualTexturing.atlases[a].handle : defaultHandle);
+        textureLocations.push_back(6 + a);
+    }
+
+    const ivec2 virtualSize = GetMaterialVirtualSize(app, material);
+    glProgramUniform3ui(programHandle, glGetUniformLocation(programHandle, "uVirtualTextures"), virtualTextures.x, virtualTextures.y, virtualTextures.z);
+    glProgramUniform4fv(programHandle, glGetUniformLocation(programHandle, "uVirtualInfo"), 3, glm::value_ptr(virtualInfo[0]));
+    glProgramUniform2f(programHandle, glGetUniformLocation(programHandle, "uVirtualSize"), static_cast<f32>(virtualSize.x), static_cast<f32>(virtualSize.y));
+    glProgramUniform1ui(programHandle, glGetUniformLocation(programHandle, "uMaterialIdx"), materialIdx);
+}
+
+void VirtualTexturingSupport::EndGeometryPass(App* app)
+{
+    VirtualTexturing& virtualTexturing = app->virtualTexturing;
+    glBindImageTexture(0, 0, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32UI);
+
+    // Still waiting for the GPU, this frame's feedback is skipped instead of stalling
+    FeedbackReadback& readback = virtualTexturing.readbacks[virtualTexturing.nextReadback];
+    if (readback.fence != nullptr)
+        return;
+
+    glMemoryBarrier(GL_FRAMEBUFFER_BARRIER_BIT | GL_PIXEL_BUFFER_BARRIER_BIT);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, virtualTexturing.feedbackFrameBuffer);
+    glReadBuffer(GL_COLOR_ATTACHMENT0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.pixelBuffer);
+    glReadPixels(0, 0, virtualTexturing.feedbackSize.x, virtualTexturing.feedbackSize.y, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+
+    readback.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    virtualTexturing.nextReadback = (virtualTexturing.nextReadback + 1) % VT_FEEDBACK_READBACK_FRAMES;
+}
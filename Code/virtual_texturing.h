@@ -0,0 +1,147 @@
+﻿#ifndef VIRTUAL_TEXTURING_H
+#define VIRTUAL_TEXTURING_H
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "platform.h"
+#include "texture_compression.h"
+
+struct App;
+struct Material;
+
+#define VT_PAGE_SIZE 128 // Texels of a virtual page
+#define VT_PAGE_BORDER 4 // One block on each side, bilinear filtering never reads past the page
+#define VT_PHYSICAL_PAGE_SIZE (VT_PAGE_SIZE + 2 * VT_PAGE_BORDER)
+#define VT_ATLAS_PAGES_PER_SIDE 32
+#define VT_MAX_PHYSICAL_ATLASES 4 // One per block format, texture units 6..9 of the virtual geometry program
+#define VT_FEEDBACK_SCALE 8 // One feedback texel per 8x8 pixels, a jittered pixel of the cell writes it
+#define VT_FEEDBACK_READBACK_FRAMES 3
+#define VT_MAX_PAGE_REQUESTS_PER_FRAME 64
+#define VT_MAX_PAGE_UPLOADS_PER_FRAME 32
+#define VT_NO_FEEDBACK 0xFFFFFFFFu
+
+// Page table states besides the physical slot index
+#define VT_PAGE_NOT_RESIDENT -1
+#define VT_PAGE_REQUESTED -2
+
+/// <summary>
+/// Texture whose mips are paged in on demand. Pages are read straight from the blocks of its texture cache
+/// (the file stays mapped), only the levels that are whole pages are virtual and the coarsest one stays resident.
+/// </summary>
+/// <param name="pageSlots">Per level, the physical slot of every page or a VT_PAGE_* state.</param>
+/// <param name="indirectionHandle">RGBA8UI mip chain with a texel per page: physical x/y, resident level and atlas.</param>
+struct VirtualTexture
+{
+    u32 textureIdx;
+    u32 atlasIdx;
+    GLenum format;
+    ivec2 size;
+    ivec2 pageCount; // At level 0
+    u32 levelCount;
+    MappedFile cacheFile;
+    const u8* mipData[16];
+    std::vector<CompressedMip> mips;
+    std::vector<std::vector<i32>> pageSlots;
+    GLuint indirectionHandle = 0;
+    bool indirectionDirty = true;
+};
+
+struct PhysicalPage
+{
+    i32 virtualTextureIdx = -1;
+    u32 level;
+    u32 x;
+    u32 y;
+    u64 lastUsedFrame = 0;
+    bool pinned = false;
+};
+
+// Fixed size texture of pages with the same block format, the slots are recycled in LRU order
+struct PhysicalPageAtlas
+{
+    GLuint handle = 0;
+    GLenum format;
+    std::vector<PhysicalPage> pages;
+};
+
+struct PageLoadJob
+{
+    u32 virtualTextureIdx;
+    u32 level;
+    u32 x;
+    u32 y;
+    const u8* mipData;
+    u32 blocksX;
+    u32 blocksY;
+    u32 blockBytes;
+    std::vector<u8> data;
+};
+
+// Feedback target and its readback ring, the CPU maps a buffer a few frames after its copy was queued
+struct FeedbackReadback
+{
+    GLuint pixelBuffer = 0;
+    GLsync fence = nullptr;
+};
+
+/// <summary>
+/// Virtual texturing of the material textures. The geometry pass writes the pages it needs into a low resolution
+/// feedback image, the readback is parsed a few frames later, the missing pages are copied out of the texture cache by a
+/// loader thread and uploaded into the physical atlases within a per frame budget. The indirection textures send every
+/// lookup to the finest resident level, so GPU memory is the atlases (fixed) plus the indirection, whatever is loaded.
+/// </summary>
+struct VirtualTexturing
+{
+    bool enabled = false;
+    u32 programIdx = 0;
+    u32 registeredTextureCount = 0;
+
+    std::vector<VirtualTexture> virtualTextures;
+    std::vector<i32> textureToVirtual; // Per texture slot, -1 when the texture is not virtual
+    std::vector<PhysicalPageAtlas> atlases;
+
+    // Feedback
+    GLuint feedbackTexture = 0;
+    GLuint feedbackFrameBuffer = 0;
+    ivec2 feedbackSize = ivec2(0);
+    FeedbackReadback readbacks[VT_FEEDBACK_READBACK_FRAMES];
+    u32 nextReadback = 0;
+    u64 frame = 0;
+
+    // Page loader thread
+    std::thread loader;
+    std::mutex mutex;
+    std::condition_variable loadAvailable;
+    std::deque<PageLoadJob> loadQueue;
+    std::deque<PageLoadJob> uploadQueue;
+    bool stopping = false;
+
+    // Stats
+    u32 residentPages = 0;
+    u32 pagesRequestedLastFrame = 0;
+    u32 pagesUploadedLastFrame = 0;
+    u32 pagesEvicted = 0;
+    u64 atlasBytes = 0;
+};
+
+struct VirtualTexturingSupport
+{
+    // Loads the program and starts the page loader, call before the vertex input layouts are reflected
+    static void Init(App* app);
+    static void Shutdown(App* app);
+
+    // Registers the newly streamed textures, parses the oldest finished feedback readback and uploads the loaded pages
+    static void Update(App* app);
+
+    static bool IsActive(const App* app);
+
+    // Geometry pass with the virtual program, draws the deferred geometry and fills the feedback image
+    static void BeginGeometryPass(App* app);
+    static void SetMaterial(App* app, u32 materialIdx, std::vector<u32>& textureHandles, std::vector<u32>& textureLocations);
+    static void EndGeometryPass(App* app);
+};
+
+#endif // VIRTUAL_TEXTURING_H
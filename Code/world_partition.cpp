@@ -0,0 +1,295 @@
+﻿#include "world_partition.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <unordered_set>
+
+#include "app.h"
+#include "engine.h"
+#include "mesh_cache.h"
+
+// Before the first residency only the files are known, the cache holds the geometry as uploaded and the source is larger than it
+static u64 EstimateFirstLoadBytes(const char* filename)
+{
+    std::error_code error;
+    const u64 cacheBytes = std::filesystem::file_size(MeshCacheSupport::GetCachePath(filename), error);
+    if (!error)
+        return cacheBytes;
+    const u64 sourceBytes = std::filesystem::file_size(filename, error);
+    return error ? 0 : sourceBytes;
+}
+
+void WorldPartitionSupport::AddPlacement(App* app, const char* filename, const u32 loadingFlags, const glm::vec3& position, const glm::vec3& orientation,
+    const glm::vec3& scale, const u32 programIdx, const glm::vec4& color, const char* name)
+{
+    WorldPartition& world = app->worldPartition;
+
+    u32 worldModelIdx = 0;
+    while (worldModelIdx < world.models.size() && world.models[worldModelIdx].filename != filename)
+        ++worldModelIdx;
+    if (worldModelIdx == world.models.size())
+    {
+        world.models.emplace_back();
+        world.models.back().filename = filename;
+        world.models.back().loadingFlags = loadingFlags;
+        world.models.back().bytes = EstimateFirstLoadBytes(filename);
+    }
+
+    const std::pair<i32, i32> coord(static_cast<i32>(glm::floor(position.x / WORLD_PARTITION_CELL_SIZE)),
+        static_cast<i32>(glm::floor(position.z / WORLD_PARTITION_CELL_SIZE)));
+    auto cellIt = world.cellLookup.find(coord);
+    if (cellIt == world.cellLookup.end())
+    {
+        cellIt = world.cellLookup.emplace(coord, static_cast<u32>(world.cells.size())).first;
+        world.cells.emplace_back();
+        world.cells.back().coord = ivec2(coord.first, coord.second);
+    }
+    WorldCell& cell = world.cells[cellIt->second];
+
+    WorldPlacement placement;
+    placement.worldModelIdx = worldModelIdx;
+    placement.position = position;
+    placement.orientation = orientation;
+    placement.scale = scale;
+    placement.programIdx = programIdx;
+    placement.color = color;
+    placement.name = name;
+    cell.placements.push_back(static_cast<u32>(world.placements.size()));
+    world.placements.push_back(placement);
+    if (std::find(cell.worldModels.begin(), cell.worldModels.end(), worldModelIdx) == cell.worldModels.end())
+        cell.worldModels.push_back(worldModelIdx);
+}
+
+static f32 GetCellDistance(const WorldCell& cell, const glm::vec3& position)
+{
+    const glm::vec2 cellMin = glm::vec2(cell.coord) * WORLD_PARTITION_CELL_SIZE;
+    const glm::vec2 closest = glm::clamp(glm::vec2(position.x, position.z), cellMin, cellMin + WORLD_PARTITION_CELL_SIZE);
+    return glm::distance(closest, glm::vec2(position.x, position.z));
+}
+
+static void ReleaseWorldModel(App* app, WorldModel& model)
+{
+    AssimpSupport::ReleaseModel(app, model.modelIdx);
+    model.residency = WorldResidency::UNLOADED;
+}
+
+static void LoadCell(App* app, WorldCell& cell)
+{
+    WorldPartition& world = app->worldPartition;
+    for (const u32 worldModelIdx : cell.worldModels)
+    {
+        WorldModel& model = world.models[worldModelIdx];
+        ++model.cellRefs;
+        if (model.residency != WorldResidency::UNLOADED || model.failed)
+            continue;
+
+        // Entities are spawned per cell once all its models are resident, not per model
+        ModelSpawn spawn;
+        spawn.spawnEntity = false;
+        model.requestIdx = model.modelIdx == UINT32_MAX
+            ? AssetLoaderSupport::ImportModelAsync(app, model.filename.c_str(), model.loadingFlags, spawn)
+            : AssetLoaderSupport::ReloadModelAsync(app, model.modelIdx, model.filename.c_str(), model.loadingFlags, spawn);
+        model.residency = WorldResidency::LOADING;
+    }
+    cell.residency = WorldResidency::LOADING;
+    ++world.totalCellLoads;
+}
+
+static void UnloadCell(App* app, WorldCell& cell)
+{
+    WorldPartition& world = app->worldPartition;
+    for (const u32 placementIdx : cell.placements)
+    {
+        WorldPlacement& placement = world.placements[placementIdx];
+        if (placement.entity != nullptr)
+            DestroyEntity(app, placement.entity);
+        placement.entity = nullptr;
+    }
+
+    // Models still loading are released by UpdateModels once their upload is done
+    for (const u32 worldModelIdx : cell.worldModels)
+    {
+        WorldModel& model = world.models[worldModelIdx];
+        if (--model.cellRefs == 0 && model.residency == WorldResidency::RESIDENT)
+            ReleaseWorldModel(app, model);
+    }
+    cell.residency = WorldResidency::UNLOADED;
+    ++world.totalCellUnloads;
+}
+
+static void UpdateModels(App* app)
+{
+    WorldPartition& world = app->worldPartition;
+    for (WorldModel& model : world.models)
+    {
+        if (model.residency != WorldResidency::LOADING)
+            continue;
+
+        const ModelRequestState state = AssetLoaderSupport::GetState(app, model.requestIdx);
+        if (state == ModelRequestState::FAILED)
+        {
+            model.failed = true;
+            model.residency = WorldResidency::UNLOADED;
+        }
+        else if (state == ModelRequestState::RESIDENT)
+        {
+            model.modelIdx = AssetLoaderSupport::GetModelIdx(app, model.requestIdx);
+            model.residency = WorldResidency::RESIDENT;
+            if (model.cellRefs == 0)
+                ReleaseWorldModel(app, model);
+        }
+    }
+}
+
+// Buffers of the resident models and the textures they sample, each texture once
+static void CountResidentBytes(App* app)
+{
+    WorldPartition& world = app->worldPartition;
+    world.residentBytes = 0;
+    world.loadingBytes = 0;
+    world.residentModels = 0;
+
+    // Textures also sampled by the models outside the partition (e.g. the startup ones) stay loaded with the cells gone, they are not charged to them
+    std::unordered_set<u32> countedTextures = { app->defaultTextureIdx };
+    std::unordered_set<u32> worldModelIdxs;
+    for (const WorldModel& model : world.models)
+        worldModelIdxs.insert(model.modelIdx);
+    for (u32 modelIdx = 0; modelIdx < app->models.size(); ++modelIdx)
+    {
+        const Model& appModel = app->models[modelIdx];
+        if (worldModelIdxs.count(modelIdx) != 0 || app->meshes[appModel.meshIdx].vertexBuffer.handle == 0)
+            continue;
+        for (const u32 materialIdx : appModel.materialIdx)
+        {
+            const Material& material = app->materials[materialIdx];
+            countedTextures.insert({ material.albedoTextureIdx, material.emissiveTextureIdx, material.normalsTextureIdx, material.masksTextureIdx, material.coneStepTextureIdx });
+        }
+    }
+    const std::unordered_set<u32> sharedTextures = countedTextures;
+
+    for (WorldModel& model : world.models)
+    {
+        if (model.residency == WorldResidency::LOADING)
+            world.loadingBytes += model.bytes;
+        if (model.residency != WorldResidency::RESIDENT)
+            continue;
+
+        const Model& appModel = app->models[model.modelIdx];
+        const Mesh& mesh = app->meshes[appModel.meshIdx];
+        model.bytes = static_cast<u64>(mesh.vertexBuffer.size) + mesh.indexBuffer.size;
+        for (const u32 materialIdx : appModel.materialIdx)
+        {
+            const Material& material = app->materials[materialIdx];
+            for (const u32 textureIdx : { material.albedoTextureIdx, material.emissiveTextureIdx, material.normalsTextureIdx, material.masksTextureIdx, material.coneStepTextureIdx })
+            {
+                if (sharedTextures.count(textureIdx) != 0)
+                    continue;
+                const u64 textureBytes = TextureSupport::GetEstimatedBytes(app->textures[textureIdx]);
+                model.bytes += textureBytes;
+                if (countedTextures.insert(textureIdx).second)
+                    world.residentBytes += textureBytes;
+            }
+        }
+        world.residentBytes += static_cast<u64>(mesh.vertexBuffer.size) + mesh.indexBuffer.size;
+        ++world.residentModels;
+    }
+}
+
+void WorldPartitionSupport::Update(App* app)
+{
+    WorldPartition& world = app->worldPartition;
+    const Camera& camera = app->camera;
+
+    // Smoothed, a single frame of fast movement should not prefetch a whole row of cells
+    if (world.cameraTracked && app->deltaTime > 0.0f)
+    {
+        const glm::vec3 frameVelocity = (camera.position - world.lastCameraPosition) / app->deltaTime;
+        world.cameraVelocity = glm::mix(world.cameraVelocity, frameVelocity, WORLD_PARTITION_VELOCITY_SMOOTHING);
+    }
+    world.lastCameraPosition = camera.position;
+    world.cameraTracked = true;
+    const glm::vec3 predictedPosition = camera.position + world.cameraVelocity * world.prefetchSeconds;
+
+    UpdateModels(app);
+
+    for (WorldCell& cell : world.cells)
+    {
+        cell.distance = GetCellDistance(cell, camera.position);
+        cell.priorityDistance = glm::min(cell.distance, GetCellDistance(cell, predictedPosition));
+    }
+
+    // Far cells, and all of them once the partition is disabled
+    for (WorldCell& cell : world.cells)
+        if (cell.residency != WorldResidency::UNLOADED && (!world.enabled || cell.priorityDistance > world.unloadRadius))
+            UnloadCell(app, cell);
+
+    // Farthest cells first while over budget
+    const u64 budgetBytes = static_cast<u64>(world.memoryBudgetMB) * 1024ull * 1024ull;
+    CountResidentBytes(app);
+    while (world.residentBytes > budgetBytes)
+    {
+        WorldCell* farthestCell = nullptr;
+        for (WorldCell& cell : world.cells)
+            if (cell.residency == WorldResidency::RESIDENT && (farthestCell == nullptr || cell.priorityDistance > farthestCell->priorityDistance))
+                farthestCell = &cell;
+        if (farthestCell == nullptr)
+            break;
+        UnloadCell(app, *farthestCell);
+        CountResidentBytes(app);
+        ++world.budgetUnloads;
+    }
+
+    // Cells whose models are all resident spawn their entities together
+    world.loadingCells = 0;
+    world.residentCells = 0;
+    for (WorldCell& cell : world.cells)
+    {
+        if (cell.residency == WorldResidency::LOADING)
+        {
+            const bool ready = std::all_of(cell.worldModels.begin(), cell.worldModels.end(), [&world](const u32 worldModelIdx)
+            {
+                return world.models[worldModelIdx].residency == WorldResidency::RESIDENT || world.models[worldModelIdx].failed;
+            });
+            if (ready)
+            {
+                for (const u32 placementIdx : cell.placements)
+                {
+                    WorldPlacement& placement = world.placements[placementIdx];
+                    const WorldModel& model = world.models[placement.worldModelIdx];
+                    if (model.residency != WorldResidency::RESIDENT)
+                        continue;
+                    CreateEntity(app, placement.position, placement.orientation, placement.scale, model.modelIdx, placement.programIdx, placement.color, placement.name.c_str());
+                    placement.entity = app->entities.back().get();
+                }
+                cell.residency = WorldResidency::RESIDENT;
+            }
+        }
+        world.loadingCells += cell.residency == WorldResidency::LOADING ? 1 : 0;
+        world.residentCells += cell.residency == WorldResidency::RESIDENT ? 1 : 0;
+    }
+    if (!world.enabled)
+        return;
+
+    // Wanted cells by priority, a load that would not fit in the budget waits for the farther cells to go
+    std::vector<WorldCell*> wantedCells;
+    for (WorldCell& cell : world.cells)
+        if (cell.residency == WorldResidency::UNLOADED && cell.priorityDistance <= world.loadRadius)
+            wantedCells.push_back(&cell);
+    std::sort(wantedCells.begin(), wantedCells.end(), [](const WorldCell* a, const WorldCell* b) { return a->priorityDistance < b->priorityDistance; });
+    for (WorldCell* cell : wantedCells)
+    {
+        if (world.loadingCells >= world.maxLoadingCells)
+            break;
+
+        u64 estimatedBytes = 0;
+        for (const u32 worldModelIdx : cell->worldModels)
+            if (world.models[worldModelIdx].residency == WorldResidency::UNLOADED)
+                estimatedBytes += world.models[worldModelIdx].bytes;
+        if (world.residentBytes + world.loadingBytes + estimatedBytes > budgetBytes)
+            break;
+
+        LoadCell(app, *cell);
+        world.loadingBytes += estimatedBytes;
+        ++world.loadingCells;
+    }
+}
@@ -0,0 +1,106 @@
+﻿#ifndef WORLD_PARTITION_H
+#define WORLD_PARTITION_H
+#include <map>
+#include <vector>
+
+#include "platform.h"
+
+struct App;
+struct Entity;
+
+#define WORLD_PARTITION_CELL_SIZE 16.0f
+#define WORLD_PARTITION_DEFAULT_MEMORY_BUDGET_MB 256
+#define WORLD_PARTITION_VELOCITY_SMOOTHING 0.1f // Weight of the last frame in the camera velocity used for the prefetch
+
+enum class WorldResidency
+{
+    UNLOADED,
+    LOADING,
+    RESIDENT
+};
+
+static const char* WorldResidencyStr[] = { "Unloaded", "Loading", "Resident" };
+
+/// <summary>
+/// Model file placed by the cells, loaded while at least one of them is loading or resident and released with the last one.
+/// </summary>
+struct WorldModel
+{
+    std::string filename;
+    u32 loadingFlags;
+    u32 modelIdx = UINT32_MAX; // Kept once created, the releases free the slots and the reloads fill them again
+    u32 requestIdx = UINT32_MAX;
+    WorldResidency residency = WorldResidency::UNLOADED;
+    bool failed = false;
+    u32 cellRefs = 0;
+    u64 bytes = 0; // Geometry and own textures when it was last resident (the file sizes before), the estimate of its next loads
+};
+
+struct WorldPlacement
+{
+    u32 worldModelIdx;
+    glm::vec3 position;
+    glm::vec3 orientation;
+    glm::vec3 scale;
+    u32 programIdx;
+    glm::vec4 color;
+    std::string name;
+    const Entity* entity = nullptr; // Spawned while the cell is resident
+};
+
+struct WorldCell
+{
+    ivec2 coord;
+    std::vector<u32> placements;
+    std::vector<u32> worldModels; // Distinct models of the placements
+    WorldResidency residency = WorldResidency::UNLOADED;
+    f32 distance = 0.0f; // Camera to the cell rectangle on XZ
+    f32 priorityDistance = 0.0f; // Smallest of the current and the predicted camera distances, cells load in this order
+};
+
+/// <summary>
+/// Splits the scene in square cells on XZ whose models and textures are only resident around the camera. Cells are loaded
+/// through the asset loader runtime imports, so the frame never waits on I/O, in the order of their distance to the camera
+/// or to where its velocity takes it in prefetchSeconds. Far cells are unloaded, and the farthest ones too while the world
+/// is over its memory budget, which also holds back the loads that would not fit.
+/// </summary>
+struct WorldPartition
+{
+    bool enabled = false;
+    f32 loadRadius = 40.0f;
+    f32 unloadRadius = 56.0f; // Above the load radius so the cells on the edge don't flip every frame
+    f32 prefetchSeconds = 1.0f;
+    u32 memoryBudgetMB = WORLD_PARTITION_DEFAULT_MEMORY_BUDGET_MB;
+    u32 maxLoadingCells = 4;
+
+    std::vector<WorldModel> models;
+    std::vector<WorldPlacement> placements;
+    std::vector<WorldCell> cells;
+    std::map<std::pair<i32, i32>, u32> cellLookup;
+
+    glm::vec3 lastCameraPosition = glm::vec3(0.0f);
+    glm::vec3 cameraVelocity = glm::vec3(0.0f);
+    bool cameraTracked = false;
+
+    // Stats
+    u64 residentBytes = 0;
+    u64 loadingBytes = 0; // Estimated from the previous loads of the models
+    u32 residentCells = 0;
+    u32 loadingCells = 0;
+    u32 residentModels = 0;
+    u32 totalCellLoads = 0;
+    u32 totalCellUnloads = 0;
+    u32 budgetUnloads = 0;
+};
+
+struct WorldPartitionSupport
+{
+    // Places an instance of the model file in the cell under its position
+    static void AddPlacement(App* app, const char* filename, u32 loadingFlags, const glm::vec3& position, const glm::vec3& orientation,
+        const glm::vec3& scale, u32 programIdx, const glm::vec4& color, const char* name);
+
+    // Loads and unloads the cells around the camera, called once per frame after the asset loader
+    static void Update(App* app);
+};
+
+#endif // WORLD_PARTITION_H
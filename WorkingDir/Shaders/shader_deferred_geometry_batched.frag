@@ -0,0 +1,158 @@
+#version 430
+
+layout(location = 0) in vec3 sPosition; // In worldspace
+layout(location = 1) in vec3 sNormal; // In worldspace
+layout(location = 2) in vec2 sTextCoord; 
+layout(location = 3) in vec3 sViewDir; // In worldspace
+layout(location = 4) in vec3 sTangent; 
+layout(location = 5) in mat3 sTBN;  
+layout(location = 9) in vec4 sClipPosition;
+layout(location = 10) in vec4 sPrevClipPosition;
+layout(location = 8) flat in uint sMaterialIdx;
+
+// One array per size/format, MATERIAL_BATCHING_MAX_TEXTURE_ARRAYS units starting at 0
+layout (binding = 0) uniform sampler2DArray uMaterialTextures[12];
+
+// Texture references are (array, layer) or the two halves of a bindless handle, see MaterialBatchingSupport
+struct BatchedMaterial
+{
+	vec4 albedoSmoothness;
+	uvec4 textureFlags; // x: albedo, y: normals, z: masks, w: cone step map
+	uvec2 albedoTexture;
+	uvec2 normalsTexture;
+	uvec2 masksTexture;
+	uvec2 coneStepTexture;
+	vec4 parallax; // x: height scale, y: fade start, z: fade end
+};
+
+layout(binding = 0, std430) readonly buffer BatchedMaterials
+{
+	BatchedMaterial uMaterials[];
+};
+
+// location in this context are the indices of the draw buffers array.
+layout(location = 0) out vec4 rt0; // Color
+layout(location = 1) out vec4 rt1; // Position world space
+layout(location = 2) out vec4 rt2; // Normals
+layout(location = 3) out vec4 rt3; // Motion vectors, the full layout writes its specular from rt7
+layout(location = 4) out vec4 rt4; // Bump
+layout(location = 5) out vec4 rt5; // Tangent
+layout(location = 6) out vec4 rt6; // Compact layout: octahedral normal (rg) and tangent (ba)
+layout(location = 7) out vec4 rt7; // Compact layout: specular (r) and bump (g)
+
+// Compact G-buffer: unit vectors folded onto an octahedron, two channels each
+vec2 OctWrap(vec2 v)
+{
+	return (1.0 - abs(v.yx)) * vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+}
+
+vec2 EncodeOctahedral(vec3 n)
+{
+	n /= max(abs(n.x) + abs(n.y) + abs(n.z), 1e-6);
+	n.xy = n.z >= 0.0 ? n.xy : OctWrap(n.xy);
+	return n.xy * 0.5 + 0.5;
+}
+
+// Sampler arrays need constant indices in GLSL 4.30, hence the switch. The derivatives are taken
+// before it since the branches are not in uniform control flow.
+vec4 SampleMaterialTexture(uvec2 textureRef, vec2 uv, vec2 dx, vec2 dy)
+{
+	vec3 coord = vec3(uv, float(textureRef.y));
+	switch (textureRef.x)
+	{
+		case 0u: return textureGrad(uMaterialTextures[0], coord, dx, dy);
+		case 1u: return textureGrad(uMaterialTextures[1], coord, dx, dy);
+		case 2u: return textureGrad(uMaterialTextures[2], coord, dx, dy);
+		case 3u: return textureGrad(uMaterialTextures[3], coord, dx, dy);
+		case 4u: return textureGrad(uMaterialTextures[4], coord, dx, dy);
+		case 5u: return textureGrad(uMaterialTextures[5], coord, dx, dy);
+		case 6u: return textureGrad(uMaterialTextures[6], coord, dx, dy);
+		case 7u: return textureGrad(uMaterialTextures[7], coord, dx, dy);
+		case 8u: return textureGrad(uMaterialTextures[8], coord, dx, dy);
+		case 9u: return textureGrad(uMaterialTextures[9], coord, dx, dy);
+		case 10u: return textureGrad(uMaterialTextures[10], coord, dx, dy);
+		case 11u: return textureGrad(uMaterialTextures[11], coord, dx, dy);
+	}
+	return vec4(1.0);
+}
+
+// Relaxed cone step mapping, see ConeStepMapSupport. Each step moves the ray as far as the cone of the texel under it allows,
+// once the ray is under the surface it stops and a binary search along the ray refines the hit. The cones are read from level 0
+const int CONE_STEPS = 6;
+const int CONE_BINARY_STEPS = 5;
+
+vec2 ConeStepMapping(uvec2 coneStepTexture, vec2 texCoords, vec3 tangentViewDir, float heightScale)
+{
+	vec3 ray = vec3(-tangentViewDir.xy * heightScale / max(tangentViewDir.z, 0.1), 1.0); // Per unit of depth
+	float rayRatio = length(ray.xy);
+	vec3 position = vec3(texCoords, 0.0);
+	for (int i = 0; i < CONE_STEPS; ++i)
+	{
+		vec2 cone = SampleMaterialTexture(coneStepTexture, position.xy, vec2(0.0), vec2(0.0)).rg;
+		float coneRatio = cone.g * cone.g;
+		float height = max(cone.r - position.z, 0.0);
+		position += ray * (coneRatio * height / (rayRatio + coneRatio));
+	}
+
+	vec3 range = 0.5 * ray * position.z;
+	vec3 probe = position - range;
+	for (int i = 0; i < CONE_BINARY_STEPS; ++i)
+	{
+		range *= 0.5;
+		probe += SampleMaterialTexture(coneStepTexture, probe.xy, vec2(0.0), vec2(0.0)).r > probe.z ? range : -range;
+	}
+	return probe.xy;
+}
+
+// Parallax scale at this distance to the camera, 0 once it is faded out
+float ParallaxFade(float heightScale, vec2 fade)
+{
+	return heightScale * (1.0 - smoothstep(fade.x, fade.y, length(sViewDir)));
+}
+
+void main()
+{
+	BatchedMaterial material = uMaterials[sMaterialIdx];
+	vec2 texCoords = sTextCoord;
+	float parallaxScale = ParallaxFade(material.parallax.x, material.parallax.yz);
+	if (material.textureFlags.w != 0u && parallaxScale > 0.0)
+	{
+		texCoords = ConeStepMapping(material.coneStepTexture, sTextCoord, normalize(transpose(sTBN) * sViewDir), parallaxScale);
+	}
+
+	vec2 dx = dFdx(texCoords);
+	vec2 dy = dFdy(texCoords);
+	vec4 objectColor = vec4(material.albedoSmoothness.rgb, 1.0);
+	if (material.textureFlags.x != 0u)
+	{
+		objectColor = SampleMaterialTexture(material.albedoTexture, texCoords, dx, dy);
+	}
+	
+	vec3 normal = normalize(sNormal);
+	if (material.textureFlags.y != 0u)
+	{
+		// Only x/y are stored (BC5), z is rebuilt from the unit length
+		normal.xy = SampleMaterialTexture(material.normalsTexture, texCoords, dx, dy).rg * 2.0 - 1.0;
+		normal.z = sqrt(max(1.0 - dot(normal.xy, normal.xy), 0.0));
+		normal = normalize(sTBN * normal);
+	}
+	
+	// A single fetch for both masks, the packing fills the missing one with these same defaults
+	float specularStrength = 0.8;
+	float bump = 0.0;
+	if (material.textureFlags.z != 0u)
+	{
+		vec2 masks = SampleMaterialTexture(material.masksTexture, texCoords, dx, dy).rg;
+		bump = masks.r;
+		specularStrength = masks.g;
+	}
+
+	rt0 = objectColor;
+	rt1 = vec4(sPosition, 1.0);
+	rt2 = vec4(normal, 1.0);
+	rt3 = vec4((sClipPosition.xy / sClipPosition.w - sPrevClipPosition.xy / sPrevClipPosition.w) * 0.5, 0.0, 1.0); // In texture coordinates
+	rt4 = vec4(bump, bump, bump, 1.0);
+	rt5 = vec4(sTangent, 1.0);
+	rt6 = vec4(EncodeOctahedral(normal), EncodeOctahedral(sTangent));
+	rt7 = vec4(specularStrength, bump, 0.0, 1.0);
+}
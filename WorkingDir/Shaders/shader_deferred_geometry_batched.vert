@@ -0,0 +1,75 @@
+#version 430
+
+layout(location = 0) in vec3 aPosition; // www.khronos.org/opengl/wiki/Layout_Qualifier_(GLSL)
+layout(location = 1) in vec3 aNormal; // In local tangent space
+layout(location = 2) in vec2 aTextCoord;
+layout(location = 3) in vec3 aTangent; // In local tangent space
+layout(location = 4) in vec3 aBitangent; // In local tangent space
+layout(location = 5) in uint aMaterialIdx; // Instanced, read at the base instance of the draw command
+
+
+struct Light					
+{
+	uint type;			
+	vec3 color;					
+	vec3 direction;				
+	vec3 position;			
+	float constant;
+    float linear;
+    float quadratic;
+	float radius;	
+};
+
+layout (binding = 0, std140) uniform GlobalParams
+{
+	vec3 uCameraPosition;   
+	mat4 uViewMatrix;
+	mat4 uProjectionMatrix;	
+	uint uLightCount; 	
+	Light uLight[16];     	
+};
+
+layout(binding = 1, std140) uniform LocalParams
+{
+	vec4 uColor;
+	mat4 uWorldMatrix;
+	mat4 uWorldViewProjectionMatrix;
+	mat3 uNormalMatrix;
+	mat4 uPrevWorldViewProjectionMatrix; // Last frame's, with this frame's jitter
+};
+
+// Can use the same locations for out and in because the belong the different stages in the pipeline.
+layout(location = 0) out vec3 vPosition;
+layout(location = 1) out vec3 vNormal; // In world tangent space
+layout(location = 2) out vec2 vTextCoord; // In worldspace
+layout(location = 3) out vec3 vViewDir; // In worldspace
+layout(location = 4) out vec3 vTangent; 
+layout(location = 5) out mat3 vTBN; 
+layout(location = 8) flat out uint vMaterialIdx;
+
+// Same depth as the other geometry pass programs, see DepthPrepass
+invariant gl_Position;
+
+// Both clip positions, the fragment shader writes the motion vector from them
+layout(location = 9) out vec4 vClipPosition;
+layout(location = 10) out vec4 vPrevClipPosition;
+
+void main() {
+    vTextCoord = aTextCoord;
+	vPosition = vec3(uWorldMatrix * vec4(aPosition, 1.0));
+
+	vec3 T = normalize(vec3(uWorldMatrix * vec4(aTangent,   0.0)));
+    vec3 B = normalize(vec3(uWorldMatrix * vec4(aBitangent, 0.0)));
+    vec3 N = normalize(vec3(uWorldMatrix * vec4(aNormal,    0.0)));
+
+    vTBN = mat3(T, B, N);
+	
+	vNormal = N;
+	vTangent = T;
+
+	vViewDir = uCameraPosition - vPosition;
+	vMaterialIdx = aMaterialIdx;
+	gl_Position = uWorldViewProjectionMatrix * vec4(aPosition, 1.0);
+	vClipPosition = gl_Position;
+	vPrevClipPosition = uPrevWorldViewProjectionMatrix * vec4(aPosition, 1.0);
+}
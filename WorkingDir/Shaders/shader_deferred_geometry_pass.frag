@@ -6,11 +6,16 @@ layout(location = 2) in vec2 sTextCoord;
 layout(location = 3) in vec3 sViewDir; // In worldspace
 layout(location = 4) in vec3 sTangent; 
 layout(location = 5) in mat3 sTBN;  
+layout(location = 9) in vec4 sClipPosition;
+layout(location = 10) in vec4 sPrevClipPosition;
 
 layout (binding = 0) uniform sampler2D uTextureDiffuse; // www.khronos.org/opengl/wiki/Uniform_(GLSL)
 layout (binding = 1) uniform sampler2D uTextureNormals; 
-layout (binding = 2) uniform sampler2D uTextureSpecular; 
-layout (binding = 3) uniform sampler2D uTextureBump; 
+layout (binding = 2) uniform sampler2D uTextureMasks; // r: bump height, g: specular mask
+layout (binding = 3) uniform sampler2D uTextureConeStep; // r: depth, g: square root of the relaxed cone ratio
+
+// Parallax fade, x: start and y: end distance to the camera
+uniform vec2 uParallaxFade;
 
 struct Light					
 {
@@ -59,47 +64,113 @@ layout(binding = 2, std140) uniform MaterialParams
 	Material material;
 };
 
+// Material features, constants in the variants compiled by ShaderPermutationSupport and the UBO flags otherwise
+#ifndef SHADER_PERMUTATION
+#define HAS_ALBEDO_TEXTURE material.hasAlbedoTexture
+#define HAS_SPECULAR_TEXTURE material.hasSpecularTexture
+#define HAS_NORMALS_TEXTURE material.hasNormalsTexture
+#define HAS_BUMP_TEXTURE material.hasBumpTexture
+#endif
+
 // location in this context are the indices of the draw buffers array.
 layout(location = 0) out vec4 rt0; // Color -> drawBuffers[0] = GL_COLOR_ATTACHMENT#; where # = n  refers to a texture in a frame buffer
 layout(location = 1) out vec4 rt1; // Position world space
 layout(location = 2) out vec4 rt2; // Normals
-layout(location = 3) out vec4 rt3; // Specular, roughness
+layout(location = 3) out vec4 rt3; // Motion vectors, the full layout writes its specular from rt7
 layout(location = 4) out vec4 rt4; // Bump
 layout(location = 5) out vec4 rt5; // Tangent
+layout(location = 6) out vec4 rt6; // Compact layout: octahedral normal (rg) and tangent (ba)
+layout(location = 7) out vec4 rt7; // Compact layout: specular (r) and bump (g)
+
+// Compact G-buffer: unit vectors folded onto an octahedron, two channels each
+vec2 OctWrap(vec2 v)
+{
+	return (1.0 - abs(v.yx)) * vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+}
+
+vec2 EncodeOctahedral(vec3 n)
+{
+	n /= max(abs(n.x) + abs(n.y) + abs(n.z), 1e-6);
+	n.xy = n.z >= 0.0 ? n.xy : OctWrap(n.xy);
+	return n.xy * 0.5 + 0.5;
+}
+
+// Relaxed cone step mapping, see ConeStepMapSupport. Each step moves the ray as far as the cone of the texel under it allows,
+// once the ray is under the surface it stops and a binary search along the ray refines the hit. The cones are read from level 0
+const int CONE_STEPS = 6;
+const int CONE_BINARY_STEPS = 5;
+
+vec2 ConeStepMapping(vec2 texCoords, vec3 tangentViewDir, float heightScale)
+{
+	vec3 ray = vec3(-tangentViewDir.xy * heightScale / max(tangentViewDir.z, 0.1), 1.0); // Per unit of depth
+	float rayRatio = length(ray.xy);
+	vec3 position = vec3(texCoords, 0.0);
+	for (int i = 0; i < CONE_STEPS; ++i)
+	{
+		vec2 cone = textureLod(uTextureConeStep, position.xy, 0.0).rg;
+		float coneRatio = cone.g * cone.g;
+		float height = max(cone.r - position.z, 0.0);
+		position += ray * (coneRatio * height / (rayRatio + coneRatio));
+	}
+
+	vec3 range = 0.5 * ray * position.z;
+	vec3 probe = position - range;
+	for (int i = 0; i < CONE_BINARY_STEPS; ++i)
+	{
+		range *= 0.5;
+		probe += textureLod(uTextureConeStep, probe.xy, 0.0).r > probe.z ? range : -range;
+	}
+	return probe.xy;
+}
+
+// Parallax scale at this distance to the camera, 0 once it is faded out
+float ParallaxFade(float heightScale, vec2 fade)
+{
+	return heightScale * (1.0 - smoothstep(fade.x, fade.y, length(sViewDir)));
+}
 
 void main()
 {
+	// The height scale is 0 for the materials without cone step map
+	vec2 texCoords = sTextCoord;
+	float parallaxScale = ParallaxFade(material.heightScale, uParallaxFade);
+	if (HAS_BUMP_TEXTURE && parallaxScale > 0.0)
+	{
+		texCoords = ConeStepMapping(sTextCoord, normalize(transpose(sTBN) * sViewDir), parallaxScale);
+	}
+
 	vec4 objectColor = vec4(material.albedo, 1.0);
-	if (material.hasAlbedoTexture)
+	if (HAS_ALBEDO_TEXTURE)
 	{
-		objectColor = texture(uTextureDiffuse, sTextCoord);
+		objectColor = texture(uTextureDiffuse, texCoords);
 	}
 	
 	vec3 normal = normalize(sNormal);
-	if (material.hasNormalsTexture)
+	if (HAS_NORMALS_TEXTURE)
 	{
-		normal = texture(uTextureNormals, sTextCoord).rgb;
-		normal = normal * 2.0 - 1.0;   
+		// Only x/y are stored (BC5), z is rebuilt from the unit length
+		normal.xy = texture(uTextureNormals, texCoords).rg * 2.0 - 1.0;
+		normal.z = sqrt(max(1.0 - dot(normal.xy, normal.xy), 0.0));
 		normal = normalize(sTBN * normal);
 	}
 	
+	// A single fetch for both masks, the packing fills the missing one with these same defaults
 	float specularStrength = 0.8;
-	if (material.hasSpecularTexture)
-	{
-		specularStrength = texture(uTextureSpecular, sTextCoord).r;
-	}
-	
 	float bump = 0.0;
-	if (material.hasBumpTexture)
+	if (HAS_SPECULAR_TEXTURE || HAS_BUMP_TEXTURE)
 	{
-		bump = texture(uTextureBump, sTextCoord).r;
+		vec2 masks = texture(uTextureMasks, texCoords).rg;
+		bump = masks.r;
+		specularStrength = masks.g;
 	}
 
     rt0 = objectColor;
 	rt1 = vec4(sPosition, 1.0);
 	rt2 = vec4(normal, 1.0);
-	rt3 = vec4(specularStrength, specularStrength, specularStrength, 1.0);
+	rt3 = vec4((sClipPosition.xy / sClipPosition.w - sPrevClipPosition.xy / sPrevClipPosition.w) * 0.5, 0.0, 1.0); // In texture coordinates
 	rt4 = vec4(bump, bump, bump, 1.0);
 	rt5 = vec4(sTangent, 1.0);
+	rt6 = vec4(EncodeOctahedral(normal), EncodeOctahedral(sTangent));
+	rt7 = vec4(specularStrength, bump, 0.0, 1.0);
 
 }
\ No newline at end of file
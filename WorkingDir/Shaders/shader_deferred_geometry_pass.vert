@@ -47,6 +47,7 @@ layout(binding = 1, std140) uniform LocalParams
 	mat4 uWorldMatrix;
 	mat4 uWorldViewProjectionMatrix;
 	mat3 uNormalMatrix;
+	mat4 uPrevWorldViewProjectionMatrix; // Last frame's, with this frame's jitter
 };
 
 layout(binding = 2, std140) uniform MaterialParams
@@ -62,6 +63,13 @@ layout(location = 3) out vec3 vViewDir; // In worldspace
 layout(location = 4) out vec3 vTangent; 
 layout(location = 5) out mat3 vTBN; 
 
+// Same depth as the other geometry pass programs, see DepthPrepass
+invariant gl_Position;
+
+// Both clip positions, the fragment shader writes the motion vector from them
+layout(location = 9) out vec4 vClipPosition;
+layout(location = 10) out vec4 vPrevClipPosition;
+
 void main() {
     vTextCoord = aTextCoord;
 	vPosition = vec3(uWorldMatrix * vec4(aPosition, 1.0));
@@ -81,5 +89,7 @@ void main() {
 
 	vViewDir = uCameraPosition - vPosition;
 	gl_Position = uWorldViewProjectionMatrix * vec4(aPosition, 1.0);
+	vClipPosition = gl_Position;
+	vPrevClipPosition = uPrevWorldViewProjectionMatrix * vec4(aPosition, 1.0);
 	float a = material.albedo.x;
 }
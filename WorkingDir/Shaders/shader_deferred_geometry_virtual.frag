@@ -0,0 +1,204 @@
+#version 430
+
+layout(location = 0) in vec3 sPosition; // In worldspace
+layout(location = 1) in vec3 sNormal; // In worldspace
+layout(location = 2) in vec2 sTextCoord; 
+layout(location = 3) in vec3 sViewDir; // In worldspace
+layout(location = 4) in vec3 sTangent; 
+layout(location = 5) in mat3 sTBN;  
+layout(location = 9) in vec4 sClipPosition;
+layout(location = 10) in vec4 sPrevClipPosition;
+
+layout (binding = 0) uniform sampler2D uTextureDiffuse; // www.khronos.org/opengl/wiki/Uniform_(GLSL)
+layout (binding = 1) uniform sampler2D uTextureNormals; 
+layout (binding = 2) uniform sampler2D uTextureMasks; // r: bump height, g: specular mask
+
+// Virtual textures replace the regular ones per role (diffuse, normals, masks), see VirtualTexturingSupport
+layout (binding = 3) uniform usampler2D uIndirectionDiffuse; // Per page: physical x/y, resident level, atlas
+layout (binding = 4) uniform usampler2D uIndirectionNormals;
+layout (binding = 5) uniform usampler2D uIndirectionMasks;
+layout (binding = 6) uniform sampler2D uPhysicalPages[4]; // One atlas per block format
+layout (binding = 0, r32ui) uniform writeonly uimage2D uFeedback;
+
+uniform uvec3 uVirtualTextures; // 1 for the virtual roles
+uniform vec4 uVirtualInfo[3]; // xy: pages at level 0, z: level count
+uniform vec2 uVirtualSize; // Texels of the largest virtual texture of the material, 0 when it has none
+uniform uint uMaterialIdx;
+uniform uvec2 uFeedbackJitter; // Pixel of the 8x8 cell writing the feedback this frame
+uniform float uPhysicalAtlasSize;
+
+#define VT_PAGE_SIZE 128.0
+#define VT_PAGE_BORDER 4.0
+#define VT_PHYSICAL_PAGE_SIZE 136.0
+#define VT_FEEDBACK_SCALE 8
+
+// Only visible fragments write feedback
+layout(early_fragment_tests) in;
+
+struct Light					
+{
+	uint type;			
+	vec3 color;					
+	vec3 direction;				
+	vec3 position;			
+	float constant;
+    float linear;
+    float quadratic;
+	float radius;	
+};
+
+struct Material
+{
+	vec3 albedo;
+	vec3 emissive;
+	float smoothness;
+	bool hasAlbedoTexture;
+	bool hasEmissiveTexture;
+	bool hasSpecularTexture;
+	bool hasNormalsTexture;
+	bool hasBumpTexture;
+	float heightScale;
+};
+
+layout (binding = 0, std140) uniform GlobalParams
+{
+	vec3 uCameraPosition;   
+	mat4 uViewMatrix;
+	mat4 uProjectionMatrix;	
+	uint uLightCount; 	
+	Light uLight[16];     	
+};
+
+layout(binding = 1, std140) uniform LocalParams
+{
+	vec4 uColor;
+	mat4 uWorldMatrix;
+	mat4 uWorldViewProjectionMatrix;
+	mat3 uNormalMatrix;
+};
+
+layout(binding = 2, std140) uniform MaterialParams
+{
+	Material material;
+};
+
+// location in this context are the indices of the draw buffers array.
+layout(location = 0) out vec4 rt0; // Color -> drawBuffers[0] = GL_COLOR_ATTACHMENT#; where # = n  refers to a texture in a frame buffer
+layout(location = 1) out vec4 rt1; // Position world space
+layout(location = 2) out vec4 rt2; // Normals
+layout(location = 3) out vec4 rt3; // Motion vectors, the full layout writes its specular from rt7
+layout(location = 4) out vec4 rt4; // Bump
+layout(location = 5) out vec4 rt5; // Tangent
+layout(location = 6) out vec4 rt6; // Compact layout: octahedral normal (rg) and tangent (ba)
+layout(location = 7) out vec4 rt7; // Compact layout: specular (r) and bump (g)
+
+// Compact G-buffer: unit vectors folded onto an octahedron, two channels each
+vec2 OctWrap(vec2 v)
+{
+	return (1.0 - abs(v.yx)) * vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+}
+
+vec2 EncodeOctahedral(vec3 n)
+{
+	n /= max(abs(n.x) + abs(n.y) + abs(n.z), 1e-6);
+	n.xy = n.z >= 0.0 ? n.xy : OctWrap(n.xy);
+	return n.xy * 0.5 + 0.5;
+}
+
+float ComputeMipLevel(vec2 texels, vec2 dx, vec2 dy)
+{
+	return log2(max(length(dx * texels), length(dy * texels)));
+}
+
+vec4 SamplePhysicalPage(uint atlas, vec2 uv)
+{
+	// Sampler arrays need constant indices in GLSL 4.30
+	switch (atlas)
+	{
+		case 0u: return textureLod(uPhysicalPages[0], uv, 0.0);
+		case 1u: return textureLod(uPhysicalPages[1], uv, 0.0);
+		case 2u: return textureLod(uPhysicalPages[2], uv, 0.0);
+		case 3u: return textureLod(uPhysicalPages[3], uv, 0.0);
+	}
+	return vec4(0.0);
+}
+
+// The indirection entry of a missing page holds its closest resident ancestor, the lookup is redone at that level
+vec4 SampleVirtualTexture(usampler2D indirection, vec4 info, vec2 uv, vec2 dx, vec2 dy, vec4 fallback)
+{
+	vec2 wrappedUV = fract(uv);
+	float level = clamp(floor(ComputeMipLevel(info.xy * VT_PAGE_SIZE, dx, dy)), 0.0, info.z - 1.0);
+	vec2 pages = info.xy / exp2(level);
+	uvec4 entry = texelFetch(indirection, ivec2(min(wrappedUV * pages, pages - 1.0)), int(level));
+	if (entry.w == 255u)
+	{
+		return fallback;
+	}
+
+	vec2 residentPages = info.xy / exp2(float(entry.z));
+	vec2 pageUV = wrappedUV * residentPages;
+	vec2 inPage = pageUV - min(floor(pageUV), residentPages - 1.0);
+	vec2 physicalUV = (vec2(entry.xy) * VT_PHYSICAL_PAGE_SIZE + VT_PAGE_BORDER + inPage * VT_PAGE_SIZE) / uPhysicalAtlasSize;
+	return SamplePhysicalPage(entry.w, physicalUV);
+}
+
+void WriteFeedback(vec2 dx, vec2 dy)
+{
+	ivec2 pixel = ivec2(gl_FragCoord.xy);
+	if (uVirtualSize.x == 0.0 || any(notEqual(uvec2(pixel & (VT_FEEDBACK_SCALE - 1)), uFeedbackJitter)))
+	{
+		return;
+	}
+
+	// Page in the space of the largest texture of the material, the CPU maps it to the level of every role
+	vec2 pageCount = uVirtualSize / VT_PAGE_SIZE;
+	float level = clamp(floor(ComputeMipLevel(uVirtualSize, dx, dy)), 0.0, 15.0);
+	vec2 pages = max(pageCount / exp2(level), vec2(1.0));
+	uvec2 page = uvec2(min(fract(sTextCoord) * pages, pages - 1.0));
+	uint feedback = (uMaterialIdx << 20) | (uint(level) << 16) | (page.y << 8) | page.x;
+	imageStore(uFeedback, pixel / VT_FEEDBACK_SCALE, uvec4(feedback));
+}
+
+void main()
+{
+	vec2 dx = dFdx(sTextCoord);
+	vec2 dy = dFdy(sTextCoord);
+	WriteFeedback(dx, dy);
+
+	vec4 objectColor = vec4(material.albedo, 1.0);
+	if (material.hasAlbedoTexture)
+	{
+		objectColor = uVirtualTextures.x != 0u ? SampleVirtualTexture(uIndirectionDiffuse, uVirtualInfo[0], sTextCoord, dx, dy, objectColor)
+			: texture(uTextureDiffuse, sTextCoord);
+	}
+	
+	vec3 normal = normalize(sNormal);
+	if (material.hasNormalsTexture)
+	{
+		// Only x/y are stored (BC5), z is rebuilt from the unit length
+		normal.xy = (uVirtualTextures.y != 0u ? SampleVirtualTexture(uIndirectionNormals, uVirtualInfo[1], sTextCoord, dx, dy, vec4(0.5))
+			: texture(uTextureNormals, sTextCoord)).rg * 2.0 - 1.0;
+		normal.z = sqrt(max(1.0 - dot(normal.xy, normal.xy), 0.0));
+		normal = normalize(sTBN * normal);
+	}
+	
+	// A single fetch for both masks, the packing fills the missing one with these same defaults
+	float specularStrength = 0.8;
+	float bump = 0.0;
+	if (material.hasSpecularTexture || material.hasBumpTexture)
+	{
+		vec2 masks = (uVirtualTextures.z != 0u ? SampleVirtualTexture(uIndirectionMasks, uVirtualInfo[2], sTextCoord, dx, dy, vec4(0.0, 0.8, 0.0, 0.0))
+			: texture(uTextureMasks, sTextCoord)).rg;
+		bump = masks.r;
+		specularStrength = masks.g;
+	}
+
+    rt0 = objectColor;
+	rt1 = vec4(sPosition, 1.0);
+	rt2 = vec4(normal, 1.0);
+	rt3 = vec4((sClipPosition.xy / sClipPosition.w - sPrevClipPosition.xy / sPrevClipPosition.w) * 0.5, 0.0, 1.0); // In texture coordinates
+	rt4 = vec4(bump, bump, bump, 1.0);
+	rt5 = vec4(sTangent, 1.0);
+	rt6 = vec4(EncodeOctahedral(normal), EncodeOctahedral(sTangent));
+	rt7 = vec4(specularStrength, bump, 0.0, 1.0);
+}
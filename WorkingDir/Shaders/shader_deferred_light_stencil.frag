@@ -0,0 +1,6 @@
+#version 430
+
+// Stencil marking of the light volumes, only the depth tested faces matter, see LightVolumes
+void main()
+{
+}
@@ -0,0 +1,152 @@
+#version 430
+
+layout (binding = 0) uniform sampler2D uRTColor; 
+layout (binding = 1) uniform sampler2D uRTPosition; 
+layout (binding = 2) uniform sampler2D uRTNormals; 
+layout (binding = 3) uniform sampler2D uRTSpecularRoughness; 
+
+// Compact layout, the full layout targets above are not bound then
+uniform bool uCompactGBuffer;
+layout (binding = 8) uniform sampler2D uRTNormalTangent; // Octahedral normal (rg) and tangent (ba)
+layout (binding = 9) uniform sampler2D uRTMasks; // Specular (r) and bump (g)
+layout (binding = 10) uniform sampler2D uRTDepth; 
+uniform mat4 uInverseViewProjection;
+
+struct Light					
+{
+	uint type;			
+	vec3 color;					
+	vec3 direction;				
+	vec3 position;			
+	float constant;
+    float linear;
+    float quadratic;
+	float radius;	
+};
+
+layout (binding = 0, std140) uniform GlobalParams
+{
+	vec3 uCameraPosition;   
+	mat4 uViewMatrix;
+	mat4 uProjectionMatrix;	
+	uint uLightCount; 	
+	Light uLight[16];     	
+};
+
+// Light volumes, see LightVolumes. The volumes read the lights uploaded for the clustered lighting
+struct ClusterLight
+{
+	vec4 positionRadius; // w: attenuation radius
+	vec4 colorType; // w: 0 directional, 1 point
+	vec4 direction;
+	vec4 attenuation; // x: constant, y: linear, z: quadratic
+};
+
+layout(std430, binding = 1) readonly buffer ClusterLights
+{
+	uvec4 uClusterGrid; // w: light count
+	vec4 uClusterDepth; // Near, far, slice scale and slice bias
+	vec4 uClusterTileSize;
+	uvec4 uClusterLimits; // x: max lights per cluster, y: cluster count
+	ClusterLight uLights[];
+};
+
+uniform uint uLightIndex;
+
+layout(location = 0) out vec4 rt0; // Final result, blended additively over the shading pass
+
+// Compact G-buffer, see GBufferLayout::COMPACT
+vec3 DecodeOctahedral(vec2 e)
+{
+	e = e * 2.0 - 1.0;
+	vec3 n = vec3(e.x, e.y, 1.0 - abs(e.x) - abs(e.y));
+	float t = clamp(-n.z, 0.0, 1.0);
+	n.x += n.x >= 0.0 ? -t : t;
+	n.y += n.y >= 0.0 ? -t : t;
+	return normalize(n);
+}
+
+float FetchDepth(vec2 texCoords)
+{
+	ivec2 size = textureSize(uRTDepth, 0);
+	return texelFetch(uRTDepth, clamp(ivec2(texCoords * vec2(size)), ivec2(0), size - 1), 0).r;
+}
+
+vec3 SamplePosition(vec2 texCoords)
+{
+	if (uCompactGBuffer)
+	{
+		vec4 worldPosition = uInverseViewProjection * vec4(vec3(texCoords, FetchDepth(texCoords)) * 2.0 - 1.0, 1.0);
+		return worldPosition.xyz / worldPosition.w;
+	}
+	return texture(uRTPosition, texCoords).rgb;
+}
+
+vec3 SampleNormal(vec2 texCoords)
+{
+	return uCompactGBuffer ? DecodeOctahedral(texture(uRTNormalTangent, texCoords).rg) : texture(uRTNormals, texCoords).rgb;
+}
+
+float SampleSpecular(vec2 texCoords)
+{
+	return uCompactGBuffer ? texture(uRTMasks, texCoords).r : texture(uRTSpecularRoughness, texCoords).r;
+}
+
+vec3 ShadeLight(uint type, vec3 lightColor, vec3 lightDirection, vec3 lightPosition, float linear, float quadratic, float radius,
+	vec3 fragPos, vec3 normal, vec3 nViewDir, vec3 albedo, float specularStrength)
+{
+	float attenuation = 0.0f;
+	vec3 lightDir = vec3(0.0f, 0.0f, 0.0f);
+
+	if (type == 1)
+	{
+		float distance = length(lightPosition - fragPos);
+		if(distance > radius)
+		{
+			return vec3(0.0);
+		}
+
+		attenuation = 1.0 / (1.0 + linear * distance + quadratic * distance * distance);
+
+		lightDir = normalize(lightPosition - fragPos);
+	}
+	else
+	{
+		lightDir = normalize(lightDirection);
+	}
+	 // diffuse
+	float diff = max(dot(normal, lightDir), 0.0); // Clamp to 0.0
+	vec3 diffuse = diff * albedo * lightColor;
+	
+	// specular
+	vec3 halfwayDir = normalize(lightDir + nViewDir);  
+	float shininess = 32;
+	float spec = pow(max(dot(normal, halfwayDir), 0.0), shininess);
+	vec3 specular = spec * specularStrength * lightColor;
+	
+	if (type == 1)
+	{
+		// attenuation
+		diffuse *= attenuation;
+		specular *= attenuation;
+	}
+	return diffuse + specular;
+}
+
+void main()
+{
+	// The sphere covers the pixels to shade, the G-buffer is read at the pixel itself (no parallax offset)
+	vec2 texCoords = gl_FragCoord.xy / vec2(textureSize(uRTColor, 0));
+
+	vec3 normal = SampleNormal(texCoords);
+	vec3 fragPos = SamplePosition(texCoords);
+	vec3 albedo = texture(uRTColor, texCoords).rgb;
+	float specularStrength = SampleSpecular(texCoords);
+	vec3 nViewDir = normalize(uCameraPosition - fragPos);
+
+	ClusterLight light = uLights[uLightIndex];
+	vec3 result = ShadeLight(uint(light.colorType.w), light.colorType.rgb, light.direction.xyz, light.positionRadius.xyz,
+		light.attenuation.y, light.attenuation.z, light.positionRadius.w, fragPos, normal, nViewDir, albedo, specularStrength);
+
+	rt0 = vec4(result, 1.0);
+}
@@ -0,0 +1,51 @@
+#version 430
+
+layout(location = 0) in vec3 aPosition; // Unit sphere
+
+struct Light					
+{
+	uint type;			
+	vec3 color;					
+	vec3 direction;				
+	vec3 position;			
+	float constant;
+    float linear;
+    float quadratic;
+	float radius;	
+};
+
+layout (binding = 0, std140) uniform GlobalParams
+{
+	vec3 uCameraPosition;   
+	mat4 uViewMatrix;
+	mat4 uProjectionMatrix;	
+	uint uLightCount; 	
+	Light uLight[16];     	
+};
+
+// Light volumes, see LightVolumes. The volumes read the lights uploaded for the clustered lighting
+struct ClusterLight
+{
+	vec4 positionRadius; // w: attenuation radius
+	vec4 colorType; // w: 0 directional, 1 point
+	vec4 direction;
+	vec4 attenuation; // x: constant, y: linear, z: quadratic
+};
+
+layout(std430, binding = 1) readonly buffer ClusterLights
+{
+	uvec4 uClusterGrid; // w: light count
+	vec4 uClusterDepth; // Near, far, slice scale and slice bias
+	vec4 uClusterTileSize;
+	uvec4 uClusterLimits; // x: max lights per cluster, y: cluster count
+	ClusterLight uLights[];
+};
+
+uniform uint uLightIndex;
+uniform float uVolumeScale;
+
+void main() {
+	vec4 positionRadius = uLights[uLightIndex].positionRadius;
+	vec3 worldPosition = positionRadius.xyz + aPosition * positionRadius.w * uVolumeScale;
+    gl_Position = uProjectionMatrix * uViewMatrix * vec4(worldPosition, 1.0);
+}
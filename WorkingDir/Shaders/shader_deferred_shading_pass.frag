@@ -4,6 +4,7 @@ layout(location = 0) in vec3 sPosition; // In worldspace
 layout(location = 1) in vec3 sNormal; // In worldspace
 layout(location = 2) in vec2 sTextCoord; 
 layout(location = 3) in vec3 sViewDir; // In worldspace
+layout(location = 4) flat in mat4 sInverseViewProjection;
 
 layout (binding = 0) uniform sampler2D uRTColor; 
 layout (binding = 1) uniform sampler2D uRTPosition; 
@@ -13,6 +14,12 @@ layout (binding = 4) uniform sampler2D uRTSSAO;
 layout (binding = 5) uniform sampler2D uRTBump; 
 layout (binding = 6) uniform sampler2D uRTTangent; 
 
+// Compact layout, the full layout targets above are not bound then
+uniform bool uCompactGBuffer;
+layout (binding = 8) uniform sampler2D uRTNormalTangent; // Octahedral normal (rg) and tangent (ba)
+layout (binding = 9) uniform sampler2D uRTMasks; // Specular (r) and bump (g)
+layout (binding = 10) uniform sampler2D uRTDepth; 
+
 struct Light					
 {
 	uint type;			
@@ -59,6 +66,34 @@ layout(binding = 2, std140) uniform MaterialParams
 	Material material;
 };
 
+// Clustered lighting, see ClusteredLighting. Without it only the uLight array is shaded
+uniform bool uClusteredLighting;
+// Light volumes, see LightVolumes. The point lights are drawn as volumes after this pass
+uniform bool uDirectionalOnly;
+
+struct ClusterLight
+{
+	vec4 positionRadius; // w: attenuation radius
+	vec4 colorType; // w: 0 directional, 1 point
+	vec4 direction;
+	vec4 attenuation; // x: constant, y: linear, z: quadratic
+};
+
+layout(std430, binding = 1) readonly buffer ClusterLights
+{
+	uvec4 uClusterGrid; // w: light count
+	vec4 uClusterDepth; // Near, far, slice scale and slice bias
+	vec4 uClusterTileSize;
+	uvec4 uClusterLimits; // x: max lights per cluster, y: cluster count
+	ClusterLight uLights[];
+};
+
+// Light count of every cluster followed by uClusterLimits.x light indices per cluster
+layout(std430, binding = 3) readonly buffer ClusterLightGrid
+{
+	uint uClusterLightGrid[];
+};
+
 // location in this context are the indices of the draw buffers array.
 layout(location = 0) out vec4 rt0; // Color -> drawBuffers[0] = GL_COLOR_ATTACHMENT#; where # = n  refers to a texture in a frame buffer
 //layout(location = 1) out vec4 rt1; // Position
@@ -67,95 +102,107 @@ layout(location = 0) out vec4 rt0; // Color -> drawBuffers[0] = GL_COLOR_ATTACHM
 //layout(location = 4) out vec4 rt4; // Specular, roughness
 //layout(location = 5) out vec4 rt3; // Final result
 
-vec2 ParallaxMapping(vec2 texCoords, vec3 viewDir, out bool hasBump)
-{ 
-	if (texture(uRTBump, texCoords).r == 0)
-	{
-		hasBump = false;
-		return texCoords;
-	}
+// Compact G-buffer, see GBufferLayout::COMPACT
+vec3 DecodeOctahedral(vec2 e)
+{
+	e = e * 2.0 - 1.0;
+	vec3 n = vec3(e.x, e.y, 1.0 - abs(e.x) - abs(e.y));
+	float t = clamp(-n.z, 0.0, 1.0);
+	n.x += n.x >= 0.0 ? -t : t;
+	n.y += n.y >= 0.0 ? -t : t;
+	return normalize(n);
+}
 
-    float height = 1 - texture(uRTBump, texCoords).r;
-	hasBump = true;
-    return texCoords - viewDir.xy * (height * material.heightScale);        
+float FetchDepth(vec2 texCoords)
+{
+	ivec2 size = textureSize(uRTDepth, 0);
+	return texelFetch(uRTDepth, clamp(ivec2(texCoords * vec2(size)), ivec2(0), size - 1), 0).r;
 }
 
-vec2 ParallaxMapping2(vec2 texCoords, vec3 viewDir, out bool hasBump)
-{ 
-	if (texture(uRTBump, texCoords).r == 0)
+vec3 SamplePosition(vec2 texCoords)
+{
+	if (uCompactGBuffer)
 	{
-		hasBump = false;
-		return texCoords;
+		vec4 worldPosition = sInverseViewProjection * vec4(vec3(texCoords, FetchDepth(texCoords)) * 2.0 - 1.0, 1.0);
+		return worldPosition.xyz / worldPosition.w;
 	}
+	return texture(uRTPosition, texCoords).rgb;
+}
 
-	hasBump=true;
-	// number of depth layers
-    const float minLayers = 128;
-    const float maxLayers = 254;
-    float numLayers = mix(maxLayers, minLayers, abs(dot(vec3(0.0, 0.0, 1.0), viewDir)));  
-    // calculate the size of each layer
-    float layerDepth = 1.0 / numLayers;
-    // depth of current layer
-    float currentLayerDepth = 0.0;
-    // the amount to shift the texture coordinates per layer (from vector P)
-    vec2 P = viewDir.xy / viewDir.z * material.heightScale;  
-    vec2 deltaTexCoords = P / numLayers;
-  
-    // get initial values
-    vec2  currentTexCoords = texCoords;
-    float currentDepthMapValue = 1-texture(uRTBump, currentTexCoords).r;
-      
-    while(currentLayerDepth < currentDepthMapValue)
-    {
-        // shift texture coordinates along direction of P
-        currentTexCoords -= deltaTexCoords;
-        // get depthmap value at current texture coordinates
-        currentDepthMapValue = 1-texture(uRTBump, currentTexCoords).r;  
-        // get depth of next layer
-        currentLayerDepth += layerDepth;  
-    }
-    
-    // get texture coordinates before collision (reverse operations)
-    vec2 prevTexCoords = currentTexCoords + deltaTexCoords;
-
-    // get depth after and before collision for linear interpolation
-    float afterDepth  = currentDepthMapValue - currentLayerDepth;
-    float beforeDepth = 1-texture(uRTBump, prevTexCoords).r - currentLayerDepth + layerDepth;
- 
-    // interpolation of texture coordinates
-    float weight = afterDepth / (afterDepth - beforeDepth);
-    vec2 finalTexCoords = prevTexCoords * weight + currentTexCoords * (1.0 - weight);
-
-    return finalTexCoords;
+vec3 SampleNormal(vec2 texCoords)
+{
+	return uCompactGBuffer ? DecodeOctahedral(texture(uRTNormalTangent, texCoords).rg) : texture(uRTNormals, texCoords).rgb;
 }
 
-void main()
+float SampleSpecular(vec2 texCoords)
 {
-	vec3 normal = texture(uRTNormals, sTextCoord).rgb;
-	vec3 tangent = texture(uRTTangent, sTextCoord).rgb;
-	tangent = normalize(tangent - dot(tangent, normal) * normal);
-	vec3 bitangent = cross(normal, tangent);
-	mat3 TBN = transpose(mat3(bitangent, tangent, normal));
+	return uCompactGBuffer ? texture(uRTMasks, texCoords).r : texture(uRTSpecularRoughness, texCoords).r;
+}
 
-    vec3 fragPos = texture(uRTPosition, sTextCoord).rgb;
-	vec3 tangentFragPos = TBN * fragPos;
-	vec3 tangentViewPos = TBN * uCameraPosition;
-	vec3 tangentViewDir = normalize(tangentViewPos - tangentFragPos);
+uint GetClusterIdx(vec3 fragPos)
+{
+	float viewDepth = max(-(uViewMatrix * vec4(fragPos, 1.0)).z, uClusterDepth.x);
+	uint slice = uint(clamp(floor(log(viewDepth) * uClusterDepth.z + uClusterDepth.w), 0.0, float(uClusterGrid.z - 1)));
+	uvec2 tile = min(uvec2(gl_FragCoord.xy / uClusterTileSize.xy), uClusterGrid.xy - 1);
+	return tile.x + uClusterGrid.x * (tile.y + uClusterGrid.y * slice);
+}
 
-	vec3 nViewDir = normalize(uCameraPosition - fragPos);
+vec3 ShadeLight(uint type, vec3 lightColor, vec3 lightDirection, vec3 lightPosition, float linear, float quadratic, float radius,
+	vec3 fragPos, vec3 normal, vec3 nViewDir, vec3 albedo, float specularStrength)
+{
+	float attenuation = 0.0f;
+	vec3 lightDir = vec3(0.0f, 0.0f, 0.0f);
 
-	bool hasBump = false;
-    vec2 texCoords = ParallaxMapping2(sTextCoord, tangentViewDir, hasBump);
-	if (hasBump == true)
+	if (type == 1)
+	{
+		float distance = length(lightPosition - fragPos);
+		if(distance > radius)
+		{
+			return vec3(0.0);
+		}
+
+		attenuation = 1.0 / (1.0 + linear * distance + quadratic * distance * distance);
+
+		lightDir = normalize(lightPosition - fragPos);
+	}
+	else
 	{
-		if(texCoords.x > 1.0 || texCoords.y > 1.0 || texCoords.x < 0.0 || texCoords.y < 0.0)
-			discard;
+		lightDir = normalize(lightDirection);
 	}
+	 // diffuse
+	float diff = max(dot(normal, lightDir), 0.0); // Clamp to 0.0
+	vec3 diffuse = diff * albedo * lightColor;
+	
+	// specular
+	vec3 halfwayDir = normalize(lightDir + nViewDir);  
+	float shininess = 32;
+	float spec = pow(max(dot(normal, halfwayDir), 0.0), shininess);
+	vec3 specular = spec * specularStrength * lightColor;
+	
+	if (type == 1)
+	{
+		// attenuation
+		diffuse *= attenuation;
+		specular *= attenuation;
+	}
+	return diffuse + specular;
+}
 
-	normal = texture(uRTNormals, texCoords).rgb;
-	fragPos = texture(uRTPosition, texCoords).rgb;
+// Tile classification variants, see TileClassification. TILE_CLASSIFIED: drawn per tile, the pixels without geometry keep the clear color.
+// TILE_MAX_LIGHTS: upper bound of the cluster light count on the tile. The parallax is resolved by the geometry pass, see ConeStepMapSupport
+void main()
+{
+#ifdef TILE_CLASSIFIED
+	if (FetchDepth(sTextCoord) == 1.0)
+		discard;
+#endif
+
+	vec2 texCoords = sTextCoord;
+	vec3 normal = SampleNormal(texCoords);
+    vec3 fragPos = SamplePosition(texCoords);
+	vec3 nViewDir = normalize(uCameraPosition - fragPos);
     vec3 albedo = texture(uRTColor, texCoords).rgb;
-	float specularStrength = texture(uRTSpecularRoughness, texCoords).r;
+	float specularStrength = SampleSpecular(texCoords);
 	float ambientOcclusion = texture(uRTSSAO, texCoords).r;
 
 
@@ -163,51 +210,36 @@ void main()
     
     vec3 result = albedo * ambientStrength * ambientOcclusion; 
 	
-	for (int i = 0; i < uLightCount; ++i)
+	if (uClusteredLighting)
 	{
-		float attenuation = 0.0f;
-		vec3 lightDir = vec3(0.0f, 0.0f, 0.0f);
-
-		if (uLight[i].type == 1)
-		{
-			float distance = length(uLight[i].position - fragPos);
-			if(distance > uLight[i].radius)
-			{
-				continue;
-			}
-
-			attenuation = 1.0 / (1.0 + uLight[i].linear * distance + uLight[i].quadratic * distance * distance);
-
-			lightDir = normalize(uLight[i].position - fragPos);
-		}
-		else
+		// Only the lights binned into the cluster of this pixel
+		uint clusterIdx = GetClusterIdx(fragPos);
+		uint clusterLightCount = uClusterLightGrid[clusterIdx];
+		uint firstIndex = uClusterLimits.y + clusterIdx * uClusterLimits.x;
+#ifdef TILE_MAX_LIGHTS
+		// Constant trip count, the classification keeps the tile under it
+		for (uint i = 0; i < TILE_MAX_LIGHTS; ++i)
 		{
-			lightDir = normalize(uLight[i].direction);
-		}
-		 // diffuse
-		float diff = max(dot(normal, lightDir), 0.0); // Clamp to 0.0
-		vec3 diffuse = diff * albedo * uLight[i].color;
-		
-		// specular
-		vec3 halfwayDir = normalize(lightDir + nViewDir);  
-		float shininess = 32;
-		float spec = pow(max(dot(normal, halfwayDir), 0.0), shininess);
-		vec3 specular = spec * specularStrength * uLight[i].color;
-		
-		if (uLight[i].type == 1)
+			if (i >= clusterLightCount)
+				break;
+#else
+		for (uint i = 0; i < clusterLightCount; ++i)
 		{
-			// attenuation
-			diffuse *= attenuation;
-			specular *= attenuation;
-			
-			result += (diffuse + specular/*+ specular*/);
+#endif
+			ClusterLight light = uLights[uClusterLightGrid[firstIndex + i]];
+			result += ShadeLight(uint(light.colorType.w), light.colorType.rgb, light.direction.xyz, light.positionRadius.xyz,
+				light.attenuation.y, light.attenuation.z, light.positionRadius.w, fragPos, normal, nViewDir, albedo, specularStrength);
 		}
-		else
+	}
+	else
+	{
+		for (int i = 0; i < uLightCount; ++i)
 		{
-			result += (diffuse + specular);
+			if (uDirectionalOnly && uLight[i].type == 1)
+				continue;
+			result += ShadeLight(uLight[i].type, uLight[i].color, uLight[i].direction, uLight[i].position,
+				uLight[i].linear, uLight[i].quadratic, uLight[i].radius, fragPos, normal, nViewDir, albedo, specularStrength);
 		}
-		
-		
 	}
 	
 	rt0 = vec4(result, 1.0);
@@ -55,8 +55,10 @@ layout(location = 0) out vec3 vPosition;
 layout(location = 1) out vec3 vNormal; // In worldspace
 layout(location = 2) out vec2 vTextCoord; // In worldspace
 layout(location = 3) out vec3 vViewDir; // In worldspace
+layout(location = 4) flat out mat4 vInverseViewProjection; // Rebuilds the world position from depth in the compact G-buffer
 
 void main() {
 	vTextCoord = aTextCoord;
+	vInverseViewProjection = inverse(uProjectionMatrix * uViewMatrix);
     gl_Position = vec4(aPosition, 1.0);
 }
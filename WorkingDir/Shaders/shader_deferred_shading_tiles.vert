@@ -0,0 +1,59 @@
+#version 430
+
+struct Light					
+{
+	uint type;			
+	vec3 color;					
+	vec3 direction;				
+	vec3 position;			
+	float constant;
+    float linear;
+    float quadratic;
+	float radius;	
+};
+
+struct DrawCommand
+{
+	uint count;
+	uint instanceCount;
+	uint first;
+	uint baseInstance;
+};
+
+layout (binding = 0, std140) uniform GlobalParams
+{
+	vec3 uCameraPosition;   
+	mat4 uViewMatrix;
+	mat4 uProjectionMatrix;	
+	uint uLightCount; 	
+	Light uLight[16];     	
+};
+
+// See shader_shading_tile_classification.comp
+layout(std430, binding = 5) readonly buffer TileClasses
+{
+	uvec4 uTileGrid; // Tiles on x and y, z: tile count, w: max lights of the simple classes
+	uvec4 uTileScreenSize;
+	DrawCommand uTileCommands[3];
+	uint uTileList[];
+};
+
+// First entry of the tile list of the drawn class, gl_InstanceID does not include the base instance in GL 4.3
+uniform uint uTileListOffset;
+
+layout(location = 2) out vec2 vTextCoord;
+layout(location = 4) flat out mat4 vInverseViewProjection; // Rebuilds the world position from depth in the compact G-buffer
+
+// Two triangles per tile instance, same outputs as shader_deferred_shading_pass.vert
+const vec2 corners[6] = vec2[](vec2(0.0, 0.0), vec2(1.0, 0.0), vec2(1.0, 1.0), vec2(0.0, 0.0), vec2(1.0, 1.0), vec2(0.0, 1.0));
+
+void main() {
+	uint tileIdx = uTileList[uTileListOffset + uint(gl_InstanceID)];
+	vec2 tile = vec2(tileIdx % uTileGrid.x, tileIdx / uTileGrid.x);
+	vec2 tileSize = vec2(16.0); // TILE_CLASS_SIZE
+	vec2 pixel = min((tile + corners[gl_VertexID]) * tileSize, vec2(uTileScreenSize.xy));
+
+	vTextCoord = pixel / vec2(uTileScreenSize.xy);
+	vInverseViewProjection = inverse(uProjectionMatrix * uViewMatrix);
+	gl_Position = vec4(vTextCoord * 2.0 - 1.0, 0.0, 1.0);
+}
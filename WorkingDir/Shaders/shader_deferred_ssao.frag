@@ -5,11 +5,17 @@ layout(location = 1) in vec3 sNormal; // In worldspace
 layout(location = 2) in vec2 sTextCoord; 
 layout(location = 3) in vec3 sViewDir; // In worldspace
 layout(location = 4) in mat3 sTBN; 
+layout(location = 8) flat in mat4 sInverseProjection;
 
 layout (binding = 1) uniform sampler2D uRTPosition; 
 layout (binding = 2) uniform sampler2D uRTNormals; 
 layout (binding = 3) uniform sampler2D uSSAONoise; 
 
+// Compact layout, the full layout targets above are not bound then
+uniform bool uCompactGBuffer;
+layout (binding = 8) uniform sampler2D uRTNormalTangent; // Octahedral normal (rg) and tangent (ba)
+layout (binding = 10) uniform sampler2D uRTDepth; 
+
 struct Light					
 {
 	uint type;			
@@ -42,6 +48,7 @@ struct ScreenSpaceAmbientOcclusion
 	float radius;
 	float bias;
 	vec2 noiseScale;
+	float falloff;
 };
 
 layout (binding = 0, std140) uniform GlobalParams
@@ -74,11 +81,44 @@ layout(binding = 3, std140) uniform SSAOParams
 // location in this context are the indices of the draw buffers array.
 layout(location = 0) out vec4 rt0; // Color -> drawBuffers[0] = GL_COLOR_ATTACHMENT#; where # = n  refers to a texture in a frame buffer
 
+// Compact G-buffer, see GBufferLayout::COMPACT
+vec3 DecodeOctahedral(vec2 e)
+{
+	e = e * 2.0 - 1.0;
+	vec3 n = vec3(e.x, e.y, 1.0 - abs(e.x) - abs(e.y));
+	float t = clamp(-n.z, 0.0, 1.0);
+	n.x += n.x >= 0.0 ? -t : t;
+	n.y += n.y >= 0.0 ? -t : t;
+	return normalize(n);
+}
+
+float FetchDepth(vec2 texCoords)
+{
+	ivec2 size = textureSize(uRTDepth, 0);
+	return texelFetch(uRTDepth, clamp(ivec2(texCoords * vec2(size)), ivec2(0), size - 1), 0).r;
+}
+
+// uRTPosition is in worldspace, the compact layout goes straight from depth to view space
+vec3 SampleViewPosition(vec2 texCoords)
+{
+	if (uCompactGBuffer)
+	{
+		vec4 viewPosition = sInverseProjection * vec4(vec3(texCoords, FetchDepth(texCoords)) * 2.0 - 1.0, 1.0);
+		return viewPosition.xyz / viewPosition.w;
+	}
+	return vec3(uViewMatrix * vec4(texture(uRTPosition, texCoords).rgb, 1.0f));
+}
+
+vec3 SampleWorldNormal(vec2 texCoords)
+{
+	return uCompactGBuffer ? DecodeOctahedral(texture(uRTNormalTangent, texCoords).rg) : texture(uRTNormals, texCoords).rgb;
+}
+
 void main()
 {
 	// Setting inputs for SSAO
-	vec3 fragPos = vec3(uViewMatrix * vec4(texture(uRTPosition, sTextCoord).rgb, 1.0f)); // convert the fragPos to view pos because uRTPosition is in worldspace
-    vec3 normal = vec3(uViewMatrix * vec4(texture(uRTNormals, sTextCoord).rgb, 0.0f)); // convert the normal to view pos because uRTPosition is in worldspace
+	vec3 fragPos = SampleViewPosition(sTextCoord);
+    vec3 normal = vec3(uViewMatrix * vec4(SampleWorldNormal(sTextCoord), 0.0f)); // convert the normal to view pos because the G-buffer normals are in worldspace
 	vec3 randomVec = normalize(texture(uSSAONoise, sTextCoord * ssao.noiseScale).xyz);
 	
 	// create TBN change-of-basis matrix: from tangent-space to view-space
@@ -101,12 +141,12 @@ void main()
         offset.xyz /= offset.w; // perspective divide
         offset.xyz = offset.xyz * 0.5 + 0.5; // transform to range 0.0 - 1.0
         
-        // get sample depth, convert the sampleDepth to view pos because uRTPosition is in worldspace
-		vec3 sampleFragPos = vec3(uViewMatrix * vec4(texture(uRTPosition, offset.xy).xyz, 1.0)); 
+        // get sample depth in view space
+		vec3 sampleFragPos = SampleViewPosition(offset.xy); 
 
         float sampleDepth = sampleFragPos.z; // get depth value of kernel sample
         // range check & accumulate
-        float rangeCheck = smoothstep(0.0, 1.0, ssao.radius / abs(fragPos.z - sampleDepth));
+        float rangeCheck = pow(smoothstep(0.0, 1.0, ssao.radius / abs(fragPos.z - sampleDepth)), ssao.falloff);
         occlusion += (sampleDepth >= samplePos.z + ssao.bias ? 1.0 : 0.0) * rangeCheck;         
 		//occlusion += (sampleDepth >= samplePos.z + ssao.bias ? 1.0 : 0.0);  
 		
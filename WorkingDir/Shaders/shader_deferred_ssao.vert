@@ -5,6 +5,7 @@ layout(location = 1) in vec3 aNormal;
 layout(location = 2) in vec2 aTextCoord;
 
 layout(location = 2) out vec2 vTextCoord;
+layout(location = 8) flat out mat4 vInverseProjection; // Rebuilds the view space position from depth in the compact G-buffer
 
 struct Light					
 {
@@ -38,6 +39,7 @@ struct ScreenSpaceAmbientOcclusion
 	float radius;
 	float bias;
 	vec2 noiseScale;
+	float falloff;
 };
 
 layout (binding = 0, std140) uniform GlobalParams
@@ -69,5 +71,6 @@ layout(binding = 3, std140) uniform SSAOParams
 
 void main() {
 	vTextCoord = aTextCoord;
+	vInverseProjection = inverse(uProjectionMatrix);
     gl_Position = vec4(aPosition, 1.0);
 }
@@ -0,0 +1,6 @@
+#version 430
+
+// Depth only, the color writes are masked
+void main()
+{
+}
@@ -0,0 +1,19 @@
+#version 430
+
+// Position only, see DepthPrepass and ForwardPlusSupport::DepthPrepass
+layout(location = 0) in vec3 aPosition;
+
+layout(binding = 1, std140) uniform LocalParams
+{
+	vec4 uColor;
+	mat4 uWorldMatrix;
+	mat4 uWorldViewProjectionMatrix;
+	mat3 uNormalMatrix;
+};
+
+// Same depth as the other geometry pass programs, see DepthPrepass
+invariant gl_Position;
+
+void main() {
+	gl_Position = uWorldViewProjectionMatrix * vec4(aPosition, 1.0);
+}
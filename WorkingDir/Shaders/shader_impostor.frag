@@ -0,0 +1,88 @@
+#version 430
+
+layout(location = 0) in vec3 sLocalPosition;
+layout(location = 1) in vec2 sAtlasCoord;
+layout(location = 2) flat in vec3 sFrameDir;
+layout(location = 3) flat in vec3 sFrameRight;
+layout(location = 4) flat in mat3 sNormalMatrix;
+
+layout (binding = 0) uniform sampler2D uTextureDiffuse; // Albedo atlas
+layout (binding = 1) uniform sampler2D uTextureNormals; // Normal + depth atlas
+
+struct Light					
+{
+	uint type;			
+	vec3 color;					
+	vec3 direction;				
+	vec3 position;			
+	float constant;
+    float linear;
+    float quadratic;
+	float radius;	
+};
+
+layout (binding = 0, std140) uniform GlobalParams
+{
+	vec3 uCameraPosition;   
+	mat4 uViewMatrix;
+	mat4 uProjectionMatrix;	
+	uint uLightCount; 	
+	Light uLight[16];     	
+};
+
+uniform mat4 uImpostorWorldMatrix;
+uniform vec4 uImpostorCenterRadius;
+uniform mat4 uImpostorPrevWorldViewProjection; // Last frame's, with this frame's jitter
+
+// Same render targets as the deferred geometry pass
+layout(location = 0) out vec4 rt0; // Color
+layout(location = 1) out vec4 rt1; // Position world space
+layout(location = 2) out vec4 rt2; // Normals
+layout(location = 3) out vec4 rt3; // Motion vectors, the full layout writes its specular from rt7
+layout(location = 4) out vec4 rt4; // Bump
+layout(location = 5) out vec4 rt5; // Tangent
+layout(location = 6) out vec4 rt6; // Compact layout: octahedral normal (rg) and tangent (ba)
+layout(location = 7) out vec4 rt7; // Compact layout: specular (r) and bump (g)
+
+// Compact G-buffer: unit vectors folded onto an octahedron, two channels each
+vec2 OctWrap(vec2 v)
+{
+	return (1.0 - abs(v.yx)) * vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+}
+
+vec2 EncodeOctahedral(vec3 n)
+{
+	n /= max(abs(n.x) + abs(n.y) + abs(n.z), 1e-6);
+	n.xy = n.z >= 0.0 ? n.xy : OctWrap(n.xy);
+	return n.xy * 0.5 + 0.5;
+}
+
+void main()
+{
+	vec4 albedo = texture(uTextureDiffuse, sAtlasCoord);
+	if (albedo.a < 0.5)
+		discard;
+
+	vec4 normalDepth = textureLod(uTextureNormals, sAtlasCoord, 0.0);
+
+	// Push the quad point back to the baked surface, depth 0 is the front of the bounding sphere
+	float radius = uImpostorCenterRadius.w;
+	vec3 localPosition = sLocalPosition + sFrameDir * (radius - normalDepth.w * 2.0 * radius);
+	vec4 worldPosition = uImpostorWorldMatrix * vec4(localPosition, 1.0);
+
+	vec4 clipPosition = uProjectionMatrix * uViewMatrix * worldPosition;
+	gl_FragDepth = (clipPosition.z / clipPosition.w) * 0.5 + 0.5;
+
+	vec3 normal = normalize(sNormalMatrix * normalDepth.xyz);
+	vec3 tangent = normalize(mat3(uImpostorWorldMatrix) * sFrameRight);
+
+	rt0 = vec4(albedo.rgb, 1.0);
+	rt1 = vec4(worldPosition.xyz, 1.0);
+	rt2 = vec4(normal, 1.0);
+	vec4 prevClipPosition = uImpostorPrevWorldViewProjection * vec4(localPosition, 1.0);
+	rt3 = vec4((clipPosition.xy / clipPosition.w - prevClipPosition.xy / prevClipPosition.w) * 0.5, 0.0, 1.0); // In texture coordinates
+	rt4 = vec4(0.0, 0.0, 0.0, 1.0);
+	rt5 = vec4(tangent, 1.0);
+	rt6 = vec4(EncodeOctahedral(normal), EncodeOctahedral(tangent));
+	rt7 = vec4(0.5, 0.0, 0.0, 1.0);
+}
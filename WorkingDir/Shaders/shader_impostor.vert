@@ -0,0 +1,75 @@
+#version 430
+
+layout(location = 0) in vec3 aPosition; // Quad in [-1, 1]
+layout(location = 2) in vec2 aTextCoord;
+
+struct Light					
+{
+	uint type;			
+	vec3 color;					
+	vec3 direction;				
+	vec3 position;			
+	float constant;
+    float linear;
+    float quadratic;
+	float radius;	
+};
+
+layout (binding = 0, std140) uniform GlobalParams
+{
+	vec3 uCameraPosition;   
+	mat4 uViewMatrix;
+	mat4 uProjectionMatrix;	
+	uint uLightCount; 	
+	Light uLight[16];     	
+};
+
+uniform mat4 uImpostorWorldMatrix;
+uniform vec4 uImpostorCenterRadius; // Local space bounding sphere
+uniform float uImpostorFramesPerSide;
+
+layout(location = 0) out vec3 vLocalPosition; // Point of the quad in local space
+layout(location = 1) out vec2 vAtlasCoord;
+layout(location = 2) flat out vec3 vFrameDir; // Local space direction the frame was baked from
+layout(location = 3) flat out vec3 vFrameRight;
+layout(location = 4) flat out mat3 vNormalMatrix;
+
+// Hemi-octahedral mapping (y up), must match ImpostorSupport
+vec2 HemiOctahedronEncode(vec3 dir)
+{
+	dir.y = max(dir.y, 0.0);
+	dir /= (abs(dir.x) + abs(dir.y) + abs(dir.z));
+	return vec2(dir.x - dir.z, dir.x + dir.z) * 0.5 + 0.5;
+}
+
+vec3 HemiOctahedronDecode(vec2 uv)
+{
+	uv = uv * 2.0 - 1.0;
+	vec2 xz = vec2(uv.x + uv.y, uv.y - uv.x) * 0.5;
+	return normalize(vec3(xz.x, 1.0 - abs(xz.x) - abs(xz.y), xz.y));
+}
+
+void main()
+{
+	vec3 center = uImpostorCenterRadius.xyz;
+	float radius = uImpostorCenterRadius.w;
+	mat4 worldToLocal = inverse(uImpostorWorldMatrix);
+
+	// Closest baked frame to the current view direction
+	vec3 viewDir = normalize(vec3(worldToLocal * vec4(uCameraPosition, 1.0)) - center);
+	vec2 frame = clamp(floor(HemiOctahedronEncode(viewDir) * uImpostorFramesPerSide), vec2(0.0), vec2(uImpostorFramesPerSide - 1.0));
+	vec3 frameDir = HemiOctahedronDecode((frame + 0.5) / uImpostorFramesPerSide);
+
+	// Same basis glm::lookAt used on the bake
+	vec3 up = abs(frameDir.y) > 0.999 ? vec3(0.0, 0.0, 1.0) : vec3(0.0, 1.0, 0.0);
+	vec3 right = normalize(cross(-frameDir, up));
+	vec3 frameUp = cross(right, -frameDir);
+
+	vLocalPosition = center + (right * aPosition.x + frameUp * aPosition.y) * radius;
+	vAtlasCoord = (frame + aTextCoord) / uImpostorFramesPerSide;
+	vFrameDir = frameDir;
+	vFrameRight = right;
+	vNormalMatrix = transpose(inverse(mat3(uImpostorWorldMatrix)));
+
+	gl_Position = uProjectionMatrix * uViewMatrix * uImpostorWorldMatrix * vec4(vLocalPosition, 1.0);
+}
@@ -0,0 +1,25 @@
+#version 430
+
+layout(location = 0) in vec3 sNormal; // In local space
+layout(location = 1) in vec2 sTextCoord;
+
+layout (binding = 0) uniform sampler2D uTextureDiffuse;
+
+uniform vec3 uAlbedo;
+uniform bool uHasAlbedoTexture;
+
+layout(location = 0) out vec4 rt0; // Albedo, alpha marks the covered texels of the frame
+layout(location = 1) out vec4 rt1; // Local space normal, depth from the front of the bounding sphere in [0, 1]
+
+void main()
+{
+	vec3 albedo = uAlbedo;
+	if (uHasAlbedoTexture)
+	{
+		albedo = texture(uTextureDiffuse, sTextCoord).rgb;
+	}
+
+	// Orthographic projection, so window depth is already linear over the sphere diameter
+	rt0 = vec4(albedo, 1.0);
+	rt1 = vec4(normalize(sNormal), gl_FragCoord.z);
+}
@@ -0,0 +1,19 @@
+#version 430
+
+layout(location = 0) in vec3 aPosition;
+layout(location = 1) in vec3 aNormal;
+layout(location = 2) in vec2 aTextCoord;
+
+// Plain uniforms, the bake runs on Init before the uniform buffer is filled
+uniform mat4 uBakeView;
+uniform mat4 uBakeProjection;
+
+layout(location = 0) out vec3 vNormal; // In local space
+layout(location = 1) out vec2 vTextCoord;
+
+void main()
+{
+	vNormal = aNormal;
+	vTextCoord = aTextCoord;
+	gl_Position = uBakeProjection * uBakeView * vec4(aPosition, 1.0);
+}
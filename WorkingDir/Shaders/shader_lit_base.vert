@@ -59,6 +59,9 @@ layout(location = 1) out vec3 vNormal; // In worldspace
 layout(location = 2) out vec2 vTextCoord; // In worldspace
 layout(location = 5) out vec3 vViewDir; // In worldspace
 
+// Same depth as the Forward+ depth prepass, the draws test it with GL_LEQUAL, see DepthPrepass
+invariant gl_Position;
+
 void main() {
     vTextCoord = aTextCoord;
 	vPosition = vec3(uWorldMatrix * vec4(aPosition, 1.0));
@@ -8,7 +8,7 @@ layout(location = 4) in mat3 sTBN;
 
 layout (binding = 0) uniform sampler2D uTextureDiffuse; // www.khronos.org/opengl/wiki/Uniform_(GLSL)
 layout (binding = 1) uniform sampler2D uTextureBump; 
-layout (binding = 2) uniform sampler2D uTextureSpecular; 
+layout (binding = 2) uniform sampler2D uTextureMasks; // r: bump height, g: specular mask
 
 struct Light					
 {
@@ -56,90 +56,139 @@ layout(binding = 2, std140) uniform MaterialParams
 	Material material;
 };
 
+// Material features, constants in the variants compiled by ShaderPermutationSupport and the UBO flags otherwise
+#ifndef SHADER_PERMUTATION
+#define HAS_ALBEDO_TEXTURE material.hasAlbedoTexture
+#define HAS_SPECULAR_TEXTURE material.hasSpecularTexture
+#define HAS_BUMP_TEXTURE material.hasBumpTexture
+#endif
+
+// Forward+, see ForwardPlus. Without it only the uLight array is shaded
+uniform bool uForwardPlus;
+
+struct ClusterLight
+{
+	vec4 positionRadius; // w: attenuation radius
+	vec4 colorType; // w: 0 directional, 1 point
+	vec4 direction;
+	vec4 attenuation; // x: constant, y: linear, z: quadratic
+};
+
+layout(std430, binding = 1) readonly buffer ClusterLights
+{
+	uvec4 uClusterGrid; // w: light count
+	vec4 uClusterDepth; // Near, far, slice scale and slice bias
+	vec4 uClusterTileSize;
+	uvec4 uClusterLimits; // x: max lights per cluster, y: cluster count
+	ClusterLight uLights[];
+};
+
+// Light count of every tile followed by uTiles.z light indices per tile
+layout(std430, binding = 4) readonly buffer TileLights
+{
+	uvec4 uTiles; // Tiles on x and y, z: max lights per tile, w: tile count
+	uint uTileLightGrid[];
+};
+
 layout(location = 0) out vec4 oColor;
 
+vec3 ShadeLight(uint type, vec3 lightColor, vec3 lightDirection, vec3 lightPosition, float linear, float quadratic, float radius,
+	vec3 normal, vec3 nViewDir, vec3 objectColor, float specularStrength)
+{
+	float attenuation = 0.0f;
+	vec3 lightDir = vec3(0.0f, 0.0f, 0.0f);
+
+	if (type == 1)
+	{
+		float distance = length(lightPosition - sPosition);
+		if(distance > radius)
+		{
+			return vec3(0.0);
+		}
+
+		attenuation = 1.0 / (1.0 + linear * distance + quadratic * distance * distance);
+
+		lightDir = normalize(lightPosition - sPosition);
+	}
+	else
+	{
+		lightDir = normalize(lightDirection);
+	}
+	
+	// To calculate PHONG = Ambient + Diffuse + Specular
+	// Calculate Ambient
+	float ambientStrength = 0.01;
+	vec3 ambient = ambientStrength * objectColor;
+	
+	// Calculate Diffuse lightning
+	float diff = max(dot(normal, lightDir), 0.0); // Clamp to 0.0
+	vec3 diffuse = diff * objectColor * lightColor;
+	
+	// Calculate Specular lightning
+	// Negate the lightDir vector. The reflect function expects the first vector to point from the light source towards the fragment's position
+	vec3 reflectDir = reflect(-lightDir, normal);  
+	// 32 value is the shininess value of the highlight. The higher the shininess value of an object, 
+	// the more it properly reflects the light instead of scattering it all around and thus the smaller the highlight becomes. 
+	float shininess = 32;
+	float spec = pow(max(dot(nViewDir, reflectDir), 0.0), shininess);
+	vec3 specular = specularStrength * spec * lightColor; 
+	
+	if (type == 1)
+	{
+		// attenuation
+		diffuse *= attenuation;
+		specular *= attenuation;
+	}
+	return ambient + diffuse + specular;
+}
+
 void main()
 {
-	vec3 result;
+	vec3 result = vec3(0.0);
 	
 	vec3 objectColor = material.albedo;
-	if (material.hasAlbedoTexture)
+	if (HAS_ALBEDO_TEXTURE)
 	{
 		objectColor = texture(uTextureDiffuse, sTextCoord).xyz;
 	}
 	
 	vec3 normal = sNormal;
-	if (material.hasBumpTexture)
+	if (HAS_BUMP_TEXTURE)
 	{
-		normal = texture(uTextureBump, sTextCoord).rgb;
-		normal = normal * 2.0 - 1.0;   
+		// Only x/y are stored (BC5), z is rebuilt from the unit length
+		normal.xy = texture(uTextureBump, sTextCoord).rg * 2.0 - 1.0;
+		normal.z = sqrt(max(1.0 - dot(normal.xy, normal.xy), 0.0));
 		normal = normalize(sTBN * normal);
 	}
 	
 	float specularStrength = 0.8;
-	if (material.hasSpecularTexture)
+	if (HAS_SPECULAR_TEXTURE)
 	{
-		specularStrength = texture(uTextureSpecular, sTextCoord).r;
+		specularStrength = texture(uTextureMasks, sTextCoord).g;
 	}
 	
-	// Get the first directional light. Not accounting for multiple directional lights for now.
-	for (int i = 0; i < uLightCount; ++i)
+	vec3 nViewDir = normalize(sViewDir);
+	if (uForwardPlus)
 	{
-		float attenuation = 0.0f;
-		vec3 lightDir = vec3(0.0f, 0.0f, 0.0f);
-
-		if (uLight[i].type == 1)
-		{
-			float distance = length(uLight[i].position - sPosition);
-			if(distance > uLight[i].radius)
-			{
-				continue;
-			}
-
-			attenuation = 1.0 / (1.0 + uLight[i].linear * distance + uLight[i].quadratic * distance * distance);
-
-			lightDir = normalize(uLight[i].position - sPosition);
-		}
-		else
+		// Only the lights listed for the tile of this pixel
+		uvec2 tile = uvec2(gl_FragCoord.xy) / 16u; // FORWARD_PLUS_TILE_SIZE
+		uint tileIdx = tile.x + tile.y * uTiles.x;
+		uint tileLightCount = uTileLightGrid[tileIdx];
+		uint firstIndex = uTiles.w + tileIdx * uTiles.z;
+		for (uint i = 0; i < tileLightCount; ++i)
 		{
-			lightDir = normalize(uLight[i].direction);
+			ClusterLight light = uLights[uTileLightGrid[firstIndex + i]];
+			result += ShadeLight(uint(light.colorType.w), light.colorType.rgb, light.direction.xyz, light.positionRadius.xyz,
+				light.attenuation.y, light.attenuation.z, light.positionRadius.w, normal, nViewDir, objectColor, specularStrength);
 		}
-		
-		// To calculate PHONG = Ambient + Diffuse + Specular
-		// Calculate Ambient
-		float ambientStrength = 0.01;
-		vec3 ambient = ambientStrength * objectColor;
-		
-		// Calculate Diffuse lightning
-	
-		float diff = max(dot(normal, lightDir), 0.0); // Clamp to 0.0
-		vec3 diffuse = diff * objectColor* uLight[i].color;
-		
-		// Calculate Specular lightning
-		
-		vec3 nViewDir = normalize(sViewDir);
-		// Negate the lightDir vector. The reflect function expects the first vector to point from the light source towards the fragment's position
-		vec3 reflectDir = reflect(-lightDir, normal);  
-		// 32 value is the shininess value of the highlight. The higher the shininess value of an object, 
-		// the more it properly reflects the light instead of scattering it all around and thus the smaller the highlight becomes. 
-		float shininess = 32;
-		float spec = pow(max(dot(nViewDir, reflectDir), 0.0), shininess);
-		vec3 specular = specularStrength * spec * uLight[i].color; 
-		
-		if (uLight[i].type == 1)
-		{
-			// attenuation
-			diffuse *= attenuation;
-			specular *= attenuation;
-			
-			result += (ambient + diffuse + specular);
-		}
-		else
+	}
+	else
+	{
+		for (int i = 0; i < uLightCount; ++i)
 		{
-			result += (ambient + diffuse + specular);
+			result += ShadeLight(uLight[i].type, uLight[i].color, uLight[i].direction, uLight[i].position,
+				uLight[i].linear, uLight[i].quadratic, uLight[i].radius, normal, nViewDir, objectColor, specularStrength);
 		}
-		
-		
 	}
 	
     oColor = vec4(result, 1);
@@ -59,6 +59,9 @@ layout(location = 2) out vec2 vTextCoord; // In world space
 layout(location = 3) out vec3 vViewDir; // In world space
 layout(location = 4) out mat3 vTBN; 
 
+// Same depth as the Forward+ depth prepass, the draws test it with GL_LEQUAL, see DepthPrepass
+invariant gl_Position;
+
 void main() {
     vTextCoord = aTextCoord;
 	vPosition = vec3(uWorldMatrix * vec4(aPosition, 1.0));
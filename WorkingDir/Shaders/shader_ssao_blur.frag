@@ -0,0 +1,45 @@
+#version 430
+
+// One axis of the separable bilateral blur, taps across a depth or normal discontinuity are dropped so the occlusion does not bleed over silhouettes
+
+layout (binding = 4) uniform sampler2D uSource; 
+layout (binding = 5) uniform sampler2D uLowResDepth; // Linear view depth
+layout (binding = 6) uniform sampler2D uLowResNormal; // View space normal, [0, 1] encoded
+
+uniform ivec2 uDirection;
+uniform float uDepthSharpness;
+
+layout(location = 0) out vec4 rt0; // Occlusion
+
+#define BLUR_RADIUS 4 // SSAO_BLUR_RADIUS
+
+// Gaussian, sigma of 2 texels
+const float gaussianWeights[BLUR_RADIUS + 1] = float[](0.2042, 0.1802, 0.1238, 0.0663, 0.0276);
+
+void main()
+{
+	ivec2 size = textureSize(uSource, 0);
+	ivec2 center = ivec2(gl_FragCoord.xy);
+	float centerDepth = texelFetch(uLowResDepth, center, 0).r;
+	vec3 centerNormal = texelFetch(uLowResNormal, center, 0).xyz * 2.0 - 1.0;
+
+	float occlusion = 0.0;
+	float totalWeight = 0.0;
+	for (int i = -BLUR_RADIUS; i <= BLUR_RADIUS; ++i)
+	{
+		ivec2 tap = clamp(center + uDirection * i, ivec2(0), size - 1);
+		float tapDepth = texelFetch(uLowResDepth, tap, 0).r;
+		vec3 tapNormal = texelFetch(uLowResNormal, tap, 0).xyz * 2.0 - 1.0;
+
+		float depthWeight = exp(-abs(tapDepth - centerDepth) / max(centerDepth, 1e-4) * uDepthSharpness);
+		float normalWeight = pow(max(dot(tapNormal, centerNormal), 0.0), 8.0);
+		float weight = gaussianWeights[abs(i)] * depthWeight * normalWeight;
+
+		occlusion += texelFetch(uSource, tap, 0).r * weight;
+		totalWeight += weight;
+	}
+
+	// The center tap always has full depth and normal weight
+	occlusion /= totalWeight;
+	rt0 = vec4(occlusion, occlusion, occlusion, 1.0);
+}
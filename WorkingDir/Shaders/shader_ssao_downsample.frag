@@ -0,0 +1,94 @@
+#version 430
+
+// Reduced resolution inputs of the SSAO tiers below FULL, see SSAOSupport::RenderLowResolution
+
+layout(location = 2) in vec2 sTextCoord; 
+layout(location = 8) flat in mat4 sInverseProjection;
+
+layout (binding = 1) uniform sampler2D uRTPosition; 
+layout (binding = 2) uniform sampler2D uRTNormals; 
+
+// Compact layout, the full layout targets above are not bound then
+uniform bool uCompactGBuffer;
+layout (binding = 8) uniform sampler2D uRTNormalTangent; // Octahedral normal (rg) and tangent (ba)
+layout (binding = 10) uniform sampler2D uRTDepth; 
+
+uniform int uResolutionDivisor; // Full resolution pixels per low resolution pixel on each axis
+
+struct Light					
+{
+	uint type;			
+	vec3 color;					
+	vec3 direction;				
+	vec3 position;			
+	float constant;
+    float linear;
+    float quadratic;
+	float radius;	
+};
+
+struct ScreenSpaceAmbientOcclusion
+{
+	vec3 samples[64];
+	uint kernelSize;
+	float radius;
+	float bias;
+	vec2 noiseScale;
+	float falloff;
+};
+
+layout (binding = 0, std140) uniform GlobalParams
+{
+	vec3 uCameraPosition;   
+	mat4 uViewMatrix;
+	mat4 uProjectionMatrix;	
+	uint uLightCount; 	
+	Light uLight[16];     	
+};
+
+layout(binding = 3, std140) uniform SSAOParams
+{
+	ScreenSpaceAmbientOcclusion ssao;
+};
+
+layout(location = 0) out vec4 rt0; // Linear view depth
+layout(location = 1) out vec4 rt1; // View space normal
+
+// Compact G-buffer, see GBufferLayout::COMPACT
+vec3 DecodeOctahedral(vec2 e)
+{
+	e = e * 2.0 - 1.0;
+	vec3 n = vec3(e.x, e.y, 1.0 - abs(e.x) - abs(e.y));
+	float t = clamp(-n.z, 0.0, 1.0);
+	n.x += n.x >= 0.0 ? -t : t;
+	n.y += n.y >= 0.0 ? -t : t;
+	return normalize(n);
+}
+
+// Full resolution pixel of the G-buffer, uRTPosition is in worldspace and the compact layout goes straight from depth to view space
+vec3 FetchViewPosition(ivec2 pixel)
+{
+	if (uCompactGBuffer)
+	{
+		vec2 texCoords = (vec2(pixel) + 0.5) / vec2(textureSize(uRTDepth, 0));
+		vec4 viewPosition = sInverseProjection * vec4(vec3(texCoords, texelFetch(uRTDepth, pixel, 0).r) * 2.0 - 1.0, 1.0);
+		return viewPosition.xyz / viewPosition.w;
+	}
+	return vec3(uViewMatrix * vec4(texelFetch(uRTPosition, pixel, 0).rgb, 1.0f));
+}
+
+vec3 FetchViewNormal(ivec2 pixel)
+{
+	vec3 worldNormal = uCompactGBuffer ? DecodeOctahedral(texelFetch(uRTNormalTangent, pixel, 0).rg) : texelFetch(uRTNormals, pixel, 0).rgb;
+	return normalize(vec3(uViewMatrix * vec4(worldNormal, 0.0f)));
+}
+
+void main()
+{
+	// Point sampled, averaging depths across an edge would invent surfaces that are in neither side
+	ivec2 fullResSize = uCompactGBuffer ? textureSize(uRTDepth, 0) : textureSize(uRTPosition, 0);
+	ivec2 pixel = min(ivec2(gl_FragCoord.xy) * uResolutionDivisor + uResolutionDivisor / 2, fullResSize - 1);
+
+	rt0 = vec4(-FetchViewPosition(pixel).z, 0.0, 0.0, 1.0);
+	rt1 = vec4(FetchViewNormal(pixel) * 0.5 + 0.5, 1.0);
+}
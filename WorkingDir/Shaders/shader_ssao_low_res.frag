@@ -0,0 +1,82 @@
+#version 430
+
+layout(location = 2) in vec2 sTextCoord; 
+
+layout (binding = 3) uniform sampler2D uSSAONoise; 
+layout (binding = 5) uniform sampler2D uLowResDepth; // Linear view depth
+layout (binding = 6) uniform sampler2D uLowResNormal; // View space normal, [0, 1] encoded
+
+struct Light					
+{
+	uint type;			
+	vec3 color;					
+	vec3 direction;				
+	vec3 position;			
+	float constant;
+    float linear;
+    float quadratic;
+	float radius;	
+};
+
+struct ScreenSpaceAmbientOcclusion
+{
+	vec3 samples[64];
+	uint kernelSize;
+	float radius;
+	float bias;
+	vec2 noiseScale;
+	float falloff;
+};
+
+layout (binding = 0, std140) uniform GlobalParams
+{
+	vec3 uCameraPosition;   
+	mat4 uViewMatrix;
+	mat4 uProjectionMatrix;	
+	uint uLightCount; 	
+	Light uLight[16];     	
+};
+
+layout(binding = 3, std140) uniform SSAOParams
+{
+	ScreenSpaceAmbientOcclusion ssao;
+};
+
+layout(location = 0) out vec4 rt0; // Occlusion
+
+// Symmetric perspective, the view position is on the ray through the texel at the stored depth
+vec3 ViewPositionFromDepth(vec2 texCoords, float linearDepth)
+{
+	vec2 ndc = texCoords * 2.0 - 1.0;
+	return vec3(ndc.x * linearDepth / uProjectionMatrix[0][0], ndc.y * linearDepth / uProjectionMatrix[1][1], -linearDepth);
+}
+
+void main()
+{
+	vec3 fragPos = ViewPositionFromDepth(sTextCoord, texture(uLowResDepth, sTextCoord).r);
+	vec3 normal = normalize(texture(uLowResNormal, sTextCoord).xyz * 2.0 - 1.0);
+
+	// The 4x4 rotation pattern repeats per low resolution pixel, the blur spans it
+	vec3 randomVec = normalize(texelFetch(uSSAONoise, ivec2(gl_FragCoord.xy) & 3, 0).xyz);
+
+	// create TBN change-of-basis matrix: from tangent-space to view-space
+	vec3 tangent = normalize(randomVec - normal * dot(randomVec, normal));
+	vec3 bitangent = cross(normal, tangent);
+	mat3 TBN = mat3(tangent, bitangent, normal);
+
+	float occlusion = 0.0;
+	for (int i = 0; i < ssao.kernelSize; ++i)
+	{
+		vec3 samplePos = fragPos + (TBN * ssao.samples[i]) * ssao.radius;
+
+		vec4 offset = uProjectionMatrix * vec4(samplePos, 1.0);
+		offset.xy = (offset.xy / offset.w) * 0.5 + 0.5;
+
+		float sampleDepth = -texture(uLowResDepth, offset.xy).r;
+		float rangeCheck = pow(smoothstep(0.0, 1.0, ssao.radius / abs(fragPos.z - sampleDepth)), ssao.falloff);
+		occlusion += (sampleDepth >= samplePos.z + ssao.bias ? 1.0 : 0.0) * rangeCheck;
+	}
+	occlusion = 1.0 - (occlusion / ssao.kernelSize);
+
+	rt0 = vec4(occlusion, occlusion, occlusion, 1.0);
+}
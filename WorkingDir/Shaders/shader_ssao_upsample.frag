@@ -0,0 +1,132 @@
+#version 430
+
+// Joint bilateral upsample: the bilinear weights of the four closest low resolution texels, scaled by how well their depth and normal match this pixel
+
+layout(location = 2) in vec2 sTextCoord; 
+layout(location = 8) flat in mat4 sInverseProjection;
+
+layout (binding = 1) uniform sampler2D uRTPosition; 
+layout (binding = 2) uniform sampler2D uRTNormals; 
+
+// Compact layout, the full layout targets above are not bound then
+uniform bool uCompactGBuffer;
+layout (binding = 8) uniform sampler2D uRTNormalTangent; // Octahedral normal (rg) and tangent (ba)
+layout (binding = 10) uniform sampler2D uRTDepth; 
+
+layout (binding = 4) uniform sampler2D uLowResOcclusion; 
+layout (binding = 5) uniform sampler2D uLowResDepth; // Linear view depth
+layout (binding = 6) uniform sampler2D uLowResNormal; // View space normal, [0, 1] encoded
+
+uniform int uResolutionDivisor;
+uniform float uDepthSharpness;
+
+struct Light					
+{
+	uint type;			
+	vec3 color;					
+	vec3 direction;				
+	vec3 position;			
+	float constant;
+    float linear;
+    float quadratic;
+	float radius;	
+};
+
+struct ScreenSpaceAmbientOcclusion
+{
+	vec3 samples[64];
+	uint kernelSize;
+	float radius;
+	float bias;
+	vec2 noiseScale;
+	float falloff;
+};
+
+layout (binding = 0, std140) uniform GlobalParams
+{
+	vec3 uCameraPosition;   
+	mat4 uViewMatrix;
+	mat4 uProjectionMatrix;	
+	uint uLightCount; 	
+	Light uLight[16];     	
+};
+
+layout(binding = 3, std140) uniform SSAOParams
+{
+	ScreenSpaceAmbientOcclusion ssao;
+};
+
+layout(location = 0) out vec4 rt0; // Occlusion
+
+// Compact G-buffer, see GBufferLayout::COMPACT
+vec3 DecodeOctahedral(vec2 e)
+{
+	e = e * 2.0 - 1.0;
+	vec3 n = vec3(e.x, e.y, 1.0 - abs(e.x) - abs(e.y));
+	float t = clamp(-n.z, 0.0, 1.0);
+	n.x += n.x >= 0.0 ? -t : t;
+	n.y += n.y >= 0.0 ? -t : t;
+	return normalize(n);
+}
+
+// Full resolution pixel of the G-buffer, uRTPosition is in worldspace and the compact layout goes straight from depth to view space
+vec3 FetchViewPosition(ivec2 pixel)
+{
+	if (uCompactGBuffer)
+	{
+		vec2 texCoords = (vec2(pixel) + 0.5) / vec2(textureSize(uRTDepth, 0));
+		vec4 viewPosition = sInverseProjection * vec4(vec3(texCoords, texelFetch(uRTDepth, pixel, 0).r) * 2.0 - 1.0, 1.0);
+		return viewPosition.xyz / viewPosition.w;
+	}
+	return vec3(uViewMatrix * vec4(texelFetch(uRTPosition, pixel, 0).rgb, 1.0f));
+}
+
+vec3 FetchViewNormal(ivec2 pixel)
+{
+	vec3 worldNormal = uCompactGBuffer ? DecodeOctahedral(texelFetch(uRTNormalTangent, pixel, 0).rg) : texelFetch(uRTNormals, pixel, 0).rgb;
+	return normalize(vec3(uViewMatrix * vec4(worldNormal, 0.0f)));
+}
+
+void main()
+{
+	ivec2 pixel = ivec2(gl_FragCoord.xy);
+	float depth = -FetchViewPosition(pixel).z;
+	vec3 normal = FetchViewNormal(pixel);
+
+	// Low resolution texel centers around this pixel, see shader_ssao_downsample.frag for the sampled positions
+	ivec2 lowResSize = textureSize(uLowResOcclusion, 0);
+	vec2 lowResCoord = (vec2(pixel) + 0.5) / float(uResolutionDivisor) - 0.5;
+	ivec2 base = ivec2(floor(lowResCoord));
+	vec2 f = lowResCoord - vec2(base);
+
+	float occlusion = 0.0;
+	float totalWeight = 0.0;
+	float closestDepthDelta = 1e30;
+	float closestOcclusion = 1.0;
+	for (int i = 0; i < 4; ++i)
+	{
+		ivec2 offset = ivec2(i & 1, i >> 1);
+		ivec2 tap = clamp(base + offset, ivec2(0), lowResSize - 1);
+		float tapDepth = texelFetch(uLowResDepth, tap, 0).r;
+		vec3 tapNormal = texelFetch(uLowResNormal, tap, 0).xyz * 2.0 - 1.0;
+		float tapOcclusion = texelFetch(uLowResOcclusion, tap, 0).r;
+
+		vec2 bilinear = mix(1.0 - f, f, vec2(offset));
+		float depthDelta = abs(tapDepth - depth);
+		float depthWeight = exp(-depthDelta / max(depth, 1e-4) * uDepthSharpness);
+		float normalWeight = pow(max(dot(tapNormal, normal), 0.0), 8.0);
+		float weight = bilinear.x * bilinear.y * depthWeight * normalWeight;
+
+		occlusion += tapOcclusion * weight;
+		totalWeight += weight;
+		if (depthDelta < closestDepthDelta)
+		{
+			closestDepthDelta = depthDelta;
+			closestOcclusion = tapOcclusion;
+		}
+	}
+
+	// Thin features missed by every tap take the closest one in depth instead of a blend from another surface
+	occlusion = totalWeight > 1e-3 ? occlusion / totalWeight : closestOcclusion;
+	rt0 = vec4(occlusion, occlusion, occlusion, 1.0);
+}
@@ -0,0 +1,56 @@
+#version 430
+
+// Temporal anti-aliasing resolve, see TemporalReprojection
+
+layout(location = 2) in vec2 sTextCoord; 
+
+layout (binding = 0) uniform sampler2D uCurrent; // Shaded with this frame's jitter
+layout (binding = 1) uniform sampler2D uHistory; // Resolved last frame
+layout (binding = 2) uniform sampler2D uMotionVectors; // In texture coordinates, current minus previous
+layout (binding = 10) uniform sampler2D uRTDepth; 
+
+uniform bool uHistoryValid;
+uniform float uHistoryWeight;
+
+layout(location = 0) out vec4 rt0;
+
+void main()
+{
+	ivec2 size = textureSize(uCurrent, 0);
+	ivec2 pixel = ivec2(gl_FragCoord.xy);
+	vec3 current = texelFetch(uCurrent, pixel, 0).rgb;
+
+	// The history is clamped to the colors around the pixel, what it holds that is not there anymore (disocclusions,
+	// shading changes) is rejected. The motion is the one of the closest neighbor, so edges move with the foreground
+	vec3 neighborhoodMin = current;
+	vec3 neighborhoodMax = current;
+	float closestDepth = texelFetch(uRTDepth, pixel, 0).r;
+	ivec2 closestPixel = pixel;
+	for (int y = -1; y <= 1; ++y)
+	{
+		for (int x = -1; x <= 1; ++x)
+		{
+			ivec2 tap = clamp(pixel + ivec2(x, y), ivec2(0), size - 1);
+			vec3 color = texelFetch(uCurrent, tap, 0).rgb;
+			neighborhoodMin = min(neighborhoodMin, color);
+			neighborhoodMax = max(neighborhoodMax, color);
+
+			float depth = texelFetch(uRTDepth, tap, 0).r;
+			if (depth < closestDepth)
+			{
+				closestDepth = depth;
+				closestPixel = tap;
+			}
+		}
+	}
+
+	vec2 previousTexCoord = (vec2(pixel) + 0.5) / vec2(size) - texelFetch(uMotionVectors, closestPixel, 0).rg;
+	if (!uHistoryValid || any(lessThan(previousTexCoord, vec2(0.0))) || any(greaterThan(previousTexCoord, vec2(1.0))))
+	{
+		rt0 = vec4(current, 1.0);
+		return;
+	}
+
+	vec3 history = clamp(texture(uHistory, previousTexCoord).rgb, neighborhoodMin, neighborhoodMax);
+	rt0 = vec4(mix(current, history, uHistoryWeight), 1.0);
+}